@@ -3,6 +3,9 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
 #include <iomanip>
 #include <thread>
 #include <chrono>
@@ -13,6 +16,7 @@
 #include <limits>
 #include <random>
 #include <map>
+#include <unordered_map>
 #include <functional>
 
 // Color wheel with harmony suggestions
@@ -373,28 +377,157 @@ RGB HSVtoRGB(const HSV& hsv) {
     }
 }
 
-// Enhanced Color class for terminal-based painting
+// Packed 0xRRGGBBAA. The low byte says what kind of color it is rather
+// than how opaque: 0 is no color (drawn with RESET), 255 a 24-bit color,
+// and 1 to 16 a color of the terminal's ANSI palette (entry + 1), printed
+// with its palette code. Palette colors still carry an RGB, for exports.
+const uint32_t COLOR_NONE = 0;
+const uint32_t COLOR_24BIT = 255;
+
+inline uint32_t packRGBA(int r, int g, int b, int a = COLOR_24BIT) {
+    auto channel = [](int value) { return static_cast<uint32_t>(std::max(0, std::min(255, value))); };
+    return channel(r) << 24 | channel(g) << 16 | channel(b) << 8 | channel(a);
+}
+
+// Same rounding as RGB::toAnsiColor()
+inline uint32_t packRGB(const RGB& rgb) {
+    return packRGBA(static_cast<int>(rgb.r * 255), static_cast<int>(rgb.g * 255), static_cast<int>(rgb.b * 255));
+}
+
+// The 16 foreground colors of the ANSI palette, with the xterm defaults as RGB
+struct AnsiPaletteEntry {
+    const char* code;
+    int r, g, b;
+};
+
+const AnsiPaletteEntry ANSI_PALETTE[] = {
+    { FG_BLACK, 0, 0, 0 },
+    { FG_RED, 205, 0, 0 },
+    { FG_GREEN, 0, 205, 0 },
+    { FG_YELLOW, 205, 205, 0 },
+    { FG_BLUE, 0, 0, 238 },
+    { FG_MAGENTA, 205, 0, 205 },
+    { FG_CYAN, 0, 205, 205 },
+    { FG_WHITE, 229, 229, 229 },
+    { FG_BRIGHT_BLACK, 127, 127, 127 },
+    { FG_BRIGHT_RED, 255, 0, 0 },
+    { FG_BRIGHT_GREEN, 0, 255, 0 },
+    { FG_BRIGHT_YELLOW, 255, 255, 0 },
+    { FG_BRIGHT_BLUE, 92, 92, 255 },
+    { FG_BRIGHT_MAGENTA, 255, 0, 255 },
+    { FG_BRIGHT_CYAN, 0, 255, 255 },
+    { FG_BRIGHT_WHITE, 255, 255, 255 },
+};
+
+const int ANSI_PALETTE_SIZE = sizeof(ANSI_PALETTE) / sizeof(ANSI_PALETTE[0]);
+
+// Color of an ANSI foreground code (palette or 24-bit); RESET and anything
+// else is no color
+uint32_t parseAnsiColor(const std::string& code) {
+    for (int i = 0; i < ANSI_PALETTE_SIZE; i++) {
+        const AnsiPaletteEntry& entry = ANSI_PALETTE[i];
+        if (code == entry.code) {
+            return packRGBA(entry.r, entry.g, entry.b, i + 1);
+        }
+    }
+    int r, g, b;
+    if (std::sscanf(code.c_str(), "\033[38;2;%d;%d;%dm", &r, &g, &b) == 3) {
+        return packRGBA(r, g, b);
+    }
+    return COLOR_NONE;
+}
+
+std::string formatAnsiColor(uint32_t rgba) {
+    uint32_t kind = rgba & 0xFF;
+    if (kind == COLOR_NONE) {
+        return RESET;
+    }
+    if (kind <= static_cast<uint32_t>(ANSI_PALETTE_SIZE)) {
+        return ANSI_PALETTE[kind - 1].code;
+    }
+    return "\033[38;2;" + std::to_string(rgba >> 24) + ";" + std::to_string((rgba >> 16) & 0xFF) + ";" +
+           std::to_string((rgba >> 8) & 0xFF) + "m";
+}
+
+// Strings stored once and referred to by a 16-bit id. Id 0 is the string
+// the table starts with; when all ids are taken, new strings get id 0.
+class InternTable {
+public:
+    explicit InternTable(const std::string& first) {
+        intern(first);
+    }
+    
+    uint16_t intern(const std::string& text) {
+        auto it = ids.find(text);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        if (strings.size() > std::numeric_limits<uint16_t>::max()) {
+            return 0;
+        }
+        uint16_t id = static_cast<uint16_t>(strings.size());
+        strings.push_back(text);
+        ids.emplace(text, id);
+        return id;
+    }
+    
+    // A deque, so references stay valid as the table grows
+    const std::string& get(uint16_t id) const { return strings[id]; }
+    
+private:
+    std::deque<std::string> strings;
+    std::unordered_map<std::string, uint16_t> ids;
+};
+
+InternTable& glyphTable() {
+    static InternTable table(" ");
+    return table;
+}
+
+InternTable& colorNameTable() {
+    static InternTable table("None");
+    return table;
+}
+
+// Color of one painted cell: RGBA plus an interned glyph and name, 8 bytes
+// in all. The ANSI sequence is only made when the cell is printed.
 class Color {
 public:
-    Color() : symbol(" "), ansiColor(RESET), name("None") {}
+    Color() : rgba(COLOR_NONE), glyph(0), name(0) {}
     
+    // From an ANSI foreground code such as FG_RED, or RESET for no color
     Color(const std::string& symbol, const std::string& ansiColor, const std::string& name)
-        : symbol(symbol), ansiColor(ansiColor), name(name) {}
+        : rgba(parseAnsiColor(ansiColor)), glyph(glyphTable().intern(symbol)), name(colorNameTable().intern(name)) {}
     
-    const std::string& getSymbol() const { return symbol; }
-    const std::string& getAnsiColor() const { return ansiColor; }
-    const std::string& getName() const { return name; }
+    Color(const std::string& symbol, const RGB& rgb, const std::string& name)
+        : rgba(packRGB(rgb)), glyph(glyphTable().intern(symbol)), name(colorNameTable().intern(name)) {}
+    
+    const std::string& getSymbol() const { return glyphTable().get(glyph); }
+    std::string getAnsiColor() const { return formatAnsiColor(rgba); }
+    const std::string& getName() const { return colorNameTable().get(name); }
+    uint32_t getRGBA() const { return rgba; }
+    
+    // Same color and name drawn with another glyph
+    Color withSymbol(const std::string& symbol) const {
+        Color color = *this;
+        color.glyph = glyphTable().intern(symbol);
+        return color;
+    }
+    
+    bool hasSameName(const Color& other) const { return name == other.name; }
     
     std::string toString() const {
-        return ansiColor + symbol + RESET;
+        return getAnsiColor() + getSymbol() + RESET;
     }
     
 private:
-    std::string symbol;
-    std::string ansiColor;
-    std::string name;
+    uint32_t rgba;
+    uint16_t glyph;
+    uint16_t name;
 };
 
+static_assert(sizeof(Color) == 8, "a texture cell is 8 bytes");
+
 // Texture class for storing the painted pixels
 class Texture {
 public:
@@ -454,11 +587,7 @@ public:
                     color1.b * (1.0f - factor) + color2.b * factor
                 );
                 
-                // Convert RGB to ANSI color
-                std::string ansiColor = interpolatedRGB.toAnsiColor();
-                std::string colorName = interpolatedRGB.getColorName();
-                
-                setPixel(x, y, Color("*", ansiColor, colorName));
+                setPixel(x, y, Color("*", interpolatedRGB, interpolatedRGB.getColorName()));
             }
         }
     }
@@ -489,20 +618,28 @@ private:
         return x >= 0 && x < width && y >= 0 && y < height;
     }
     
-    // Recursive flood fill (be careful with stack overflow on large areas)
+    // Flood fill over cells with the target's color name. Iterative, so
+    // large canvases do not overflow the stack.
     void floodFill(int x, int y, const Color& targetColor, const Color& replacementColor) {
-        if (!isInBounds(x, y)) return;
-        
-        Color currentColor = getPixel(x, y);
-        if (currentColor.getName() != targetColor.getName()) return;
-        
-        setPixel(x, y, replacementColor);
-        
-        // Recursively fill adjacent pixels
-        floodFill(x+1, y, targetColor, replacementColor);
-        floodFill(x-1, y, targetColor, replacementColor);
-        floodFill(x, y+1, targetColor, replacementColor);
-        floodFill(x, y-1, targetColor, replacementColor);
+        // Filling a name with itself would never finish
+        if (replacementColor.hasSameName(targetColor)) return;
+        
+        std::vector<std::pair<int, int>> pending = { { x, y } };
+        while (!pending.empty()) {
+            std::pair<int, int> cell = pending.back();
+            pending.pop_back();
+            if (!isInBounds(cell.first, cell.second) || !getPixel(cell.first, cell.second).hasSameName(targetColor)) {
+                continue;
+            }
+            
+            setPixel(cell.first, cell.second, replacementColor);
+            
+            // Adjacent pixels
+            pending.push_back({ cell.first + 1, cell.second });
+            pending.push_back({ cell.first - 1, cell.second });
+            pending.push_back({ cell.first, cell.second + 1 });
+            pending.push_back({ cell.first, cell.second - 1 });
+        }
     }
 };
 
@@ -782,10 +919,7 @@ public:
         std::string symbol = symbols[rand() % symbols.size()];
         
         // Create a color with the new RGB values
-        std::string ansiCode = rgb.toAnsiColor();
-        std::string colorName = rgb.getColorName();
-        
-        Color rainbowColor(symbol, ansiCode, colorName);
+        Color rainbowColor(symbol, rgb, rgb.getColorName());
         layer.paint(x, y, rainbowColor, getSize());
     }
     
@@ -811,10 +945,7 @@ public:
             std::string symbol = symbols[rand() % symbols.size()];
             
             // Create a color with the new RGB values
-            std::string ansiCode = rgb.toAnsiColor();
-            std::string colorName = rgb.getColorName();
-            
-            Color rainbowColor(symbol, ansiCode, colorName);
+            Color rainbowColor(symbol, rgb, rgb.getColorName());
             
             // Paint with increasing size for animation effect
             float animSize = size * ((hueOffset + 30.0f) / 150.0f);
@@ -904,7 +1035,7 @@ private:
     void applyShape(Layer& layer, int x, int y, 
                    const std::vector<ShapePoint>& shape, const Color& color) {
         for (const auto& point : shape) {
-            Color pointColor(point.symbol, color.getAnsiColor(), color.getName());
+            Color pointColor = color.withSymbol(point.symbol);
             layer.paint(x + point.dx, y + point.dy, pointColor, size);
         }
     }
@@ -913,7 +1044,7 @@ private:
                             const std::vector<ShapePoint>& shape, 
                             const Color& color, float scale) {
         for (const auto& point : shape) {
-            Color pointColor(point.symbol, color.getAnsiColor(), color.getName());
+            Color pointColor = color.withSymbol(point.symbol);
             int scaledX = x + static_cast<int>(point.dx * scale);
             int scaledY = y + static_cast<int>(point.dy * scale);
             layer.paint(scaledX, scaledY, pointColor, size * scale);
@@ -1011,7 +1142,7 @@ public:
                 int dx = static_cast<int>(cos(rad) * radius);
                 int dy = static_cast<int>(sin(rad) * radius);
                 
-                Color splashColor("·", color.getAnsiColor(), color.getName());
+                Color splashColor = color.withSymbol("·");
                 layer.paint(x + dx, y + dy, splashColor, 0.5f);
             }
             animationDelay(30);
@@ -1060,7 +1191,7 @@ public:
                 int patternY = y + dy;
                 
                 std::string symbol = patterns[currentPattern](patternX, patternY);
-                Color patternColor(symbol, color.getAnsiColor(), color.getName());
+                Color patternColor = color.withSymbol(symbol);
                 
                 layer.paint(patternX, patternY, patternColor, size);
             }
@@ -1147,9 +1278,8 @@ private:
             float hue = static_cast<float>(std::rand() % 360);
             HSV hsv(hue, 0.9f, 0.9f);
             RGB rgb = HSVtoRGB(hsv);
-            std::string ansiColor = rgb.toAnsiColor();
             
-            Color sparkleColor(symbol, ansiColor, "Sparkle");
+            Color sparkleColor(symbol, rgb, "Sparkle");
             layer.paint(x + dx, y + dy, sparkleColor, 0.5f);
             
             if (useAnimation) {
@@ -1210,7 +1340,6 @@ private:
                 
                 HSV hsv(hue, 1.0f, 1.0f);
                 RGB rgb = HSVtoRGB(hsv);
-                std::string ansiColor = rgb.toAnsiColor();
                 
                 // Use different symbols based on distance
                 std::string symbol = "*";
@@ -1218,7 +1347,7 @@ private:
                 else if (dist <= 2 * length / 3) symbol = "*";
                 else symbol = "·";
                 
-                Color rayColor(symbol, ansiColor, "Rainbow");
+                Color rayColor(symbol, rgb, "Rainbow");
                 layer.paint(x + dx, y + dy, rayColor, 0.5f);
                 
                 if (useAnimation) {
@@ -1266,7 +1395,7 @@ public:
         // Draw each character of the text
         for (size_t i = 0; i < currentText.size(); i++) {
             std::string charStr(1, currentText[i]);
-            Color textColor(charStr, color.getAnsiColor(), color.getName());
+            Color textColor = color.withSymbol(charStr);
             layer.paint(x + i, y, textColor, size);
         }
     }
@@ -1280,7 +1409,7 @@ public:
         // Type out the text character by character
         for (size_t i = 0; i < currentText.size(); i++) {
             std::string charStr(1, currentText[i]);
-            Color textColor(charStr, color.getAnsiColor(), color.getName());
+            Color textColor = color.withSymbol(charStr);
             layer.paint(x + i, y, textColor, size);
             animationDelay(100); // Typing delay
         }
@@ -1521,11 +1650,9 @@ private:
                         int b = std::stoi(command.substr(5, 2), nullptr, 16);
                         
                         RGB rgb(r / 255.0f, g / 255.0f, b / 255.0f);
-                        std::string ansiColor = rgb.toAnsiColor();
-                        std::string colorName = rgb.getColorName();
                         
                         if (currentTool) {
-                            currentTool->setColor(Color("*", ansiColor, colorName));
+                            currentTool->setColor(Color("*", rgb, rgb.getColorName()));
                             std::cout << "Color set to: " << command << std::endl;
                         }
                     } catch (...) {
@@ -2016,10 +2143,9 @@ private:
         RGB newRgb(selectedColor.r / 255.0f, selectedColor.g / 255.0f, selectedColor.b / 255.0f);
         
         // Apply to the current tool
-        std::string ansiCode = newRgb.toAnsiColor();
         std::string newColorName = newRgb.getColorName();
         
-        Color newColor(toolColor.getSymbol(), ansiCode, newColorName);
+        Color newColor(toolColor.getSymbol(), newRgb, newColorName);
         currentTool->setColor(newColor);
         
         std::cout << BOLD << FG_GREEN << "✓ " << RESET 
@@ -2433,10 +2559,9 @@ private:
         for (int i = 0; i < 4; i++) {
             HSV borderHsv(i * 90.0f, 0.8f, 0.9f);
             RGB borderRgb = HSVtoRGB(borderHsv);
-            std::string borderColor = borderRgb.toAnsiColor();
             
             // Create a different color for each side
-            borderTool.setColor(Color("#", borderColor, "Border" + std::to_string(i)));
+            borderTool.setColor(Color("#", borderRgb, "Border" + std::to_string(i)));
             
             // Draw sides of a rectangle
             switch (i) {
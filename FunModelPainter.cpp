@@ -18,6 +18,9 @@
 #include "color_wheel.h"
 #include "color_wheel_app.cpp"
 
+// Shared memory-mapped OBJ reader
+#include "obj_reader.h"
+
 // ANSI color codes for terminal output
 #define RESET         "\033[0m"
 #define BOLD          "\033[1m"
@@ -752,58 +755,54 @@ public:
     Model() : loaded(false) {}
     
     bool loadFromOBJ(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
+        std::cout << FG_BRIGHT_CYAN << ICON_WAIT << " " << "Loading model from: " << filename << " -" << RESET << std::endl;
+        
+        // Memory-mapped, multithreaded OBJ loader (handles n-gons and negative indices)
+        obj_reader::ObjData obj;
+        if (!obj_reader::load(filename, obj)) {
             std::cerr << FG_BRIGHT_RED << ICON_WARNING << " " << "Failed to open file: " << filename << RESET << std::endl;
             return false;
         }
         
-        std::cout << FG_BRIGHT_CYAN << ICON_WAIT << " " << "Loading model from: " << filename << " -" << RESET << std::endl;
-        
         vertices.clear();
         uvs.clear();
         faces.clear();
         
-        std::string line;
-        while (std::getline(file, line)) {
-            if (line.empty() || line[0] == '#') continue;
-            
-            std::istringstream iss(line);
-            std::string token;
-            iss >> token;
+        vertices.reserve(obj.vertexCount());
+        for (size_t i = 0; i < obj.vertexCount(); i++) {
+            const float* p = &obj.positions[i * 3];
+            vertices.push_back(Vertex(p[0], p[1], p[2]));
+        }
+        
+        uvs.reserve(obj.texcoordCount());
+        for (size_t i = 0; i < obj.texcoordCount(); i++) {
+            uvs.push_back(UV(obj.texcoords[i * 2], obj.texcoords[i * 2 + 1]));
+        }
+        
+        faces.reserve(obj.faceCount());
+        for (size_t f = 0; f < obj.faceCount(); f++) {
+            const obj_reader::Corner* corners = obj.faceCorners(f);
+            std::vector<int> vertexIndices, uvIndices;
+            vertexIndices.reserve(obj.faceSize(f));
             
-            if (token == "v") {
-                float x, y, z;
-                iss >> x >> y >> z;
-                vertices.push_back(Vertex(x, y, z));
-            } else if (token == "vt") {
-                float u, v;
-                iss >> u >> v;
-                uvs.push_back(UV(u, v));
-            } else if (token == "f") {
-                std::string faceToken;
-                std::vector<int> vertexIndices, uvIndices;
-                
-                while (iss >> faceToken) {
-                    // Parse face format: v/vt/vn or v/vt or v//vn or v
-                    std::replace(faceToken.begin(), faceToken.end(), '/', ' ');
-                    std::istringstream faceIss(faceToken);
-                    int vi, vti, vni;
-                    
-                    faceIss >> vi;
-                    vertexIndices.push_back(vi - 1);  // OBJ indices are 1-based
-                    
-                    if (faceIss >> vti) {
-                        uvIndices.push_back(vti - 1);  // OBJ indices are 1-based
-                    }
+            bool valid = true;
+            for (uint32_t c = 0; c < obj.faceSize(f); c++) {
+                if (corners[c].v < 0) {
+                    valid = false;
+                    break;
                 }
-                
+                vertexIndices.push_back(corners[c].v);
+                if (corners[c].vt >= 0) {
+                    uvIndices.push_back(corners[c].vt);
+                }
+            }
+            
+            // Skip faces with invalid vertex indices
+            if (valid) {
                 faces.push_back(Face(vertexIndices, uvIndices));
             }
         }
         
-        file.close();
-        
         loaded = !vertices.empty();
         name = filename;
         
@@ -10,6 +10,7 @@
 #include <map>
 #include <memory>
 #include "../include/color_wheel.h"
+#include "obj_reader.h"
 
 /**
  * ShaderSketch Simple GUI Implementation
@@ -90,9 +91,9 @@ struct Model {
     float positionZ = 0.0f;
     
     bool loadFromOBJ(const std::string& filename) {
-        // Very simple OBJ loader
-        std::ifstream file(filename);
-        if (!file.is_open()) {
+        // Memory-mapped, multithreaded OBJ loader
+        obj_reader::ObjData obj;
+        if (!obj_reader::load(filename, obj)) {
             std::cerr << "Failed to open OBJ file: " << filename << std::endl;
             createDefaultCube();
             return false;
@@ -102,70 +103,35 @@ struct Model {
         triangles.clear();
         uvCoords.clear();
         
-        std::string line;
-        std::vector<std::pair<float, float>> tempUVs;
+        vertices.reserve(obj.vertexCount());
+        for (size_t i = 0; i < obj.vertexCount(); i++) {
+            const float* p = &obj.positions[i * 3];
+            vertices.push_back(Vertex(p[0], p[1], p[2]));
+        }
         
-        while (std::getline(file, line)) {
-            std::istringstream iss(line);
-            std::string type;
-            iss >> type;
+        // Faces are fan-triangulated so n-gons are supported
+        for (size_t f = 0; f < obj.faceCount(); f++) {
+            const obj_reader::Corner* corners = obj.faceCorners(f);
+            uint32_t cornerCount = obj.faceSize(f);
             
-            if (type == "v") {
-                // Vertex
-                float x, y, z;
-                iss >> x >> y >> z;
-                vertices.push_back(Vertex(x, y, z));
-            }
-            else if (type == "vt") {
-                // Texture coordinate
-                float u, v;
-                iss >> u >> v;
-                tempUVs.push_back(std::make_pair(u, v));
-            }
-            else if (type == "f") {
-                // Face (assuming triangles)
-                std::string v1, v2, v3;
-                iss >> v1 >> v2 >> v3;
-                
-                // Parse face indices (format: vertex/texture/normal)
-                auto parseVertex = [](const std::string& str) -> std::pair<int, int> {
-                    std::istringstream viss(str);
-                    std::string indexStr;
-                    std::vector<int> indices;
-                    
-                    while (std::getline(viss, indexStr, '/')) {
-                        if (indexStr.empty()) {
-                            indices.push_back(0);
-                        } else {
-                            indices.push_back(std::stoi(indexStr));
-                        }
-                    }
-                    
-                    // Return vertex and texture indices (1-based in OBJ format)
-                    return std::make_pair(
-                        indices.size() > 0 ? indices[0] - 1 : 0,
-                        indices.size() > 1 ? indices[1] - 1 : 0
-                    );
-                };
-                
-                auto [v1idx, vt1] = parseVertex(v1);
-                auto [v2idx, vt2] = parseVertex(v2);
-                auto [v3idx, vt3] = parseVertex(v3);
+            for (uint32_t c = 1; c + 1 < cornerCount; c++) {
+                const obj_reader::Corner* tri[3] = { &corners[0], &corners[c], &corners[c + 1] };
+                if (tri[0]->v < 0 || tri[1]->v < 0 || tri[2]->v < 0) {
+                    continue;
+                }
                 
-                Triangle t(v1idx, v2idx, v3idx);
-                triangles.push_back(t);
+                triangles.push_back(Triangle(tri[0]->v, tri[1]->v, tri[2]->v));
                 
                 // Store UV coordinates for this triangle
-                if (!tempUVs.empty()) {
-                    if (vt1 >= 0 && vt1 < static_cast<int>(tempUVs.size())) uvCoords.push_back(tempUVs[vt1]);
-                    if (vt2 >= 0 && vt2 < static_cast<int>(tempUVs.size())) uvCoords.push_back(tempUVs[vt2]);
-                    if (vt3 >= 0 && vt3 < static_cast<int>(tempUVs.size())) uvCoords.push_back(tempUVs[vt3]);
+                for (const obj_reader::Corner* corner : tri) {
+                    if (corner->vt >= 0) {
+                        uvCoords.push_back(std::make_pair(obj.texcoords[corner->vt * 2],
+                                                          obj.texcoords[corner->vt * 2 + 1]));
+                    }
                 }
             }
         }
         
-        file.close();
-        
         if (vertices.empty() || triangles.empty()) {
             std::cerr << "Empty or invalid OBJ file: " << filename << std::endl;
             createDefaultCube();
@@ -0,0 +1,83 @@
+/**
+ * OBJ reader throughput benchmark
+ *
+ * Usage: obj_bench [model.obj] [runs]
+ *
+ * Without a file argument a synthetic grid mesh (~64 MB) is generated in the
+ * temp directory. Reports MB/s for 1 thread and for every power of two up to
+ * the number of hardware threads.
+ *
+ * Build: g++ -std=c++17 -O2 obj_bench.cpp -o obj_bench -pthread
+ */
+#include "obj_reader.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <filesystem>
+#include <cstdlib>
+
+// Write a grid of quads with positions, texture coordinates and normals
+static std::string generateGridOBJ(int gridSize) {
+    std::string path = (std::filesystem::temp_directory_path() / "obj_bench_grid.obj").string();
+    std::ofstream file(path, std::ios::binary);
+
+    file << std::fixed << std::setprecision(6);
+    for (int y = 0; y <= gridSize; y++) {
+        for (int x = 0; x <= gridSize; x++) {
+            float u = static_cast<float>(x) / gridSize;
+            float v = static_cast<float>(y) / gridSize;
+            file << "v " << (u * 2.0f - 1.0f) << " " << (v * 2.0f - 1.0f) << " " << (u * v) << "\n";
+            file << "vt " << u << " " << v << "\n";
+        }
+    }
+    file << "vn 0.000000 0.000000 1.000000\n";
+
+    int stride = gridSize + 1;
+    for (int y = 0; y < gridSize; y++) {
+        for (int x = 0; x < gridSize; x++) {
+            int i = y * stride + x + 1;
+            file << "f " << i << "/" << i << "/1 "
+                 << (i + 1) << "/" << (i + 1) << "/1 "
+                 << (i + stride + 1) << "/" << (i + stride + 1) << "/1 "
+                 << (i + stride) << "/" << (i + stride) << "/1\n";
+        }
+    }
+
+    return path;
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "";
+    int runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    if (path.empty()) {
+        std::cout << "Generating synthetic grid mesh..." << std::endl;
+        path = generateGridOBJ(700);
+    }
+
+    obj_reader::ObjData data;
+    if (!obj_reader::load(path, data)) {
+        std::cerr << "Failed to open OBJ file: " << path << std::endl;
+        return 1;
+    }
+
+    std::cout << path << ": " << data.vertexCount() << " vertices, "
+              << data.texcoordCount() << " texcoords, "
+              << data.normalCount() << " normals, "
+              << data.faceCount() << " faces" << std::endl;
+
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; ; threads *= 2) {
+        threads = std::min(threads, maxThreads);
+
+        obj_reader::BenchmarkResult result = obj_reader::benchmark(path, threads, runs);
+        std::cout << std::setw(3) << threads << " thread(s): "
+                  << std::fixed << std::setprecision(1) << std::setw(8) << result.megabytesPerSecond << " MB/s ("
+                  << std::setprecision(2) << result.bestSeconds * 1000.0 << " ms for "
+                  << result.bytes / (1024.0 * 1024.0) << " MB)" << std::endl;
+
+        if (threads == maxThreads) break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,465 @@
+#ifndef OBJ_READER_H
+#define OBJ_READER_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Shared OBJ reader for the standalone painters.
+//
+// The file is memory-mapped, split into line-aligned chunks that are parsed
+// in parallel with std::from_chars, and the chunks are then merged with
+// index fix-ups. Supports v/vt/vn, faces with any number of corners (n-gons)
+// in all four corner formats (v, v/vt, v//vn, v/vt/vn), and negative
+// (relative) indices. Unknown statements (o, g, s, usemtl, ...) are skipped.
+namespace obj_reader {
+
+// One face corner, 0-based; -1 means the attribute was not given
+struct Corner {
+    int v = -1;
+    int vt = -1;
+    int vn = -1;
+};
+
+// Parsed OBJ contents
+struct ObjData {
+    std::vector<float> positions;   // x, y, z per vertex
+    std::vector<float> texcoords;   // u, v per texture coordinate
+    std::vector<float> normals;     // x, y, z per normal
+    std::vector<Corner> corners;    // face corners of all faces
+    std::vector<uint32_t> faceStart; // faces + 1 offsets into corners
+
+    size_t vertexCount() const { return positions.size() / 3; }
+    size_t texcoordCount() const { return texcoords.size() / 2; }
+    size_t normalCount() const { return normals.size() / 3; }
+    size_t faceCount() const { return faceStart.empty() ? 0 : faceStart.size() - 1; }
+
+    // Number of corners in a face (3 for triangles, more for n-gons)
+    uint32_t faceSize(size_t face) const { return faceStart[face + 1] - faceStart[face]; }
+    const Corner* faceCorners(size_t face) const { return corners.data() + faceStart[face]; }
+
+    void clear() {
+        positions.clear();
+        texcoords.clear();
+        normals.clear();
+        corners.clear();
+        faceStart.clear();
+    }
+};
+
+namespace detail {
+
+// Corner attribute flags for indices that are relative to the chunk start
+enum : uint8_t {
+    REL_V = 1 << 0,
+    REL_VT = 1 << 1,
+    REL_VN = 1 << 2
+};
+
+// Result of parsing one line-aligned chunk
+struct Chunk {
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+    std::vector<float> normals;
+    std::vector<Corner> corners;
+    std::vector<uint8_t> relative;   // REL_* flags per corner
+    std::vector<uint32_t> faceSizes;
+};
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) ++p;
+    return p;
+}
+
+inline const char* skipLine(const char* p, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return nl ? nl + 1 : end;
+}
+
+inline const char* parseFloat(const char* p, const char* end, float& value) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') ++p; // from_chars does not accept a leading '+'
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        value = 0.0f;
+        return p;
+    }
+    return result.ptr;
+}
+
+// Parse one index of a corner. Positive indices are absolute (1-based);
+// negative ones count back from the elements seen so far in this chunk and
+// are flagged so the merge step can add the chunk's base offset.
+inline const char* parseIndex(const char* p, const char* end, int localCount,
+                              int& index, uint8_t& flags, uint8_t relFlag) {
+    int raw = 0;
+    const char* digits = (p < end && *p == '+') ? p + 1 : p;
+    auto result = std::from_chars(digits, end, raw);
+    if (result.ec != std::errc() || raw == 0) {
+        index = -1;
+        return result.ec == std::errc() ? result.ptr : p;
+    }
+    if (raw > 0) {
+        index = raw - 1;
+    } else {
+        index = localCount + raw;
+        flags |= relFlag;
+    }
+    return result.ptr;
+}
+
+inline void parseChunk(const char* p, const char* end, Chunk& chunk) {
+    // Rough reservation: most OBJ lines are 25-40 bytes
+    size_t estimatedLines = static_cast<size_t>(end - p) / 32;
+    chunk.positions.reserve(estimatedLines * 3 / 2);
+    chunk.corners.reserve(estimatedLines * 3 / 2);
+    chunk.relative.reserve(estimatedLines * 3 / 2);
+    chunk.faceSizes.reserve(estimatedLines / 2);
+
+    while (p < end) {
+        p = skipBlanks(p, end);
+        if (p >= end) break;
+
+        char c = *p;
+        if (c == 'v' && p + 1 < end) {
+            char next = p[1];
+            if (isBlank(next)) {
+                float x, y, z;
+                p = parseFloat(p + 2, end, x);
+                p = parseFloat(p, end, y);
+                p = parseFloat(p, end, z);
+                chunk.positions.insert(chunk.positions.end(), {x, y, z});
+            } else if (next == 't' && p + 2 < end && isBlank(p[2])) {
+                float u, v;
+                p = parseFloat(p + 3, end, u);
+                p = parseFloat(p, end, v);
+                chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+            } else if (next == 'n' && p + 2 < end && isBlank(p[2])) {
+                float x, y, z;
+                p = parseFloat(p + 3, end, x);
+                p = parseFloat(p, end, y);
+                p = parseFloat(p, end, z);
+                chunk.normals.insert(chunk.normals.end(), {x, y, z});
+            }
+        } else if (c == 'f' && p + 1 < end && isBlank(p[1])) {
+            int vCount = static_cast<int>(chunk.positions.size() / 3);
+            int vtCount = static_cast<int>(chunk.texcoords.size() / 2);
+            int vnCount = static_cast<int>(chunk.normals.size() / 3);
+            uint32_t cornerCount = 0;
+
+            p += 2;
+            for (;;) {
+                p = skipBlanks(p, end);
+                if (p >= end || *p == '\n' || *p == '#') break;
+
+                Corner corner;
+                uint8_t flags = 0;
+                const char* start = p;
+                p = parseIndex(p, end, vCount, corner.v, flags, REL_V);
+                if (p < end && *p == '/') {
+                    ++p;
+                    if (p < end && *p != '/') {
+                        p = parseIndex(p, end, vtCount, corner.vt, flags, REL_VT);
+                    }
+                    if (p < end && *p == '/') {
+                        ++p;
+                        p = parseIndex(p, end, vnCount, corner.vn, flags, REL_VN);
+                    }
+                }
+                if (p == start) break; // Malformed token, give up on this line
+
+                chunk.corners.push_back(corner);
+                chunk.relative.push_back(flags);
+                cornerCount++;
+            }
+
+            if (cornerCount >= 3) {
+                chunk.faceSizes.push_back(cornerCount);
+            } else {
+                // Degenerate face: drop its corners
+                chunk.corners.resize(chunk.corners.size() - cornerCount);
+                chunk.relative.resize(chunk.relative.size() - cornerCount);
+            }
+        }
+
+        p = skipLine(p, end);
+    }
+}
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            close();
+            return false;
+        }
+        length = static_cast<size_t>(fileSize.QuadPart);
+        if (length == 0) return true;
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            close();
+            return false;
+        }
+        bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close();
+            return false;
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length == 0) return true;
+
+        void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            close();
+            return false;
+        }
+        madvise(address, length, MADV_SEQUENTIAL);
+        bytes = static_cast<const char*>(address);
+#endif
+        if (!bytes) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// Files below this size are parsed on the calling thread
+const size_t MIN_PARALLEL_BYTES = 1 << 20;
+const size_t MIN_CHUNK_BYTES = 256 << 10;
+
+} // namespace detail
+
+// Parse OBJ text that is already in memory. threadCount == 0 picks the
+// number of hardware threads.
+inline void parse(const char* data, size_t size, ObjData& out, unsigned threadCount = 0) {
+    out.clear();
+    if (!data || size == 0) return;
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (size < detail::MIN_PARALLEL_BYTES) {
+        threadCount = 1;
+    }
+    threadCount = static_cast<unsigned>(std::min<size_t>(threadCount,
+        std::max<size_t>(1, size / detail::MIN_CHUNK_BYTES)));
+
+    // Split into line-aligned ranges
+    const char* end = data + size;
+    std::vector<const char*> bounds(threadCount + 1);
+    bounds[0] = data;
+    bounds[threadCount] = end;
+    for (unsigned i = 1; i < threadCount; i++) {
+        const char* guess = data + (size / threadCount) * i;
+        guess = std::max(guess, bounds[i - 1]);
+        bounds[i] = guess < end ? detail::skipLine(guess, end) : end;
+    }
+
+    // Parse chunks in parallel
+    std::vector<detail::Chunk> chunks(threadCount);
+    if (threadCount == 1) {
+        detail::parseChunk(data, end, chunks[0]);
+    } else {
+        std::vector<std::thread> workers;
+        workers.reserve(threadCount - 1);
+        for (unsigned i = 1; i < threadCount; i++) {
+            workers.emplace_back(detail::parseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+        }
+        detail::parseChunk(bounds[0], bounds[1], chunks[0]);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Prefix sums give each chunk its base offsets in the merged arrays
+    struct Base {
+        size_t positions = 0, texcoords = 0, normals = 0, corners = 0, faces = 0;
+    };
+    std::vector<Base> bases(threadCount + 1);
+    for (unsigned i = 0; i < threadCount; i++) {
+        bases[i + 1].positions = bases[i].positions + chunks[i].positions.size();
+        bases[i + 1].texcoords = bases[i].texcoords + chunks[i].texcoords.size();
+        bases[i + 1].normals = bases[i].normals + chunks[i].normals.size();
+        bases[i + 1].corners = bases[i].corners + chunks[i].corners.size();
+        bases[i + 1].faces = bases[i].faces + chunks[i].faceSizes.size();
+    }
+
+    const Base& total = bases[threadCount];
+    out.positions.resize(total.positions);
+    out.texcoords.resize(total.texcoords);
+    out.normals.resize(total.normals);
+    out.corners.resize(total.corners);
+    out.faceStart.resize(total.faces + 1);
+    out.faceStart[total.faces] = static_cast<uint32_t>(total.corners);
+
+    // Merge chunks in parallel, fixing up relative indices
+    auto merge = [&](unsigned i) {
+        const detail::Chunk& chunk = chunks[i];
+        const Base& base = bases[i];
+
+        std::copy(chunk.positions.begin(), chunk.positions.end(), out.positions.begin() + base.positions);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), out.texcoords.begin() + base.texcoords);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), out.normals.begin() + base.normals);
+
+        int vBase = static_cast<int>(base.positions / 3);
+        int vtBase = static_cast<int>(base.texcoords / 2);
+        int vnBase = static_cast<int>(base.normals / 3);
+        Corner* dst = out.corners.data() + base.corners;
+        for (size_t c = 0; c < chunk.corners.size(); c++) {
+            Corner corner = chunk.corners[c];
+            uint8_t flags = chunk.relative[c];
+            if (flags & detail::REL_V) corner.v += vBase;
+            if (flags & detail::REL_VT) corner.vt += vtBase;
+            if (flags & detail::REL_VN) corner.vn += vnBase;
+            dst[c] = corner;
+        }
+
+        uint32_t offset = static_cast<uint32_t>(base.corners);
+        uint32_t* starts = out.faceStart.data() + base.faces;
+        for (size_t f = 0; f < chunk.faceSizes.size(); f++) {
+            starts[f] = offset;
+            offset += chunk.faceSizes[f];
+        }
+    };
+
+    if (threadCount == 1) {
+        merge(0);
+    } else {
+        std::vector<std::thread> workers;
+        workers.reserve(threadCount - 1);
+        for (unsigned i = 1; i < threadCount; i++) {
+            workers.emplace_back(merge, i);
+        }
+        merge(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Invalid (out-of-range) indices become -1
+    int vCount = static_cast<int>(out.vertexCount());
+    int vtCount = static_cast<int>(out.texcoordCount());
+    int vnCount = static_cast<int>(out.normalCount());
+    for (Corner& corner : out.corners) {
+        if (corner.v < 0 || corner.v >= vCount) corner.v = -1;
+        if (corner.vt < 0 || corner.vt >= vtCount) corner.vt = -1;
+        if (corner.vn < 0 || corner.vn >= vnCount) corner.vn = -1;
+    }
+}
+
+// Memory-map and parse an OBJ file. Returns false if the file can't be opened.
+inline bool load(const std::string& path, ObjData& out, unsigned threadCount = 0) {
+    detail::MappedFile file;
+    if (!file.open(path)) {
+        out.clear();
+        return false;
+    }
+    parse(file.data(), file.size(), out, threadCount);
+    return true;
+}
+
+// Throughput measurement for a file, in MB/s (best of several runs)
+struct BenchmarkResult {
+    size_t bytes = 0;
+    double bestSeconds = 0.0;
+    double megabytesPerSecond = 0.0;
+};
+
+inline BenchmarkResult benchmark(const std::string& path, unsigned threadCount = 0, int runs = 5) {
+    BenchmarkResult result;
+    detail::MappedFile file;
+    if (!file.open(path)) return result;
+
+    ObjData data;
+    result.bytes = file.size();
+    result.bestSeconds = 1e30;
+    for (int i = 0; i < std::max(1, runs); i++) {
+        auto start = std::chrono::steady_clock::now();
+        parse(file.data(), file.size(), data, threadCount);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        result.bestSeconds = std::min(result.bestSeconds, elapsed.count());
+    }
+    if (result.bestSeconds > 0.0) {
+        result.megabytesPerSecond = (result.bytes / (1024.0 * 1024.0)) / result.bestSeconds;
+    }
+    return result;
+}
+
+} // namespace obj_reader
+
+#endif // OBJ_READER_H
@@ -0,0 +1,1033 @@
+/**
+ * Painter benchmark suite
+ *
+ * Usage: painter_bench [--json results.json] [--filter text] [--runs N] [--quick] [--threads]
+ *
+ * Microbenchmarks time one operation over a range of sizes: brush dabs per
+ * radius, flood fills per area, layer resizes, compositing per layer count,
+ * mesh bounds per vertex count, ray picks per triangle count, OBJ parsing
+ * per MB and PNG encoding per megapixel.
+ * Macrobenchmarks replay a generated stroke session through the paint tools
+ * and save and reopen a project. Nothing here needs a window or GL context.
+ *
+ * paint_frame paints and composites frame after frame of a stroke that is
+ * already under way, the steady state of the editor. It fails if those
+ * frames allocate from the heap at all.
+ *
+ * draw_commands culls a row of meshes and checks the indirect draw commands
+ * GeometryBuffer builds for the ones left (count, firstIndex, baseVertex,
+ * mesh index) against offsets summed up separately.
+ *
+ * determinism runs fills, resizes, compositing, mesh bounds and a
+ * parallelFor reduction with 1 to all threads and fails unless every thread
+ * count gives the same bytes. --threads runs the fill, resize, composite and
+ * mesh_bounds cases once per thread count (1, 2, 4, ... all), to see how
+ * they scale.
+ *
+ * Every case runs N times (default 5) and reports the median and fastest
+ * run, and the heap allocations per operation. --json writes the same
+ * results as one record per case, so the files of two commits can be
+ * diffed; --filter only runs cases whose name contains the text; --quick
+ * drops the largest sizes. A failed check makes the exit code 1.
+ *
+ * Build: cmake --build build --target painter_bench
+ */
+#include "obj_reader.h"
+#include "compositor.h"
+#include "layer.h"
+#include "model.h"
+#include "paint_tool.h"
+#include "png_codec.h"
+#include "project.h"
+#include "texture.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+
+namespace {
+    // Every heap allocation of the process, counted by the operators new below
+    std::atomic<uint64_t> heapAllocations(0);
+
+    void* allocate(size_t size, size_t alignment) noexcept {
+        heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        size = size ? size : 1;
+        if (alignment <= alignof(std::max_align_t)) {
+            return std::malloc(size);
+        }
+
+        // Over-aligned: room to align, with the block's start stored just
+        // before the aligned pointer (aligned_alloc is not on every platform)
+        void* block = std::malloc(size + alignment + sizeof(void*));
+        if (!block) {
+            return nullptr;
+        }
+        uintptr_t start = reinterpret_cast<uintptr_t>(block) + sizeof(void*);
+        void* memory = reinterpret_cast<void*>((start + alignment - 1) & ~(uintptr_t(alignment) - 1));
+        static_cast<void**>(memory)[-1] = block;
+        return memory;
+    }
+
+    void release(void* memory) noexcept {
+        std::free(memory);
+    }
+
+    void releaseAligned(void* memory, std::align_val_t alignment) noexcept {
+        if (memory && static_cast<size_t>(alignment) > alignof(std::max_align_t)) {
+            memory = static_cast<void**>(memory)[-1];
+        }
+        std::free(memory);
+    }
+
+    void* allocateOrThrow(size_t size, size_t alignment) {
+        if (void* memory = allocate(size, alignment)) {
+            return memory;
+        }
+        throw std::bad_alloc();
+    }
+}
+
+// All forms of new and delete, so that no allocation path goes uncounted;
+// the sized, array, aligned and nothrow ones only differ in how they allocate
+
+void* operator new(size_t size) {
+    return allocateOrThrow(size, 0);
+}
+
+void* operator new[](size_t size) {
+    return allocateOrThrow(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept {
+    release(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    release(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    release(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    release(memory);
+}
+
+void operator delete(void* memory, std::align_val_t alignment) noexcept {
+    releaseAligned(memory, alignment);
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept {
+    releaseAligned(memory, alignment);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept {
+    releaseAligned(memory, alignment);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept {
+    releaseAligned(memory, alignment);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    release(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    release(memory);
+}
+
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    releaseAligned(memory, alignment);
+}
+
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    releaseAligned(memory, alignment);
+}
+
+namespace {
+    struct Options {
+        std::string jsonPath;
+        std::string filter;
+        int runs = 5;
+        bool quick = false;
+        bool threadSweep = false;
+    };
+
+    // One benchmark case: `operations` of something per run, and optionally
+    // `amount` units of work per run for a throughput figure
+    struct Result {
+        std::string suite;
+        std::string name;
+        std::string parameter;
+        size_t operations = 1;
+        double amount = 0.0;
+        std::string unit;
+        std::vector<double> milliseconds;
+        uint64_t allocations = 0;       // over all runs
+        bool skipped = false;
+        bool checked = false;           // a check of results, not timed
+        bool passed = false;
+
+        double median() const {
+            std::vector<double> sorted = milliseconds;
+            std::sort(sorted.begin(), sorted.end());
+            return sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+        }
+
+        double best() const {
+            return milliseconds.empty() ? 0.0 : *std::min_element(milliseconds.begin(), milliseconds.end());
+        }
+
+        double allocationsPerOp() const {
+            return milliseconds.empty() ? 0.0 : static_cast<double>(allocations) / milliseconds.size() / operations;
+        }
+    };
+
+    class Suite {
+    public:
+        explicit Suite(const Options& options) : options(options) {}
+
+        bool wants(const std::string& name) const {
+            return options.filter.empty() || name.find(options.filter) != std::string::npos;
+        }
+
+        bool quick() const { return options.quick; }
+
+        // Time `body` options.runs times; `prepare` runs untimed before each run
+        const Result& run(const std::string& suite, const std::string& name, const std::string& parameter,
+                          size_t operations, double amount, const std::string& unit, const std::function<void()>& body,
+                          const std::function<void()>& prepare = nullptr) {
+            Result result{ suite, name, parameter, operations, amount, unit, {}, 0, false };
+            for (int i = 0; i < options.runs; i++) {
+                if (prepare) {
+                    prepare();
+                }
+                uint64_t allocations = heapAllocations.load(std::memory_order_relaxed);
+                auto start = std::chrono::steady_clock::now();
+                body();
+                auto end = std::chrono::steady_clock::now();
+                result.allocations += heapAllocations.load(std::memory_order_relaxed) - allocations;
+                result.milliseconds.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            }
+            print(result);
+            results.push_back(std::move(result));
+            return results.back();
+        }
+
+        void skip(const std::string& suite, const std::string& name, const std::string& parameter) {
+            Result result{ suite, name, parameter, 0, 0.0, "", {}, 0, true };
+            print(result);
+            results.push_back(std::move(result));
+        }
+
+        void check(const std::string& suite, const std::string& name, const std::string& parameter, bool passed,
+                   const std::string& message) {
+            Result result{ suite, name, parameter, 0, 0.0, "", {}, 0, false, true, passed };
+            print(result);
+            results.push_back(std::move(result));
+            if (!passed) {
+                fail(name, parameter + ": " + message);
+            }
+        }
+
+        // A case whose results are checked found them wrong; main() then exits with 1
+        void fail(const std::string& name, const std::string& message) {
+            std::cerr << name << ": FAILED: " << message << std::endl;
+            failures++;
+        }
+
+        size_t getFailures() const { return failures; }
+
+        bool writeJSON(const std::string& path) const;
+
+    private:
+        const Options& options;
+        std::vector<Result> results;
+        size_t failures = 0;
+
+        static void print(const Result& result) {
+            std::cout << std::left << std::setw(16) << result.name << std::setw(18) << result.parameter << std::right;
+            if (result.skipped) {
+                std::cout << "  skipped" << std::endl;
+                return;
+            }
+            if (result.checked) {
+                std::cout << (result.passed ? "  ok" : "  FAILED") << std::endl;
+                return;
+            }
+            double median = result.median();
+            std::cout << std::fixed << std::setprecision(3) << std::setw(12) << median << " ms"
+                      << std::setw(12) << median * 1000.0 / result.operations << " us/op"
+                      << std::setprecision(1) << std::setw(10) << result.allocationsPerOp() << " allocs/op";
+            if (result.amount > 0.0 && median > 0.0) {
+                std::cout << std::setprecision(1) << std::setw(12) << result.amount / (median / 1000.0) << " "
+                          << result.unit;
+            }
+            std::cout << std::endl;
+        }
+    };
+
+    bool Suite::writeJSON(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "Failed to write benchmark results: " << path << std::endl;
+            return false;
+        }
+
+        // Names and units are plain identifiers, so they need no escaping
+        out << std::setprecision(6) << "{\n\"threads\": " << ThreadPool::shared().getThreadCount()
+            << ",\n\"runs\": " << options.runs << ",\n\"results\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            out << (i ? "," : "") << "\n{\"suite\":\"" << result.suite << "\",\"name\":\"" << result.name
+                << "\",\"parameter\":\"" << result.parameter << "\"";
+            if (result.skipped) {
+                out << ",\"skipped\":true}";
+                continue;
+            }
+            if (result.checked) {
+                out << ",\"passed\":" << (result.passed ? "true" : "false") << "}";
+                continue;
+            }
+            double median = result.median();
+            out << ",\"operations\":" << result.operations << ",\"median_ms\":" << median
+                << ",\"best_ms\":" << result.best() << ",\"us_per_op\":" << median * 1000.0 / result.operations
+                << ",\"allocations_per_op\":" << result.allocationsPerOp();
+            if (result.amount > 0.0 && median > 0.0) {
+                out << ",\"throughput\":" << result.amount / (median / 1000.0) << ",\"unit\":\"" << result.unit
+                    << "\"";
+            }
+            out << ",\"runs_ms\":[";
+            for (size_t r = 0; r < result.milliseconds.size(); r++) {
+                out << (r ? "," : "") << result.milliseconds[r];
+            }
+            out << "]}";
+        }
+        out << "\n]\n}\n";
+
+        if (!out) {
+            std::cerr << "Failed to write benchmark results: " << path << std::endl;
+            return false;
+        }
+        std::cout << "Wrote " << results.size() << " results to " << path << std::endl;
+        return true;
+    }
+
+    // Transparent RGBA layer with soft round strokes, like painted layers
+    std::vector<unsigned char> generateLayer(int size, unsigned seed) {
+        std::vector<unsigned char> rgba(static_cast<size_t>(size) * size * 4, 0);
+        std::mt19937 random(seed);
+
+        for (int stroke = 0; stroke < 300; stroke++) {
+            int cx = random() % size;
+            int cy = random() % size;
+            int radius = 8 + random() % std::max(1, size / 32);
+            unsigned char r = random(), g = random(), b = random();
+
+            for (int y = std::max(0, cy - radius); y < std::min(size, cy + radius); y++) {
+                for (int x = std::max(0, cx - radius); x < std::min(size, cx + radius); x++) {
+                    int distance = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                    if (distance < radius * radius) {
+                        unsigned char* pixel = &rgba[(static_cast<size_t>(y) * size + x) * 4];
+                        pixel[0] = r;
+                        pixel[1] = g;
+                        pixel[2] = b;
+                        pixel[3] = static_cast<unsigned char>(
+                            255 * (1.0f - static_cast<float>(distance) / (radius * radius)));
+                    }
+                }
+            }
+        }
+
+        return rgba;
+    }
+
+    // Bumpy grid of gridSize x gridSize quads over [-1, 1] in x and y
+    MeshData generateGrid(int gridSize) {
+        MeshData grid;
+        int stride = gridSize + 1;
+        grid.vertices.reserve(static_cast<size_t>(stride) * stride);
+        for (int y = 0; y <= gridSize; y++) {
+            for (int x = 0; x <= gridSize; x++) {
+                float u = static_cast<float>(x) / gridSize;
+                float v = static_cast<float>(y) / gridSize;
+                Vertex vertex;
+                vertex.Position = glm::vec3(u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.1f * std::sin(u * 12.0f) * v);
+                vertex.Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+                vertex.TexCoords = glm::vec2(u, v);
+                grid.vertices.push_back(vertex);
+            }
+        }
+
+        grid.indices.reserve(static_cast<size_t>(gridSize) * gridSize * 6);
+        for (int y = 0; y < gridSize; y++) {
+            for (int x = 0; x < gridSize; x++) {
+                unsigned int i = y * stride + x;
+                grid.indices.insert(grid.indices.end(), { i, i + 1, i + stride + 1, i, i + stride + 1, i + stride });
+            }
+        }
+        return grid;
+    }
+
+    // The same grid as an OBJ file with positions, texture coordinates and normals
+    std::string writeGridOBJ(const std::filesystem::path& directory, int gridSize) {
+        std::string path = (directory / ("grid_" + std::to_string(gridSize) + ".obj")).string();
+        std::ofstream file(path, std::ios::binary);
+        MeshData grid = generateGrid(gridSize);
+
+        file << std::fixed << std::setprecision(6);
+        for (const Vertex& vertex : grid.vertices) {
+            file << "v " << vertex.Position.x << " " << vertex.Position.y << " " << vertex.Position.z << "\n";
+            file << "vt " << vertex.TexCoords.x << " " << vertex.TexCoords.y << "\n";
+        }
+        file << "vn 0.000000 0.000000 1.000000\n";
+        for (size_t i = 0; i < grid.indices.size(); i += 3) {
+            file << "f";
+            for (size_t c = 0; c < 3; c++) {
+                unsigned int index = grid.indices[i + c] + 1;
+                file << " " << index << "/" << index << "/1";
+            }
+            file << "\n";
+        }
+        return path;
+    }
+
+    // A session of strokes in world coordinates; every tenth is a fill and
+    // every seventh an eraser stroke, the rest are brush strokes
+    struct Stroke {
+        int tool;
+        std::vector<glm::vec3> points;
+    };
+
+    std::vector<Stroke> generateSession(size_t strokeCount, unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> position(-0.9f, 0.9f);
+        std::uniform_real_distribution<float> step(-0.02f, 0.02f);
+
+        std::vector<Stroke> session(strokeCount);
+        for (size_t s = 0; s < strokeCount; s++) {
+            Stroke& stroke = session[s];
+            stroke.tool = s % 10 == 9 ? 2 : (s % 7 == 6 ? 1 : 0);
+            glm::vec3 point(position(random), position(random), 0.0f);
+            size_t points = stroke.tool == 2 ? 1 : 40;
+            for (size_t p = 0; p < points; p++) {
+                stroke.points.push_back(point);
+                point.x = std::min(1.0f, std::max(-1.0f, point.x + step(random)));
+                point.y = std::min(1.0f, std::max(-1.0f, point.y + step(random)));
+            }
+        }
+        return session;
+    }
+
+    // Replay strokes the way PaintWorker does, compositing after each like a frame would
+    void replaySession(Project& project, const std::vector<Stroke>& session, std::vector<PaintTool*>& tools) {
+        for (const Stroke& stroke : session) {
+            PaintTool* tool = tools[stroke.tool];
+            project.beginEdit(tool->getName());
+            tool->begin(project.getCurrentLayer(), stroke.points.front());
+            for (size_t p = 1; p < stroke.points.size(); p++) {
+                tool->update(stroke.points[p]);
+            }
+            tool->end();
+            project.endEdit();
+            project.updateComposite();
+        }
+    }
+
+    void brushBenchmarks(Suite& suite) {
+        if (!suite.wants("brush_dab")) {
+            return;
+        }
+
+        // Fewer dabs for the large radii to keep runs short
+        for (float radius : { 4.0f, 16.0f, 64.0f, 256.0f }) {
+            size_t dabs = std::max<size_t>(10, static_cast<size_t>(32000.0f / radius));
+            Texture texture(2048, 2048);
+            std::mt19937 random(7);
+            suite.run("micro", "brush_dab", "radius=" + std::to_string(static_cast<int>(radius)), dabs, 0.0, "", [&]() {
+                for (size_t i = 0; i < dabs; i++) {
+                    texture.applyBrush(random() % 2048, random() % 2048, glm::vec4(0.8f, 0.2f, 0.1f, 0.5f), radius,
+                                       0.5f);
+                }
+            });
+        }
+    }
+
+    // The cases below take the pool's thread limit as set by main(); threads
+    // is appended to their parameter when sweeping
+
+    void fillBenchmarks(Suite& suite, const std::string& threads) {
+        if (!suite.wants("fill")) {
+            return;
+        }
+
+        // A black frame around a white square of the given side; runs
+        // alternate the color so each one fills the whole square
+        for (int side : { 256, 1024, 2046 }) {
+            Texture texture(2048, 2048);
+            texture.clear(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+            std::vector<unsigned char> white(static_cast<size_t>(side) * side * texture.getChannels(), 255);
+            texture.writeRegion(1, 1, side, side, white.data());
+
+            int run = 0;
+            double megapixels = static_cast<double>(side) * side / 1e6;
+            suite.run("micro", "fill", "area=" + std::to_string(side) + "x" + std::to_string(side) + threads, 1,
+                      megapixels, "MP/s", [&]() {
+                glm::vec4 color = run++ % 2 ? glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) : glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+                texture.fill(1 + side / 2, 1 + side / 2, color, 0.1f);
+            });
+        }
+    }
+
+    void resizeBenchmarks(Suite& suite, const std::string& threads) {
+        if (!suite.wants("resize")) {
+            return;
+        }
+
+        // A painted layer grown to 1.5 times its side, which copies every row
+        std::vector<int> sides = { 1024 };
+        if (!suite.quick()) {
+            sides.push_back(2048);
+        }
+        for (int side : sides) {
+            std::vector<unsigned char> rgba = generateLayer(side, 77);
+            std::unique_ptr<Layer> layer;
+            int grown = side * 3 / 2;
+            double megapixels = static_cast<double>(grown) * grown / 1e6;
+            suite.run("micro", "resize", std::to_string(side) + "->" + std::to_string(grown) + threads, 1, megapixels,
+                      "MP/s", [&]() {
+                layer->resize(grown, grown);
+            }, [&]() {
+                layer = std::make_unique<Layer>(std::make_unique<Texture>(side, side, std::vector<unsigned char>(rgba)));
+            });
+        }
+    }
+
+    void compositeBenchmarks(Suite& suite, const std::string& threads) {
+        if (!suite.wants("composite")) {
+            return;
+        }
+
+        const int size = 1024;
+        Arena arena;
+        CompositeLayers all{ArenaAllocator<CompositeLayer>(arena)};
+        for (int i = 0; i < 16; i++) {
+            CompositeLayer layer;
+            layer.pixels = std::make_shared<const std::vector<unsigned char>>(generateLayer(size, 100 + i));
+            layer.id = layer.pixels.get();
+            layer.width = size;
+            layer.height = size;
+            layer.mode = static_cast<BlendMode>(i % BLEND_MODE_COUNT);
+            all.push_back(layer);
+        }
+
+        std::vector<unsigned char> rgba;
+        double megapixels = static_cast<double>(size) * size / 1e6;
+        for (size_t count : { 1, 4, 16 }) {
+            CompositeLayers layers(all.begin(), all.begin() + count, all.get_allocator());
+            suite.run("micro", "composite", "layers=" + std::to_string(count) + threads, 1, megapixels, "MP/s", [&]() {
+                Compositor::flatten(layers, size, size, rgba);
+            });
+        }
+    }
+
+    void boundsBenchmarks(Suite& suite, const std::string& threads) {
+        if (!suite.wants("mesh_bounds")) {
+            return;
+        }
+
+        // A mesh computes its bounds when it is built; the vertices are
+        // copied untimed and moved in
+        std::vector<int> grids = { 512 };
+        if (!suite.quick()) {
+            grids.push_back(1024);
+        }
+        for (int gridSize : grids) {
+            MeshData grid = generateGrid(gridSize);
+            std::vector<Vertex> vertices;
+            double megavertices = grid.vertices.size() / 1e6;
+            suite.run("micro", "mesh_bounds", "vertices=" + std::to_string(grid.vertices.size()) + threads, 1,
+                      megavertices, "Mvertices/s", [&]() {
+                Mesh mesh(std::move(vertices), {});
+            }, [&]() {
+                vertices = grid.vertices;
+            });
+        }
+    }
+
+    // 1, 2, 4, ... and every thread the pool can use
+    std::vector<size_t> threadCounts() {
+        ThreadPool& pool = ThreadPool::shared();
+        pool.setMaxThreads(0);
+        size_t all = pool.getMaxThreads();
+        std::vector<size_t> counts;
+        for (size_t count = 1; count < all; count *= 2) {
+            counts.push_back(count);
+        }
+        counts.push_back(all);
+        return counts;
+    }
+
+    // Results of the parallel code must not depend on the thread count;
+    // each part is run with every count and compared with one thread
+    void determinismChecks(Suite& suite) {
+        if (!suite.wants("determinism")) {
+            return;
+        }
+
+        const int size = 1024;
+        std::vector<unsigned char> rgba = generateLayer(size, 5);
+        CompositeLayers layers{ArenaAllocator<CompositeLayer>(Arena::frame())};
+        for (int i = 0; i < 4; i++) {
+            CompositeLayer layer;
+            layer.pixels = std::make_shared<const std::vector<unsigned char>>(generateLayer(size, 200 + i));
+            layer.id = layer.pixels.get();
+            layer.width = size;
+            layer.height = size;
+            layer.opacity = 0.6f + 0.1f * i;
+            layer.mode = static_cast<BlendMode>((i + 1) % BLEND_MODE_COUNT);
+            layers.push_back(layer);
+        }
+        MeshData grid = generateGrid(600);
+
+        // Per-range float sums, combined in range order
+        auto reduce = [](std::vector<unsigned char>& out) {
+            const size_t count = 1 << 20;
+            std::vector<float> sums((count + 999) / 1000, 0.0f);
+            ThreadPool::shared().parallelFor(0, count, 1000, [&](size_t first, size_t last) {
+                float sum = 0.0f;
+                for (size_t i = first; i < last; i++) {
+                    sum += std::sin(static_cast<float>(i)) * 0.001f;
+                }
+                sums[first / 1000] = sum;
+            });
+            float total = 0.0f;
+            for (float sum : sums) {
+                total += sum;
+            }
+            out.resize(sizeof(total));
+            std::memcpy(out.data(), &total, sizeof(total));
+        };
+        // The transparent background is one region larger than the search
+        // goes one by one
+        auto fill = [&](std::vector<unsigned char>& out) {
+            Texture texture(size, size, std::vector<unsigned char>(rgba));
+            texture.fill(0, 0, glm::vec4(0.1f, 0.7f, 0.3f, 1.0f), 0.2f);
+            out = texture.getData();
+        };
+        auto resize = [&](std::vector<unsigned char>& out) {
+            Layer layer(std::make_unique<Texture>(size, size, std::vector<unsigned char>(rgba)));
+            layer.resize(size * 3 / 2 + 7, size - 33);
+            out = layer.getTexture()->getData();
+        };
+        auto composite = [&](std::vector<unsigned char>& out) {
+            Compositor::flatten(layers, size, size, out);
+        };
+        auto bounds = [&](std::vector<unsigned char>& out) {
+            Mesh mesh(grid.vertices, grid.indices);
+            const Bounds& meshBounds = mesh.getBounds();
+            float values[7] = { meshBounds.min.x, meshBounds.min.y, meshBounds.min.z, meshBounds.max.x,
+                                meshBounds.max.y, meshBounds.max.z, meshBounds.radius };
+            out.assign(reinterpret_cast<const unsigned char*>(values),
+                       reinterpret_cast<const unsigned char*>(values) + sizeof(values));
+        };
+
+        const std::pair<const char*, std::function<void(std::vector<unsigned char>&)>> parts[] = {
+            { "parallel_for", reduce }, { "fill", fill }, { "resize", resize }, { "composite", composite },
+            { "mesh_bounds", bounds }
+        };
+        std::vector<size_t> counts = threadCounts();
+        for (const auto& part : parts) {
+            std::vector<unsigned char> expected;
+            std::vector<unsigned char> output;
+            std::string mismatch;
+            for (size_t threads : counts) {
+                ThreadPool::shared().setMaxThreads(threads);
+                part.second(threads == 1 ? expected : output);
+                if (threads > 1 && output != expected && mismatch.empty()) {
+                    mismatch = "differs with " + std::to_string(threads) + " threads";
+                }
+            }
+            ThreadPool::shared().setMaxThreads(0);
+            suite.check("check", "determinism", std::string(part.first) + ",threads=1-" +
+                        std::to_string(counts.back()), mismatch.empty(), mismatch);
+        }
+    }
+
+    // The commands for a culled model are checked against offsets worked out
+    // here: meshes of different sizes, some without indices and one empty,
+    // in a row along x of which an orthographic view sees the middle
+    void drawCommandChecks(Suite& suite) {
+        if (!suite.wants("draw_commands")) {
+            return;
+        }
+
+        const int meshCount = 24;
+        std::vector<Mesh> meshes;
+        std::vector<Bounds> bounds;
+        std::vector<uint32_t> vertexCounts, indexCounts;
+        for (int i = 0; i < meshCount; i++) {
+            MeshData grid = generateGrid(1 + i % 5);
+            for (Vertex& vertex : grid.vertices) {
+                vertex.Position = vertex.Position * 0.4f + glm::vec3(static_cast<float>(i), 0.0f, 0.0f);
+            }
+            if (i % 7 == 3) {
+                grid.indices.clear();
+            }
+            if (i == 10) {
+                grid.vertices.clear();
+                grid.indices.clear();
+            }
+            vertexCounts.push_back(static_cast<uint32_t>(grid.vertices.size()));
+            indexCounts.push_back(static_cast<uint32_t>(grid.indices.empty() ? grid.vertices.size()
+                                                                             : grid.indices.size()));
+            meshes.emplace_back(std::move(grid.vertices), std::move(grid.indices));
+            bounds.push_back(meshes.back().getBounds());
+        }
+
+        // Sees x from 5.5 to 17.5, so meshes 6 to 17 (10 being empty)
+        glm::mat4 projection = glm::ortho(5.5f, 17.5f, -2.0f, 2.0f, 0.1f, 10.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        BoundsList list;
+        list.assign(bounds);
+        std::vector<uint8_t> visible;
+        list.cull(Frustum::fromMatrix(projection * view), visible);
+
+        std::vector<DrawElementsIndirectCommand> expected;
+        uint32_t firstIndex = 0;
+        int32_t baseVertex = 0;
+        std::string mismatch;
+        for (int i = 0; i < meshCount; i++) {
+            bool inView = i >= 6 && i <= 17 && i != 10;
+            if ((visible[i] != 0) != inView && i != 10) {
+                mismatch = "mesh " + std::to_string(i) + (inView ? " culled" : " not culled");
+            }
+            if (inView) {
+                expected.push_back({ indexCounts[i], 1, firstIndex, baseVertex, static_cast<uint32_t>(i) });
+            }
+            firstIndex += indexCounts[i];
+            baseVertex += static_cast<int32_t>(vertexCounts[i]);
+        }
+
+        std::vector<MeshRange> ranges;
+        std::vector<DrawElementsIndirectCommand> commands;
+        if (!GeometryBuffer::layoutMeshes(meshes, ranges)) {
+            mismatch = "layout failed";
+        }
+        GeometryBuffer::buildCommands(ranges, commands, &visible);
+        if (mismatch.empty() && commands.size() != expected.size()) {
+            mismatch = std::to_string(commands.size()) + " commands instead of " + std::to_string(expected.size());
+        }
+        for (size_t i = 0; mismatch.empty() && i < commands.size(); i++) {
+            const DrawElementsIndirectCommand& command = commands[i];
+            const DrawElementsIndirectCommand& want = expected[i];
+            if (command.count != want.count || command.instanceCount != 1 || command.firstIndex != want.firstIndex ||
+                command.baseVertex != want.baseVertex || command.baseInstance != want.baseInstance) {
+                mismatch = "command " + std::to_string(i) + " (mesh " + std::to_string(want.baseInstance) + ") differs";
+            }
+        }
+
+        // Without a mask every non-empty mesh is drawn
+        GeometryBuffer::buildCommands(ranges, commands);
+        if (mismatch.empty() && commands.size() != static_cast<size_t>(meshCount - 1)) {
+            mismatch = "unculled: " + std::to_string(commands.size()) + " commands";
+        }
+        suite.check("check", "draw_commands", "meshes=" + std::to_string(meshCount) + ",drawn=" +
+                    std::to_string(expected.size()), mismatch.empty(), mismatch);
+    }
+
+    void frameBenchmarks(Suite& suite) {
+        if (!suite.wants("paint_frame")) {
+            return;
+        }
+
+        // The middle of three layers is painted. The stroke goes over the
+        // same path again and again, so after the warm-up every frame finds
+        // its tiles recorded for undo and the arenas at their working size.
+        Project project;
+        project.addLayer("Base");
+        project.addLayer("Paint");
+        project.addLayer("Top");
+        project.setCurrentLayerIndex(1);
+        BrushTool brush;
+        brush.setSize(12.0f);
+        brush.setColor(glm::vec4(0.2f, 0.4f, 0.9f, 1.0f));
+
+        const size_t frames = 100;
+        auto paintFrame = [&](size_t frame) {
+            Arena::frame().reset();
+            float t = static_cast<float>(frame % frames) / frames;
+            brush.update(glm::vec3(t - 0.5f, 0.2f * std::sin(t * 6.2832f), 0.0f));
+            project.updateComposite();
+        };
+
+        project.beginEdit(brush.getName());
+        brush.begin(project.getCurrentLayer(), glm::vec3(-0.5f, 0.0f, 0.0f));
+        for (size_t frame = 0; frame < frames * 2; frame++) {
+            paintFrame(frame);
+        }
+        const Result& result = suite.run("macro", "paint_frame", "layers=3", frames, 0.0, "", [&]() {
+            for (size_t frame = 0; frame < frames; frame++) {
+                paintFrame(frame);
+            }
+        });
+        brush.end();
+        project.endEdit();
+
+        // Temporaries come from the arenas, so steady frames never touch the heap
+        if (result.allocations > 0) {
+            suite.fail("paint_frame", std::to_string(result.allocations) + " heap allocations in " +
+                       std::to_string(result.milliseconds.size() * frames) + " frames");
+        }
+    }
+
+    void pickBenchmarks(Suite& suite) {
+        if (!suite.wants("ray_pick")) {
+            return;
+        }
+
+        // Rays straight down onto the grid from random points above it
+        std::vector<int> grids = { 32, 256 };
+        if (!suite.quick()) {
+            grids.push_back(1024);
+        }
+        for (int gridSize : grids) {
+            MeshData grid = generateGrid(gridSize);
+            Mesh mesh(grid.vertices, grid.indices);
+            size_t triangles = grid.indices.size() / 3;
+            size_t picks = std::min<size_t>(200, std::max<size_t>(5, 2000000 / triangles));
+            std::mt19937 random(11);
+            std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+            size_t hits = 0;
+            suite.run("micro", "ray_pick", "triangles=" + std::to_string(triangles), picks, 0.0, "",
+                      [&]() {
+                for (size_t i = 0; i < picks; i++) {
+                    float distance;
+                    glm::vec3 origin(position(random), position(random), 5.0f);
+                    hits += mesh.intersectRay(origin, glm::vec3(0.0f, 0.0f, -1.0f), distance);
+                }
+            });
+            if (hits == 0) {
+                std::cerr << "ray_pick: no ray hit the grid" << std::endl;
+            }
+        }
+    }
+
+    void objBenchmarks(Suite& suite, const std::filesystem::path& directory) {
+        if (!suite.wants("obj_parse")) {
+            return;
+        }
+
+        std::vector<int> grids = { 150 };
+        if (!suite.quick()) {
+            grids.push_back(600);
+        }
+        for (int gridSize : grids) {
+            std::string path = writeGridOBJ(directory, gridSize);
+            double megabytes = static_cast<double>(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+            std::ostringstream parameter;
+            parameter << std::fixed << std::setprecision(1) << "size=" << megabytes << "MB";
+
+            obj_reader::ObjData data;
+            suite.run("micro", "obj_parse", parameter.str(), 1, megabytes, "MB/s", [&]() {
+                if (!obj_reader::load(path, data)) {
+                    std::cerr << "obj_parse: failed to read " << path << std::endl;
+                }
+            });
+        }
+    }
+
+    void pngBenchmarks(Suite& suite) {
+        if (!suite.wants("png_encode")) {
+            return;
+        }
+
+        std::vector<int> sizes = { 1024 };
+        if (!suite.quick()) {
+            sizes.push_back(2048);
+        }
+        const PngCodec::Mode modes[2] = { PngCodec::MODE_FAST, PngCodec::MODE_COMPACT };
+        const char* modeNames[2] = { "fast", "compact" };
+        for (int size : sizes) {
+            std::vector<unsigned char> rgba = generateLayer(size, 1234);
+            double megapixels = static_cast<double>(size) * size / 1e6;
+            for (int m = 0; m < 2; m++) {
+                std::vector<unsigned char> png;
+                suite.run("micro", "png_encode", std::string(modeNames[m]) + "," + std::to_string(size) + "x" +
+                          std::to_string(size), 1, megapixels, "MP/s", [&]() {
+                    PngCodec::encode(rgba.data(), size, size, 4, modes[m], png);
+                });
+            }
+        }
+    }
+
+    void sessionBenchmarks(Suite& suite, const std::filesystem::path& directory) {
+        BrushTool brush;
+        EraserTool eraser;
+        FillTool fill;
+        std::vector<PaintTool*> tools = { &brush, &eraser, &fill };
+        for (PaintTool* tool : tools) {
+            tool->setSize(12.0f);
+            tool->setColor(glm::vec4(0.2f, 0.4f, 0.9f, 1.0f));
+        }
+
+        std::vector<Stroke> session = generateSession(suite.quick() ? 60 : 200, 42);
+        if (suite.wants("stroke_session")) {
+            std::unique_ptr<Project> project;
+            suite.run("macro", "stroke_session", "strokes=" + std::to_string(session.size()), session.size(), 0.0, "",
+                      [&]() {
+                replaySession(*project, session, tools);
+            }, [&]() {
+                project = std::make_unique<Project>();
+                project->addLayer("Base");
+                project->addLayer("Paint");
+            });
+        }
+
+        if (!suite.wants("project_")) {
+            return;
+        }
+
+        // Saving needs a model; the grid goes through the regular importer
+        Project project;
+        if (!project.loadModel(writeGridOBJ(directory, 256))) {
+            suite.skip("macro", "project_save", "importer unavailable");
+            suite.skip("macro", "project_open", "importer unavailable");
+            return;
+        }
+        for (int i = 0; i < 3; i++) {
+            project.addLayer("Layer " + std::to_string(i + 1));
+            replaySession(project, session, tools);
+        }
+
+        std::string path = (directory / "session.painter").string();
+        std::string parameter = "layers=" + std::to_string(project.getLayers().size()) + "," +
+                                std::to_string(project.getTextureWidth()) + "x" +
+                                std::to_string(project.getTextureHeight());
+        if (suite.wants("project_save")) {
+            suite.run("macro", "project_save", parameter, 1, 0.0, "", [&]() {
+                project.saveProject(path);
+            });
+        } else {
+            project.saveProject(path);
+        }
+
+        if (suite.wants("project_open")) {
+            suite.run("macro", "project_open", parameter, 1, 0.0, "", [&]() {
+                Project opened;
+                if (!opened.loadProject(path)) {
+                    std::cerr << "project_open: failed to open " << path << std::endl;
+                }
+            });
+        }
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--json" && i + 1 < argc) {
+                options.jsonPath = argv[++i];
+            } else if (arg == "--filter" && i + 1 < argc) {
+                options.filter = argv[++i];
+            } else if (arg == "--runs" && i + 1 < argc) {
+                options.runs = std::max(1, std::atoi(argv[++i]));
+            } else if (arg == "--quick") {
+                options.quick = true;
+            } else if (arg == "--threads") {
+                options.threadSweep = true;
+            } else {
+                std::cerr << "Usage: painter_bench [--json results.json] [--filter text] [--runs N] [--quick] "
+                             "[--threads]" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "painter_bench";
+    std::filesystem::create_directories(directory);
+
+    std::cout << "Thread pool: " << ThreadPool::shared().getThreadCount() << " worker(s), " << options.runs
+              << " runs per case, median shown" << std::endl;
+
+    Suite suite(options);
+    brushBenchmarks(suite);
+
+    // The cases that scale with threads, once with all of them or per count
+    std::vector<size_t> counts = options.threadSweep ? threadCounts() : std::vector<size_t>{ 0 };
+    for (size_t threads : counts) {
+        ThreadPool::shared().setMaxThreads(threads);
+        std::string parameter = options.threadSweep ? ",threads=" + std::to_string(threads) : "";
+        fillBenchmarks(suite, parameter);
+        resizeBenchmarks(suite, parameter);
+        compositeBenchmarks(suite, parameter);
+        boundsBenchmarks(suite, parameter);
+    }
+    ThreadPool::shared().setMaxThreads(0);
+
+    pickBenchmarks(suite);
+    objBenchmarks(suite, directory);
+    pngBenchmarks(suite);
+    sessionBenchmarks(suite, directory);
+    frameBenchmarks(suite);
+    drawCommandChecks(suite);
+    determinismChecks(suite);
+
+    std::filesystem::remove_all(directory);
+
+    if (!options.jsonPath.empty() && !suite.writeJSON(options.jsonPath)) {
+        return 1;
+    }
+    if (suite.getFailures() > 0) {
+        std::cerr << suite.getFailures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
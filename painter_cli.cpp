@@ -0,0 +1,529 @@
+/**
+ * Headless batch painter
+ *
+ * Usage: painter_cli --script ops.txt [--out dir] [--jobs N] [--json timings.json] asset|directory...
+ *
+ * Loads every asset (a model, or a project saved by the application), runs
+ * the script on it and writes the script's outputs. Directories are searched
+ * for assets, not recursively. Assets are processed in parallel on the shared
+ * thread pool (--jobs caps how many at once), and each one is timed: load,
+ * script and total. Nothing here needs a display, GLFW or a GL context; the
+ * target is built with PAINTER_HEADLESS, so it does not link libGL either.
+ *
+ * The script has one operation per line; # starts a comment:
+ *
+ *   layer [name]                    add a layer and paint on it
+ *   select <index>                  paint on an existing layer
+ *   clear                           clear the current layer
+ *   remove <index>                  remove a layer
+ *   tool brush|eraser|fill          tool for the following strokes
+ *   size <pixels>
+ *   hardness <0..1>
+ *   color <r> <g> <b> [a]           components in 0..1
+ *   tolerance <0..1>                fill tolerance
+ *   stroke uv <u> <v> [<u> <v>...]  stroke through texture coordinates in 0..1
+ *   stroke world <x> <y> <z> [...]  stroke through world positions
+ *   fill uv <u> <v>                 shorthand for tool fill plus a one-point stroke
+ *   fill world <x> <y> <z>
+ *   composite <file.png>            write the flattened layers
+ *   save <project>                  .json for the legacy layout, else one file
+ *   export <model>                  any format Project::exportModel writes
+ *
+ * Output paths are relative to --out (default: the current directory), and
+ * {name} in them is replaced by the asset's file name without extension.
+ *
+ * Build: cmake --build build --target painter_cli
+ */
+#include "paint_tool.h"
+#include "png_codec.h"
+#include "project.h"
+#include "project_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace {
+    struct Options {
+        std::string scriptPath;
+        std::filesystem::path outputDirectory = ".";
+        std::string jsonPath;
+        size_t jobs = 0;    // 0 = one per pool worker
+        std::vector<std::string> inputs;
+    };
+
+    struct Operation {
+        enum Type {
+            ADD_LAYER,
+            SELECT_LAYER,
+            CLEAR_LAYER,
+            REMOVE_LAYER,
+            TOOL,
+            SIZE,
+            HARDNESS,
+            COLOR,
+            TOLERANCE,
+            STROKE,
+            FILL,
+            COMPOSITE,
+            SAVE,
+            EXPORT
+        };
+
+        Type type;
+        int line = 0;
+        std::string text;                   // layer name, tool name or output path
+        float value = 0.0f;
+        glm::vec4 color = glm::vec4(0.0f);
+        std::vector<glm::vec3> points;      // world positions
+    };
+
+    struct AssetResult {
+        std::string path;
+        bool ok = false;
+        std::string error;
+        double loadMs = 0.0;
+        double scriptMs = 0.0;
+        double totalMs = 0.0;
+        size_t outputs = 0;
+    };
+
+    const char* const MODEL_EXTENSIONS[] = { ".obj", ".fbx", ".gltf", ".glb", ".dae", ".3ds", ".ply", ".stl" };
+
+    // Texture coordinates as the world positions the paint tools map back to
+    // them (Utils::worldToTextureCoord)
+    glm::vec3 uvToWorld(float u, float v) {
+        return glm::vec3(u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.0f);
+    }
+
+    // Points of a stroke or fill: "uv u v ..." or "world x y z ..."
+    bool parsePoints(std::istringstream& in, std::vector<glm::vec3>& points, std::string& error) {
+        std::string space;
+        in >> space;
+        std::vector<float> values;
+        float value;
+        while (in >> value) {
+            values.push_back(value);
+        }
+        if (!in.eof()) {
+            error = "expected numbers";
+            return false;
+        }
+
+        size_t stride = space == "uv" ? 2 : space == "world" ? 3 : 0;
+        if (stride == 0) {
+            error = "expected uv or world, got '" + space + "'";
+            return false;
+        }
+        if (values.empty() || values.size() % stride != 0) {
+            error = "expected a multiple of " + std::to_string(stride) + " coordinates";
+            return false;
+        }
+        for (size_t i = 0; i < values.size(); i += stride) {
+            points.push_back(stride == 2 ? uvToWorld(values[i], values[i + 1])
+                                         : glm::vec3(values[i], values[i + 1], values[i + 2]));
+        }
+        return true;
+    }
+
+    bool parseOperation(const std::string& line, Operation& operation, std::string& error) {
+        std::istringstream in(line);
+        std::string keyword;
+        in >> keyword;
+
+        auto number = [&](float& value) {
+            if (!(in >> value)) {
+                error = keyword + " expects a number";
+                return false;
+            }
+            return true;
+        };
+        auto rest = [&]() {
+            std::string text;
+            std::getline(in >> std::ws, text);
+            return text;
+        };
+
+        if (keyword == "layer") {
+            operation.type = Operation::ADD_LAYER;
+            operation.text = rest();
+        } else if (keyword == "select" || keyword == "remove") {
+            operation.type = keyword == "select" ? Operation::SELECT_LAYER : Operation::REMOVE_LAYER;
+            if (!number(operation.value) || operation.value < 0.0f) {
+                error = keyword + " expects a layer index";
+                return false;
+            }
+        } else if (keyword == "clear") {
+            operation.type = Operation::CLEAR_LAYER;
+        } else if (keyword == "tool") {
+            operation.type = Operation::TOOL;
+            in >> operation.text;
+            if (operation.text != "brush" && operation.text != "eraser" && operation.text != "fill") {
+                error = "unknown tool '" + operation.text + "'";
+                return false;
+            }
+        } else if (keyword == "size" || keyword == "hardness" || keyword == "tolerance") {
+            operation.type = keyword == "size" ? Operation::SIZE
+                           : keyword == "hardness" ? Operation::HARDNESS : Operation::TOLERANCE;
+            return number(operation.value);
+        } else if (keyword == "color") {
+            operation.type = Operation::COLOR;
+            operation.color.a = 1.0f;
+            if (!number(operation.color.r) || !number(operation.color.g) || !number(operation.color.b)) {
+                return false;
+            }
+            float alpha;
+            if (in >> alpha) {
+                operation.color.a = alpha;
+            }
+        } else if (keyword == "stroke" || keyword == "fill") {
+            operation.type = keyword == "stroke" ? Operation::STROKE : Operation::FILL;
+            if (!parsePoints(in, operation.points, error)) {
+                error = keyword + ": " + error;
+                return false;
+            }
+            if (operation.type == Operation::FILL && operation.points.size() != 1) {
+                error = "fill expects one point";
+                return false;
+            }
+        } else if (keyword == "composite" || keyword == "save" || keyword == "export") {
+            operation.type = keyword == "composite" ? Operation::COMPOSITE
+                           : keyword == "save" ? Operation::SAVE : Operation::EXPORT;
+            operation.text = rest();
+            if (operation.text.empty()) {
+                error = keyword + " expects a path";
+                return false;
+            }
+        } else {
+            error = "unknown operation '" + keyword + "'";
+            return false;
+        }
+        return true;
+    }
+
+    // The whole script is checked before any asset is touched
+    bool loadScript(const std::string& path, std::vector<Operation>& script) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Failed to open script: " << path << std::endl;
+            return false;
+        }
+
+        std::string line;
+        bool ok = true;
+        for (int number = 1; std::getline(in, line); number++) {
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            Operation operation;
+            operation.line = number;
+            std::string error;
+            if (!parseOperation(line, operation, error)) {
+                std::cerr << path << ":" << number << ": " << error << std::endl;
+                ok = false;
+                continue;
+            }
+            script.push_back(std::move(operation));
+        }
+        return ok;
+    }
+
+    bool isAsset(const std::filesystem::path& path) {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (extension == ".json") {
+            return true;
+        }
+        for (const char* model : MODEL_EXTENSIONS) {
+            if (extension == model) {
+                return true;
+            }
+        }
+        return ProjectFile::isProjectFile(path.string());
+    }
+
+    // Files named on the command line, and the assets in named directories
+    bool collectAssets(const std::vector<std::string>& inputs, std::vector<std::string>& assets) {
+        for (const std::string& input : inputs) {
+            std::error_code error;
+            if (!std::filesystem::is_directory(input, error)) {
+                assets.push_back(input);
+                continue;
+            }
+
+            std::vector<std::string> found;
+            for (const auto& entry : std::filesystem::directory_iterator(input, error)) {
+                if (entry.is_regular_file() && isAsset(entry.path())) {
+                    found.push_back(entry.path().string());
+                }
+            }
+            if (error) {
+                std::cerr << "Failed to list " << input << ": " << error.message() << std::endl;
+                return false;
+            }
+            std::sort(found.begin(), found.end());
+            assets.insert(assets.end(), found.begin(), found.end());
+        }
+        return true;
+    }
+
+    std::string outputPath(const Options& options, const std::string& pattern, const std::string& name) {
+        std::string path = pattern;
+        for (size_t at = path.find("{name}"); at != std::string::npos; at = path.find("{name}", at + name.size())) {
+            path.replace(at, 6, name);
+        }
+        return (options.outputDirectory / path).string();
+    }
+
+    bool load(Project& project, const std::string& path) {
+        std::string extension = std::filesystem::path(path).extension().string();
+        if (extension == ".json" || ProjectFile::isProjectFile(path)) {
+            return project.loadProject(path);
+        }
+        return project.loadModel(path);
+    }
+
+    // Run the script on one asset; the first failing operation stops it
+    void processAsset(const Options& options, const std::vector<Operation>& script, AssetResult& result) {
+        using Clock = std::chrono::steady_clock;
+        auto start = Clock::now();
+        std::string name = std::filesystem::path(result.path).stem().string();
+
+        Project project;
+        if (!load(project, result.path)) {
+            result.error = "failed to load";
+            return;
+        }
+        auto loaded = Clock::now();
+        result.loadMs = std::chrono::duration<double, std::milli>(loaded - start).count();
+
+        // Tools keep their settings between strokes, so every asset gets its own
+        BrushTool brush;
+        EraserTool eraser;
+        FillTool fill;
+        PaintTool* tool = &brush;
+
+        auto paint = [&](PaintTool* with, const std::vector<glm::vec3>& points) {
+            project.beginEdit(with->getName());
+            with->begin(project.getCurrentLayer(), points.front());
+            for (size_t p = 1; p < points.size(); p++) {
+                with->update(points[p]);
+            }
+            with->end();
+            project.endEdit();
+        };
+
+        for (const Operation& operation : script) {
+            bool ok = true;
+            switch (operation.type) {
+                case Operation::ADD_LAYER:
+                    // Unnamed layers are numbered per project, not per process
+                    project.addLayer(operation.text.empty()
+                                     ? "Layer " + std::to_string(project.getLayers().size() + 1)
+                                     : operation.text);
+                    break;
+                case Operation::SELECT_LAYER: {
+                    size_t index = static_cast<size_t>(operation.value);
+                    ok = index < project.getLayers().size();
+                    if (ok) {
+                        project.setCurrentLayerIndex(index);
+                    }
+                    break;
+                }
+                case Operation::CLEAR_LAYER:
+                    ok = project.getCurrentLayer() != nullptr;
+                    if (ok) {
+                        project.beginEdit("Clear Layer");
+                        project.getCurrentLayer()->clear();
+                        project.endEdit();
+                    }
+                    break;
+                case Operation::REMOVE_LAYER:
+                    ok = project.removeLayer(static_cast<size_t>(operation.value));
+                    break;
+                case Operation::TOOL:
+                    tool = operation.text == "eraser" ? static_cast<PaintTool*>(&eraser)
+                         : operation.text == "fill" ? static_cast<PaintTool*>(&fill) : &brush;
+                    break;
+                case Operation::SIZE:
+                    brush.setSize(operation.value);
+                    eraser.setSize(operation.value);
+                    break;
+                case Operation::HARDNESS:
+                    brush.setHardness(operation.value);
+                    eraser.setHardness(operation.value);
+                    break;
+                case Operation::COLOR:
+                    brush.setColor(operation.color);
+                    fill.setColor(operation.color);
+                    break;
+                case Operation::TOLERANCE:
+                    fill.setTolerance(operation.value);
+                    break;
+                case Operation::STROKE:
+                case Operation::FILL:
+                    ok = project.getCurrentLayer() != nullptr;
+                    if (ok) {
+                        paint(operation.type == Operation::FILL ? &fill : tool, operation.points);
+                    }
+                    break;
+                case Operation::COMPOSITE: {
+                    std::vector<unsigned char> rgba;
+                    project.flattenLayers(rgba);
+                    ok = PngCodec::writeFile(outputPath(options, operation.text, name), rgba.data(),
+                                             project.getTextureWidth(), project.getTextureHeight(), 4,
+                                             PngCodec::MODE_COMPACT);
+                    result.outputs += ok;
+                    break;
+                }
+                case Operation::SAVE:
+                    ok = project.saveProject(outputPath(options, operation.text, name));
+                    result.outputs += ok;
+                    break;
+                case Operation::EXPORT:
+                    ok = project.exportModel(outputPath(options, operation.text, name));
+                    result.outputs += ok;
+                    break;
+            }
+            if (!ok) {
+                result.error = "line " + std::to_string(operation.line) + " failed";
+                return;
+            }
+        }
+
+        auto finished = Clock::now();
+        result.scriptMs = std::chrono::duration<double, std::milli>(finished - loaded).count();
+        result.totalMs = std::chrono::duration<double, std::milli>(finished - start).count();
+        result.ok = true;
+    }
+
+    bool writeJSON(const std::string& path, const std::vector<AssetResult>& results, double wallMs) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "Failed to write timings: " << path << std::endl;
+            return false;
+        }
+
+        auto quoted = [](const std::string& text) {
+            std::string escaped = "\"";
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    escaped += '\\';
+                }
+                escaped += c;
+            }
+            return escaped + "\"";
+        };
+
+        out << std::setprecision(6) << "{\n\"threads\": " << ThreadPool::shared().getThreadCount()
+            << ",\n\"wall_ms\": " << wallMs << ",\n\"assets\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const AssetResult& result = results[i];
+            out << (i ? "," : "") << "\n{\"path\":" << quoted(result.path) << ",\"ok\":"
+                << (result.ok ? "true" : "false");
+            if (result.ok) {
+                out << ",\"load_ms\":" << result.loadMs << ",\"script_ms\":" << result.scriptMs
+                    << ",\"total_ms\":" << result.totalMs << ",\"outputs\":" << result.outputs;
+            } else {
+                out << ",\"error\":" << quoted(result.error);
+            }
+            out << "}";
+        }
+        out << "\n]\n}\n";
+
+        if (!out) {
+            std::cerr << "Failed to write timings: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--script" && i + 1 < argc) {
+                options.scriptPath = argv[++i];
+            } else if (arg == "--out" && i + 1 < argc) {
+                options.outputDirectory = argv[++i];
+            } else if (arg == "--jobs" && i + 1 < argc) {
+                options.jobs = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+            } else if (arg == "--json" && i + 1 < argc) {
+                options.jsonPath = argv[++i];
+            } else if (!arg.empty() && arg[0] != '-') {
+                options.inputs.push_back(arg);
+            } else {
+                options.inputs.clear();
+                break;
+            }
+        }
+        if (options.scriptPath.empty() || options.inputs.empty()) {
+            std::cerr << "Usage: painter_cli --script ops.txt [--out dir] [--jobs N] [--json timings.json] "
+                         "asset|directory..." << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    std::vector<Operation> script;
+    std::vector<std::string> assets;
+    if (!loadScript(options.scriptPath, script) || !collectAssets(options.inputs, assets)) {
+        return 1;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(options.outputDirectory, error);
+
+    ThreadPool& pool = ThreadPool::shared();
+    size_t jobs = options.jobs ? options.jobs : std::max<size_t>(1, pool.getThreadCount());
+    std::cout << "Processing " << assets.size() << " asset(s), " << jobs << " at a time" << std::endl;
+
+    // Each job takes the next asset until none are left; the projects' own
+    // saving and encoding work shares the same pool
+    std::vector<AssetResult> results(assets.size());
+    std::atomic<size_t> next(0);
+    std::mutex printMutex;
+    auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(std::min(jobs, assets.size()), [&](size_t) {
+        for (size_t i = next++; i < assets.size(); i = next++) {
+            AssetResult& result = results[i];
+            result.path = assets[i];
+            processAsset(options, script, result);
+
+            std::lock_guard<std::mutex> lock(printMutex);
+            if (result.ok) {
+                std::cout << std::fixed << std::setprecision(1) << result.path << ": " << result.totalMs
+                          << " ms (load " << result.loadMs << ", script " << result.scriptMs << "), "
+                          << result.outputs << " output(s)" << std::endl;
+            } else {
+                std::cerr << result.path << ": " << result.error << std::endl;
+            }
+        }
+    });
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t failed = std::count_if(results.begin(), results.end(), [](const AssetResult& result) { return !result.ok; });
+    std::cout << std::fixed << std::setprecision(1) << assets.size() - failed << " of " << assets.size()
+              << " asset(s) done in " << wallMs << " ms" << std::endl;
+
+    if (!options.jsonPath.empty() && !writeJSON(options.jsonPath, results, wallMs)) {
+        return 1;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,552 @@
+/**
+ * GPU checks against the CPU paths
+ *
+ * Usage: painter_gl_check [--filter text]
+ *
+ * Renders offscreen on a headless EGL context (e.g. Mesa llvmpipe, with
+ * EGL_PLATFORM=surfaceless) and compares the image with what the CPU code
+ * computes for the same input:
+ *
+ *   composite   layers flattened by composite.frag from a texture array (the
+ *               GPU compositing path of the renderer) against
+ *               Compositor::flatten, per channel within a small tolerance
+ *   geometry    a model drawn by GeometryBuffer as one indirect draw of the
+ *               meshes left after frustum culling against every mesh drawn
+ *               from its own buffers, which must give the same pixels
+ *
+ * --filter only runs checks whose name contains the text. Exits with 1 if a
+ * check fails, and with 77 (skipped, for ctest) if no GL 4.5 context can be
+ * created.
+ *
+ * Build: cmake --build build --target painter_gl_check (only when EGL is found)
+ */
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include "compositor.h"
+#include "culling.h"
+#include "geometry_buffer.h"
+#include "model.h"
+#include "renderer.h"
+#include "shader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    const int EXIT_SKIPPED = 77;
+
+    // std140 layouts of the blocks in the shaders (see renderer.cpp)
+    struct FrameBlock {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::mat4 model;
+    };
+
+    struct LayerBlock {
+        int32_t layerCount;
+        int32_t padding[3];
+        float layerParams[Renderer::MAX_GPU_LAYERS][4];    // opacity, blend mode
+    };
+
+    const unsigned int LAYER_BLOCK_BINDING = 0;
+    const unsigned int FRAME_BLOCK_BINDING = 1;
+
+    // Headless context with an RGBA8 color and a depth attachment to draw to
+    class Context {
+    public:
+        ~Context() {
+            if (framebuffer != 0) {
+                glDeleteFramebuffers(1, &framebuffer);
+                glDeleteRenderbuffers(2, renderbuffers);
+            }
+            if (display != EGL_NO_DISPLAY) {
+                eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                if (context != EGL_NO_CONTEXT) {
+                    eglDestroyContext(display, context);
+                }
+                eglTerminate(display);
+            }
+        }
+
+        bool create(int width, int height) {
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            EGLint major, minor;
+            if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+                std::cerr << "No EGL display" << std::endl;
+                display = EGL_NO_DISPLAY;
+                return false;
+            }
+
+            // The surface is never made current: everything is drawn into
+            // the framebuffer below
+            const EGLint configAttributes[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE
+            };
+            EGLConfig config;
+            EGLint configs = 0;
+            const EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE
+            };
+            if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, configAttributes, &config, 1, &configs) ||
+                configs == 0) {
+                std::cerr << "No EGL config for OpenGL" << std::endl;
+                return false;
+            }
+            context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+            if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+                std::cerr << "No OpenGL 4.5 core context" << std::endl;
+                return false;
+            }
+            if (!gladLoadGL()) {
+                std::cerr << "Failed to initialize GLAD" << std::endl;
+                return false;
+            }
+            std::cout << "Renderer: " << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << std::endl;
+
+            this->width = width;
+            this->height = height;
+            glGenFramebuffers(1, &framebuffer);
+            glGenRenderbuffers(2, renderbuffers);
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cerr << "Incomplete framebuffer" << std::endl;
+                return false;
+            }
+            glViewport(0, 0, width, height);
+            return true;
+        }
+
+        void clear() const {
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+
+        // Bottom row first, as the CPU images are laid out for texturing
+        void read(std::vector<unsigned char>& rgba) const {
+            rgba.resize(static_cast<size_t>(width) * height * 4);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        }
+
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+
+    private:
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+        unsigned int framebuffer = 0;
+        unsigned int renderbuffers[2] = { 0, 0 };
+        int width = 0;
+        int height = 0;
+    };
+
+    // Deterministic test layer: soft blobs over noise, partly transparent
+    std::vector<unsigned char> generateLayer(int width, int height, unsigned int seed) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4);
+        float cx = static_cast<float>(rng() % width);
+        float cy = static_cast<float>(rng() % height);
+        float radius = 0.25f * std::min(width, height) + static_cast<float>(rng() % 32);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                unsigned char* pixel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+                float distance = std::hypot(x - cx, y - cy) / radius;
+                for (int c = 0; c < 3; c++) {
+                    pixel[c] = static_cast<unsigned char>(byte(rng));
+                }
+                pixel[3] = distance < 1.0f ? static_cast<unsigned char>(255.0f * (1.0f - distance))
+                                           : static_cast<unsigned char>(byte(rng) / 8);
+            }
+        }
+        return rgba;
+    }
+
+    // Largest difference of premultiplied channels and of alpha, so colors
+    // of nearly transparent pixels (rounded differently by 8-bit output)
+    // count for as little as they show
+    int compareImages(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+        int largest = 0;
+        for (size_t i = 0; i + 3 < a.size() && i + 3 < b.size(); i += 4) {
+            for (int c = 0; c < 3; c++) {
+                int difference = std::abs(a[i + c] * a[i + 3] - b[i + c] * b[i + 3]) / 255;
+                largest = std::max(largest, difference);
+            }
+            largest = std::max(largest, std::abs(a[i + 3] - b[i + 3]));
+        }
+        return largest;
+    }
+
+    // A triangle covering the viewport with texture coordinates 0..1 over it,
+    // so every fragment samples the center of its own texel
+    class FullscreenTriangle {
+    public:
+        FullscreenTriangle() {
+            const float vertices[] = {
+                -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                3.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 2.0f, 0.0f,
+                -1.0f, 3.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 2.0f
+            };
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &VBO);
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+            for (int attribute = 0; attribute < 3; attribute++) {
+                glEnableVertexAttribArray(attribute);
+                glVertexAttribPointer(attribute, attribute == 2 ? 2 : 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),
+                                      (void*)(attribute * 3 * sizeof(float)));
+            }
+            glBindVertexArray(0);
+        }
+
+        ~FullscreenTriangle() {
+            glDeleteBuffers(1, &VBO);
+            glDeleteVertexArrays(1, &VAO);
+        }
+
+        void draw() const {
+            glBindVertexArray(VAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+        }
+
+    private:
+        unsigned int VAO = 0;
+        unsigned int VBO = 0;
+    };
+
+    // Identity transforms, or the given camera, for the vertex shaders
+    class FrameUniforms {
+    public:
+        FrameUniforms() {
+            glGenBuffers(1, &buffer);
+            set(glm::mat4(1.0f), glm::mat4(1.0f));
+        }
+
+        ~FrameUniforms() { glDeleteBuffers(1, &buffer); }
+
+        void set(const glm::mat4& projection, const glm::mat4& view) {
+            FrameBlock frame{ projection, view, glm::mat4(1.0f) };
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(frame), &frame, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, buffer);
+        }
+
+    private:
+        unsigned int buffer = 0;
+    };
+
+    struct Checks {
+        std::string filter;
+        int failures = 0;
+
+        bool wants(const std::string& name) const {
+            return filter.empty() || name.find(filter) != std::string::npos;
+        }
+
+        void report(const std::string& name, const std::string& parameter, bool passed, const std::string& detail) {
+            std::cout << std::left << std::setw(16) << name << std::setw(28) << parameter
+                      << (passed ? "ok" : "FAILED") << "  " << detail << std::endl;
+            if (!passed) {
+                failures++;
+            }
+        }
+    };
+
+    // Layers of the composite's size go to the array as they are, others
+    // resampled by Compositor::sampleLayer, as Renderer::uploadLayerArray does
+    void compositeCheck(Checks& checks, Context& context) {
+        if (!checks.wants("composite")) {
+            return;
+        }
+
+        const int width = context.getWidth();
+        const int height = context.getHeight();
+        const int tolerance = 2;
+        CompositeLayers layers{ArenaAllocator<CompositeLayer>(Arena::frame())};
+        for (int i = 0; i < 7; i++) {
+            CompositeLayer layer;
+            layer.width = i == 4 ? width / 2 : width;
+            layer.height = i == 4 ? height / 3 : height;
+            layer.pixels = std::make_shared<const std::vector<unsigned char>>(
+                generateLayer(layer.width, layer.height, 11 + i));
+            layer.id = layer.pixels.get();
+            layer.visible = i != 5;
+            layer.opacity = 0.4f + 0.1f * i;
+            layer.mode = static_cast<BlendMode>(i % BLEND_MODE_COUNT);
+            layers.push_back(layer);
+        }
+
+        Shader shader("paint.vert", "composite.frag");
+        if (!shader.finish()) {
+            checks.report("composite", "program", false, "composite.frag did not link");
+            return;
+        }
+
+        LayerBlock block = {};
+        block.layerCount = static_cast<int32_t>(layers.size());
+        unsigned int array = 0;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, static_cast<int>(layers.size()), 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+        std::vector<unsigned char> sampled;
+        for (size_t i = 0; i < layers.size(); i++) {
+            const CompositeLayer& layer = layers[i];
+            if (!layer.visible) {
+                continue;
+            }
+            block.layerParams[i][0] = std::min(layer.opacity, 1.0f);
+            block.layerParams[i][1] = static_cast<float>(layer.mode);
+            const unsigned char* pixels = layer.pixels->data();
+            if (layer.width != width || layer.height != height) {
+                Compositor::sampleLayer(layer, width, height, sampled);
+                pixels = sampled.data();
+            }
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<int>(i), width, height, 1, GL_RGBA,
+                            GL_UNSIGNED_BYTE, pixels);
+        }
+
+        unsigned int layerBlock = 0;
+        glGenBuffers(1, &layerBlock);
+        glBindBuffer(GL_UNIFORM_BUFFER, layerBlock);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(block), &block, GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, LAYER_BLOCK_BINDING, layerBlock);
+
+        // The straight-alpha output as it is, without blending onto anything
+        FrameUniforms frame;
+        FullscreenTriangle triangle;
+        context.clear();
+        glDisable(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        shader.use();
+        shader.setInt("layerTextures", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        triangle.draw();
+        std::vector<unsigned char> gpu;
+        context.read(gpu);
+
+        glDeleteBuffers(1, &layerBlock);
+        glDeleteTextures(1, &array);
+
+        std::vector<unsigned char> cpu;
+        Compositor::flatten(layers, width, height, cpu);
+        int difference = compareImages(gpu, cpu);
+        checks.report("composite", "layers=" + std::to_string(layers.size()), difference <= tolerance,
+                      "largest difference " + std::to_string(difference) + " (tolerance " +
+                      std::to_string(tolerance) + ")");
+    }
+
+    // Tilted, wavy patch of gridSize^2 quads around center
+    MeshData generatePatch(int gridSize, const glm::vec3& center, float tilt) {
+        MeshData patch;
+        int stride = gridSize + 1;
+        glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), tilt, glm::vec3(1.0f, 0.3f, 0.0f));
+        for (int y = 0; y <= gridSize; y++) {
+            for (int x = 0; x <= gridSize; x++) {
+                float u = static_cast<float>(x) / gridSize;
+                float v = static_cast<float>(y) / gridSize;
+                glm::vec3 position(u - 0.5f, v - 0.5f, 0.15f * std::sin(u * 7.0f + tilt) * v);
+                Vertex vertex;
+                vertex.Position = center + glm::vec3(rotation * glm::vec4(position, 1.0f));
+                glm::vec3 normal(-std::cos(u * 7.0f) * v, -0.3f, 1.0f);
+                vertex.Normal = glm::normalize(glm::vec3(rotation * glm::vec4(normal, 0.0f)));
+                vertex.TexCoords = glm::vec2(u, v);
+                patch.vertices.push_back(vertex);
+            }
+        }
+        for (int y = 0; y < gridSize; y++) {
+            for (int x = 0; x < gridSize; x++) {
+                unsigned int i = y * stride + x;
+                patch.indices.insert(patch.indices.end(), { i, i + 1, i + stride + 1, i, i + stride + 1, i + stride });
+            }
+        }
+        return patch;
+    }
+
+    // One mesh in its own buffers, drawn on its own like before GeometryBuffer
+    class SeparateMesh {
+    public:
+        explicit SeparateMesh(const Mesh& mesh) : indexed(mesh.hasIndices()) {
+            count = static_cast<int>(indexed ? mesh.getIndicesCount() : mesh.getVerticesCount());
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(2, buffers);
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+            glBufferData(GL_ARRAY_BUFFER, mesh.getVerticesCount() * sizeof(Vertex), mesh.getVertices().data(),
+                         GL_STATIC_DRAW);
+            if (indexed) {
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.getIndicesCount() * sizeof(unsigned int),
+                             mesh.getIndices().data(), GL_STATIC_DRAW);
+            }
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            glBindVertexArray(0);
+        }
+
+        ~SeparateMesh() {
+            glDeleteBuffers(2, buffers);
+            glDeleteVertexArrays(1, &VAO);
+        }
+
+        SeparateMesh(const SeparateMesh&) = delete;
+        SeparateMesh& operator=(const SeparateMesh&) = delete;
+
+        void draw() const {
+            if (count == 0) {
+                return;
+            }
+            glBindVertexArray(VAO);
+            if (indexed) {
+                glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, nullptr);
+            } else {
+                glDrawArrays(GL_TRIANGLES, 0, count);
+            }
+            glBindVertexArray(0);
+        }
+
+    private:
+        bool indexed;
+        int count = 0;
+        unsigned int VAO = 0;
+        unsigned int buffers[2] = { 0, 0 };
+    };
+
+    // A grid of overlapping patches at different depths, some without
+    // indices and one empty, with a camera that sees only part of them
+    void geometryCheck(Checks& checks, Context& context) {
+        if (!checks.wants("geometry")) {
+            return;
+        }
+
+        std::vector<Mesh> meshes;
+        std::vector<Bounds> bounds;
+        for (int i = 0; i < 30; i++) {
+            glm::vec3 center(static_cast<float>(i % 6) * 0.8f - 2.0f, static_cast<float>(i / 6) * 0.7f - 1.4f,
+                             -0.35f * static_cast<float>(i % 4));
+            MeshData patch = generatePatch(2 + i % 7, center, 0.4f * static_cast<float>(i));
+            if (i % 5 == 2) {
+                // Triangle soup: the same triangles without an index buffer
+                std::vector<Vertex> soup;
+                for (unsigned int index : patch.indices) {
+                    soup.push_back(patch.vertices[index]);
+                }
+                patch.vertices = std::move(soup);
+                patch.indices.clear();
+            }
+            if (i == 13) {
+                patch.vertices.clear();
+                patch.indices.clear();
+            }
+            meshes.emplace_back(std::move(patch.vertices), std::move(patch.indices));
+            bounds.push_back(meshes.back().getBounds());
+        }
+
+        // Looking at the grid from the lower left, so its far corner is out of view
+        float aspect = static_cast<float>(context.getWidth()) / context.getHeight();
+        glm::mat4 projection = glm::perspective(glm::radians(35.0f), aspect, 0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(-1.6f, -1.0f, 3.2f), glm::vec3(-1.0f, -0.6f, 0.0f),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+        BoundsList list;
+        list.assign(bounds);
+        std::vector<uint8_t> visible;
+        size_t drawn = list.cull(Frustum::fromMatrix(projection * view), visible);
+        std::string parameter = "meshes=" + std::to_string(meshes.size()) + ",drawn=" + std::to_string(drawn);
+
+        Shader shader("basic.vert", "basic.frag");
+        if (!shader.finish()) {
+            checks.report("geometry", parameter, false, "basic shaders did not link");
+            return;
+        }
+        FrameUniforms frame;
+        frame.set(projection, view);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDisable(GL_BLEND);
+        shader.use();
+
+        // Every mesh, culled or not, on its own
+        context.clear();
+        std::vector<std::unique_ptr<SeparateMesh>> separate;
+        for (const Mesh& mesh : meshes) {
+            separate.push_back(std::make_unique<SeparateMesh>(mesh));
+            separate.back()->draw();
+        }
+        std::vector<unsigned char> expected;
+        context.read(expected);
+        separate.clear();
+
+        // The visible ones in a single indirect draw
+        GeometryBuffer geometry;
+        geometry.assign(meshes);
+        context.clear();
+        geometry.draw(visible);
+        std::vector<unsigned char> multiDraw;
+        context.read(multiDraw);
+
+        size_t covered = 0;
+        size_t differing = 0;
+        for (size_t i = 0; i < expected.size(); i += 4) {
+            covered += expected[i + 3] != 0 ? 1 : 0;
+            differing += std::equal(&expected[i], &expected[i] + 4, &multiDraw[i]) ? 0 : 1;
+        }
+        bool passed = differing == 0 && drawn < meshes.size() && covered > 0;
+        checks.report("geometry", parameter, passed,
+                      std::to_string(differing) + " of " + std::to_string(covered) + " covered pixels differ");
+    }
+}
+
+int main(int argc, char** argv) {
+    Checks checks;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            checks.filter = argv[++i];
+        } else {
+            std::cerr << "Usage: painter_gl_check [--filter text]" << std::endl;
+            return 1;
+        }
+    }
+
+    Context context;
+    if (!context.create(320, 240)) {
+        std::cerr << "Skipping the GPU checks" << std::endl;
+        return EXIT_SKIPPED;
+    }
+
+    compositeCheck(checks, context);
+    geometryCheck(checks, context);
+
+    if (checks.failures > 0) {
+        std::cerr << checks.failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * Layer save/load benchmark
+ *
+ * Usage: png_bench [layers] [size]
+ *
+ * Generates paint-like RGBA layers (default 8 layers of 2048x2048), then
+ * times saving them as PNG files one after another and through the thread
+ * pool, in both compact (stb zlib) and fast encoding modes, followed by
+ * sequential and parallel loading. Files go to the temp directory.
+ *
+ * Build (needs the stb_image and stb_image_write headers):
+ *   g++ -std=c++17 -O2 -Isrc -I<stb dir> png_bench.cpp src/png_codec.cpp \
+ *       src/thread_pool.cpp src/arena.cpp src/perf_counters.cpp src/file_writer.cpp \
+ *       -o png_bench -pthread
+ */
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include "png_codec.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+// Transparent layer with a few hundred soft round strokes
+static std::vector<unsigned char> generateLayer(int size, unsigned seed) {
+    std::vector<unsigned char> rgba(static_cast<size_t>(size) * size * 4, 0);
+    std::mt19937 random(seed);
+
+    for (int stroke = 0; stroke < 300; stroke++) {
+        int cx = random() % size;
+        int cy = random() % size;
+        int radius = 8 + random() % (size / 32);
+        unsigned char r = random(), g = random(), b = random();
+
+        for (int y = std::max(0, cy - radius); y < std::min(size, cy + radius); y++) {
+            for (int x = std::max(0, cx - radius); x < std::min(size, cx + radius); x++) {
+                int distance = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                if (distance < radius * radius) {
+                    unsigned char* pixel = &rgba[(static_cast<size_t>(y) * size + x) * 4];
+                    pixel[0] = r;
+                    pixel[1] = g;
+                    pixel[2] = b;
+                    pixel[3] = static_cast<unsigned char>(255 * (1.0f - static_cast<float>(distance) / (radius * radius)));
+                }
+            }
+        }
+    }
+
+    return rgba;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    int layerCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 8;
+    int size = argc > 2 ? std::max(64, std::atoi(argv[2])) : 2048;
+
+    std::cout << "Generating " << layerCount << " layers of " << size << "x" << size << "..." << std::endl;
+    std::vector<std::vector<unsigned char>> layers;
+    for (int i = 0; i < layerCount; i++) {
+        layers.push_back(generateLayer(size, 1234 + i));
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "png_bench";
+    std::filesystem::create_directories(directory);
+    std::vector<std::string> paths;
+    for (int i = 0; i < layerCount; i++) {
+        paths.push_back((directory / ("layer_" + std::to_string(i) + ".png")).string());
+    }
+
+    ThreadPool& pool = ThreadPool::shared();
+    std::cout << "Thread pool: " << pool.getThreadCount() << " worker(s)" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+
+    const PngCodec::Mode modes[2] = { PngCodec::MODE_COMPACT, PngCodec::MODE_FAST };
+    const char* modeNames[2] = { "compact", "fast" };
+
+    for (int m = 0; m < 2; m++) {
+        PngCodec::Mode mode = modes[m];
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < layerCount; i++) {
+            PngCodec::writeFile(paths[i], layers[i].data(), size, size, 4, mode);
+        }
+        double sequentialSave = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        pool.parallelFor(layerCount, [&](size_t i) {
+            PngCodec::writeFile(paths[i], layers[i].data(), size, size, 4, mode);
+        });
+        double parallelSave = elapsedMs(start);
+
+        uintmax_t totalBytes = 0;
+        for (const std::string& path : paths) {
+            totalBytes += std::filesystem::file_size(path);
+        }
+
+        std::vector<std::vector<unsigned char>> loaded(layerCount);
+        std::vector<int> widths(layerCount), heights(layerCount);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < layerCount; i++) {
+            PngCodec::readFile(paths[i], loaded[i], widths[i], heights[i]);
+        }
+        double sequentialLoad = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        pool.parallelFor(layerCount, [&](size_t i) {
+            PngCodec::readFile(paths[i], loaded[i], widths[i], heights[i]);
+        });
+        double parallelLoad = elapsedMs(start);
+
+        bool identical = true;
+        for (int i = 0; i < layerCount; i++) {
+            identical = identical && loaded[i] == layers[i];
+        }
+
+        std::cout << std::setw(8) << modeNames[m] << ": "
+                  << std::setw(8) << totalBytes / 1024 << " KB, save "
+                  << std::setw(7) << sequentialSave << " ms sequential / "
+                  << std::setw(7) << parallelSave << " ms parallel, load "
+                  << std::setw(7) << sequentialLoad << " ms sequential / "
+                  << std::setw(7) << parallelLoad << " ms parallel"
+                  << (identical ? "" : "  [ROUND TRIP MISMATCH]") << std::endl;
+    }
+
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -1,6 +1,19 @@
 #include "application.h"
+#include "profiler.h"
+#include "arena.h"
+#include <chrono>
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
+
+namespace {
+    // Frames drawn per invalidation, and how long an idle loop sleeps before
+    // ticking background work such as autosave
+    const int FRAMES_PER_INVALIDATE = 3;
+    const double IDLE_WAIT_SECONDS = 0.5;
+}
 
 // Static member to store the current instance for callbacks
 static Application* currentInstance = nullptr;
@@ -26,46 +39,100 @@ static void keyCallbackForwarder(GLFWwindow* window, int key, int scancode, int
     if (currentInstance) currentInstance->keyCallback(window, key, scancode, action, mods);
 }
 
-Application::Application() 
-    : window(nullptr), 
+static void windowRefreshCallbackForwarder(GLFWwindow* window) {
+    if (currentInstance) currentInstance->windowRefreshCallback(window);
+}
+
+Application::Application(const ApplicationOptions& options) 
+    : options(options),
+      window(nullptr), 
       windowWidth(1280), 
       windowHeight(720),
+      currentTool(nullptr),
       lastMouseX(0.0),
       lastMouseY(0.0),
       mousePressed(false),
-      currentTool(nullptr) {
+      rotating(false),
+      recordedTool(nullptr),
+      replayNext(0),
+      pendingFrames(FRAMES_PER_INVALIDATE),
+      frameCount(0),
+      drawnStamp(0) {
     
     // Store instance for callbacks
     currentInstance = this;
+    heldKeys.fill(false);
+    memoryBudget.setBudgets(options.softMemoryBudget, options.hardMemoryBudget);
+    
+    // A replay starts from the window size it was recorded at
+    if (isReplaying() && !startReplay()) {
+        throw std::runtime_error("Failed to read input log " + options.replayPath);
+    }
     
     // Initialize GLFW and create window
-    initGLFW();
+    if (!options.headless) {
+        initGLFW();
+    }
     
     // Create camera
     camera = std::make_unique<Camera>(glm::vec3(0.0f, 0.0f, 5.0f));
     
     // Create renderer
-    renderer = std::make_unique<Renderer>();
+    if (!options.headless) {
+        renderer = std::make_unique<Renderer>();
+    }
     
     // Create project
     project = std::make_unique<Project>();
+    autosave = std::make_unique<Autosave>();
     
     // Initialize UI
-    initUI();
+    if (!options.headless) {
+        initUI();
+    }
     
     // Initialize painting tools
     initTools();
     
+    // Paint off the main thread; finished commands wake the event loop
+    std::function<void()> onPainted;
+    if (!options.headless) {
+        onPainted = [] { glfwPostEmptyEvent(); };
+    }
+    paintWorker = std::make_unique<PaintWorker>(*project, onPainted);
+    
     // Set up callbacks
-    setupCallbacks();
+    if (!options.headless) {
+        setupCallbacks();
+    }
+    
+    if (!options.recordPath.empty() && !isReplaying()) {
+        recorder = std::make_unique<InputRecorder>();
+        if (!recorder->open(options.recordPath, windowWidth, windowHeight)) {
+            recorder.reset();
+        }
+    }
 }
 
 Application::~Application() {
+    // Finish queued strokes while the tools and project still exist
+    paintWorker.reset();
+    
+    if (recorder) {
+        recorder->finish(*project);
+    }
+    
+    if (Profiler::isTraceRequested()) {
+        Profiler::writeChromeTrace(Profiler::getTracePath());
+    }
+    
     // ImGui cleanup is handled by UI destructor
     
     // Destroy window
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
     
     // Reset static instance
     currentInstance = nullptr;
@@ -102,6 +169,7 @@ void Application::setupCallbacks() {
     glfwSetCursorPosCallback(window, cursorPosCallbackForwarder);
     glfwSetScrollCallback(window, scrollCallbackForwarder);
     glfwSetKeyCallback(window, keyCallbackForwarder);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallbackForwarder);
 }
 
 void Application::initUI() {
@@ -122,75 +190,217 @@ void Application::initTools() {
     currentTool = paintTools[0].get();
 }
 
-void Application::run() {
-    float lastFrame = 0.0f;
+int Application::run() {
+    PROFILE_THREAD_NAME("Main");
+    if (options.headless) {
+        return runHeadless();
+    }
+    float lastFrame = static_cast<float>(glfwGetTime());
     
     // Main loop
     while (!glfwWindowShouldClose(window)) {
+        // Sleep until an event arrives, unless a frame is pending
+        bool polled = pendingFrames > 0;
+        auto replayedAt = std::chrono::steady_clock::now();
+        if (isReplaying()) {
+            // Window events still arrive, but the scene only sees the log
+            glfwPollEvents();
+            if (!replayFrame()) {
+                break;
+            }
+            replayedAt = std::chrono::steady_clock::now();
+            invalidate();
+            polled = true;
+        } else if (polled) {
+            PROFILE_SCOPE("Application::pollEvents");
+            glfwPollEvents();
+        } else {
+            glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+        }
+        PROFILE_SCOPE("Application::frame");
+        
         // Calculate delta time
         float currentFrame = static_cast<float>(glfwGetTime());
         float deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
         
         // Process input
-        processInput();
+        if (processInput()) {
+            invalidate();
+        }
+        
+        // The paint worker waits while the frame reads the layers. Frames are
+        // still drawn while a fill searches, but edits wait until it is done.
+        std::unique_lock<std::mutex> layers = paintWorker->lockForDrawing();
+        
+        // Save in the background if the project changed
+        if (!isReplaying()) {
+            autosave->update(*project, deltaTime);
+        }
+        
+        // Evict what can be recreated if the project outgrew the budgets
+        if (!paintWorker->isBusy()) {
+            performance.setMemoryReport(memoryBudget.update(*project));
+        }
+        
+        // Edits that did not come through an input callback, such as strokes
+        // finished by the paint worker
+        if (project->getChangeStamp() != drawnStamp) {
+            invalidate();
+        }
+        
+        if (pendingFrames == 0) {
+            continue;
+        }
+        pendingFrames--;
+        auto frameStart = std::chrono::steady_clock::now();
+        Arena::frame().reset();
+        paintWorker->beginFrame();
+        if (recorder) {
+            InputEvent frame;
+            frame.type = InputEvent::FRAME;
+            record(frame);
+        }
         
         // Update
-        update(deltaTime);
+        {
+            PROFILE_SCOPE("Application::update");
+            update(deltaTime);
+        }
         
         // Render
-        render();
+        {
+            PROFILE_SCOPE("Application::render");
+            render();
+        }
+        drawnStamp = project->getChangeStamp();
+        layers.unlock();
         
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // Swap buffers
+        {
+            PROFILE_SCOPE("Application::swapBuffers");
+            glfwSwapBuffers(window);
+        }
+        frameCount++;
+        paintWorker->endFrame(polled);
+        std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+        performance.endFrame(frameTime.count());
+        if (isReplaying()) {
+            std::chrono::duration<double, std::milli> replayTime = std::chrono::steady_clock::now() - replayedAt;
+            replayFrameTimes.push_back(replayTime.count());
+        }
     }
+    
+    return isReplaying() ? finishReplay() : 0;
+}
+
+void Application::invalidate() {
+    pendingFrames = FRAMES_PER_INVALIDATE;
 }
 
-void Application::processInput() {
+bool Application::processInput() {
     // Close window on Escape key
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+    if (window && glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     }
     
-    // Camera movement
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+    // A replay moves the camera at the recorded frames instead
+    if (isReplaying()) {
+        return false;
+    }
+    return moveCamera();
+}
+
+bool Application::moveCamera() {
+    // Camera movement; held keys keep the frame dirty
+    bool moved = false;
+    if (heldKeys[GLFW_KEY_W]) {
         camera->processKeyboard(CameraMovement::FORWARD, 0.05f);
+        moved = true;
     }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+    if (heldKeys[GLFW_KEY_S]) {
         camera->processKeyboard(CameraMovement::BACKWARD, 0.05f);
+        moved = true;
     }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+    if (heldKeys[GLFW_KEY_A]) {
         camera->processKeyboard(CameraMovement::LEFT, 0.05f);
+        moved = true;
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+    if (heldKeys[GLFW_KEY_D]) {
         camera->processKeyboard(CameraMovement::RIGHT, 0.05f);
+        moved = true;
     }
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
+    if (heldKeys[GLFW_KEY_Q]) {
         camera->processKeyboard(CameraMovement::UP, 0.05f);
+        moved = true;
     }
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
+    if (heldKeys[GLFW_KEY_E]) {
         camera->processKeyboard(CameraMovement::DOWN, 0.05f);
+        moved = true;
     }
+    return moved;
 }
 
 void Application::update(float deltaTime) {
     // Update UI
     ui->update(deltaTime, *project, paintTools, currentTool);
     
+    // Edits from the menus and panels stay queued while a fill is searching
+    if (paintWorker->isBusy()) {
+        return;
+    }
+    
+    // Project edits from the menus and panels; a replay ignores them
+    for (const InputEvent& command : ui->takeCommands()) {
+        if (!isReplaying()) {
+            record(command);
+            applyCommand(static_cast<ProjectCommand>(command.a), command.b);
+        }
+    }
+    
     // Process UI commands
     if (ui->shouldLoadModel()) {
-        std::string path = ui->getModelPath();
-        project->loadModel(path);
+        if (!isReplaying()) {
+            InputEvent event;
+            event.type = InputEvent::LOAD_MODEL;
+            event.path = ui->getModelPath();
+            record(event);
+            project->loadModel(event.path);
+        }
         ui->clearModelLoadFlag();
     }
     
     if (ui->shouldSaveProject()) {
         std::string path = ui->getProjectPath();
-        project->saveProject(path);
+        if (project->saveProject(path)) {
+            // Keep autosaves next to the project the user picked
+            autosave->setPath(path + ".autosave");
+        }
         ui->clearSaveProjectFlag();
     }
     
+    if (ui->shouldSaveVersion()) {
+        project->saveVersion(ui->getProjectPath());
+        ui->clearSaveVersionFlag();
+    }
+    
+    if (ui->getVersionToOpen() != 0) {
+        if (!isReplaying()) {
+            InputEvent event;
+            event.type = InputEvent::OPEN_VERSION;
+            event.path = ui->getProjectPath();
+            event.a = static_cast<int32_t>(ui->getVersionToOpen());
+            record(event);
+            project->openVersion(event.path, ui->getVersionToOpen());
+        }
+        ui->clearVersionToOpen();
+    }
+    
+    if (ui->shouldSaveTrace()) {
+        Profiler::writeChromeTrace(Profiler::getTracePath());
+        ui->clearSaveTraceFlag();
+    }
+    
     if (ui->shouldExportModel()) {
         std::string path = ui->getExportPath();
         project->exportModel(path);
@@ -198,7 +408,10 @@ void Application::update(float deltaTime) {
     }
     
     // Update current tool
-    currentTool = ui->getSelectedTool();
+    if (!isReplaying()) {
+        currentTool = ui->getSelectedTool();
+        recordToolChanges();
+    }
 }
 
 void Application::render() {
@@ -208,73 +421,160 @@ void Application::render() {
     
     // Render the model if available
     if (project->hasModel()) {
+        renderer->setCompositeMode(ui->useGpuCompositing() ? Renderer::COMPOSITE_GPU : Renderer::COMPOSITE_CPU);
         renderer->render(project->getModel(), *camera, *project);
+        ui->setCullStats(renderer->getCullStats());
+        ui->setUniformCalls(renderer->getFrameUniformCalls());
+    }
+    ui->setPaintLatency(paintWorker->getLatency());
+    if (ui->isPerformancePanelOpen()) {
+        performance.sampleMemory(*project);
     }
+    ui->setPerformanceStats(performance.getStats());
     
     // Render UI
     ui->render();
 }
 
 void Application::framebufferSizeCallback(GLFWwindow* window, int width, int height) {
-    windowWidth = width;
-    windowHeight = height;
+    invalidate();
     glViewport(0, 0, width, height);
     
-    // Update camera aspect ratio
-    camera->setAspectRatio(static_cast<float>(width) / static_cast<float>(height));
+    if (isReplaying()) {
+        return;
+    }
+    InputEvent event;
+    event.type = InputEvent::RESIZE;
+    event.a = width;
+    event.b = height;
+    record(event);
+    handleResize(width, height);
 }
 
 void Application::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
-    if (ui->wantCaptureMouse()) {
+    // Any input may change the UI as well as the scene
+    invalidate();
+    auto inputTime = std::chrono::steady_clock::now();
+    
+    // Releases always reach the scene, so strokes and drags end
+    if (isReplaying() || (ui->wantCaptureMouse() && action != GLFW_RELEASE)) {
         return;
     }
     
+    InputEvent event;
+    event.type = InputEvent::MOUSE_BUTTON;
+    event.a = button;
+    event.b = action;
+    event.c = mods;
+    glfwGetCursorPos(window, &event.x, &event.y);
+    record(event);
+    handleMouseButton(button, action, event.x, event.y, inputTime);
+}
+
+void Application::cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
+    // Any input may change the UI as well as the scene
+    invalidate();
+    auto inputTime = std::chrono::steady_clock::now();
+    
+    if (isReplaying() || ui->wantCaptureMouse()) {
+        return;
+    }
+    
+    InputEvent event;
+    event.type = InputEvent::CURSOR;
+    event.x = xpos;
+    event.y = ypos;
+    record(event);
+    handleCursor(xpos, ypos, inputTime);
+}
+
+void Application::scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
+    // Any input may change the UI as well as the scene
+    invalidate();
+    
+    if (isReplaying() || ui->wantCaptureMouse()) {
+        return;
+    }
+    
+    InputEvent event;
+    event.type = InputEvent::SCROLL;
+    event.x = xoffset;
+    event.y = yoffset;
+    record(event);
+    handleScroll(yoffset);
+}
+
+void Application::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    // Any input may change the UI as well as the scene
+    invalidate();
+    
+    // Releases always reach the scene, so held camera keys let go
+    if (isReplaying() || (ui->wantCaptureKeyboard() && action != GLFW_RELEASE)) {
+        return;
+    }
+    
+    InputEvent event;
+    event.type = InputEvent::KEY;
+    event.a = key;
+    event.b = action;
+    event.c = mods;
+    record(event);
+    handleKey(key, action, mods);
+}
+
+void Application::handleResize(int width, int height) {
+    windowWidth = width;
+    windowHeight = height;
+    
+    // Update camera aspect ratio (a minimized window is 0 x 0)
+    if (width > 0 && height > 0) {
+        camera->setAspectRatio(static_cast<float>(width) / static_cast<float>(height));
+    }
+}
+
+void Application::handleMouseButton(int button, int action, double xpos, double ypos,
+                                    std::chrono::steady_clock::time_point inputTime) {
     if (button == GLFW_MOUSE_BUTTON_LEFT) {
         if (action == GLFW_PRESS) {
             mousePressed = true;
             
             // Start painting if we have a model and a tool
             if (project->hasModel() && currentTool) {
-                double xpos, ypos;
-                glfwGetCursorPos(window, &xpos, &ypos);
-                
                 // Perform ray casting to determine the 3D position on the model
                 glm::vec3 worldPos;
-                if (renderer->pickPosition(project->getModel(), *camera, xpos, ypos, windowWidth, windowHeight, worldPos)) {
-                    currentTool->begin(project->getCurrentLayer(), worldPos);
+                if (pick(xpos, ypos, worldPos)) {
+                    paintWorker->beginStroke(currentTool, worldPos, inputTime);
                 }
             }
         } else if (action == GLFW_RELEASE) {
             mousePressed = false;
             
             // End painting
-            if (currentTool) {
-                currentTool->end();
-            }
+            paintWorker->endStroke(inputTime);
         }
     } else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
         if (action == GLFW_PRESS) {
             // Store mouse position for camera rotation
-            glfwGetCursorPos(window, &lastMouseX, &lastMouseY);
+            lastMouseX = xpos;
+            lastMouseY = ypos;
+            rotating = true;
+        } else if (action == GLFW_RELEASE) {
+            rotating = false;
         }
     }
 }
 
-void Application::cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
-    if (ui->wantCaptureMouse()) {
-        return;
-    }
-    
+void Application::handleCursor(double xpos, double ypos, std::chrono::steady_clock::time_point inputTime) {
     if (mousePressed && currentTool && project->hasModel()) {
         // Continue painting
         glm::vec3 worldPos;
-        if (renderer->pickPosition(project->getModel(), *camera, xpos, ypos, windowWidth, windowHeight, worldPos)) {
-            currentTool->update(worldPos);
+        if (pick(xpos, ypos, worldPos)) {
+            paintWorker->continueStroke(worldPos, inputTime);
         }
     }
     
     // Camera rotation with right mouse button
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+    if (rotating) {
         float xoffset = static_cast<float>(xpos - lastMouseX);
         float yoffset = static_cast<float>(lastMouseY - ypos); // Reversed since y-coordinates go from bottom to top
         
@@ -285,18 +585,14 @@ void Application::cursorPosCallback(GLFWwindow* window, double xpos, double ypos
     }
 }
 
-void Application::scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
-    if (ui->wantCaptureMouse()) {
-        return;
-    }
-    
+void Application::handleScroll(double yoffset) {
     // Camera zoom
     camera->processMouseScroll(static_cast<float>(yoffset));
 }
 
-void Application::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    if (ui->wantCaptureKeyboard()) {
-        return;
+void Application::handleKey(int key, int action, int mods) {
+    if (key >= 0 && key <= GLFW_KEY_LAST) {
+        heldKeys[key] = (action != GLFW_RELEASE);
     }
     
     // Handle keyboard shortcuts
@@ -320,30 +616,324 @@ void Application::keyCallback(GLFWwindow* window, int key, int scancode, int act
                     currentTool = paintTools[2].get();
                 }
                 break;
+            case GLFW_KEY_Z:
+                // Undo
+                if (mods & GLFW_MOD_CONTROL) {
+                    auto layers = paintWorker->lock();
+                    project->undo();
+                }
+                break;
+            case GLFW_KEY_Y:
+                // Redo
+                if (mods & GLFW_MOD_CONTROL) {
+                    auto layers = paintWorker->lock();
+                    project->redo();
+                }
+                break;
             case GLFW_KEY_N:
                 // New layer
                 if (mods & GLFW_MOD_CONTROL) {
+                    auto layers = paintWorker->lock();
                     project->addLayer();
                 }
                 break;
             case GLFW_KEY_S:
                 // Save project
-                if (mods & GLFW_MOD_CONTROL) {
+                if ((mods & GLFW_MOD_CONTROL) && ui) {
                     ui->setSaveProjectFlag();
                 }
                 break;
             case GLFW_KEY_O:
                 // Open model
-                if (mods & GLFW_MOD_CONTROL) {
+                if ((mods & GLFW_MOD_CONTROL) && ui) {
                     ui->setModelLoadFlag();
                 }
                 break;
             case GLFW_KEY_E:
                 // Export model
-                if (mods & GLFW_MOD_CONTROL) {
+                if ((mods & GLFW_MOD_CONTROL) && ui) {
                     ui->setExportModelFlag();
                 }
                 break;
+            case GLFW_KEY_F12:
+                // Save profiler trace
+                if (ui) {
+                    ui->setSaveTraceFlag();
+                }
+                break;
+        }
+    }
+}
+
+bool Application::pick(double xpos, double ypos, glm::vec3& worldPos) {
+    // Headless replays have no renderer, but pick the same way
+    if (renderer) {
+        return renderer->pickPosition(project->getModel(), *camera, xpos, ypos, windowWidth, windowHeight, worldPos);
+    }
+    return Renderer::pickModel(project->getModel(), *camera, xpos, ypos, windowWidth, windowHeight, worldPos);
+}
+
+void Application::record(const InputEvent& event) {
+    if (recorder) {
+        recorder->record(event);
+    }
+}
+
+void Application::applyCommand(ProjectCommand command, int layer) {
+    switch (command) {
+        case ProjectCommand::NEW_PROJECT:
+            project->clear();
+            project->addLayer(); // Add a default layer
+            break;
+        case ProjectCommand::UNDO:
+            project->undo();
+            break;
+        case ProjectCommand::REDO:
+            project->redo();
+            break;
+        case ProjectCommand::CLEAR_ALL_LAYERS:
+            project->beginEdit("Clear All Layers");
+            for (size_t i = 0; i < project->getLayers().size(); i++) {
+                project->getLayer(i)->clear();
+            }
+            project->endEdit();
+            break;
+        case ProjectCommand::ADD_LAYER:
+            project->addLayer();
+            break;
+        case ProjectCommand::REMOVE_LAYER:
+            project->removeLayer(static_cast<size_t>(layer));
+            break;
+        case ProjectCommand::CLEAR_LAYER:
+            if (project->getCurrentLayer()) {
+                project->beginEdit("Clear Layer");
+                project->getCurrentLayer()->clear();
+                project->endEdit();
+            }
+            break;
+        case ProjectCommand::SELECT_LAYER:
+            if (static_cast<size_t>(layer) < project->getLayers().size()) {
+                project->setCurrentLayerIndex(static_cast<size_t>(layer));
+            }
+            break;
+    }
+}
+
+void Application::recordToolChanges() {
+    if (!recorder) {
+        return;
+    }
+    
+    // The first call records every tool, so a replay starts from the same settings
+    bool first = recordedSettings.empty();
+    recordedSettings.resize(paintTools.size());
+    for (size_t i = 0; i < paintTools.size(); i++) {
+        const PaintTool* tool = paintTools[i].get();
+        InputEvent settings;
+        settings.type = InputEvent::TOOL_SETTINGS;
+        settings.a = static_cast<int32_t>(i);
+        settings.size = tool->getSize();
+        settings.hardness = tool->getHardness();
+        settings.color = tool->getColor();
+        if (const FillTool* fill = dynamic_cast<const FillTool*>(tool)) {
+            settings.tolerance = fill->getTolerance();
+        }
+        
+        const InputEvent& last = recordedSettings[i];
+        if (first || settings.size != last.size || settings.hardness != last.hardness ||
+            settings.color != last.color || settings.tolerance != last.tolerance) {
+            record(settings);
+            recordedSettings[i] = settings;
         }
     }
+    
+    if (first || currentTool != recordedTool) {
+        for (size_t i = 0; i < paintTools.size(); i++) {
+            if (paintTools[i].get() == currentTool) {
+                InputEvent select;
+                select.type = InputEvent::SELECT_TOOL;
+                select.a = static_cast<int32_t>(i);
+                record(select);
+            }
+        }
+        recordedTool = currentTool;
+    }
+}
+
+void Application::windowRefreshCallback(GLFWwindow* window) {
+    // The window was uncovered or resized and its contents are lost
+    invalidate();
+}
+
+bool Application::startReplay() {
+    InputLog::Header header;
+    if (!InputLog::read(options.replayPath, header, replayEvents)) {
+        return false;
+    }
+    if (header.windowWidth > 0 && header.windowHeight > 0) {
+        windowWidth = header.windowWidth;
+        windowHeight = header.windowHeight;
+    }
+    
+    // The hashes are checked at the end rather than replayed
+    auto hashes = std::find_if(replayEvents.begin(), replayEvents.end(),
+                               [](const InputEvent& event) { return event.type == InputEvent::LAYER_HASHES; });
+    if (hashes != replayEvents.end()) {
+        recordedHashes = hashes->hashes;
+    }
+    
+    replayNext = 0;
+    replayStart = std::chrono::steady_clock::now();
+    std::cout << "Replaying " << replayEvents.size() << " input events from " << options.replayPath << std::endl;
+    return true;
+}
+
+bool Application::replayFrame() {
+    PROFILE_SCOPE("Application::replayFrame");
+    if (replayNext >= replayEvents.size()) {
+        return false;
+    }
+    
+    // In real time, wait until the frame was drawn in the recording
+    size_t frameEnd = replayNext;
+    while (frameEnd < replayEvents.size() && replayEvents[frameEnd].type != InputEvent::FRAME) {
+        frameEnd++;
+    }
+    if (!options.fastReplay && frameEnd < replayEvents.size()) {
+        std::this_thread::sleep_until(replayStart + std::chrono::microseconds(replayEvents[frameEnd].time));
+    }
+    
+    for (; replayNext <= frameEnd && replayNext < replayEvents.size(); replayNext++) {
+        applyEvent(replayEvents[replayNext]);
+    }
+    return true;
+}
+
+void Application::applyEvent(const InputEvent& event) {
+    auto now = std::chrono::steady_clock::now();
+    switch (event.type) {
+        case InputEvent::FRAME:
+            moveCamera();
+            break;
+        case InputEvent::CURSOR:
+            handleCursor(event.x, event.y, now);
+            break;
+        case InputEvent::MOUSE_BUTTON:
+            handleMouseButton(event.a, event.b, event.x, event.y, now);
+            break;
+        case InputEvent::SCROLL:
+            handleScroll(event.y);
+            break;
+        case InputEvent::KEY:
+            handleKey(event.a, event.b, event.c);
+            break;
+        case InputEvent::RESIZE:
+            handleResize(event.a, event.b);
+            break;
+        case InputEvent::SELECT_TOOL:
+            if (event.a >= 0 && static_cast<size_t>(event.a) < paintTools.size()) {
+                currentTool = paintTools[event.a].get();
+            }
+            break;
+        case InputEvent::TOOL_SETTINGS:
+            if (event.a >= 0 && static_cast<size_t>(event.a) < paintTools.size()) {
+                PaintTool* tool = paintTools[event.a].get();
+                tool->setSize(event.size);
+                tool->setHardness(event.hardness);
+                tool->setColor(event.color);
+                if (FillTool* fill = dynamic_cast<FillTool*>(tool)) {
+                    fill->setTolerance(event.tolerance);
+                }
+            }
+            break;
+        case InputEvent::COMMAND: {
+            auto layers = paintWorker->lock();
+            applyCommand(static_cast<ProjectCommand>(event.a), event.b);
+            break;
+        }
+        case InputEvent::LOAD_MODEL: {
+            auto layers = paintWorker->lock();
+            project->loadModel(event.path);
+            break;
+        }
+        case InputEvent::OPEN_VERSION: {
+            auto layers = paintWorker->lock();
+            project->openVersion(event.path, static_cast<uint32_t>(event.a));
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+int Application::runHeadless() {
+    // Each frame is timed from its first event until the paint worker has
+    // drawn it and the layers are composited, as the window would show them
+    while (true) {
+        auto frameStart = std::chrono::steady_clock::now();
+        Arena::frame().reset();
+        if (!replayFrame()) {
+            break;
+        }
+        {
+            auto layers = paintWorker->lock();
+            project->updateComposite();
+        }
+        std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frameStart;
+        replayFrameTimes.push_back(frameTime.count());
+        frameCount++;
+    }
+    return finishReplay();
+}
+
+int Application::finishReplay() {
+    // A log cut short may leave a stroke open
+    paintWorker->endStroke(std::chrono::steady_clock::now());
+    auto layers = paintWorker->lock();
+    
+    std::vector<double> sorted = replayFrameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double time : sorted) {
+        total += time;
+    }
+    auto percentile = [&sorted](double p) {
+        return sorted.empty() ? 0.0 : sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+    };
+    
+    std::vector<uint64_t> hashes = InputLog::hashLayers(*project);
+    bool identical = (hashes == recordedHashes);
+    
+    std::cout << "Replayed " << sorted.size() << " frames in " << total << " ms"
+              << " (avg " << (sorted.empty() ? 0.0 : total / sorted.size())
+              << " ms, p50 " << percentile(0.5)
+              << " ms, p95 " << percentile(0.95)
+              << " ms, max " << percentile(1.0) << " ms)" << std::endl;
+    if (recordedHashes.empty()) {
+        std::cerr << "Input log has no layer hashes to compare against" << std::endl;
+    } else if (identical) {
+        std::cout << "Layers are identical to the recording (" << hashes.size() << " layers)" << std::endl;
+    } else {
+        std::cerr << "Layers differ from the recording" << std::endl;
+    }
+    
+    if (!options.reportPath.empty()) {
+        std::ofstream report(options.reportPath);
+        report << "{\n  \"frames\": " << replayFrameTimes.size() << ",\n"
+               << "  \"total_ms\": " << total << ",\n"
+               << "  \"p50_ms\": " << percentile(0.5) << ",\n"
+               << "  \"p95_ms\": " << percentile(0.95) << ",\n"
+               << "  \"max_ms\": " << percentile(1.0) << ",\n"
+               << "  \"identical\": " << (identical ? "true" : "false") << ",\n"
+               << "  \"frame_ms\": [";
+        for (size_t i = 0; i < replayFrameTimes.size(); i++) {
+            report << (i ? ", " : "") << replayFrameTimes[i];
+        }
+        report << "]\n}\n";
+        if (!report) {
+            std::cerr << "Failed to write replay report: " << options.reportPath << std::endl;
+        }
+    }
+    
+    return (recordedHashes.empty() || identical) ? 0 : 1;
 }
@@ -6,21 +6,58 @@
 #include "ui.h"
 #include "paint_tool.h"
 #include "project.h"
+#include "autosave.h"
+#include "paint_worker.h"
+#include "performance_monitor.h"
+#include "input_log.h"
 
 #include <GLFW/glfw3.h>
+#include <array>
+#include <chrono>
 #include <string>
 #include <memory>
 #include <vector>
 
+// Command line options (see main.cpp)
+struct ApplicationOptions {
+    std::string recordPath;     // record input to this log
+    std::string replayPath;     // replay this log instead of taking input
+    std::string reportPath;     // per-frame timings of the replay as JSON
+    bool headless = false;      // replay without a window or GL context
+    bool fastReplay = false;    // replay frames back to back instead of at the recorded times
+    size_t softMemoryBudget = 0;    // bytes; over it caches and hidden layers are evicted (0 = none)
+    size_t hardMemoryBudget = 0;    // bytes; over it a warning is printed (0 = none)
+};
+
 class Application {
 public:
-    Application();
+    explicit Application(const ApplicationOptions& options = ApplicationOptions());
     ~Application();
     
-    void run();
+    // Returns the exit code: nonzero if a replay ended with other layers
+    // than the recording did
+    int run();
+    
+    // Request a redraw. The loop sleeps in glfwWaitEventsTimeout until
+    // something invalidates the frame: input, a window refresh, held camera
+    // keys or a project change.
+    void invalidate();
+    
+    // Frames drawn so far, for tests and diagnostics
+    uint64_t getFrameCount() const { return frameCount; }
+    
+    // GLFW callbacks, called through the forwarders in application.cpp
+    void framebufferSizeCallback(GLFWwindow* window, int width, int height);
+    void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+    void cursorPosCallback(GLFWwindow* window, double xpos, double ypos);
+    void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
+    void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    void windowRefreshCallback(GLFWwindow* window);
     
 private:
-    // GLFW window
+    ApplicationOptions options;
+    
+    // GLFW window (null when headless)
     GLFWwindow* window;
     int windowWidth;
     int windowHeight;
@@ -30,8 +67,17 @@ private:
     std::unique_ptr<Camera> camera;
     std::unique_ptr<UI> ui;
     std::unique_ptr<Project> project;
+    std::unique_ptr<Autosave> autosave;
     std::vector<std::unique_ptr<PaintTool>> paintTools;
     
+    // Runs the strokes started by the mouse callbacks
+    std::unique_ptr<PaintWorker> paintWorker;
+    
+    // Frame times and counters for the Performance panel, and the memory
+    // budgets checked every loop
+    PerformanceMonitor performance;
+    MemoryBudget memoryBudget;
+    
     // Current state
     PaintTool* currentTool;
     
@@ -39,24 +85,63 @@ private:
     double lastMouseX;
     double lastMouseY;
     bool mousePressed;
+    bool rotating;
+    
+    // Keys pressed over the scene; held camera keys move it once per frame
+    std::array<bool, GLFW_KEY_LAST + 1> heldKeys;
+    
+    // Input recording, and the tool state last written to it
+    std::unique_ptr<InputRecorder> recorder;
+    PaintTool* recordedTool;
+    std::vector<InputEvent> recordedSettings;
+    
+    // Replay: the log, the next event and the time of each replayed frame
+    std::vector<InputEvent> replayEvents;
+    size_t replayNext;
+    std::chrono::steady_clock::time_point replayStart;
+    std::vector<uint64_t> recordedHashes;
+    std::vector<double> replayFrameTimes;
+    
+    // Frames still to draw after the last invalidation (ImGui needs a few to
+    // settle hover and popup state), frames drawn, and the project change
+    // stamp of the last drawn frame
+    int pendingFrames;
+    uint64_t frameCount;
+    uint64_t drawnStamp;
     
     // Initialize application
     void initGLFW();
     void initUI();
     void initTools();
     
-    // GLFW callbacks
-    static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
-    static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
-    static void cursorPosCallback(GLFWwindow* window, double xpos, double ypos);
-    static void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
-    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
-    
     // Set up callback context
     void setupCallbacks();
     
-    // Handle input
-    void processInput();
+    // Handle input; returns true if the camera moved
+    bool processInput();
+    bool moveCamera();
+    
+    // Scene input, from the GLFW callbacks or a replayed log
+    bool isReplaying() const { return !options.replayPath.empty(); }
+    void record(const InputEvent& event);
+    void handleMouseButton(int button, int action, double xpos, double ypos,
+                           std::chrono::steady_clock::time_point inputTime);
+    void handleCursor(double xpos, double ypos, std::chrono::steady_clock::time_point inputTime);
+    void handleScroll(double yoffset);
+    void handleKey(int key, int action, int mods);
+    void handleResize(int width, int height);
+    bool pick(double xpos, double ypos, glm::vec3& worldPos);
+    
+    // UI edits and tool changes (the layers must be locked)
+    void applyCommand(ProjectCommand command, int layer);
+    void recordToolChanges();
+    
+    // Replay the events of one frame; false once the log is done
+    bool startReplay();
+    bool replayFrame();
+    void applyEvent(const InputEvent& event);
+    int runHeadless();
+    int finishReplay();
     
     // Update and render
     void update(float deltaTime);
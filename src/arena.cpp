@@ -0,0 +1,72 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+
+Arena::Arena(size_t blockSize)
+    : current(0), offset(0), blockSize(std::max<size_t>(blockSize, 1)), peak(0) {
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    bytes = std::max<size_t>(bytes, 1);
+    while (current < blocks.size()) {
+        Block& block = blocks[current];
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+        size_t start = ((base + offset + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+        if (start + bytes <= block.size) {
+            offset = start + bytes;
+            peak = std::max(peak, getUsed());
+            return block.data.get() + start;
+        }
+        // Too small; the rest of the block is wasted until reset()
+        current++;
+        offset = 0;
+    }
+
+    // Blocks double, so a growing arena needs few of them
+    size_t size = std::max(blocks.empty() ? blockSize : blocks.back().size * 2, bytes + alignment);
+    blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+    current = blocks.size() - 1;
+    offset = 0;
+    return allocate(bytes, alignment);
+}
+
+void Arena::reset() {
+    if (blocks.size() > 1) {
+        // One block as large as all of them, so the next round fits in it
+        size_t size = getReserved();
+        blocks.clear();
+        blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+    }
+    current = 0;
+    offset = 0;
+}
+
+size_t Arena::getUsed() const {
+    size_t used = offset;
+    for (size_t i = 0; i < current && i < blocks.size(); i++) {
+        used += blocks[i].size;
+    }
+    return used;
+}
+
+size_t Arena::getReserved() const {
+    size_t reserved = 0;
+    for (const Block& block : blocks) {
+        reserved += block.size;
+    }
+    return reserved;
+}
+
+Arena::Scope::Scope(Arena& arena)
+    : arena(arena), block(arena.current), offset(arena.offset) {
+}
+
+Arena::Scope::~Scope() {
+    arena.current = block;
+    arena.offset = offset;
+}
+
+Arena& Arena::frame() {
+    thread_local Arena arena;
+    return arena;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Linear allocator for temporaries. Allocation bumps an offset into the
+// current block; nothing is freed on its own, everything goes at once with
+// reset() or when a Scope ends. Blocks are kept for reuse, and reset()
+// merges them into one, so once the arena has grown to its working size it
+// stops calling the heap.
+//
+// An arena belongs to one thread at a time; memory from it may be written
+// by tasks the owner waits for.
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 64 << 10);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    // Free everything allocated so far
+    void reset();
+
+    size_t getUsed() const;
+    size_t getReserved() const;
+    size_t getPeak() const { return peak; }
+
+    // Frees what was allocated from the arena while the scope lived, so
+    // functions can use an arena they did not reset themselves
+    class Scope {
+    public:
+        explicit Scope(Arena& arena);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        Arena& get() const { return arena; }
+
+    private:
+        Arena& arena;
+        size_t block;
+        size_t offset;
+    };
+
+    // The calling thread's arena for per-frame temporaries. The application
+    // resets the main thread's at the start of each frame; other threads
+    // only allocate from theirs inside a Scope.
+    static Arena& frame();
+
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current;     // block allocated from
+    size_t offset;      // into the current block
+    size_t blockSize;
+    size_t peak;
+};
+
+// STL allocator on an Arena; deallocate() is a no-op
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(&other.getArena()) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    Arena& getArena() const { return *arena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == &other.getArena(); }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != &other.getArena(); }
+
+private:
+    Arena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,83 @@
+#include "autosave.h"
+#include "project.h"
+#include <iostream>
+
+Autosave::Autosave(const std::string& path, float intervalSeconds)
+    : path(path), interval(intervalSeconds), elapsed(0.0f),
+      busy(false), stopping(false), savedStamp(0) {
+    worker = std::thread(&Autosave::run, this);
+}
+
+Autosave::~Autosave() {
+    // Let a save that is already running finish so no temp file is left behind
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void Autosave::update(const Project& project, float deltaTime) {
+    elapsed += deltaTime;
+    if (elapsed < interval || !project.hasModel()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (busy || project.getChangeStamp() <= savedStamp) {
+            return;
+        }
+        busy = true;
+    }
+    elapsed = 0.0f;
+
+    // Snapshot on this thread; it only copies references
+    std::unique_ptr<Job> next(new Job{ project.createSnapshot(), path });
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = std::move(next);
+    }
+    wake.notify_one();
+}
+
+bool Autosave::isSaving() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return busy;
+}
+
+void Autosave::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [this] { return job || stopping; });
+        if (!job) {
+            break;
+        }
+
+        std::unique_ptr<Job> current = std::move(job);
+        lock.unlock();
+
+        SaveStats stats;
+        bool saved = current->snapshot.write(current->path, stats);
+        if (saved) {
+            std::cout << "Autosaved " << current->path << " (" << stats.tilesEncoded << " tiles encoded, "
+                      << stats.tilesReused << " reused, " << stats.bytesWritten / 1024 << " KB) in "
+                      << stats.milliseconds << " ms" << std::endl;
+        } else {
+            std::cerr << "Autosave failed: " << current->path << std::endl;
+        }
+
+        // Release the shared pixel buffers before reporting back, so painting
+        // does not have to copy them
+        uint64_t stamp = current->snapshot.changeStamp;
+        current.reset();
+
+        lock.lock();
+        if (saved) {
+            savedStamp = stamp;
+        }
+        busy = false;
+    }
+}
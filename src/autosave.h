@@ -0,0 +1,57 @@
+#pragma once
+
+#include "project_snapshot.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class Project;
+
+// Periodic background saving.
+// update() runs on the UI thread and only takes a snapshot of the project;
+// encoding changed tiles and writing the file happen on a worker thread.
+// At most one save is in flight, and unchanged projects are not saved again.
+class Autosave {
+public:
+    explicit Autosave(const std::string& path = "autosave.3dp", float intervalSeconds = 30.0f);
+    ~Autosave();
+
+    Autosave(const Autosave&) = delete;
+    Autosave& operator=(const Autosave&) = delete;
+
+    // Settings
+    void setPath(const std::string& path) { this->path = path; }
+    void setInterval(float seconds) { interval = seconds; }
+    const std::string& getPath() const { return path; }
+
+    // Call once per frame; never waits for the worker
+    void update(const Project& project, float deltaTime);
+
+    // Whether a save is currently being written
+    bool isSaving() const;
+
+private:
+    struct Job {
+        ProjectSnapshot snapshot;
+        std::string path;
+    };
+
+    std::string path;
+    float interval;
+    float elapsed;
+
+    // Shared with the worker
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::unique_ptr<Job> job;
+    bool busy;
+    bool stopping;
+    uint64_t savedStamp;
+
+    std::thread worker;
+
+    // Worker thread loop
+    void run();
+};
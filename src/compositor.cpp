@@ -0,0 +1,507 @@
+#include "compositor.h"
+#include "thread_pool.h"
+#include "tile_codec.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define COMPOSITOR_SSE2 1
+#endif
+
+const char* blendModeName(BlendMode mode) {
+    switch (mode) {
+        case BLEND_MULTIPLY: return "multiply";
+        case BLEND_SCREEN: return "screen";
+        case BLEND_OVERLAY: return "overlay";
+        case BLEND_ADD: return "add";
+        default: return "normal";
+    }
+}
+
+BlendMode parseBlendMode(const std::string& name) {
+    for (int mode = 0; mode < BLEND_MODE_COUNT; mode++) {
+        if (name == blendModeName(static_cast<BlendMode>(mode))) {
+            return static_cast<BlendMode>(mode);
+        }
+    }
+    return BLEND_NORMAL;
+}
+
+namespace {
+    const int TILE_SIZE = TileCodec::TILE_SIZE;
+
+    // Rows are blended into a float accumulator holding premultiplied RGBA.
+    // With the backdrop cb (premultiplied, alpha ab) and the source color cs
+    // (straight, alpha lane 1) at alpha a, every mode is
+    //     a * (1 - ab) * cs + a * X + (1 - a) * cb
+    // where X is the backdrop alpha times the mode's blend function. X works
+    // out to ab in the alpha lane for every mode, which gives the usual
+    // a + ab - a * ab.
+
+#ifdef COMPOSITOR_SSE2
+    inline __m128 loadPixel(const unsigned char* pixel) {
+        int32_t bits;
+        std::memcpy(&bits, pixel, 4);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero), zero);
+        return _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(1.0f / 255.0f));
+    }
+
+    inline __m128 alphaLaneMask() {
+        return _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+    }
+
+    // Take the alpha lane from b and the color lanes from a
+    inline __m128 withAlpha(__m128 a, __m128 b) {
+        const __m128 mask = alphaLaneMask();
+        return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+    }
+
+    inline __m128 splatAlpha(__m128 v) {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    template <BlendMode M>
+    inline __m128 blendTerm(__m128 cb, __m128 cs, __m128 ab);
+
+    template <>
+    inline __m128 blendTerm<BLEND_NORMAL>(__m128, __m128 cs, __m128 ab) {
+        return _mm_mul_ps(ab, cs);
+    }
+
+    template <>
+    inline __m128 blendTerm<BLEND_MULTIPLY>(__m128 cb, __m128 cs, __m128) {
+        return _mm_mul_ps(cs, cb);
+    }
+
+    template <>
+    inline __m128 blendTerm<BLEND_SCREEN>(__m128 cb, __m128 cs, __m128 ab) {
+        return _mm_sub_ps(_mm_add_ps(cb, _mm_mul_ps(ab, cs)), _mm_mul_ps(cs, cb));
+    }
+
+    template <>
+    inline __m128 blendTerm<BLEND_OVERLAY>(__m128 cb, __m128 cs, __m128 ab) {
+        const __m128 two = _mm_set1_ps(2.0f);
+        __m128 low = _mm_mul_ps(two, _mm_mul_ps(cs, cb));
+        __m128 high = _mm_sub_ps(ab, _mm_mul_ps(two, _mm_mul_ps(_mm_sub_ps(ab, cb),
+                                                                 _mm_sub_ps(_mm_set1_ps(1.0f), cs))));
+        __m128 useLow = _mm_cmple_ps(_mm_mul_ps(two, cb), ab);
+        return _mm_or_ps(_mm_and_ps(useLow, low), _mm_andnot_ps(useLow, high));
+    }
+
+    template <>
+    inline __m128 blendTerm<BLEND_ADD>(__m128 cb, __m128 cs, __m128 ab) {
+        return _mm_min_ps(ab, _mm_add_ps(cb, _mm_mul_ps(ab, cs)));
+    }
+
+    template <BlendMode M>
+    void blendRowMode(float* acc, const unsigned char* src, int count, float opacity) {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 layerOpacity = _mm_set1_ps(opacity);
+        for (int i = 0; i < count; i++) {
+            if (src[i * 4 + 3] == 0) {
+                continue;
+            }
+            __m128 s = loadPixel(src + i * 4);
+            __m128 a = _mm_mul_ps(splatAlpha(s), layerOpacity);
+            __m128 cs = withAlpha(s, one);
+            __m128 cb = _mm_loadu_ps(acc + i * 4);
+            __m128 ab = splatAlpha(cb);
+            __m128 x = blendTerm<M>(cb, cs, ab);
+            __m128 out = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(a, _mm_sub_ps(one, ab)), cs),
+                                    _mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(_mm_sub_ps(one, a), cb)));
+            _mm_storeu_ps(acc + i * 4, out);
+        }
+    }
+
+    // Straight RGBA8 to premultiplied float
+    void loadRow(float* acc, const unsigned char* rgba, int count) {
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (int i = 0; i < count; i++) {
+            __m128 s = loadPixel(rgba + i * 4);
+            _mm_storeu_ps(acc + i * 4, _mm_mul_ps(s, withAlpha(splatAlpha(s), one)));
+        }
+    }
+
+    // Premultiplied float to straight RGBA8
+    void storeRow(const float* acc, unsigned char* rgba, int count) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (int i = 0; i < count; i++) {
+            if (acc[i * 4 + 3] <= 0.0f) {
+                std::memset(rgba + i * 4, 0, 4);
+                continue;
+            }
+            __m128 c = _mm_loadu_ps(acc + i * 4);
+            c = withAlpha(_mm_div_ps(c, splatAlpha(c)), c);
+            c = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(c, zero), one), scale), half);
+            __m128i bytes = _mm_cvttps_epi32(c);
+            bytes = _mm_packs_epi32(bytes, bytes);
+            bytes = _mm_packus_epi16(bytes, bytes);
+            int32_t bits = _mm_cvtsi128_si32(bytes);
+            std::memcpy(rgba + i * 4, &bits, 4);
+        }
+    }
+#else
+    template <BlendMode M>
+    inline float blendTerm(float cb, float cs, float ab);
+
+    template <>
+    inline float blendTerm<BLEND_NORMAL>(float, float cs, float ab) {
+        return ab * cs;
+    }
+
+    template <>
+    inline float blendTerm<BLEND_MULTIPLY>(float cb, float cs, float) {
+        return cs * cb;
+    }
+
+    template <>
+    inline float blendTerm<BLEND_SCREEN>(float cb, float cs, float ab) {
+        return cb + ab * cs - cs * cb;
+    }
+
+    template <>
+    inline float blendTerm<BLEND_OVERLAY>(float cb, float cs, float ab) {
+        return 2.0f * cb <= ab ? 2.0f * cs * cb : ab - 2.0f * (ab - cb) * (1.0f - cs);
+    }
+
+    template <>
+    inline float blendTerm<BLEND_ADD>(float cb, float cs, float ab) {
+        return std::min(ab, cb + ab * cs);
+    }
+
+    template <BlendMode M>
+    void blendRowMode(float* acc, const unsigned char* src, int count, float opacity) {
+        for (int i = 0; i < count; i++) {
+            const unsigned char* s = src + i * 4;
+            if (s[3] == 0) {
+                continue;
+            }
+            float a = s[3] / 255.0f * opacity;
+            float* cb = acc + i * 4;
+            float ab = cb[3];
+            for (int c = 0; c < 4; c++) {
+                float cs = c < 3 ? s[c] / 255.0f : 1.0f;
+                cb[c] = a * (1.0f - ab) * cs + a * blendTerm<M>(cb[c], cs, ab) + (1.0f - a) * cb[c];
+            }
+        }
+    }
+
+    void loadRow(float* acc, const unsigned char* rgba, int count) {
+        for (int i = 0; i < count; i++) {
+            float alpha = rgba[i * 4 + 3] / 255.0f;
+            for (int c = 0; c < 3; c++) {
+                acc[i * 4 + c] = rgba[i * 4 + c] / 255.0f * alpha;
+            }
+            acc[i * 4 + 3] = alpha;
+        }
+    }
+
+    void storeRow(const float* acc, unsigned char* rgba, int count) {
+        for (int i = 0; i < count; i++) {
+            float alpha = acc[i * 4 + 3];
+            if (alpha <= 0.0f) {
+                std::memset(rgba + i * 4, 0, 4);
+                continue;
+            }
+            for (int c = 0; c < 4; c++) {
+                float value = c < 3 ? acc[i * 4 + c] / alpha : alpha;
+                rgba[i * 4 + c] = static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    }
+#endif
+
+    void blendRow(BlendMode mode, float* acc, const unsigned char* src, int count, float opacity) {
+        switch (mode) {
+            case BLEND_MULTIPLY: blendRowMode<BLEND_MULTIPLY>(acc, src, count, opacity); break;
+            case BLEND_SCREEN: blendRowMode<BLEND_SCREEN>(acc, src, count, opacity); break;
+            case BLEND_OVERLAY: blendRowMode<BLEND_OVERLAY>(acc, src, count, opacity); break;
+            case BLEND_ADD: blendRowMode<BLEND_ADD>(acc, src, count, opacity); break;
+            default: blendRowMode<BLEND_NORMAL>(acc, src, count, opacity); break;
+        }
+    }
+
+    // Fill a row with a straight-alpha color (null = transparent)
+    void fillRow(float* acc, const float* color, int count) {
+        float alpha = color ? std::min(std::max(color[3], 0.0f), 1.0f) : 0.0f;
+        float premultiplied[4] = {0.0f, 0.0f, 0.0f, alpha};
+        for (int c = 0; color && c < 3; c++) {
+            premultiplied[c] = std::min(std::max(color[c], 0.0f), 1.0f) * alpha;
+        }
+        for (int i = 0; i < count; i++) {
+            std::memcpy(acc + i * 4, premultiplied, sizeof(premultiplied));
+        }
+    }
+
+    bool contributes(const CompositeLayer& layer) {
+        return layer.visible && layer.opacity > 0.0f && layer.pixels && layer.width > 0 && layer.height > 0 &&
+               layer.channels >= 1 && layer.channels <= 4 &&
+               layer.pixels->size() >= static_cast<size_t>(layer.width) * layer.height * layer.channels;
+    }
+
+    // RGBA8 pixels of a layer for count output pixels starting at (x, y).
+    // Layers matching the output are read in place; others are sampled
+    // nearest-neighbour and expanded to RGBA into scratch.
+    const unsigned char* layerRow(const CompositeLayer& layer, int width, int height, int x, int y, int count,
+                                  unsigned char* scratch) {
+        const unsigned char* data = layer.pixels->data();
+        if (layer.width == width && layer.height == height && layer.channels == 4) {
+            return data + (static_cast<size_t>(y) * width + x) * 4;
+        }
+
+        int channels = layer.channels;
+        int sy = static_cast<int>(static_cast<long long>(y) * layer.height / height);
+        for (int i = 0; i < count; i++) {
+            int sx = static_cast<int>(static_cast<long long>(x + i) * layer.width / width);
+            const unsigned char* src = data + (static_cast<size_t>(sy) * layer.width + sx) * channels;
+            unsigned char* dst = scratch + i * 4;
+            dst[0] = src[0];
+            dst[1] = channels >= 2 ? src[1] : src[0];
+            dst[2] = channels >= 3 ? src[2] : src[0];
+            dst[3] = channels >= 4 ? src[3] : 255;
+        }
+        return scratch;
+    }
+
+    // Blend layers [first, last) into a row of the accumulator
+    void blendLayers(const CompositeLayers& layers, size_t first, size_t last, int width, int height,
+                     int x, int y, int count, float* acc, unsigned char* scratch) {
+        for (size_t i = first; i < last; i++) {
+            const CompositeLayer& layer = layers[i];
+            if (!contributes(layer)) {
+                continue;
+            }
+            const unsigned char* src = layerRow(layer, width, height, x, y, count, scratch);
+            blendRow(layer.mode, acc, src, count, std::min(layer.opacity, 1.0f));
+        }
+    }
+
+    void tileRect(size_t tile, int width, int height, int& x, int& y, int& tileWidth, int& tileHeight) {
+        int columns = TileCodec::tileCount(width);
+        x = static_cast<int>(tile % columns) * TILE_SIZE;
+        y = static_cast<int>(tile / columns) * TILE_SIZE;
+        tileWidth = std::min(TILE_SIZE, width - x);
+        tileHeight = std::min(TILE_SIZE, height - y);
+    }
+}
+
+Compositor::Compositor()
+    : width(0), height(0), current(0), valid(false) {
+}
+
+void Compositor::invalidate() {
+    valid = false;
+}
+
+void Compositor::release() {
+    valid = false;
+    std::vector<unsigned char>().swap(below);
+    std::vector<unsigned char>().swap(above);
+    std::vector<unsigned char>().swap(result);
+    std::vector<uint64_t>().swap(belowStamps);
+    std::vector<uint64_t>().swap(currentStamps);
+    std::vector<uint64_t>().swap(aboveStamps);
+}
+
+size_t Compositor::getMemoryUsage() const {
+    return below.capacity() + above.capacity() + result.capacity() +
+           (belowStamps.capacity() + currentStamps.capacity() + aboveStamps.capacity()) * sizeof(uint64_t);
+}
+
+void Compositor::update(const CompositeLayers& layers, size_t current, int width, int height) {
+    updatedTiles.clear();
+    stats = Stats();
+    width = std::max(width, 0);
+    height = std::max(height, 0);
+
+    size_t count = layers.size();
+    if (count > 0 && current >= count) {
+        current = count - 1;
+    }
+
+    // Temporaries come from the thread's frame arena and go when this returns
+    Arena::Scope scope(Arena::frame());
+    ArenaAllocator<LayerKey> alloc(scope.get());
+    ArenaVector<LayerKey> newKeys(alloc);
+    newKeys.reserve(count);
+    for (const auto& layer : layers) {
+        newKeys.push_back({layer.id, layer.visible, layer.opacity, layer.mode,
+                           layer.width, layer.height, layer.channels});
+    }
+
+    size_t tiles = static_cast<size_t>(TileCodec::tileCount(width)) * TileCodec::tileCount(height);
+    bool rebuild = !valid || width != this->width || height != this->height || current != this->current ||
+                   !std::equal(newKeys.begin(), newKeys.end(), keys.begin(), keys.end());
+    if (rebuild) {
+        this->width = width;
+        this->height = height;
+        this->current = current;
+        keys.assign(newKeys.begin(), newKeys.end());
+        valid = true;
+
+        size_t bytes = static_cast<size_t>(width) * height * 4;
+        below.assign(bytes, 0);
+        above.assign(bytes, 0);
+        result.assign(bytes, 0);
+        belowStamps.assign(tiles, 0);
+        currentStamps.assign(tiles, 0);
+        aboveStamps.assign(tiles, 0);
+    }
+    if (tiles == 0) {
+        return;
+    }
+
+    // Layers of another size do not share the tile grid; any change to them
+    // dirties every tile
+    ArenaVector<uint64_t> wholeStamps(count, 0, alloc);
+    size_t belowLayers = 0;
+    size_t aboveLayers = 0;
+    bool hasCurrent = false;
+    bool aboveCached = true;
+    for (size_t i = 0; i < count; i++) {
+        const CompositeLayer& layer = layers[i];
+        if (!contributes(layer)) {
+            continue;
+        }
+        if (layer.width != width || layer.height != height || layer.tileCount != tiles) {
+            for (size_t tile = 0; tile < layer.tileCount; tile++) {
+                wholeStamps[i] = std::max(wholeStamps[i], layer.tileStamps[tile]);
+            }
+        }
+        if (i < current) {
+            belowLayers++;
+        } else if (i > current) {
+            aboveLayers++;
+            aboveCached = aboveCached && layer.mode == BLEND_NORMAL;
+        } else {
+            hasCurrent = true;
+        }
+    }
+
+    auto stampOf = [&](size_t layer, size_t tile) -> uint64_t {
+        if (!contributes(layers[layer])) {
+            return 0;
+        }
+        const CompositeLayer& input = layers[layer];
+        return input.tileCount == tiles && input.width == width && input.height == height
+            ? input.tileStamps[tile] : wholeStamps[layer];
+    };
+
+    // Work out which caches each tile needs rebuilt
+    enum { DIRTY_BELOW = 1, DIRTY_ABOVE = 2 };
+    ArenaVector<unsigned char> dirty(tiles, 0, alloc);
+    for (size_t tile = 0; tile < tiles; tile++) {
+        uint64_t belowStamp = 0;
+        uint64_t aboveStamp = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (i < current) {
+                belowStamp = std::max(belowStamp, stampOf(i, tile));
+            } else if (i > current) {
+                aboveStamp = std::max(aboveStamp, stampOf(i, tile));
+            }
+        }
+        uint64_t currentStamp = count > 0 ? stampOf(current, tile) : 0;
+
+        bool belowDirty = rebuild || belowStamp != belowStamps[tile];
+        bool aboveDirty = rebuild || aboveStamp != aboveStamps[tile];
+        if (!belowDirty && !aboveDirty && currentStamp == currentStamps[tile]) {
+            continue;
+        }
+
+        dirty[tile] = (belowDirty ? DIRTY_BELOW : 0) | (aboveDirty && aboveCached ? DIRTY_ABOVE : 0);
+        belowStamps[tile] = belowStamp;
+        currentStamps[tile] = currentStamp;
+        aboveStamps[tile] = aboveStamp;
+        updatedTiles.push_back(tile);
+
+        stats.layerBlends += (belowDirty ? belowLayers : 0) + (aboveDirty && aboveCached ? aboveLayers : 0);
+        stats.layerBlends += 1 + (hasCurrent ? 1 : 0) + (aboveCached ? (aboveLayers > 0 ? 1 : 0) : aboveLayers);
+    }
+    stats.tilesComposited = updatedTiles.size();
+
+    auto compositeTile = [&](size_t index) {
+        size_t tile = updatedTiles[index];
+        int x, y, tileWidth, tileHeight;
+        tileRect(tile, width, height, x, y, tileWidth, tileHeight);
+
+        // Rows of the tile, from the arena of whichever thread runs it
+        Arena::Scope rows(Arena::frame());
+        ArenaAllocator<float> rowAlloc(rows.get());
+        ArenaVector<float> acc(static_cast<size_t>(tileWidth) * 4, rowAlloc);
+        ArenaVector<unsigned char> scratch(static_cast<size_t>(tileWidth) * 4, rowAlloc);
+        for (int row = y; row < y + tileHeight; row++) {
+            size_t offset = (static_cast<size_t>(row) * width + x) * 4;
+
+            if (dirty[tile] & DIRTY_BELOW) {
+                fillRow(acc.data(), nullptr, tileWidth);
+                blendLayers(layers, 0, current, width, height, x, row, tileWidth, acc.data(), scratch.data());
+                storeRow(acc.data(), &below[offset], tileWidth);
+            }
+            if (dirty[tile] & DIRTY_ABOVE) {
+                fillRow(acc.data(), nullptr, tileWidth);
+                blendLayers(layers, current + 1, count, width, height, x, row, tileWidth, acc.data(), scratch.data());
+                storeRow(acc.data(), &above[offset], tileWidth);
+            }
+
+            loadRow(acc.data(), &below[offset], tileWidth);
+            if (hasCurrent) {
+                blendLayers(layers, current, current + 1, width, height, x, row, tileWidth, acc.data(), scratch.data());
+            }
+            if (aboveCached) {
+                blendRow(BLEND_NORMAL, acc.data(), &above[offset], tileWidth, 1.0f);
+            } else {
+                blendLayers(layers, current + 1, count, width, height, x, row, tileWidth, acc.data(), scratch.data());
+            }
+            storeRow(acc.data(), &result[offset], tileWidth);
+        }
+    };
+    // Passed by reference, which std::function stores without allocating
+    ThreadPool::shared().parallelFor(updatedTiles.size(), std::ref(compositeTile));
+}
+
+void Compositor::flatten(const CompositeLayers& layers, int width, int height,
+                         std::vector<unsigned char>& rgba, const float* background) {
+    width = std::max(width, 0);
+    height = std::max(height, 0);
+    rgba.assign(static_cast<size_t>(width) * height * 4, 0);
+
+    size_t tiles = static_cast<size_t>(TileCodec::tileCount(width)) * TileCodec::tileCount(height);
+    ThreadPool::shared().parallelFor(tiles, [&](size_t tile) {
+        int x, y, tileWidth, tileHeight;
+        tileRect(tile, width, height, x, y, tileWidth, tileHeight);
+
+        Arena::Scope rows(Arena::frame());
+        ArenaAllocator<float> rowAlloc(rows.get());
+        ArenaVector<float> acc(static_cast<size_t>(tileWidth) * 4, rowAlloc);
+        ArenaVector<unsigned char> scratch(static_cast<size_t>(tileWidth) * 4, rowAlloc);
+        for (int row = y; row < y + tileHeight; row++) {
+            fillRow(acc.data(), background, tileWidth);
+            blendLayers(layers, 0, layers.size(), width, height, x, row, tileWidth, acc.data(), scratch.data());
+            storeRow(acc.data(), &rgba[(static_cast<size_t>(row) * width + x) * 4], tileWidth);
+        }
+    });
+}
+
+void Compositor::sampleLayer(const CompositeLayer& layer, int width, int height, std::vector<unsigned char>& rgba) {
+    width = std::max(width, 0);
+    height = std::max(height, 0);
+    rgba.assign(static_cast<size_t>(width) * height * 4, 0);
+    if (!layer.pixels || layer.width <= 0 || layer.height <= 0 || layer.channels < 1 || layer.channels > 4 ||
+        layer.pixels->size() < static_cast<size_t>(layer.width) * layer.height * layer.channels) {
+        return;
+    }
+
+    for (int y = 0; y < height; y++) {
+        unsigned char* row = &rgba[static_cast<size_t>(y) * width * 4];
+        const unsigned char* src = layerRow(layer, width, height, 0, y, width, row);
+        if (src != row) {
+            std::memcpy(row, src, static_cast<size_t>(width) * 4);
+        }
+    }
+}
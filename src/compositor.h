@@ -0,0 +1,128 @@
+#pragma once
+
+#include "arena.h"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Separable blend modes (W3C compositing definitions)
+enum BlendMode : uint8_t {
+    BLEND_NORMAL = 0,
+    BLEND_MULTIPLY,
+    BLEND_SCREEN,
+    BLEND_OVERLAY,
+    BLEND_ADD,
+    BLEND_MODE_COUNT
+};
+
+// Name used in project files and the UI
+const char* blendModeName(BlendMode mode);
+BlendMode parseBlendMode(const std::string& name);
+
+// One input layer of the compositor. Pixels are straight-alpha 8-bit with
+// 1, 3 or 4 channels; layers of another size than the output are sampled
+// nearest-neighbour.
+struct CompositeLayer {
+    const void* id = nullptr;       // identity for cache invalidation
+    std::shared_ptr<const std::vector<unsigned char>> pixels;
+    int width = 0;
+    int height = 0;
+    int channels = 4;
+    bool visible = true;
+    float opacity = 1.0f;
+    BlendMode mode = BLEND_NORMAL;
+
+    // Change stamps per TileCodec tile of the layer (see Layer::getTileStamps),
+    // not owned; Project::getCompositeLayers() copies them into its arena
+    const uint64_t* tileStamps = nullptr;
+    size_t tileCount = 0;
+};
+
+// Inputs are built per frame, so they live in an arena
+using CompositeLayers = ArenaVector<CompositeLayer>;
+
+// CPU layer compositor working on TileCodec::TILE_SIZE tiles.
+//
+// Besides the result it keeps the flattened stacks below and above the
+// current layer. When only the current layer changes, as while painting,
+// each dirty tile is recomposited from those three images instead of all N
+// layers. Tiles are only recomposited when a layer's tile stamps say they
+// changed. The above stack can only be pre-flattened while every layer in
+// it uses BLEND_NORMAL; otherwise dirty tiles blend those layers one by one.
+//
+// Needs no GL context, so it serves export and headless use as well.
+class Compositor {
+public:
+    struct Stats {
+        size_t tilesComposited = 0;     // result tiles rebuilt by the last update
+        size_t layerBlends = 0;         // layer (or cached stack) tiles blended by the last update
+    };
+
+    Compositor();
+
+    // Bring the result up to date for layers (bottom to top) with `current`
+    // being the layer that is edited. Output is straight-alpha RGBA8.
+    void update(const CompositeLayers& layers, size_t current, int width, int height);
+
+    // Result of the last update and the tiles it changed (row-major tile indices)
+    const std::vector<unsigned char>& getResult() const { return result; }
+    const std::vector<size_t>& getUpdatedTiles() const { return updatedTiles; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const Stats& getStats() const { return stats; }
+
+    // Drop the caches; the next update recomposites everything
+    void invalidate();
+    
+    // invalidate() and free the cache memory too
+    void release();
+    
+    // Bytes held by the caches and the result
+    size_t getMemoryUsage() const;
+
+    // Composite without caching, optionally over an opaque or translucent
+    // straight-alpha background color (RGBA in 0..1)
+    static void flatten(const CompositeLayers& layers, int width, int height,
+                        std::vector<unsigned char>& rgba, const float* background = nullptr);
+    
+    // A layer's pixels as width x height RGBA8, resampled and expanded the
+    // same way the compositor reads them
+    static void sampleLayer(const CompositeLayer& layer, int width, int height, std::vector<unsigned char>& rgba);
+
+private:
+    // What the caches were built from; any difference forces a full rebuild
+    struct LayerKey {
+        const void* id;
+        bool visible;
+        float opacity;
+        BlendMode mode;
+        int width;
+        int height;
+        int channels;
+
+        bool operator==(const LayerKey& other) const {
+            return id == other.id && visible == other.visible && opacity == other.opacity && mode == other.mode &&
+                   width == other.width && height == other.height && channels == other.channels;
+        }
+    };
+
+    int width;
+    int height;
+    size_t current;
+    std::vector<LayerKey> keys;
+    bool valid;
+
+    std::vector<unsigned char> below;
+    std::vector<unsigned char> above;
+    std::vector<unsigned char> result;
+
+    // Latest layer stamp each cached tile includes
+    std::vector<uint64_t> belowStamps;
+    std::vector<uint64_t> currentStamps;
+    std::vector<uint64_t> aboveStamps;
+
+    std::vector<size_t> updatedTiles;
+    Stats stats;
+};
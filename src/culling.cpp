@@ -0,0 +1,124 @@
+#include "culling.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CULLING_SSE2 1
+#endif
+
+bool Bounds::rayHitsSphere(const glm::vec3& origin, const glm::vec3& direction) const {
+    if (empty) {
+        return false;
+    }
+    glm::vec3 toCenter = center - origin;
+    float along = glm::dot(toCenter, direction);
+    if (along < -radius) {
+        return false;   // sphere is behind the ray
+    }
+    float distanceSquared = glm::dot(toCenter, toCenter) - along * along;
+    return distanceSquared <= radius * radius;
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& m) {
+    // Rows of the (column-major) matrix; clip space is -w..w on every axis
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++) {
+        rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+    }
+
+    Frustum frustum;
+    for (int axis = 0; axis < 3; axis++) {
+        frustum.planes[axis * 2] = rows[3] + rows[axis];
+        frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+    }
+    for (glm::vec4& plane : frustum.planes) {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f) {
+            plane = plane / length;
+        }
+    }
+    return frustum;
+}
+
+void BoundsList::assign(const std::vector<Bounds>& bounds) {
+    count = bounds.size();
+    size_t padded = (count + 3) & ~static_cast<size_t>(3);
+    for (std::vector<float>* values : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+        values->assign(padded, 0.0f);
+    }
+    empty.assign(count, 1);
+
+    for (size_t i = 0; i < count; i++) {
+        const Bounds& box = bounds[i];
+        if (box.empty) {
+            continue;
+        }
+        centerX[i] = (box.min.x + box.max.x) * 0.5f;
+        centerY[i] = (box.min.y + box.max.y) * 0.5f;
+        centerZ[i] = (box.min.z + box.max.z) * 0.5f;
+        extentX[i] = (box.max.x - box.min.x) * 0.5f;
+        extentY[i] = (box.max.y - box.min.y) * 0.5f;
+        extentZ[i] = (box.max.z - box.min.z) * 0.5f;
+        empty[i] = 0;
+    }
+    charge.set(padded * 6 * sizeof(float) + count);
+}
+
+size_t BoundsList::cull(const Frustum& frustum, std::vector<uint8_t>& visible) const {
+    visible.resize(count);
+    return cull(frustum, visible.data());
+}
+
+size_t BoundsList::cull(const Frustum& frustum, uint8_t* visible) const {
+    // A box is outside if it lies entirely behind one plane: the distance of
+    // its center plus its extent projected on the plane normal is negative
+#ifdef CULLING_SSE2
+    for (size_t i = 0; i < count; i += 4) {
+        __m128 cx = _mm_loadu_ps(&centerX[i]);
+        __m128 cy = _mm_loadu_ps(&centerY[i]);
+        __m128 cz = _mm_loadu_ps(&centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&extentX[i]);
+        __m128 ey = _mm_loadu_ps(&extentY[i]);
+        __m128 ez = _mm_loadu_ps(&extentZ[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx),
+                                                    _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(plane.x)), ex),
+                                                 _mm_mul_ps(_mm_set1_ps(std::fabs(plane.y)), ey)),
+                                      _mm_mul_ps(_mm_set1_ps(std::fabs(plane.z)), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (size_t lane = 0; lane < 4 && i + lane < count; lane++) {
+            visible[i + lane] = (mask >> lane) & 1;
+        }
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        bool inside = true;
+        for (const glm::vec4& plane : frustum.planes) {
+            float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+            float reach = std::fabs(plane.x) * extentX[i] + std::fabs(plane.y) * extentY[i] +
+                          std::fabs(plane.z) * extentZ[i];
+            if (distance + reach < 0.0f) {
+                inside = false;
+                break;
+            }
+        }
+        visible[i] = inside ? 1 : 0;
+    }
+#endif
+
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (empty[i]) {
+            visible[i] = 0;
+        }
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "memory_budget.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Axis-aligned box and bounding sphere of a mesh
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center;
+    float radius = 0.0f;
+    bool empty = true;
+
+    // Whether a ray (normalized direction) can hit anything inside the sphere
+    bool rayHitsSphere(const glm::vec3& origin, const glm::vec3& direction) const;
+};
+
+// The six planes of a view-projection matrix, normalized and facing inwards
+struct Frustum {
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+};
+
+// Culling counters of the last frame and pick
+struct CullStats {
+    size_t meshes = 0;
+    size_t meshesDrawn = 0;
+    size_t pickCandidates = 0;      // meshes whose triangles the last pick tested
+};
+
+// Boxes in structure-of-arrays form (center and half extent), so the frustum
+// test runs on four boxes at a time with SSE2
+class BoundsList {
+public:
+    void assign(const std::vector<Bounds>& bounds);
+    size_t size() const { return count; }
+
+    // visible[i] = 1 if box i intersects the frustum; returns how many do
+    size_t cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+    // Same into size() bytes the caller provides
+    size_t cull(const Frustum& frustum, uint8_t* visible) const;
+
+private:
+    size_t count = 0;
+
+    // Padded to a multiple of four
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<uint8_t> empty;
+
+    MemoryCharge charge{ MemoryStats::BOUNDS };
+};
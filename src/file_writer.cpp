@@ -0,0 +1,206 @@
+#include "file_writer.h"
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#endif
+
+bool writeFileGather(const std::string& path, const std::vector<WriteSegment>& segments) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    std::vector<iovec> iov;
+    iov.reserve(segments.size());
+    for (const WriteSegment& segment : segments) {
+        if (segment.size > 0) {
+            iov.push_back({ const_cast<void*>(segment.data), segment.size });
+        }
+    }
+
+#ifdef IOV_MAX
+    const size_t maxBatch = IOV_MAX;
+#else
+    const size_t maxBatch = 1024;
+#endif
+
+    // writev may write partially, so advance through the list until done
+    bool ok = true;
+    size_t first = 0;
+    while (ok && first < iov.size()) {
+        int count = static_cast<int>(std::min(maxBatch, iov.size() - first));
+        ssize_t written = ::writev(fd, &iov[first], count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+
+        size_t remaining = static_cast<size_t>(written);
+        while (first < iov.size() && remaining >= iov[first].iov_len) {
+            remaining -= iov[first].iov_len;
+            first++;
+        }
+        if (remaining > 0) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+            iov[first].iov_len -= remaining;
+        }
+    }
+
+    if (::close(fd) != 0) {
+        ok = false;
+    }
+    return ok;
+#else
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool ok = true;
+    for (const WriteSegment& segment : segments) {
+        if (segment.size > 0 && std::fwrite(segment.data, 1, segment.size, file) != segment.size) {
+            ok = false;
+            break;
+        }
+    }
+
+    if (std::fclose(file) != 0) {
+        ok = false;
+    }
+    return ok;
+#endif
+}
+
+FileWriter::FileWriter(size_t bufferSize)
+    : file(nullptr), buffer(bufferSize < 64 ? 64 : bufferSize), used(0), bytesWritten(0), failed(false) {
+}
+
+FileWriter::~FileWriter() {
+    close();
+}
+
+bool FileWriter::open(const std::string& path) {
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    // We do our own buffering
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    used = 0;
+    bytesWritten = 0;
+    failed = false;
+    return true;
+}
+
+bool FileWriter::close() {
+    if (!file) {
+        return !failed;
+    }
+
+    flush();
+    if (std::fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+
+    return !failed;
+}
+
+void FileWriter::write(const void* data, size_t size) {
+    if (size > buffer.size()) {
+        // Large blocks go straight to the file
+        flush();
+        if (file && std::fwrite(data, 1, size, file) != size) {
+            failed = true;
+        }
+        bytesWritten += size;
+        return;
+    }
+
+    reserve(size);
+    std::memcpy(buffer.data() + used, data, size);
+    used += size;
+}
+
+void FileWriter::writeChar(char c) {
+    reserve(1);
+    buffer[used++] = c;
+}
+
+void FileWriter::writeString(const char* str) {
+    write(str, std::strlen(str));
+}
+
+void FileWriter::writeFloat(float value) {
+    // Shortest representation of a float is at most 15 characters
+    reserve(32);
+    char* begin = buffer.data() + used;
+    std::to_chars_result result = std::to_chars(begin, begin + 32, value);
+    used += result.ptr - begin;
+}
+
+void FileWriter::writeUInt(uint32_t value) {
+    reserve(16);
+    char* begin = buffer.data() + used;
+    std::to_chars_result result = std::to_chars(begin, begin + 16, value);
+    used += result.ptr - begin;
+}
+
+void FileWriter::writeU8(uint8_t value) {
+    reserve(1);
+    buffer[used++] = static_cast<char>(value);
+}
+
+void FileWriter::writeU16LE(uint16_t value) {
+    reserve(2);
+    buffer[used++] = static_cast<char>(value & 0xFF);
+    buffer[used++] = static_cast<char>((value >> 8) & 0xFF);
+}
+
+void FileWriter::writeU32LE(uint32_t value) {
+    reserve(4);
+    buffer[used++] = static_cast<char>(value & 0xFF);
+    buffer[used++] = static_cast<char>((value >> 8) & 0xFF);
+    buffer[used++] = static_cast<char>((value >> 16) & 0xFF);
+    buffer[used++] = static_cast<char>((value >> 24) & 0xFF);
+}
+
+void FileWriter::writeFloatLE(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeU32LE(bits);
+}
+
+void FileWriter::reserve(size_t size) {
+    if (used + size > buffer.size()) {
+        flush();
+    }
+}
+
+void FileWriter::flush() {
+    if (used == 0) {
+        return;
+    }
+
+    if (!file || std::fwrite(buffer.data(), 1, used, file) != used) {
+        failed = true;
+    }
+
+    bytesWritten += used;
+    used = 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// One block of a gathered write
+struct WriteSegment {
+    const void* data;
+    size_t size;
+};
+
+// Write all segments to a file in a single pass using scatter/gather I/O
+// (writev on POSIX, sequential writes elsewhere). Segments are not copied.
+bool writeFileGather(const std::string& path, const std::vector<WriteSegment>& segments);
+
+// Buffered file writer used by the native exporters.
+// Data is collected in a fixed-size buffer and written out in large blocks,
+// so memory use stays constant no matter how big the output gets.
+class FileWriter {
+public:
+    explicit FileWriter(size_t bufferSize = 1 << 20);
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    // Open file for writing (truncates existing file)
+    bool open(const std::string& path);
+
+    // Flush remaining data and close; returns false if any write failed
+    bool close();
+
+    // Raw bytes
+    void write(const void* data, size_t size);
+    void writeChar(char c);
+    void writeString(const char* str);
+    void writeString(const std::string& str) { write(str.data(), str.size()); }
+
+    // Text numbers (shortest round-trip representation)
+    void writeFloat(float value);
+    void writeUInt(uint32_t value);
+
+    // Little-endian binary values
+    void writeU8(uint8_t value);
+    void writeU16LE(uint16_t value);
+    void writeU32LE(uint32_t value);
+    void writeFloatLE(float value);
+
+    // Getters
+    bool isOpen() const { return file != nullptr; }
+    bool good() const { return !failed; }
+    uint64_t getBytesWritten() const { return bytesWritten + used; }
+
+private:
+    std::FILE* file;
+    std::vector<char> buffer;
+    size_t used;
+    uint64_t bytesWritten;
+    bool failed;
+
+    // Make room for at least size bytes in the buffer
+    void reserve(size_t size);
+
+    // Write buffer contents to file
+    void flush();
+};
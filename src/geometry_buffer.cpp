@@ -0,0 +1,229 @@
+#include "geometry_buffer.h"
+#include "model.h"
+#include "perf_counters.h"
+#ifndef PAINTER_HEADLESS
+#include <glad/glad.h>
+#endif
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+GeometryBuffer::GeometryBuffer()
+    : VAO(0), VBO(0), EBO(0), commandBuffer(0), drawnCount(0), gpuCharge(MemoryStats::GPU_BUFFERS) {
+}
+
+GeometryBuffer::~GeometryBuffer() {
+    release();
+}
+
+void GeometryBuffer::release() {
+#ifndef PAINTER_HEADLESS
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (VBO) glDeleteBuffers(1, &VBO);
+    if (EBO) glDeleteBuffers(1, &EBO);
+    if (commandBuffer) glDeleteBuffers(1, &commandBuffer);
+#endif
+    VAO = VBO = EBO = commandBuffer = 0;
+    pendingVertices.clear();
+    pendingIndices.clear();
+    ranges.clear();
+    commands.clear();
+    drawnMask.clear();
+    drawnCount = 0;
+    gpuCharge.set(0);
+}
+
+bool GeometryBuffer::layoutMeshes(const std::vector<Mesh>& meshes, std::vector<MeshRange>& ranges) {
+    ranges.clear();
+    ranges.reserve(meshes.size());
+
+    uint64_t vertexCount = 0;
+    uint64_t indexCount = 0;
+    for (const Mesh& mesh : meshes) {
+        MeshRange range;
+        range.firstIndex = static_cast<uint32_t>(indexCount);
+        range.baseVertex = static_cast<int32_t>(vertexCount);
+        range.vertexCount = static_cast<uint32_t>(mesh.getVerticesCount());
+        range.indexCount = static_cast<uint32_t>(mesh.hasIndices() ? mesh.getIndicesCount() : mesh.getVerticesCount());
+        ranges.push_back(range);
+
+        vertexCount += mesh.getVerticesCount();
+        indexCount += range.indexCount;
+        if (vertexCount > static_cast<uint64_t>(std::numeric_limits<int32_t>::max()) ||
+            indexCount > std::numeric_limits<uint32_t>::max()) {
+            ranges.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void GeometryBuffer::buildCommands(const std::vector<MeshRange>& ranges,
+                                   std::vector<DrawElementsIndirectCommand>& commands,
+                                   const std::vector<uint8_t>* visible) {
+    commands.clear();
+    commands.reserve(ranges.size());
+    for (size_t i = 0; i < ranges.size(); i++) {
+        const MeshRange& range = ranges[i];
+        if (range.indexCount == 0 || (visible && (i >= visible->size() || !(*visible)[i]))) {
+            continue;
+        }
+        commands.push_back({range.indexCount, 1, range.firstIndex, range.baseVertex, static_cast<uint32_t>(i)});
+    }
+}
+
+bool GeometryBuffer::assign(const std::vector<Mesh>& meshes) {
+    release();
+
+    if (!layoutMeshes(meshes, ranges)) {
+        std::cerr << "Model too large for a single geometry buffer" << std::endl;
+        return false;
+    }
+    buildCommands(ranges, commands);
+    if (commands.empty()) {
+        return true;
+    }
+
+    pendingVertices.reserve(meshes.size());
+    pendingIndices.reserve(meshes.size());
+    for (const Mesh& mesh : meshes) {
+        pendingVertices.push_back(mesh.shareVertices());
+        pendingIndices.push_back(mesh.shareIndices());
+    }
+    drawnCount = commands.size();
+    return true;
+}
+
+#ifndef PAINTER_HEADLESS
+void GeometryBuffer::upload() const {
+    const MeshRange& last = ranges.back();
+    size_t vertexCount = static_cast<size_t>(last.baseVertex) + last.vertexCount;
+    size_t indexCount = static_cast<size_t>(last.firstIndex) + last.indexCount;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &commandBuffer);
+
+    glBindVertexArray(VAO);
+
+    // Allocate once, then copy each mesh to its range
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    PerfCounters::add(PerfCounters::UPLOADED_BYTES, vertexCount * sizeof(Vertex) + indexCount * sizeof(unsigned int));
+    gpuCharge.set(vertexCount * sizeof(Vertex) + indexCount * sizeof(unsigned int) +
+                  commands.size() * sizeof(DrawElementsIndirectCommand));
+
+    std::vector<unsigned int> sequential;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        const MeshRange& range = ranges[i];
+        if (range.vertexCount > 0) {
+            glBufferSubData(GL_ARRAY_BUFFER, static_cast<size_t>(range.baseVertex) * sizeof(Vertex),
+                            range.vertexCount * sizeof(Vertex), pendingVertices[i]->data());
+        }
+
+        const unsigned int* indices = pendingIndices[i]->data();
+        if (pendingIndices[i]->empty()) {
+            sequential.resize(range.indexCount);
+            std::iota(sequential.begin(), sequential.end(), 0u);
+            indices = sequential.data();
+        }
+        if (range.indexCount > 0) {
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<size_t>(range.firstIndex) * sizeof(unsigned int),
+                            range.indexCount * sizeof(unsigned int), indices);
+        }
+    }
+    pendingVertices.clear();
+    pendingIndices.clear();
+
+    // Position attribute
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+
+    // Normal attribute
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+
+    // Texture coordinates attribute
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+    glBindVertexArray(0);
+
+    // The command buffer starts out with every command, as drawnMask says
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GeometryBuffer::draw() const {
+    if (commands.empty()) {
+        return;
+    }
+    if (!VAO) {
+        upload();
+    }
+
+    if (!drawnMask.empty()) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand),
+                        commands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        drawnMask.clear();
+        drawnCount = commands.size();
+    }
+    submit(drawnCount);
+}
+
+void GeometryBuffer::draw(const std::vector<uint8_t>& visible) const {
+    if (commands.empty()) {
+        return;
+    }
+    if (!VAO) {
+        upload();
+    }
+
+    if (visible != drawnMask) {
+        std::vector<DrawElementsIndirectCommand> visibleCommands;
+        buildCommands(ranges, visibleCommands, &visible);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, visibleCommands.size() * sizeof(DrawElementsIndirectCommand),
+                        visibleCommands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        drawnMask = visible;
+        drawnCount = visibleCommands.size();
+    }
+    submit(drawnCount);
+}
+
+void GeometryBuffer::submit(size_t count) const {
+    if (count == 0) {
+        return;
+    }
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(count), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+#else
+
+// Built without GL (PAINTER_HEADLESS): the layout is kept, nothing is drawn
+void GeometryBuffer::upload() const {
+}
+
+void GeometryBuffer::draw() const {
+}
+
+void GeometryBuffer::draw(const std::vector<uint8_t>&) const {
+}
+
+void GeometryBuffer::submit(size_t) const {
+}
+
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "memory_budget.h"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class Mesh;
+struct Vertex;
+
+// One command of GL_DRAW_INDIRECT_BUFFER as read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;      // index of the mesh
+};
+
+// Where a mesh lives in the merged buffers
+struct MeshRange {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    int32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+};
+
+// All meshes of a model packed into one vertex and one index buffer behind a
+// single VAO, drawn with one glMultiDrawElementsIndirect call. Meshes keep
+// their own index values (applied through baseVertex); meshes without
+// indices get sequential ones so every mesh is drawn the same way.
+//
+// Like Texture, the GL buffers are only created on the first draw, on the GL
+// thread, so models can be built without a GL context. Built with
+// PAINTER_HEADLESS, drawing does nothing and no GL library is needed.
+class GeometryBuffer {
+public:
+    GeometryBuffer();
+    ~GeometryBuffer();
+
+    GeometryBuffer(const GeometryBuffer&) = delete;
+    GeometryBuffer& operator=(const GeometryBuffer&) = delete;
+
+    // Take the meshes (sharing their geometry), replacing the previous contents
+    bool assign(const std::vector<Mesh>& meshes);
+    void release();
+    bool isUploaded() const { return VAO != 0; }
+
+    // Draw all meshes, or those with a nonzero entry in visible, with the
+    // program that is in use. The command buffer is only rewritten when the
+    // set of visible meshes changes.
+    void draw() const;
+    void draw(const std::vector<uint8_t>& visible) const;
+
+    const std::vector<MeshRange>& getRanges() const { return ranges; }
+    const std::vector<DrawElementsIndirectCommand>& getCommands() const { return commands; }
+
+    // CPU side of the layout, usable without a GL context. Returns false if
+    // the meshes do not fit 32-bit offsets.
+    static bool layoutMeshes(const std::vector<Mesh>& meshes, std::vector<MeshRange>& ranges);
+
+    // One command per non-empty range (that is visible, if given)
+    static void buildCommands(const std::vector<MeshRange>& ranges, std::vector<DrawElementsIndirectCommand>& commands,
+                              const std::vector<uint8_t>* visible = nullptr);
+
+private:
+    mutable unsigned int VAO;
+    mutable unsigned int VBO;
+    mutable unsigned int EBO;
+    mutable unsigned int commandBuffer;
+
+    // Geometry waiting for upload, dropped once it is in the GL buffers
+    mutable std::vector<std::shared_ptr<const std::vector<Vertex>>> pendingVertices;
+    mutable std::vector<std::shared_ptr<const std::vector<unsigned int>>> pendingIndices;
+
+    std::vector<MeshRange> ranges;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    // Contents of the command buffer: all commands while the mask is empty
+    mutable std::vector<uint8_t> drawnMask;
+    mutable size_t drawnCount;
+    
+    // Estimated size of the GL buffers
+    mutable MemoryCharge gpuCharge;
+
+    // Create the GL buffers from the pending geometry (GL thread only)
+    void upload() const;
+    void submit(size_t count) const;
+};
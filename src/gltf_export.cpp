@@ -0,0 +1,282 @@
+#include "gltf_export.h"
+#include "file_writer.h"
+#include <nlohmann/json.hpp>
+#include <stb_image_write.h>
+#include <iostream>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace GltfExport {
+    namespace {
+        // glTF constants
+        const uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+        const uint32_t GLB_VERSION = 2;
+        const uint32_t CHUNK_JSON = 0x4E4F534A;     // "JSON"
+        const uint32_t CHUNK_BIN = 0x004E4942;      // "BIN\0"
+        const int GL_FLOAT_TYPE = 5126;
+        const int GL_UNSIGNED_INT_TYPE = 5125;
+        const int GL_ARRAY_BUFFER_TARGET = 34962;
+        const int GL_ELEMENT_ARRAY_BUFFER_TARGET = 34963;
+        const int GL_LINEAR_FILTER = 9729;
+        const int GL_CLAMP_TO_EDGE_WRAP = 33071;
+
+        // Interleaved vertices are referenced in place, so the layout must match glTF's
+        // (and the host must be little-endian, like every platform we ship on)
+        static_assert(sizeof(Vertex) == 32, "Vertex must be tightly packed (3 + 3 + 2 floats)");
+        static_assert(offsetof(Vertex, Normal) == 12, "Unexpected Vertex layout");
+        static_assert(offsetof(Vertex, TexCoords) == 24, "Unexpected Vertex layout");
+
+        void appendToVector(void* context, void* data, int size) {
+            auto* out = static_cast<std::vector<unsigned char>*>(context);
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            out->insert(out->end(), bytes, bytes + size);
+        }
+
+        inline uint32_t padTo4(size_t size) {
+            return static_cast<uint32_t>((4 - (size & 3)) & 3);
+        }
+
+        inline void putU32LE(unsigned char* out, uint32_t value) {
+            out[0] = static_cast<unsigned char>(value & 0xFF);
+            out[1] = static_cast<unsigned char>((value >> 8) & 0xFF);
+            out[2] = static_cast<unsigned char>((value >> 16) & 0xFF);
+            out[3] = static_cast<unsigned char>((value >> 24) & 0xFF);
+        }
+    }
+
+    bool writeGLB(const std::vector<Mesh>& meshes,
+                  const unsigned char* rgba, int width, int height,
+                  const std::string& path) {
+        auto startTime = std::chrono::steady_clock::now();
+
+        if (meshes.empty()) {
+            std::cerr << "Cannot export empty model." << std::endl;
+            return false;
+        }
+
+        // Encode the baked texture
+        std::vector<unsigned char> png;
+        if (rgba && width > 0 && height > 0) {
+            if (!stbi_write_png_to_func(appendToVector, &png, width, height, 4, rgba, width * 4)) {
+                std::cerr << "Failed to encode texture for GLB export." << std::endl;
+                return false;
+            }
+        }
+
+        // Binary chunk segments, referenced in place
+        std::vector<WriteSegment> binSegments;
+        size_t binLength = 0;
+
+        nlohmann::json bufferViews = nlohmann::json::array();
+        nlohmann::json accessors = nlohmann::json::array();
+        nlohmann::json gltfMeshes = nlohmann::json::array();
+        nlohmann::json nodes = nlohmann::json::array();
+        nlohmann::json sceneNodes = nlohmann::json::array();
+
+        for (size_t m = 0; m < meshes.size(); m++) {
+            const Mesh& mesh = meshes[m];
+            const std::vector<Vertex>& vertices = mesh.getVertices();
+            const std::vector<unsigned int>& indices = mesh.getIndices();
+            if (vertices.empty()) {
+                continue;
+            }
+
+            // Position bounds are required by the spec
+            glm::vec3 minPos(std::numeric_limits<float>::max());
+            glm::vec3 maxPos(-std::numeric_limits<float>::max());
+            for (const Vertex& vertex : vertices) {
+                minPos = glm::min(minPos, vertex.Position);
+                maxPos = glm::max(maxPos, vertex.Position);
+            }
+
+            // Interleaved vertex buffer view
+            size_t vertexBytes = vertices.size() * sizeof(Vertex);
+            size_t vertexView = bufferViews.size();
+            nlohmann::json view;
+            view["buffer"] = 0;
+            view["byteOffset"] = binLength;
+            view["byteLength"] = vertexBytes;
+            view["byteStride"] = sizeof(Vertex);
+            view["target"] = GL_ARRAY_BUFFER_TARGET;
+            bufferViews.push_back(view);
+            binSegments.push_back({ vertices.data(), vertexBytes });
+            binLength += vertexBytes;
+
+            nlohmann::json attributes;
+            const char* names[3] = { "POSITION", "NORMAL", "TEXCOORD_0" };
+            const size_t offsets[3] = { offsetof(Vertex, Position), offsetof(Vertex, Normal), offsetof(Vertex, TexCoords) };
+            const char* types[3] = { "VEC3", "VEC3", "VEC2" };
+            for (int a = 0; a < 3; a++) {
+                nlohmann::json accessor;
+                accessor["bufferView"] = vertexView;
+                accessor["byteOffset"] = offsets[a];
+                accessor["componentType"] = GL_FLOAT_TYPE;
+                accessor["count"] = vertices.size();
+                accessor["type"] = types[a];
+                if (a == 0) {
+                    accessor["min"] = { minPos.x, minPos.y, minPos.z };
+                    accessor["max"] = { maxPos.x, maxPos.y, maxPos.z };
+                }
+                attributes[names[a]] = accessors.size();
+                accessors.push_back(accessor);
+            }
+
+            nlohmann::json primitive;
+            primitive["attributes"] = attributes;
+            primitive["mode"] = 4; // TRIANGLES
+            if (!png.empty()) {
+                primitive["material"] = 0;
+            }
+
+            // Index buffer view
+            if (!indices.empty()) {
+                size_t indexBytes = indices.size() * sizeof(unsigned int);
+                nlohmann::json indexView;
+                indexView["buffer"] = 0;
+                indexView["byteOffset"] = binLength;
+                indexView["byteLength"] = indexBytes;
+                indexView["target"] = GL_ELEMENT_ARRAY_BUFFER_TARGET;
+
+                nlohmann::json accessor;
+                accessor["bufferView"] = bufferViews.size();
+                accessor["componentType"] = GL_UNSIGNED_INT_TYPE;
+                accessor["count"] = indices.size();
+                accessor["type"] = "SCALAR";
+
+                bufferViews.push_back(indexView);
+                primitive["indices"] = accessors.size();
+                accessors.push_back(accessor);
+
+                binSegments.push_back({ indices.data(), indexBytes });
+                binLength += indexBytes;
+            }
+
+            nlohmann::json gltfMesh;
+            gltfMesh["name"] = "mesh_" + std::to_string(m);
+            gltfMesh["primitives"] = nlohmann::json::array();
+            gltfMesh["primitives"].push_back(primitive);
+
+            nlohmann::json node;
+            node["mesh"] = gltfMeshes.size();
+            sceneNodes.push_back(nodes.size());
+            nodes.push_back(node);
+            gltfMeshes.push_back(gltfMesh);
+        }
+
+        // Padding bytes shared by every segment that needs alignment
+        static const unsigned char zeros[4] = { 0, 0, 0, 0 };
+        static const unsigned char spaces[4] = { ' ', ' ', ' ', ' ' };
+
+        nlohmann::json gltf;
+        nlohmann::json asset;
+        asset["version"] = "2.0";
+        asset["generator"] = "3D Model Painter";
+        gltf["asset"] = asset;
+        gltf["scene"] = 0;
+        nlohmann::json scene;
+        scene["nodes"] = sceneNodes;
+        gltf["scenes"] = nlohmann::json::array();
+        gltf["scenes"].push_back(scene);
+        gltf["nodes"] = nodes;
+        gltf["meshes"] = gltfMeshes;
+
+        // Embedded texture
+        if (!png.empty()) {
+            nlohmann::json imageView;
+            imageView["buffer"] = 0;
+            imageView["byteOffset"] = binLength;
+            imageView["byteLength"] = png.size();
+
+            nlohmann::json image;
+            image["bufferView"] = bufferViews.size();
+            image["mimeType"] = "image/png";
+            bufferViews.push_back(imageView);
+
+            binSegments.push_back({ png.data(), png.size() });
+            binLength += png.size();
+            uint32_t pad = padTo4(png.size());
+            binSegments.push_back({ zeros, pad });
+            binLength += pad;
+
+            nlohmann::json sampler;
+            sampler["magFilter"] = GL_LINEAR_FILTER;
+            sampler["minFilter"] = GL_LINEAR_FILTER;
+            sampler["wrapS"] = GL_CLAMP_TO_EDGE_WRAP;
+            sampler["wrapT"] = GL_CLAMP_TO_EDGE_WRAP;
+
+            nlohmann::json texture;
+            texture["source"] = 0;
+            texture["sampler"] = 0;
+
+            nlohmann::json baseColorTexture;
+            baseColorTexture["index"] = 0;
+            nlohmann::json pbr;
+            pbr["baseColorTexture"] = baseColorTexture;
+            pbr["metallicFactor"] = 0.0f;
+            pbr["roughnessFactor"] = 1.0f;
+            nlohmann::json material;
+            material["name"] = "PaintedLayers";
+            material["pbrMetallicRoughness"] = pbr;
+
+            gltf["images"] = nlohmann::json::array();
+            gltf["images"].push_back(image);
+            gltf["samplers"] = nlohmann::json::array();
+            gltf["samplers"].push_back(sampler);
+            gltf["textures"] = nlohmann::json::array();
+            gltf["textures"].push_back(texture);
+            gltf["materials"] = nlohmann::json::array();
+            gltf["materials"].push_back(material);
+        }
+
+        nlohmann::json buffer;
+        buffer["byteLength"] = binLength;
+        gltf["buffers"] = nlohmann::json::array();
+        gltf["buffers"].push_back(buffer);
+        gltf["bufferViews"] = bufferViews;
+        gltf["accessors"] = accessors;
+
+        std::string json = gltf.dump();
+        uint32_t jsonPad = padTo4(json.size());
+        uint32_t jsonChunkLength = static_cast<uint32_t>(json.size() + jsonPad);
+
+        if (binLength > std::numeric_limits<uint32_t>::max() - jsonChunkLength - 28) {
+            std::cerr << "Model is too large for a GLB file." << std::endl;
+            return false;
+        }
+
+        // Header (12 bytes) + JSON chunk header (8) + BIN chunk header (8)
+        unsigned char header[12];
+        unsigned char jsonHeader[8];
+        unsigned char binHeader[8];
+        uint32_t totalLength = 12 + 8 + jsonChunkLength + 8 + static_cast<uint32_t>(binLength);
+        putU32LE(header + 0, GLB_MAGIC);
+        putU32LE(header + 4, GLB_VERSION);
+        putU32LE(header + 8, totalLength);
+        putU32LE(jsonHeader + 0, jsonChunkLength);
+        putU32LE(jsonHeader + 4, CHUNK_JSON);
+        putU32LE(binHeader + 0, static_cast<uint32_t>(binLength));
+        putU32LE(binHeader + 4, CHUNK_BIN);
+
+        std::vector<WriteSegment> segments;
+        segments.reserve(binSegments.size() + 5);
+        segments.push_back({ header, sizeof(header) });
+        segments.push_back({ jsonHeader, sizeof(jsonHeader) });
+        segments.push_back({ json.data(), json.size() });
+        segments.push_back({ spaces, jsonPad });
+        segments.push_back({ binHeader, sizeof(binHeader) });
+        segments.insert(segments.end(), binSegments.begin(), binSegments.end());
+
+        if (!writeFileGather(path, segments)) {
+            std::cerr << "Failed to write GLB file: " << path << std::endl;
+            return false;
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        std::cout << "Exported GLB " << path << " (" << totalLength / 1024 << " KB) in "
+                  << elapsed.count() << " ms" << std::endl;
+
+        return true;
+    }
+}
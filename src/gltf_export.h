@@ -0,0 +1,17 @@
+#pragma once
+
+#include "model.h"
+#include <string>
+#include <vector>
+
+// Binary glTF 2.0 (.glb) exporter.
+// Vertex and index data are referenced straight from the mesh arrays and
+// written together with the JSON and the embedded texture in one gathered
+// write, so no intermediate copy of the geometry is made.
+namespace GltfExport {
+    // Write meshes as a GLB file with an RGBA8 base color texture embedded as PNG.
+    // Pass nullptr for rgba to export geometry only.
+    bool writeGLB(const std::vector<Mesh>& meshes,
+                  const unsigned char* rgba, int width, int height,
+                  const std::string& path);
+}
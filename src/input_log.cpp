@@ -0,0 +1,353 @@
+#include "input_log.h"
+#include "mapped_file.h"
+#include "project.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const char MAGIC[4] = { 'P', 'L', 'O', 'G' };
+    const uint32_t VERSION = 1;
+    const size_t HEADER_SIZE = 16;
+
+    // Events are flushed in small blocks, so little is lost if the app dies
+    const size_t WRITE_BUFFER_SIZE = 64 * 1024;
+
+    void writeVarint(FileWriter& writer, uint64_t value) {
+        while (value >= 0x80) {
+            writer.writeU8(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        writer.writeU8(static_cast<uint8_t>(value));
+    }
+
+    // Zigzag, so small negative values (GLFW_KEY_UNKNOWN) stay one byte
+    void writeSigned(FileWriter& writer, int32_t value) {
+        writeVarint(writer, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+    }
+
+    void writeDouble(FileWriter& writer, double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        writer.writeU32LE(static_cast<uint32_t>(bits));
+        writer.writeU32LE(static_cast<uint32_t>(bits >> 32));
+    }
+
+    void writeText(FileWriter& writer, const std::string& text) {
+        writeVarint(writer, text.size());
+        writer.writeString(text);
+    }
+
+    // Bounds-checked cursor over the mapped log; any overrun sets failed
+    struct Reader {
+        const unsigned char* p;
+        const unsigned char* end;
+        bool failed = false;
+
+        bool has(size_t count) {
+            if (static_cast<size_t>(end - p) < count) {
+                failed = true;
+            }
+            return !failed;
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (!has(1)) {
+                    return 0;
+                }
+                uint8_t byte = *p++;
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    return value;
+                }
+            }
+            failed = true;
+            return 0;
+        }
+
+        int32_t signedVarint() {
+            uint32_t value = static_cast<uint32_t>(varint());
+            return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+        }
+
+        uint64_t u64() {
+            if (!has(8)) {
+                return 0;
+            }
+            uint64_t value = 0;
+            for (int i = 7; i >= 0; i--) {
+                value = (value << 8) | p[i];
+            }
+            p += 8;
+            return value;
+        }
+
+        uint32_t u32() {
+            if (!has(4)) {
+                return 0;
+            }
+            uint32_t value = static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                             (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+            p += 4;
+            return value;
+        }
+
+        double f64() {
+            uint64_t bits = u64();
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        float f32() {
+            uint32_t bits = u32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        std::string text() {
+            uint64_t size = varint();
+            if (!has(size)) {
+                return std::string();
+            }
+            std::string value(reinterpret_cast<const char*>(p), size);
+            p += size;
+            return value;
+        }
+    };
+}
+
+namespace InputLog {
+    bool read(const std::string& path, Header& header, std::vector<InputEvent>& events) {
+        MappedFile file;
+        if (!file.open(path)) {
+            std::cerr << "Failed to open input log: " << path << std::endl;
+            return false;
+        }
+
+        Reader in{ file.data(), file.data() + file.size() };
+        if (file.size() < HEADER_SIZE || std::memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0) {
+            std::cerr << "Not an input log: " << path << std::endl;
+            return false;
+        }
+        in.p += sizeof(MAGIC);
+        uint32_t version = in.u32();
+        if (version != VERSION) {
+            std::cerr << "Unsupported input log version " << version << ": " << path << std::endl;
+            return false;
+        }
+        header.windowWidth = static_cast<int32_t>(in.u32());
+        header.windowHeight = static_cast<int32_t>(in.u32());
+
+        events.clear();
+        uint64_t time = 0;
+        while (in.p < in.end && !in.failed) {
+            InputEvent event;
+            uint8_t type = *in.p++;
+            if (type >= InputEvent::TYPE_COUNT) {
+                in.failed = true;
+                break;
+            }
+            event.type = static_cast<InputEvent::Type>(type);
+            time += in.varint();
+            event.time = time;
+
+            switch (event.type) {
+                case InputEvent::FRAME:
+                    break;
+                case InputEvent::CURSOR:
+                case InputEvent::SCROLL:
+                    event.x = in.f64();
+                    event.y = in.f64();
+                    break;
+                case InputEvent::MOUSE_BUTTON:
+                    event.a = in.signedVarint();
+                    event.b = in.signedVarint();
+                    event.c = in.signedVarint();
+                    event.x = in.f64();
+                    event.y = in.f64();
+                    break;
+                case InputEvent::KEY:
+                    event.a = in.signedVarint();
+                    event.b = in.signedVarint();
+                    event.c = in.signedVarint();
+                    break;
+                case InputEvent::RESIZE:
+                case InputEvent::COMMAND:
+                    event.a = in.signedVarint();
+                    event.b = in.signedVarint();
+                    break;
+                case InputEvent::SELECT_TOOL:
+                    event.a = in.signedVarint();
+                    break;
+                case InputEvent::TOOL_SETTINGS:
+                    event.a = in.signedVarint();
+                    event.size = in.f32();
+                    event.hardness = in.f32();
+                    event.tolerance = in.f32();
+                    for (int i = 0; i < 4; i++) {
+                        event.color[i] = in.f32();
+                    }
+                    break;
+                case InputEvent::LOAD_MODEL:
+                    event.path = in.text();
+                    break;
+                case InputEvent::OPEN_VERSION:
+                    event.path = in.text();
+                    event.a = in.signedVarint();
+                    break;
+                case InputEvent::LAYER_HASHES: {
+                    uint64_t count = in.varint();
+                    for (uint64_t i = 0; i < count && !in.failed; i++) {
+                        event.hashes.push_back(in.u64());
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            if (!in.failed) {
+                events.push_back(std::move(event));
+            }
+        }
+
+        // A log cut short by a crash still replays up to the damage
+        if (in.failed) {
+            std::cerr << "Input log is truncated after " << events.size() << " events: " << path << std::endl;
+        }
+        return true;
+    }
+
+    std::vector<uint64_t> hashLayers(const Project& project) {
+        std::vector<uint64_t> hashes;
+        for (const auto& layer : project.getLayers()) {
+            const Texture* texture = layer->getTexture();
+            const std::vector<unsigned char>& pixels = texture->getData();
+            uint64_t hash = 14695981039346656037ull;
+            for (unsigned char byte : pixels) {
+                hash = (hash ^ byte) * 1099511628211ull;
+            }
+            hashes.push_back(hash);
+        }
+        return hashes;
+    }
+}
+
+InputRecorder::InputRecorder()
+    : writer(WRITE_BUFFER_SIZE), lastTime(0), eventCount(0) {
+}
+
+InputRecorder::~InputRecorder() {
+    writer.close();
+}
+
+bool InputRecorder::open(const std::string& path, int windowWidth, int windowHeight) {
+    if (!writer.open(path)) {
+        std::cerr << "Failed to create input log: " << path << std::endl;
+        return false;
+    }
+
+    writer.write(MAGIC, sizeof(MAGIC));
+    writer.writeU32LE(VERSION);
+    writer.writeU32LE(static_cast<uint32_t>(windowWidth));
+    writer.writeU32LE(static_cast<uint32_t>(windowHeight));
+
+    this->path = path;
+    start = std::chrono::steady_clock::now();
+    lastTime = 0;
+    eventCount = 0;
+    std::cout << "Recording input to " << path << std::endl;
+    return true;
+}
+
+void InputRecorder::record(InputEvent event) {
+    if (!writer.isOpen()) {
+        return;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    event.time = std::max<uint64_t>(lastTime, static_cast<uint64_t>(elapsed.count()));
+
+    writer.writeU8(event.type);
+    writeVarint(writer, event.time - lastTime);
+    lastTime = event.time;
+    eventCount++;
+
+    switch (event.type) {
+        case InputEvent::FRAME:
+            break;
+        case InputEvent::CURSOR:
+        case InputEvent::SCROLL:
+            writeDouble(writer, event.x);
+            writeDouble(writer, event.y);
+            break;
+        case InputEvent::MOUSE_BUTTON:
+            writeSigned(writer, event.a);
+            writeSigned(writer, event.b);
+            writeSigned(writer, event.c);
+            writeDouble(writer, event.x);
+            writeDouble(writer, event.y);
+            break;
+        case InputEvent::KEY:
+            writeSigned(writer, event.a);
+            writeSigned(writer, event.b);
+            writeSigned(writer, event.c);
+            break;
+        case InputEvent::RESIZE:
+        case InputEvent::COMMAND:
+            writeSigned(writer, event.a);
+            writeSigned(writer, event.b);
+            break;
+        case InputEvent::SELECT_TOOL:
+            writeSigned(writer, event.a);
+            break;
+        case InputEvent::TOOL_SETTINGS:
+            writeSigned(writer, event.a);
+            writer.writeFloatLE(event.size);
+            writer.writeFloatLE(event.hardness);
+            writer.writeFloatLE(event.tolerance);
+            for (int i = 0; i < 4; i++) {
+                writer.writeFloatLE(event.color[i]);
+            }
+            break;
+        case InputEvent::LOAD_MODEL:
+            writeText(writer, event.path);
+            break;
+        case InputEvent::OPEN_VERSION:
+            writeText(writer, event.path);
+            writeSigned(writer, event.a);
+            break;
+        case InputEvent::LAYER_HASHES:
+            writeVarint(writer, event.hashes.size());
+            for (uint64_t hash : event.hashes) {
+                writer.writeU32LE(static_cast<uint32_t>(hash));
+                writer.writeU32LE(static_cast<uint32_t>(hash >> 32));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool InputRecorder::finish(const Project& project) {
+    if (!writer.isOpen()) {
+        return false;
+    }
+
+    InputEvent hashes;
+    hashes.type = InputEvent::LAYER_HASHES;
+    hashes.hashes = InputLog::hashLayers(project);
+    record(hashes);
+
+    size_t bytes = writer.getBytesWritten();
+    if (!writer.close()) {
+        std::cerr << "Failed to write input log: " << path << std::endl;
+        return false;
+    }
+    std::cout << "Recorded " << eventCount << " input events (" << bytes << " bytes) to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "file_writer.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Project;
+
+// Project edits picked in the menus and the layers panel. The UI queues them
+// and Application applies them, so they can be recorded like input.
+enum class ProjectCommand : uint8_t {
+    NEW_PROJECT,
+    UNDO,
+    REDO,
+    CLEAR_ALL_LAYERS,
+    ADD_LAYER,
+    REMOVE_LAYER,       // layer = index
+    CLEAR_LAYER,
+    SELECT_LAYER        // layer = index
+};
+
+// One recorded input. Only what reaches the scene is recorded (input the UI
+// captured is not), plus the UI's edits and tool changes as they are applied.
+struct InputEvent {
+    enum Type : uint8_t {
+        FRAME,          // a frame starts; held camera keys act once per frame
+        CURSOR,         // x, y
+        MOUSE_BUTTON,   // a = button, b = action, c = mods, at cursor x, y
+        SCROLL,         // x, y offsets
+        KEY,            // a = key, b = action, c = mods
+        RESIZE,         // a = width, b = height
+        SELECT_TOOL,    // a = tool index
+        TOOL_SETTINGS,  // a = tool index; size, hardness, tolerance, color
+        COMMAND,        // a = ProjectCommand, b = layer
+        LOAD_MODEL,     // path
+        OPEN_VERSION,   // path, a = version
+        LAYER_HASHES,   // written last, to check a replay against
+        TYPE_COUNT
+    };
+
+    Type type = FRAME;
+    uint64_t time = 0;          // microseconds since recording started
+    double x = 0.0;
+    double y = 0.0;
+    int32_t a = 0;
+    int32_t b = 0;
+    int32_t c = 0;
+    float size = 0.0f;
+    float hardness = 0.0f;
+    float tolerance = 0.0f;
+    glm::vec4 color = glm::vec4(0.0f);
+    std::string path;
+    std::vector<uint64_t> hashes;
+};
+
+// Compact binary input log (.plog): a 16-byte header with the initial window
+// size, then events of a type byte, the time since the previous event as a
+// varint and a payload that depends on the type.
+namespace InputLog {
+    struct Header {
+        int32_t windowWidth = 0;
+        int32_t windowHeight = 0;
+    };
+
+    bool read(const std::string& path, Header& header, std::vector<InputEvent>& events);
+
+    // FNV-1a of every layer's pixels, bottom to top
+    std::vector<uint64_t> hashLayers(const Project& project);
+}
+
+// Appends events to a log as they happen
+class InputRecorder {
+public:
+    InputRecorder();
+    ~InputRecorder();
+
+    bool open(const std::string& path, int windowWidth, int windowHeight);
+
+    // Stamps the event with the time since open()
+    void record(InputEvent event);
+
+    // Write the layer hashes and close; returns false if any write failed
+    bool finish(const Project& project);
+
+    bool isOpen() const { return writer.isOpen(); }
+    size_t getEventCount() const { return eventCount; }
+
+private:
+    FileWriter writer;
+    std::string path;
+    std::chrono::steady_clock::time_point start;
+    uint64_t lastTime;
+    size_t eventCount;
+};
@@ -1,63 +1,248 @@
 #include "layer.h"
+#include "project_file.h"
+#include "project_snapshot.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    // Rows per task when resizing
+    const size_t RESIZE_GRAIN_ROWS = 64;
+}
 
 Layer::Layer(int width, int height, const std::string& name)
-    : name(name), visible(true), opacity(1.0f) {
+    : name(name), visible(true), opacity(1.0f), blendMode(BLEND_NORMAL), width(width), height(height), sourceLayer(0),
+      recorder(nullptr) {
     texture = std::make_unique<Texture>(width, height);
+    resetChangeTracking();
     clear();
 }
 
 Layer::Layer(const std::string& path, const std::string& name)
-    : name(name), visible(true), opacity(1.0f) {
+    : name(name), visible(true), opacity(1.0f), blendMode(BLEND_NORMAL), sourceLayer(0), recorder(nullptr) {
     texture = std::make_unique<Texture>(path);
+    width = texture->getWidth();
+    height = texture->getHeight();
+    resetChangeTracking();
+}
+
+Layer::Layer(std::unique_ptr<Texture> texture, const std::string& name)
+    : name(name), visible(true), opacity(1.0f), blendMode(BLEND_NORMAL), texture(std::move(texture)), sourceLayer(0),
+      recorder(nullptr) {
+    width = this->texture->getWidth();
+    height = this->texture->getHeight();
+    resetChangeTracking();
+}
+
+Layer::Layer(std::shared_ptr<const ProjectFile> source, uint32_t sourceLayer, int width, int height,
+             const std::string& name)
+    : name(name), visible(true), opacity(1.0f), blendMode(BLEND_NORMAL), width(width), height(height),
+      source(std::move(source)), sourceLayer(sourceLayer), recorder(nullptr) {
+    resetChangeTracking();
 }
 
 Layer::~Layer() {
     // Texture is cleaned up by its destructor
 }
 
+Texture* Layer::ensureLoaded() const {
+    if (!texture) {
+        std::vector<unsigned char> pixels;
+        decodeSource(pixels);
+        loadPixels(std::move(pixels));
+    }
+    
+    return texture.get();
+}
+
+bool Layer::decodeSource(std::vector<unsigned char>& rgba) const {
+    if (texture) {
+        return false;
+    }
+    
+    if (!source || !source->decodeLayer(sourceLayer, width, height, rgba)) {
+        std::cerr << "Failed to load layer pixels: " << name << std::endl;
+        rgba.assign(static_cast<size_t>(width) * height * 4, 0);
+        return false;
+    }
+    
+    return true;
+}
+
+void Layer::loadPixels(std::vector<unsigned char>&& rgba) const {
+    if (texture) {
+        return;
+    }
+    
+    // The decoded buffer becomes the texture's storage without a copy
+    texture = std::make_unique<Texture>(width, height, std::move(rgba));
+}
+
+size_t Layer::unloadPixels() {
+    if (!texture || !source) {
+        return 0;
+    }
+    
+    size_t bytes = texture->getData().size();
+    texture.reset();
+    return bytes;
+}
+
+void Layer::resetChangeTracking() {
+    // A new cache, so saves still running keep the one matching their size
+    size_t tiles = static_cast<size_t>(TileCodec::tileCount(width)) * TileCodec::tileCount(height);
+    changeStamp = Utils::nextChangeStamp();
+    tileStamps.assign(tiles, changeStamp);
+    tileCache = std::make_shared<LayerTileCache>();
+}
+
+void Layer::getTileRect(size_t tile, int& x, int& y, int& tileWidth, int& tileHeight) const {
+    int columns = TileCodec::tileCount(width);
+    x = static_cast<int>(tile % columns) * TileCodec::TILE_SIZE;
+    y = static_cast<int>(tile / columns) * TileCodec::TILE_SIZE;
+    tileWidth = std::min(TileCodec::TILE_SIZE, width - x);
+    tileHeight = std::min(TileCodec::TILE_SIZE, height - y);
+}
+
+void Layer::readTile(size_t tile, std::vector<unsigned char>& pixels) const {
+    const Texture* texture = ensureLoaded();
+    int x, y, tileWidth, tileHeight;
+    getTileRect(tile, x, y, tileWidth, tileHeight);
+    pixels.resize(static_cast<size_t>(tileWidth) * tileHeight * texture->getChannels());
+    texture->readRegion(x, y, tileWidth, tileHeight, pixels.data());
+}
+
+void Layer::writeTile(size_t tile, const unsigned char* pixels) {
+    int x, y, tileWidth, tileHeight;
+    getTileRect(tile, x, y, tileWidth, tileHeight);
+    ensureLoaded()->writeRegion(x, y, tileWidth, tileHeight, pixels);
+    markChanged(x, y, x + tileWidth - 1, y + tileHeight - 1);
+}
+
+void Layer::prepareChange(int minX, int minY, int maxX, int maxY) {
+    minX = std::max(minX, 0);
+    minY = std::max(minY, 0);
+    maxX = std::min(maxX, width - 1);
+    maxY = std::min(maxY, height - 1);
+    if (!recorder || minX > maxX || minY > maxY) {
+        return;
+    }
+    
+    int columns = TileCodec::tileCount(width);
+    for (int ty = minY / TileCodec::TILE_SIZE; ty <= maxY / TileCodec::TILE_SIZE; ty++) {
+        for (int tx = minX / TileCodec::TILE_SIZE; tx <= maxX / TileCodec::TILE_SIZE; tx++) {
+            recorder->recordTile(*this, static_cast<size_t>(ty) * columns + tx);
+        }
+    }
+}
+
+void Layer::markChanged(int minX, int minY, int maxX, int maxY) {
+    minX = std::max(minX, 0);
+    minY = std::max(minY, 0);
+    maxX = std::min(maxX, width - 1);
+    maxY = std::min(maxY, height - 1);
+    if (minX > maxX || minY > maxY) {
+        return;
+    }
+    
+    // The pixels now differ from the project file's
+    source.reset();
+    changeStamp = Utils::nextChangeStamp();
+    int columns = TileCodec::tileCount(width);
+    for (int ty = minY / TileCodec::TILE_SIZE; ty <= maxY / TileCodec::TILE_SIZE; ty++) {
+        for (int tx = minX / TileCodec::TILE_SIZE; tx <= maxX / TileCodec::TILE_SIZE; tx++) {
+            tileStamps[static_cast<size_t>(ty) * columns + tx] = changeStamp;
+        }
+    }
+}
+
 void Layer::clear(const glm::vec4& color) {
-    texture->clear(color);
+    prepareChange(0, 0, width - 1, height - 1);
+    ensureLoaded()->clear(color);
+    markChanged(0, 0, width - 1, height - 1);
 }
 
 void Layer::paint(int x, int y, const glm::vec4& color, float radius, float hardness) {
-    texture->applyBrush(x, y, color, radius, hardness);
+    prepareChange(static_cast<int>(x - radius), static_cast<int>(y - radius),
+                  static_cast<int>(x + radius), static_cast<int>(y + radius));
+    ensureLoaded()->applyBrush(x, y, color, radius, hardness);
+    markChanged(static_cast<int>(x - radius), static_cast<int>(y - radius),
+                static_cast<int>(x + radius), static_cast<int>(y + radius));
 }
 
 void Layer::fill(int x, int y, const glm::vec4& color, float tolerance) {
-    texture->fill(x, y, color, tolerance);
+    // Find the region first, so only its tiles are recorded and stamped
+    const Texture* texture = ensureLoaded();
+    FillPlan plan;
+    Arena arena;
+    Texture::planFill(texture->getData(), width, height, texture->getChannels(), x, y, color, tolerance, plan, arena);
+    applyFill(plan);
+}
+
+void Layer::applyFill(const FillPlan& plan) {
+    if (plan.empty()) {
+        return;
+    }
+    
+    prepareChange(plan.minX, plan.minY, plan.maxX, plan.maxY);
+    ensureLoaded()->applyFill(plan);
+    markChanged(plan.minX, plan.minY, plan.maxX, plan.maxY);
 }
 
 void Layer::erase(int x, int y, float radius, float hardness) {
     // Erasing is just painting with transparent color
     glm::vec4 transparent(0.0f, 0.0f, 0.0f, 0.0f);
-    texture->applyBrush(x, y, transparent, radius, hardness);
+    prepareChange(static_cast<int>(x - radius), static_cast<int>(y - radius),
+                  static_cast<int>(x + radius), static_cast<int>(y + radius));
+    ensureLoaded()->applyBrush(x, y, transparent, radius, hardness);
+    markChanged(static_cast<int>(x - radius), static_cast<int>(y - radius),
+                static_cast<int>(x + radius), static_cast<int>(y + radius));
 }
 
 void Layer::resize(int width, int height) {
-    // Create new texture with desired dimensions
-    std::unique_ptr<Texture> newTexture = std::make_unique<Texture>(width, height);
-    
-    // Clear with transparent
-    newTexture->clear(glm::vec4(0.0f, 0.0f, 0.0f, 0.0f));
+    const Texture* oldTexture = ensureLoaded();
+    const std::vector<unsigned char>& oldData = oldTexture->getData();
+    int oldWidth = oldTexture->getWidth();
+    int oldChannels = oldTexture->getChannels();
     
-    // Copy old texture content
-    int copyWidth = std::min(width, texture->getWidth());
-    int copyHeight = std::min(height, texture->getHeight());
-    
-    for (int y = 0; y < copyHeight; y++) {
-        for (int x = 0; x < copyWidth; x++) {
-            glm::vec4 pixelColor = texture->getPixel(x, y);
-            newTexture->setPixel(x, y, pixelColor);
+    // Copy old texture content into transparent RGBA, a band of rows per task
+    std::vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4, 0);
+    int copyWidth = std::min(width, oldWidth);
+    int copyHeight = std::min(height, oldTexture->getHeight());
+    ThreadPool::shared().parallelFor(0, copyHeight, RESIZE_GRAIN_ROWS, [&](size_t firstRow, size_t lastRow) {
+        for (size_t y = firstRow; y < lastRow; y++) {
+            const unsigned char* from = &oldData[y * oldWidth * oldChannels];
+            unsigned char* to = &rgba[y * width * 4];
+            if (oldChannels == 4) {
+                std::memcpy(to, from, static_cast<size_t>(copyWidth) * 4);
+                continue;
+            }
+            
+            // Gray (and gray-alpha) spreads over red, green and blue; without
+            // an alpha channel pixels are opaque
+            for (int x = 0; x < copyWidth; x++) {
+                const unsigned char* pixel = &from[x * oldChannels];
+                if (oldChannels >= 3) {
+                    to[x * 4 + 0] = pixel[0];
+                    to[x * 4 + 1] = pixel[1];
+                    to[x * 4 + 2] = pixel[2];
+                } else {
+                    to[x * 4 + 0] = to[x * 4 + 1] = to[x * 4 + 2] = pixel[0];
+                }
+                to[x * 4 + 3] = oldChannels == 2 ? pixel[1] : (oldChannels >= 4 ? pixel[3] : 255);
+            }
         }
-    }
-    
-    // Update texture
-    newTexture->updateTexture();
+    });
     
     // Replace old texture
-    texture = std::move(newTexture);
+    texture = std::make_unique<Texture>(width, height, std::move(rgba));
+    source.reset();
+    this->width = width;
+    this->height = height;
+    resetChangeTracking();
 }
 
 bool Layer::saveToFile(const std::string& path) const {
-    return texture->saveToFile(path);
+    return ensureLoaded()->saveToFile(path);
 }
@@ -1,8 +1,24 @@
 #pragma once
 
+#include "compositor.h"
 #include "texture.h"
+#include "utils.h"
 #include <string>
 #include <memory>
+#include <vector>
+#include <cstdint>
+
+class ProjectFile;
+struct LayerTileCache;
+class Layer;
+
+// Gets each tile of a layer right before an edit first modifies it, so the
+// previous pixels can be kept (see UndoHistory)
+class TileRecorder {
+public:
+    virtual ~TileRecorder() {}
+    virtual void recordTile(const Layer& layer, size_t tile) = 0;
+};
 
 class Layer {
 public:
@@ -12,6 +28,13 @@ public:
     // Load layer from texture file
     Layer(const std::string& path, const std::string& name = "Layer");
     
+    // Take ownership of an existing texture
+    Layer(std::unique_ptr<Texture> texture, const std::string& name = "Layer");
+    
+    // Layer stored in a project file; pixels are decoded on first use
+    Layer(std::shared_ptr<const ProjectFile> source, uint32_t sourceLayer, int width, int height,
+          const std::string& name = "Layer");
+    
     // Destructor
     ~Layer();
     
@@ -19,14 +42,56 @@ public:
     const std::string& getName() const { return name; }
     bool isVisible() const { return visible; }
     float getOpacity() const { return opacity; }
-    unsigned int getTextureID() const { return texture->getID(); }
-    int getWidth() const { return texture->getWidth(); }
-    int getHeight() const { return texture->getHeight(); }
+    BlendMode getBlendMode() const { return blendMode; }
+    unsigned int getTextureID() const { return ensureLoaded()->getID(); }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    
+    // Lazy loading state
+    bool isLoaded() const { return texture != nullptr; }
+    size_t getResidentBytes() const { return texture ? texture->getData().size() : 0; }
+    const std::shared_ptr<const ProjectFile>& getSource() const { return source; }
+    uint32_t getSourceLayer() const { return sourceLayer; }
+    
+    // Decoded pixels that were not edited since can be dropped and decoded
+    // again from the project file on next use. Returns the bytes freed.
+    size_t unloadPixels();
+    
+    // Forget the project file, e.g. so it can be replaced
+    void releaseSource() { source.reset(); }
+    
+    // Split form of lazy loading: decodeSource() only reads the project file
+    // and may run on any thread; loadPixels() creates the texture and must run
+    // on the GL thread. Both are no-ops for layers that are already loaded.
+    bool decodeSource(std::vector<unsigned char>& rgba) const;
+    void loadPixels(std::vector<unsigned char>&& rgba) const;
+    
+    // Change tracking for incremental saves: one stamp per tile
+    // (TileCodec::TILE_SIZE squared) and one for the whole layer
+    uint64_t getChangeStamp() const { return changeStamp; }
+    const std::vector<uint64_t>& getTileStamps() const { return tileStamps; }
+    const std::shared_ptr<LayerTileCache>& getTileCache() const { return tileCache; }
+    
+    // Tiles are TileCodec::TILE_SIZE squared, clipped at the right and bottom
+    // edges, and hold getTexture()->getChannels() bytes per pixel
+    size_t getTileCount() const { return tileStamps.size(); }
+    void getTileRect(size_t tile, int& x, int& y, int& tileWidth, int& tileHeight) const;
+    void readTile(size_t tile, std::vector<unsigned char>& pixels) const;
+    
+    // Replace the pixels of a tile, uploading only that tile
+    void writeTile(size_t tile, const unsigned char* pixels);
+    
+    // While set, edits report the tiles they are about to modify
+    void setTileRecorder(TileRecorder* recorder) { this->recorder = recorder; }
     
     // Setters
-    void setName(const std::string& name) { this->name = name; }
-    void setVisible(bool visible) { this->visible = visible; }
-    void setOpacity(float opacity) { this->opacity = std::max(0.0f, std::min(1.0f, opacity)); }
+    void setName(const std::string& name) { this->name = name; changeStamp = Utils::nextChangeStamp(); }
+    void setVisible(bool visible) { this->visible = visible; changeStamp = Utils::nextChangeStamp(); }
+    void setOpacity(float opacity) {
+        this->opacity = std::max(0.0f, std::min(1.0f, opacity));
+        changeStamp = Utils::nextChangeStamp();
+    }
+    void setBlendMode(BlendMode mode) { blendMode = mode; changeStamp = Utils::nextChangeStamp(); }
     
     // Clear layer with color
     void clear(const glm::vec4& color = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f));
@@ -37,6 +102,9 @@ public:
     // Fill area on layer
     void fill(int x, int y, const glm::vec4& color, float tolerance = 0.1f);
     
+    // Write a fill planned on a copy of the pixels (see Texture::planFill)
+    void applyFill(const FillPlan& plan);
+    
     // Erase on layer
     void erase(int x, int y, float radius, float hardness);
     
@@ -47,12 +115,39 @@ public:
     bool saveToFile(const std::string& path) const;
     
     // Get texture
-    Texture* getTexture() { return texture.get(); }
-    const Texture* getTexture() const { return texture.get(); }
+    Texture* getTexture() { return ensureLoaded(); }
+    const Texture* getTexture() const { return ensureLoaded(); }
     
 private:
     std::string name;
     bool visible;
     float opacity;
-    std::unique_ptr<Texture> texture;
+    BlendMode blendMode;
+    int width;
+    int height;
+    mutable std::unique_ptr<Texture> texture;
+    
+    // Project file the pixels still live in (kept after decoding until the
+    // first edit, so unedited pixels can be unloaded)
+    mutable std::shared_ptr<const ProjectFile> source;
+    uint32_t sourceLayer;
+    
+    // Change tracking
+    uint64_t changeStamp;
+    std::vector<uint64_t> tileStamps;
+    std::shared_ptr<LayerTileCache> tileCache;
+    
+    TileRecorder* recorder;
+    
+    // Decode pixels from the project file if that has not happened yet
+    Texture* ensureLoaded() const;
+    
+    // Start tracking changes for the current size
+    void resetChangeTracking();
+    
+    // Report the tiles a pixel rectangle (inclusive) is about to modify
+    void prepareChange(int minX, int minY, int maxX, int maxY);
+    
+    // Stamp the tiles touched by a pixel rectangle (inclusive)
+    void markChanged(int minX, int minY, int maxX, int maxY);
 };
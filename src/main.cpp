@@ -1,15 +1,58 @@
 /**
  * 3D Model Painter
  * A C++ application for painting 3D models (OBJ and FBX) with layer support
+ *
+ * Options:
+ *   --record <log>    record input to a log
+ *   --replay <log>    replay a log instead of taking input
+ *   --headless        replay without a window, as fast as possible
+ *   --realtime        replay at the recorded times (default with a window)
+ *   --fast            replay frames back to back (default when headless)
+ *   --report <json>   write the replay's per-frame timings
+ *   --soft-budget MB  evict caches and unedited hidden layers, and spill
+ *                     undo steps, above this much memory
+ *   --hard-budget MB  also drop the compositor caches and warn above this
  */
 #include "application.h"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 int main(int argc, char** argv) {
+    ApplicationOptions options;
+    int pace = 0;   // -1 = --realtime, 1 = --fast
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--record") == 0 && hasValue) {
+            options.recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && hasValue) {
+            options.replayPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--report") == 0 && hasValue) {
+            options.reportPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--soft-budget") == 0 && hasValue) {
+            options.softMemoryBudget = std::strtoull(argv[++i], nullptr, 10) << 20;
+        } else if (std::strcmp(argv[i], "--hard-budget") == 0 && hasValue) {
+            options.hardMemoryBudget = std::strtoull(argv[++i], nullptr, 10) << 20;
+        } else if (std::strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strcmp(argv[i], "--realtime") == 0) {
+            pace = -1;
+        } else if (std::strcmp(argv[i], "--fast") == 0) {
+            pace = 1;
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (options.headless && options.replayPath.empty()) {
+        std::cerr << "--headless needs a log to --replay" << std::endl;
+        return 1;
+    }
+    options.fastReplay = pace == 0 ? options.headless : pace > 0;
+    
     try {
-        Application app;
-        app.run();
-        return 0;
+        Application app(options);
+        return app.run();
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;
         return 1;
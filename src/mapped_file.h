@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map file into memory; an empty file maps successfully with size 0
+    bool open(const std::string& path);
+
+    // Unmap file
+    void close();
+
+    // Getters
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool isOpen() const { return opened; }
+
+private:
+    const unsigned char* bytes;
+    size_t length;
+    bool opened;
+
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fd;
+#endif
+};
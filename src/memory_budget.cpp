@@ -0,0 +1,157 @@
+#include "memory_budget.h"
+#include "project.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+
+namespace {
+    std::array<std::atomic<size_t>, MemoryStats::CATEGORY_COUNT> charged{};
+
+    const char* const CATEGORY_NAMES[MemoryStats::CATEGORY_COUNT] = {
+        "Layer pixels", "Undo history", "Meshes", "Bounds", "GPU textures", "GPU buffers", "Caches"
+    };
+
+    // Undo keeps at least this much in RAM, so the last few steps stay quick
+    const size_t MIN_UNDO_BUDGET = 32u << 20;
+}
+
+namespace MemoryStats {
+    const char* getName(Category category) {
+        return category < CATEGORY_COUNT ? CATEGORY_NAMES[category] : "";
+    }
+
+    void add(Category category, size_t bytes) {
+        if (bytes) {
+            charged[category].fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    void remove(Category category, size_t bytes) {
+        if (bytes) {
+            charged[category].fetch_sub(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    Totals read() {
+        Totals totals{};
+        for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+            totals[i] = charged[i].load(std::memory_order_relaxed);
+        }
+        return totals;
+    }
+}
+
+MemoryCharge::MemoryCharge(MemoryStats::Category category, size_t bytes)
+    : category(category), bytes(bytes) {
+    MemoryStats::add(category, bytes);
+}
+
+MemoryCharge::MemoryCharge(const MemoryCharge& other)
+    : category(other.category), bytes(other.bytes) {
+    MemoryStats::add(category, bytes);
+}
+
+MemoryCharge::MemoryCharge(MemoryCharge&& other) noexcept
+    : category(other.category), bytes(other.bytes) {
+    other.bytes = 0;
+}
+
+MemoryCharge& MemoryCharge::operator=(const MemoryCharge& other) {
+    if (this != &other) {
+        MemoryStats::remove(category, bytes);
+        category = other.category;
+        bytes = other.bytes;
+        MemoryStats::add(category, bytes);
+    }
+    return *this;
+}
+
+MemoryCharge& MemoryCharge::operator=(MemoryCharge&& other) noexcept {
+    if (this != &other) {
+        MemoryStats::remove(category, bytes);
+        category = other.category;
+        bytes = other.bytes;
+        other.bytes = 0;
+    }
+    return *this;
+}
+
+MemoryCharge::~MemoryCharge() {
+    MemoryStats::remove(category, bytes);
+}
+
+void MemoryCharge::set(size_t bytes) {
+    MemoryStats::remove(category, this->bytes);
+    this->bytes = bytes;
+    MemoryStats::add(category, bytes);
+}
+
+MemoryBudget::MemoryBudget()
+    : undoBudget(0), warned(false) {
+}
+
+void MemoryBudget::setBudgets(size_t softBytes, size_t hardBytes) {
+    report.softBudget = softBytes;
+    report.hardBudget = hardBytes;
+}
+
+void MemoryBudget::measure(Project& project) {
+    report.bytes = MemoryStats::read();
+    report.bytes[MemoryStats::UNDO_HISTORY] = project.getUndoHistory().getMemoryUsage();
+    report.bytes[MemoryStats::CACHES] = project.getCacheMemory();
+    report.total = 0;
+    for (size_t bytes : report.bytes) {
+        report.total += bytes;
+    }
+}
+
+const MemoryReport& MemoryBudget::update(Project& project) {
+    measure(project);
+    UndoHistory& undo = project.getUndoHistory();
+    size_t before = report.total;
+
+    if (report.softBudget && report.total > report.softBudget) {
+        project.releaseTileCaches();
+        measure(project);
+        if (report.total > report.softBudget) {
+            project.unloadHiddenLayers();
+            measure(project);
+        }
+        if (report.total > report.softBudget) {
+            // Undo spills in the background, so its usage drops over the next frames
+            if (!undoBudget) {
+                undoBudget = undo.getMemoryBudget();
+            }
+            size_t excess = report.total - report.softBudget;
+            size_t undoBytes = report.bytes[MemoryStats::UNDO_HISTORY];
+            size_t target = std::max(MIN_UNDO_BUDGET, undoBytes > excess ? undoBytes - excess : 0);
+            if (target < undo.getMemoryBudget()) {
+                undo.setMemoryBudget(target);
+            }
+        }
+    } else if (undoBudget && (!report.softBudget || report.total < report.softBudget / 4 * 3)) {
+        // Pressure is gone, or the budget was turned off; undo may grow up to
+        // its own budget again
+        undo.setMemoryBudget(undoBudget);
+        undoBudget = 0;
+    }
+
+    if (report.hardBudget && report.total > report.hardBudget) {
+        project.releaseCompositeCache();
+        measure(project);
+    }
+
+    report.overSoft = report.softBudget && report.total > report.softBudget;
+    report.overHard = report.hardBudget && report.total > report.hardBudget;
+    if (report.overHard && !warned) {
+        std::cerr << "Memory use of " << (report.total >> 20) << " MB is over the hard budget of "
+                  << (report.hardBudget >> 20) << " MB" << std::endl;
+    }
+    warned = report.overHard;
+
+    if (report.total < before) {
+        report.lastEvicted = before - report.total;
+        report.evictions++;
+    }
+    return report;
+}
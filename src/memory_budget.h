@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Project;
+
+// Memory per subsystem. Owners of large buffers charge them here through a
+// MemoryCharge, so totals are always current and cost nothing to read. GPU
+// sizes are estimates from the allocation sizes GL was given.
+namespace MemoryStats {
+    enum Category {
+        LAYER_PIXELS,   // CPU copies of texture pixels
+        UNDO_HISTORY,   // undo steps held in RAM (spilled steps are on disk)
+        MESHES,         // vertices and indices
+        BOUNDS,         // per-mesh bounds for culling and picking
+        GPU_TEXTURES,
+        GPU_BUFFERS,
+        CACHES,         // encoded tiles for incremental saves, compositor stacks
+        CATEGORY_COUNT
+    };
+
+    using Totals = std::array<size_t, CATEGORY_COUNT>;
+
+    const char* getName(Category category);
+
+    void add(Category category, size_t bytes);
+    void remove(Category category, size_t bytes);
+
+    // The charged categories; UNDO_HISTORY and CACHES are measured by MemoryBudget
+    Totals read();
+}
+
+// Bytes charged to a category while the owner lives. Copies charge again,
+// as they own a copy of the buffer.
+class MemoryCharge {
+public:
+    explicit MemoryCharge(MemoryStats::Category category, size_t bytes = 0);
+    MemoryCharge(const MemoryCharge& other);
+    MemoryCharge(MemoryCharge&& other) noexcept;
+    MemoryCharge& operator=(const MemoryCharge& other);
+    MemoryCharge& operator=(MemoryCharge&& other) noexcept;
+    ~MemoryCharge();
+
+    void set(size_t bytes);
+    size_t get() const { return bytes; }
+
+private:
+    MemoryStats::Category category;
+    size_t bytes;
+};
+
+// Immutable shared vector whose bytes stay charged until the last reference
+// goes. Values moved in are not copied.
+template <typename T>
+std::shared_ptr<const std::vector<T>> makeChargedVector(MemoryStats::Category category, std::vector<T> values) {
+    struct Charged {
+        std::vector<T> values;
+        MemoryCharge charge;
+        Charged(MemoryStats::Category category, std::vector<T>&& values)
+            : values(std::move(values)), charge(category, this->values.capacity() * sizeof(T)) {}
+    };
+    auto charged = std::make_shared<Charged>(category, std::move(values));
+    return std::shared_ptr<const std::vector<T>>(charged, &charged->values);
+}
+
+// Totals and budgets as of the last MemoryBudget::update()
+struct MemoryReport {
+    MemoryStats::Totals bytes{};
+    size_t total = 0;
+    size_t softBudget = 0;          // 0 = none
+    size_t hardBudget = 0;
+    bool overSoft = false;
+    bool overHard = false;
+    size_t lastEvicted = 0;         // freed by the last update that evicted
+    uint64_t evictions = 0;         // updates that had to evict
+};
+
+// Soft and hard limits on the total. Over the soft budget, memory that can be
+// recreated is let go, cheapest first: encoded tile caches, pixels of hidden
+// layers that are still in their project file, then undo steps (spilled to
+// disk). Over the hard budget the compositor caches go too, and a warning is
+// printed once per crossing.
+class MemoryBudget {
+public:
+    MemoryBudget();
+
+    void setBudgets(size_t softBytes, size_t hardBytes);
+
+    // Measure and evict as needed. Layers locked, on the GL thread (evicted
+    // layers free their GL textures).
+    const MemoryReport& update(Project& project);
+
+    const MemoryReport& getReport() const { return report; }
+
+private:
+    MemoryReport report;
+    size_t undoBudget;      // the history's own budget, while update() lowers it
+    bool warned;
+
+    void measure(Project& project);
+};
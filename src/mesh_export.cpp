@@ -0,0 +1,159 @@
+#include "mesh_export.h"
+#include "file_writer.h"
+#include <iostream>
+
+namespace MeshExport {
+    namespace {
+        // Models are imported with aiProcess_FlipUVs, so flip V back on export
+        // to keep files in the OBJ/PLY bottom-up convention and round-trip cleanly.
+        inline float exportV(float v) {
+            return 1.0f - v;
+        }
+
+        // Number of triangles in a mesh (indexed or not)
+        size_t triangleCount(const Mesh& mesh) {
+            return mesh.hasIndices() ? mesh.getIndicesCount() / 3 : mesh.getVerticesCount() / 3;
+        }
+
+        // Index of a triangle corner (indexed or not)
+        inline uint32_t cornerIndex(const Mesh& mesh, size_t triangle, int corner) {
+            size_t i = triangle * 3 + corner;
+            return mesh.hasIndices() ? mesh.getIndices()[i] : static_cast<uint32_t>(i);
+        }
+    }
+
+    bool writeOBJ(const std::vector<Mesh>& meshes, const std::string& path) {
+        FileWriter writer;
+        if (!writer.open(path)) {
+            std::cerr << "Failed to open file for writing: " << path << std::endl;
+            return false;
+        }
+
+        writer.writeString("# Exported by 3D Model Painter\n");
+
+        // OBJ indices are global and 1-based
+        uint32_t vertexOffset = 1;
+
+        for (size_t m = 0; m < meshes.size(); m++) {
+            const Mesh& mesh = meshes[m];
+            const std::vector<Vertex>& vertices = mesh.getVertices();
+
+            writer.writeString("o mesh_");
+            writer.writeUInt(static_cast<uint32_t>(m));
+            writer.writeChar('\n');
+
+            for (const Vertex& vertex : vertices) {
+                writer.writeString("v ");
+                writer.writeFloat(vertex.Position.x);
+                writer.writeChar(' ');
+                writer.writeFloat(vertex.Position.y);
+                writer.writeChar(' ');
+                writer.writeFloat(vertex.Position.z);
+                writer.writeChar('\n');
+            }
+
+            for (const Vertex& vertex : vertices) {
+                writer.writeString("vt ");
+                writer.writeFloat(vertex.TexCoords.x);
+                writer.writeChar(' ');
+                writer.writeFloat(exportV(vertex.TexCoords.y));
+                writer.writeChar('\n');
+            }
+
+            for (const Vertex& vertex : vertices) {
+                writer.writeString("vn ");
+                writer.writeFloat(vertex.Normal.x);
+                writer.writeChar(' ');
+                writer.writeFloat(vertex.Normal.y);
+                writer.writeChar(' ');
+                writer.writeFloat(vertex.Normal.z);
+                writer.writeChar('\n');
+            }
+
+            // Position, texture coordinate and normal share the same index
+            size_t triangles = triangleCount(mesh);
+            for (size_t t = 0; t < triangles; t++) {
+                writer.writeChar('f');
+                for (int c = 0; c < 3; c++) {
+                    uint32_t index = cornerIndex(mesh, t, c) + vertexOffset;
+                    writer.writeChar(' ');
+                    writer.writeUInt(index);
+                    writer.writeChar('/');
+                    writer.writeUInt(index);
+                    writer.writeChar('/');
+                    writer.writeUInt(index);
+                }
+                writer.writeChar('\n');
+            }
+
+            vertexOffset += static_cast<uint32_t>(vertices.size());
+        }
+
+        if (!writer.close()) {
+            std::cerr << "Failed to write OBJ file: " << path << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool writePLY(const std::vector<Mesh>& meshes, const std::string& path) {
+        size_t totalVertices = 0;
+        size_t totalTriangles = 0;
+        for (const Mesh& mesh : meshes) {
+            totalVertices += mesh.getVerticesCount();
+            totalTriangles += triangleCount(mesh);
+        }
+
+        FileWriter writer;
+        if (!writer.open(path)) {
+            std::cerr << "Failed to open file for writing: " << path << std::endl;
+            return false;
+        }
+
+        // Header
+        writer.writeString("ply\nformat binary_little_endian 1.0\ncomment Exported by 3D Model Painter\n");
+        writer.writeString("element vertex ");
+        writer.writeUInt(static_cast<uint32_t>(totalVertices));
+        writer.writeString("\nproperty float x\nproperty float y\nproperty float z\n");
+        writer.writeString("property float nx\nproperty float ny\nproperty float nz\n");
+        writer.writeString("property float s\nproperty float t\n");
+        writer.writeString("element face ");
+        writer.writeUInt(static_cast<uint32_t>(totalTriangles));
+        writer.writeString("\nproperty list uchar uint vertex_indices\nend_header\n");
+
+        // Vertex data
+        for (const Mesh& mesh : meshes) {
+            for (const Vertex& vertex : mesh.getVertices()) {
+                writer.writeFloatLE(vertex.Position.x);
+                writer.writeFloatLE(vertex.Position.y);
+                writer.writeFloatLE(vertex.Position.z);
+                writer.writeFloatLE(vertex.Normal.x);
+                writer.writeFloatLE(vertex.Normal.y);
+                writer.writeFloatLE(vertex.Normal.z);
+                writer.writeFloatLE(vertex.TexCoords.x);
+                writer.writeFloatLE(exportV(vertex.TexCoords.y));
+            }
+        }
+
+        // Face data (meshes are merged, so offset indices)
+        uint32_t vertexOffset = 0;
+        for (const Mesh& mesh : meshes) {
+            size_t triangles = triangleCount(mesh);
+            for (size_t t = 0; t < triangles; t++) {
+                writer.writeU8(3);
+                writer.writeU32LE(cornerIndex(mesh, t, 0) + vertexOffset);
+                writer.writeU32LE(cornerIndex(mesh, t, 1) + vertexOffset);
+                writer.writeU32LE(cornerIndex(mesh, t, 2) + vertexOffset);
+            }
+            vertexOffset += static_cast<uint32_t>(mesh.getVerticesCount());
+        }
+
+        if (!writer.close()) {
+            std::cerr << "Failed to write PLY file: " << path << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}
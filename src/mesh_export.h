@@ -0,0 +1,16 @@
+#pragma once
+
+#include "model.h"
+#include <string>
+#include <vector>
+
+// Native streaming exporters that write straight from Mesh data.
+// Output goes through a fixed-size buffer, so memory use does not grow
+// with the size of the model.
+namespace MeshExport {
+    // Write meshes as a Wavefront OBJ file (one object per mesh)
+    bool writeOBJ(const std::vector<Mesh>& meshes, const std::string& path);
+
+    // Write meshes as a binary little-endian PLY file (meshes are merged)
+    bool writePLY(const std::vector<Mesh>& meshes, const std::string& path);
+}
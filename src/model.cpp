@@ -1,58 +1,110 @@
 #include "model.h"
-#include <glad/glad.h>
+#include "arena.h"
+#include "mesh_export.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <assimp/Exporter.hpp>
 
-// Mesh implementation
-Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
-    : vertices(vertices), indices(indices), VAO(0), VBO(0), EBO(0) {
-    setupMesh();
-}
-
-Mesh::~Mesh() {
-    // Clean up OpenGL resources
-    if (VAO) glDeleteVertexArrays(1, &VAO);
-    if (VBO) glDeleteBuffers(1, &VBO);
-    if (EBO) glDeleteBuffers(1, &EBO);
+namespace {
+    // Vertices per task when converting meshes and computing their bounds
+    const size_t MESH_GRAIN_VERTICES = 16384;
 }
 
-void Mesh::setupMesh() {
-    // Create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    
-    if (!indices.empty()) {
-        glGenBuffers(1, &EBO);
+// Mesh implementation
+Mesh::Mesh(std::vector<Vertex> vertexData, std::vector<unsigned int> indexData)
+    : vertices(makeChargedVector(MemoryStats::MESHES, std::move(vertexData))),
+      indices(makeChargedVector(MemoryStats::MESHES, std::move(indexData))) {
+    const std::vector<Vertex>& vertices = *this->vertices;
+    if (vertices.empty()) {
+        return;
     }
     
-    // Bind VAO
-    glBindVertexArray(VAO);
-    
-    // Load data into vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-    
-    // Load indices
-    if (!indices.empty()) {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    // Box from the extremes, sphere around its center. Both are reduced
+    // over ranges of vertices in parallel; min and max are exact, so the
+    // result does not depend on how the ranges are spread over threads.
+    // The per-range results are temporaries in the thread's frame arena.
+    ThreadPool& pool = ThreadPool::shared();
+    Arena::Scope scope(Arena::frame());
+    ArenaAllocator<glm::vec3> alloc(scope.get());
+    size_t ranges = (vertices.size() + MESH_GRAIN_VERTICES - 1) / MESH_GRAIN_VERTICES;
+    ArenaVector<glm::vec3> rangeMin(ranges, vertices[0].Position, alloc);
+    ArenaVector<glm::vec3> rangeMax(ranges, vertices[0].Position, alloc);
+    pool.parallelFor(0, vertices.size(), MESH_GRAIN_VERTICES, [&](size_t first, size_t last) {
+        size_t range = first / MESH_GRAIN_VERTICES;
+        for (size_t i = first; i < last; i++) {
+            rangeMin[range] = glm::min(rangeMin[range], vertices[i].Position);
+            rangeMax[range] = glm::max(rangeMax[range], vertices[i].Position);
+        }
+    });
+    bounds.min = rangeMin[0];
+    bounds.max = rangeMax[0];
+    for (size_t range = 1; range < ranges; range++) {
+        bounds.min = glm::min(bounds.min, rangeMin[range]);
+        bounds.max = glm::max(bounds.max, rangeMax[range]);
     }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
     
-    // Set vertex attribute pointers
-    // Position attribute
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    
-    // Normal attribute
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    
-    // Texture coordinates attribute
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    ArenaVector<float> rangeRadiusSquared(ranges, 0.0f, alloc);
+    pool.parallelFor(0, vertices.size(), MESH_GRAIN_VERTICES, [&](size_t first, size_t last) {
+        float radiusSquared = 0.0f;
+        for (size_t i = first; i < last; i++) {
+            glm::vec3 offset = vertices[i].Position - bounds.center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        rangeRadiusSquared[first / MESH_GRAIN_VERTICES] = radiusSquared;
+    });
+    bounds.radius = std::sqrt(*std::max_element(rangeRadiusSquared.begin(), rangeRadiusSquared.end()));
+    bounds.empty = false;
+}
+
+bool Mesh::intersectRay(const glm::vec3& origin, const glm::vec3& direction, float& distance) const {
+    const std::vector<Vertex>& vertices = *this->vertices;
+    const std::vector<unsigned int>& indices = *this->indices;
     
-    // Unbind VAO
-    glBindVertexArray(0);
+    // Moller-Trumbore over every indexed triangle
+    bool hit = false;
+    distance = std::numeric_limits<float>::max();
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        glm::vec3 v0 = vertices[indices[i]].Position;
+        glm::vec3 v1 = vertices[indices[i+1]].Position;
+        glm::vec3 v2 = vertices[indices[i+2]].Position;
+        
+        glm::vec3 e1 = v1 - v0;
+        glm::vec3 e2 = v2 - v0;
+        glm::vec3 p = glm::cross(direction, e2);
+        float det = glm::dot(e1, p);
+        
+        // If ray is parallel to triangle
+        if (det < 1e-6 && det > -1e-6) {
+            continue;
+        }
+        
+        float invDet = 1.0f / det;
+        
+        // Barycentric coordinates
+        glm::vec3 t = origin - v0;
+        float u = glm::dot(t, p) * invDet;
+        if (u < 0.0f || u > 1.0f) {
+            continue;
+        }
+        
+        glm::vec3 q = glm::cross(t, e1);
+        float v = glm::dot(direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) {
+            continue;
+        }
+        
+        float dist = glm::dot(e2, q) * invDet;
+        if (dist > 1e-6 && dist < distance) {
+            distance = dist;
+            hit = true;
+        }
+    }
+    return hit;
 }
 
 // Model implementation
@@ -63,8 +115,12 @@ Model::~Model() {
 }
 
 bool Model::loadModel(const std::string& path) {
+    PROFILE_SCOPE("Model::loadModel");
+    
     // Clear existing data
     meshes.clear();
+    geometry.release();
+    meshBounds.assign({});
     
     // Save path
     this->path = path;
@@ -91,7 +147,54 @@ bool Model::loadModel(const std::string& path) {
     // Process the scene
     processNode(scene->mRootNode, scene);
     
-    return true;
+    return finishLoading();
+}
+
+bool Model::loadFromMeshData(const std::string& path, const std::vector<MeshData>& meshData) {
+    // Clear existing data
+    meshes.clear();
+    geometry.release();
+    meshBounds.assign({});
+    
+    this->path = path;
+    directory = path.substr(0, path.find_last_of('/'));
+    
+    // Meshes compute their bounds while they are built, so build them concurrently
+    std::vector<std::unique_ptr<Mesh>> built(meshData.size());
+    ThreadPool::shared().parallelFor(meshData.size(), [&](size_t i) {
+        if (!meshData[i].vertices.empty()) {
+            built[i] = std::make_unique<Mesh>(meshData[i].vertices, meshData[i].indices);
+        }
+    });
+    
+    meshes.reserve(meshData.size());
+    for (std::unique_ptr<Mesh>& mesh : built) {
+        if (mesh) {
+            meshes.push_back(std::move(*mesh));
+        }
+    }
+    
+    return !meshes.empty() && finishLoading();
+}
+
+bool Model::finishLoading() {
+    std::vector<Bounds> bounds;
+    bounds.reserve(meshes.size());
+    for (const Mesh& mesh : meshes) {
+        bounds.push_back(mesh.getBounds());
+    }
+    meshBounds.assign(bounds);
+    
+    // Pack all meshes into one set of GL buffers, created on the first draw
+    return geometry.assign(meshes);
+}
+
+void Model::clear() {
+    meshes.clear();
+    geometry.release();
+    meshBounds.assign({});
+    path.clear();
+    directory.clear();
 }
 
 bool Model::exportModel(const std::string& path) const {
@@ -102,27 +205,34 @@ bool Model::exportModel(const std::string& path) const {
     
     // Determine export format from path extension
     std::string extension = path.substr(path.find_last_of(".") + 1);
-    std::string formatId;
     
+    // OBJ and PLY are streamed straight from mesh data
     if (extension == "obj") {
-        formatId = "obj";
-    } else if (extension == "fbx") {
-        formatId = "fbx";
-    } else {
+        return MeshExport::writeOBJ(meshes, path);
+    } else if (extension == "ply") {
+        return MeshExport::writePLY(meshes, path);
+    } else if (extension != "fbx") {
         std::cerr << "Unsupported export format: " << extension << std::endl;
         return false;
     }
     
-    // Create exporter
+    // Other formats go through Assimp
     Assimp::Exporter exporter;
     
-    // Create a new scene
+    // The scene owns everything allocated below and frees it on destruction
     aiScene scene;
     scene.mRootNode = new aiNode();
     
+    // Assimp exporters expect at least one material
+    scene.mNumMaterials = 1;
+    scene.mMaterials = new aiMaterial*[1];
+    scene.mMaterials[0] = new aiMaterial();
+    
     // Initialize scene with meshes
     scene.mNumMeshes = static_cast<unsigned int>(meshes.size());
     scene.mMeshes = new aiMesh*[scene.mNumMeshes];
+    scene.mRootNode->mNumMeshes = scene.mNumMeshes;
+    scene.mRootNode->mMeshes = new unsigned int[scene.mNumMeshes];
     
     // Create meshes
     for (unsigned int i = 0; i < scene.mNumMeshes; i++) {
@@ -130,6 +240,7 @@ bool Model::exportModel(const std::string& path) const {
         
         scene.mMeshes[i] = new aiMesh();
         aiMesh* aiMesh = scene.mMeshes[i];
+        aiMesh->mMaterialIndex = 0;
         
         // Set vertices
         aiMesh->mNumVertices = static_cast<unsigned int>(mesh.getVertices().size());
@@ -163,31 +274,11 @@ bool Model::exportModel(const std::string& path) const {
         }
         
         // Add to scene
-        scene.mRootNode->mNumMeshes++;
-        scene.mRootNode->mMeshes = new unsigned int[scene.mRootNode->mNumMeshes];
-        scene.mRootNode->mMeshes[scene.mRootNode->mNumMeshes - 1] = i;
+        scene.mRootNode->mMeshes[i] = i;
     }
     
     // Export scene
-    aiReturn result = exporter.Export(&scene, formatId, path);
-    
-    // Clean up scene
-    for (unsigned int i = 0; i < scene.mNumMeshes; i++) {
-        delete[] scene.mMeshes[i]->mVertices;
-        delete[] scene.mMeshes[i]->mNormals;
-        delete[] scene.mMeshes[i]->mTextureCoords[0];
-        
-        for (unsigned int j = 0; j < scene.mMeshes[i]->mNumFaces; j++) {
-            delete[] scene.mMeshes[i]->mFaces[j].mIndices;
-        }
-        
-        delete[] scene.mMeshes[i]->mFaces;
-        delete scene.mMeshes[i];
-    }
-    
-    delete[] scene.mMeshes;
-    delete[] scene.mRootNode->mMeshes;
-    delete scene.mRootNode;
+    aiReturn result = exporter.Export(&scene, extension, path);
     
     if (result != aiReturn_SUCCESS) {
         std::cerr << "Failed to export model: " << exporter.GetErrorString() << std::endl;
@@ -198,15 +289,30 @@ bool Model::exportModel(const std::string& path) const {
 }
 
 void Model::processNode(aiNode* node, const aiScene* scene) {
-    // Process meshes in this node
+    // Gather meshes in node order, then convert them on all cores
+    std::vector<aiMesh*> sceneMeshes;
+    collectMeshes(node, scene, sceneMeshes);
+    
+    std::vector<std::unique_ptr<Mesh>> processed(sceneMeshes.size());
+    ThreadPool::shared().parallelFor(sceneMeshes.size(), [&](size_t i) {
+        processed[i] = std::make_unique<Mesh>(processMesh(sceneMeshes[i], scene));
+    });
+    
+    meshes.reserve(meshes.size() + processed.size());
+    for (std::unique_ptr<Mesh>& mesh : processed) {
+        meshes.push_back(std::move(*mesh));
+    }
+}
+
+void Model::collectMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& out) {
+    // Meshes in this node
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        out.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
     
-    // Process child nodes
+    // Child nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene);
+        collectMeshes(node->mChildren[i], scene, out);
     }
 }
 
@@ -214,41 +320,45 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     
-    // Process vertices
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
-        
-        // Position
-        vertex.Position.x = mesh->mVertices[i].x;
-        vertex.Position.y = mesh->mVertices[i].y;
-        vertex.Position.z = mesh->mVertices[i].z;
-        
-        // Normal
-        if (mesh->HasNormals()) {
-            vertex.Normal.x = mesh->mNormals[i].x;
-            vertex.Normal.y = mesh->mNormals[i].y;
-            vertex.Normal.z = mesh->mNormals[i].z;
-        }
-        
-        // Texture coordinates
-        if (mesh->mTextureCoords[0]) {
-            vertex.TexCoords.x = mesh->mTextureCoords[0][i].x;
-            vertex.TexCoords.y = mesh->mTextureCoords[0][i].y;
-        } else {
-            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+    // Process vertices, a range per task for large meshes
+    vertices.resize(mesh->mNumVertices);
+    ThreadPool::shared().parallelFor(0, mesh->mNumVertices, MESH_GRAIN_VERTICES, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            Vertex& vertex = vertices[i];
+            
+            // Position
+            vertex.Position.x = mesh->mVertices[i].x;
+            vertex.Position.y = mesh->mVertices[i].y;
+            vertex.Position.z = mesh->mVertices[i].z;
+            
+            // Normal
+            if (mesh->HasNormals()) {
+                vertex.Normal.x = mesh->mNormals[i].x;
+                vertex.Normal.y = mesh->mNormals[i].y;
+                vertex.Normal.z = mesh->mNormals[i].z;
+            }
+            
+            // Texture coordinates
+            if (mesh->mTextureCoords[0]) {
+                vertex.TexCoords.x = mesh->mTextureCoords[0][i].x;
+                vertex.TexCoords.y = mesh->mTextureCoords[0][i].y;
+            } else {
+                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            }
         }
-        
-        vertices.push_back(vertex);
-    }
+    });
     
     // Process indices
+    size_t indexCount = 0;
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; j++) {
-            indices.push_back(face.mIndices[j]);
-        }
+        indexCount += mesh->mFaces[i].mNumIndices;
+    }
+    indices.reserve(indexCount);
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        const aiFace& face = mesh->mFaces[i];
+        indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
     }
     
-    // Create mesh
-    return Mesh(vertices, indices);
+    // Create mesh; the vectors become its geometry
+    return Mesh(std::move(vertices), std::move(indices));
 }
@@ -2,6 +2,9 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include "culling.h"
+#include "geometry_buffer.h"
 #include <glm/glm.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -14,32 +17,39 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
-// Mesh class
+// Mesh class. Geometry is immutable and shared between copies; the GL
+// buffers of all meshes live in the model's GeometryBuffer.
 class Mesh {
 public:
-    Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
-    ~Mesh();
+    // Vectors moved in become the mesh's geometry without a copy
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
     
     // Getters
-    unsigned int getVAO() const { return VAO; }
-    bool hasIndices() const { return !indices.empty(); }
-    size_t getIndicesCount() const { return indices.size(); }
-    size_t getVerticesCount() const { return vertices.size(); }
-    const std::vector<Vertex>& getVertices() const { return vertices; }
-    const std::vector<unsigned int>& getIndices() const { return indices; }
+    bool hasIndices() const { return !indices->empty(); }
+    size_t getIndicesCount() const { return indices->size(); }
+    size_t getVerticesCount() const { return vertices->size(); }
+    const std::vector<Vertex>& getVertices() const { return *vertices; }
+    const std::vector<unsigned int>& getIndices() const { return *indices; }
+    const Bounds& getBounds() const { return bounds; }
+    
+    // Nearest triangle the ray hits, as distance along the (unit) direction
+    bool intersectRay(const glm::vec3& origin, const glm::vec3& direction, float& distance) const;
+    
+    // Share the (immutable) geometry, e.g. with a background save
+    std::shared_ptr<const std::vector<Vertex>> shareVertices() const { return vertices; }
+    std::shared_ptr<const std::vector<unsigned int>> shareIndices() const { return indices; }
     
 private:
     // Mesh data
+    std::shared_ptr<const std::vector<Vertex>> vertices;
+    std::shared_ptr<const std::vector<unsigned int>> indices;
+    Bounds bounds;
+};
+
+// Raw geometry of one mesh, used to rebuild a model without re-importing it
+struct MeshData {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    
-    // OpenGL objects
-    unsigned int VAO;
-    unsigned int VBO;
-    unsigned int EBO;
-    
-    // Set up mesh
-    void setupMesh();
 };
 
 // Model class
@@ -51,21 +61,35 @@ public:
     // Load model from file
     bool loadModel(const std::string& path);
     
+    // Build model from already decoded geometry (e.g. stored in a project file)
+    bool loadFromMeshData(const std::string& path, const std::vector<MeshData>& meshData);
+    
+    // Drop all meshes and their GL buffers
+    void clear();
+    
     // Export model to file
     bool exportModel(const std::string& path) const;
     
     // Getters
     const std::vector<Mesh>& getMeshes() const { return meshes; }
+    const GeometryBuffer& getGeometry() const { return geometry; }
+    const BoundsList& getMeshBounds() const { return meshBounds; }
     const std::string& getPath() const { return path; }
     bool isLoaded() const { return !meshes.empty(); }
     
 private:
     // Model data
     std::vector<Mesh> meshes;
+    GeometryBuffer geometry;
+    BoundsList meshBounds;
     std::string path;
     std::string directory;
     
+    // Hand the meshes to the geometry buffer and gather their bounds
+    bool finishLoading();
+    
     // Process Assimp scene
     void processNode(aiNode* node, const aiScene* scene);
+    static void collectMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& out);
     Mesh processMesh(aiMesh* mesh, const aiScene* scene);
 };
@@ -72,6 +72,7 @@ void BrushTool::update(const glm::vec3& position) {
 void BrushTool::end() {
     painting = false;
     currentLayer = nullptr;
+    strokeArena.reset();
 }
 
 // EraserTool implementation
@@ -121,23 +122,60 @@ void EraserTool::update(const glm::vec3& position) {
 void EraserTool::end() {
     painting = false;
     currentLayer = nullptr;
+    strokeArena.reset();
 }
 
 // FillTool implementation
 FillTool::FillTool() 
-    : PaintTool("Fill", "fill"), tolerance(0.1f) {
+    : PaintTool("Fill", "fill"), tolerance(0.1f), sourceWidth(0), sourceHeight(0), sourceChannels(0), seedX(0),
+      seedY(0), fillTolerance(0.0f) {
 }
 
 void FillTool::begin(Layer* layer, const glm::vec3& position) {
+    if (beginDeferred(layer, position)) {
+        runDeferred();
+        commitDeferred();
+    }
+}
+
+bool FillTool::beginDeferred(Layer* layer, const glm::vec3& position) {
     if (!layer) {
-        return;
+        return false;
     }
     
     currentLayer = layer;
     
-    // Fill at position
+    // Fill at position, with the settings of this moment
     glm::vec2 texCoord = Utils::worldToTextureCoord(position, layer->getWidth(), layer->getHeight());
-    layer->fill(texCoord.x, texCoord.y, color, tolerance);
+    const Texture* texture = layer->getTexture();
+    source = texture->sharePixels();
+    sourceWidth = texture->getWidth();
+    sourceHeight = texture->getHeight();
+    sourceChannels = texture->getChannels();
+    seedX = static_cast<int>(texCoord.x);
+    seedY = static_cast<int>(texCoord.y);
+    fillColor = color;
+    fillTolerance = tolerance;
+    return true;
+}
+
+void FillTool::runDeferred() {
+    if (!source) {
+        return;
+    }
+    
+    Texture::planFill(*source, sourceWidth, sourceHeight, sourceChannels, seedX, seedY, fillColor, fillTolerance,
+                      plan, strokeArena);
+    
+    // Drop the copy, so writing the fill does not duplicate the pixels
+    source.reset();
+}
+
+void FillTool::commitDeferred() {
+    if (currentLayer && currentLayer->getWidth() == sourceWidth && currentLayer->getHeight() == sourceHeight) {
+        currentLayer->applyFill(plan);
+    }
+    plan = FillPlan();
 }
 
 void FillTool::update(const glm::vec3& position) {
@@ -146,4 +184,6 @@ void FillTool::update(const glm::vec3& position) {
 
 void FillTool::end() {
     currentLayer = nullptr;
+    source.reset();
+    strokeArena.reset();
 }
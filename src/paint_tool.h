@@ -18,6 +18,17 @@ public:
     // End painting
     virtual void end() = 0;
     
+    // Tools with a slow begin() can split it for PaintWorker: beginDeferred()
+    // runs with the layers locked and returns true if work is left,
+    // runDeferred() then runs unlocked and commitDeferred() locked again.
+    // By default everything happens in begin().
+    virtual bool beginDeferred(Layer* layer, const glm::vec3& position) { begin(layer, position); return false; }
+    virtual void runDeferred() {}
+    virtual void commitDeferred() {}
+    
+    // Layer of the stroke in progress, null between strokes
+    Layer* getLayer() const { return currentLayer; }
+    
     // Getters
     const std::string& getName() const { return name; }
     const std::string& getIconName() const { return iconName; }
@@ -39,6 +50,9 @@ protected:
     glm::vec3 lastPosition;
     bool painting;
     
+    // Temporaries that last until the stroke ends; end() resets it
+    Arena strokeArena;
+    
     // Tool parameters
     float size;
     float hardness;
@@ -77,9 +91,25 @@ public:
     void update(const glm::vec3& position) override;
     void end() override;
     
+    // The flood search runs on a shared copy of the layer's pixels
+    bool beginDeferred(Layer* layer, const glm::vec3& position) override;
+    void runDeferred() override;
+    void commitDeferred() override;
+    
     float getTolerance() const { return tolerance; }
     void setTolerance(float tolerance) { this->tolerance = tolerance; }
     
 private:
     float tolerance;
+    
+    // Fill prepared by beginDeferred()
+    std::shared_ptr<const std::vector<unsigned char>> source;
+    int sourceWidth;
+    int sourceHeight;
+    int sourceChannels;
+    int seedX;
+    int seedY;
+    glm::vec4 fillColor;
+    float fillTolerance;
+    FillPlan plan;
 };
@@ -0,0 +1,244 @@
+#include "paint_worker.h"
+#include "paint_tool.h"
+#include "project.h"
+#include "profiler.h"
+#include <algorithm>
+
+void LatencyWindow::add(double milliseconds) {
+    samples[next] = static_cast<float>(milliseconds);
+    next = (next + 1) % SIZE;
+    filled = std::min(filled + 1, SIZE);
+}
+
+double LatencyWindow::average() const {
+    if (filled == 0) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < filled; i++) {
+        sum += samples[i];
+    }
+    return sum / static_cast<double>(filled);
+}
+
+double LatencyWindow::maximum() const {
+    if (filled == 0) {
+        return 0.0;
+    }
+    return *std::max_element(samples.begin(), samples.begin() + filled);
+}
+
+PaintWorker::PaintWorker(Project& project, std::function<void()> onPainted)
+    : project(project), onPainted(std::move(onPainted)), sleeping(false), stopping(false), inFlight(false),
+      activeTool(nullptr), hasFrame(false) {
+    thread = std::thread(&PaintWorker::run, this);
+}
+
+PaintWorker::~PaintWorker() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_one();
+    thread.join();
+}
+
+void PaintWorker::beginStroke(PaintTool* tool, const glm::vec3& position, Clock::time_point inputTime) {
+    PaintCommand command;
+    command.type = PaintCommand::BEGIN_STROKE;
+    command.tool = tool;
+    command.position = position;
+    command.inputTime = inputTime;
+    push(command);
+}
+
+void PaintWorker::continueStroke(const glm::vec3& position, Clock::time_point inputTime) {
+    PaintCommand command;
+    command.type = PaintCommand::CONTINUE_STROKE;
+    command.position = position;
+    command.inputTime = inputTime;
+    push(command);
+}
+
+void PaintWorker::endStroke(Clock::time_point inputTime) {
+    PaintCommand command;
+    command.type = PaintCommand::END_STROKE;
+    command.inputTime = inputTime;
+    push(command);
+}
+
+void PaintWorker::push(const PaintCommand& command) {
+    while (!queue.push(command)) {
+        std::this_thread::yield();
+    }
+
+    // Pairs with the fence in waitForWork(): either the worker sees the
+    // command before sleeping, or this sees it sleeping and wakes it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCondition.notify_one();
+    }
+}
+
+std::unique_lock<std::mutex> PaintWorker::lock() {
+    {
+        std::unique_lock<std::mutex> wait(wakeMutex);
+        drainedCondition.wait(wait, [this] { return queue.empty() && !inFlight; });
+    }
+    return std::unique_lock<std::mutex>(layerMutex);
+}
+
+std::unique_lock<std::mutex> PaintWorker::lockForDrawing() {
+    {
+        std::unique_lock<std::mutex> wait(wakeMutex);
+        drainedCondition.wait(wait, [this] { return queue.empty(); });
+    }
+
+    // A command taken from the queue is taken with the layer lock held, so
+    // this waits for it to finish or to unlock for its search
+    return std::unique_lock<std::mutex>(layerMutex);
+}
+
+bool PaintWorker::isBusy() {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    return inFlight;
+}
+
+bool PaintWorker::waitForWork() {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wakeCondition.wait(lock, [this] { return stopping || !queue.empty(); });
+    sleeping.store(false, std::memory_order_relaxed);
+
+    // Queued commands still run when stopping, so open strokes end cleanly
+    return !queue.empty();
+}
+
+void PaintWorker::run() {
+    PROFILE_THREAD_NAME("Paint worker");
+    
+    std::unique_lock<std::mutex> layers(layerMutex, std::defer_lock);
+    while (true) {
+        layers.lock();
+        PaintCommand command;
+        {
+            // Taking a command marks it in flight in the same step, for lock()
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            inFlight = queue.pop(command);
+            if (inFlight && queue.empty()) {
+                drainedCondition.notify_all();
+            }
+        }
+        if (!inFlight) {
+            layers.unlock();
+            if (!waitForWork()) {
+                break;
+            }
+            continue;
+        }
+
+        execute(command, layers);
+        layers.unlock();
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            inFlight = false;
+            drainedCondition.notify_all();
+        }
+
+        Clock::time_point finished = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            std::chrono::duration<double, std::milli> elapsed = finished - command.inputTime;
+            latency.inputToPaint.add(elapsed.count());
+            latency.commands++;
+            finishedInputs.push_back(command.inputTime);
+        }
+        if (onPainted) {
+            onPainted();
+        }
+    }
+
+    // Strokes still open when the queue ran dry
+    layers.lock();
+    finishStroke();
+}
+
+void PaintWorker::execute(const PaintCommand& command, std::unique_lock<std::mutex>& layers) {
+    PROFILE_SCOPE("PaintWorker::execute");
+    
+    // A stroke whose layer was removed meanwhile ends here
+    if (activeTool && !project.hasLayer(activeTool->getLayer())) {
+        finishStroke();
+    }
+
+    switch (command.type) {
+        case PaintCommand::BEGIN_STROKE: {
+            finishStroke();
+            Layer* layer = project.getCurrentLayer();
+            if (!layer || !command.tool) {
+                break;
+            }
+
+            project.beginEdit(command.tool->getName());
+            activeTool = command.tool;
+            if (activeTool->beginDeferred(layer, command.position)) {
+                // The slow part runs unlocked, so frames keep being drawn
+                layers.unlock();
+                activeTool->runDeferred();
+                layers.lock();
+                if (project.hasLayer(layer)) {
+                    activeTool->commitDeferred();
+                }
+            }
+            break;
+        }
+        case PaintCommand::CONTINUE_STROKE:
+            if (activeTool) {
+                activeTool->update(command.position);
+            }
+            break;
+        case PaintCommand::END_STROKE:
+            finishStroke();
+            break;
+    }
+}
+
+void PaintWorker::finishStroke() {
+    if (!activeTool) {
+        return;
+    }
+
+    activeTool->end();
+    project.endEdit();
+    activeTool = nullptr;
+}
+
+void PaintWorker::beginFrame() {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    frameInputs.insert(frameInputs.end(), finishedInputs.begin(), finishedInputs.end());
+    finishedInputs.clear();
+}
+
+void PaintWorker::endFrame(bool backToBack) {
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    for (const Clock::time_point& input : frameInputs) {
+        std::chrono::duration<double, std::milli> elapsed = now - input;
+        latency.inputToScreen.add(elapsed.count());
+    }
+    frameInputs.clear();
+
+    if (hasFrame && backToBack) {
+        std::chrono::duration<double, std::milli> interval = now - lastFrameTime;
+        latency.frameInterval.add(interval.count());
+    }
+    lastFrameTime = now;
+    hasFrame = true;
+}
+
+PaintLatency PaintWorker::getLatency() const {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return latency;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "spsc_queue.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+class PaintTool;
+class Project;
+
+// Recent durations in milliseconds
+class LatencyWindow {
+public:
+    void add(double milliseconds);
+    size_t count() const { return filled; }
+    double average() const;
+    double maximum() const;
+
+private:
+    static constexpr size_t SIZE = 120;
+    std::array<float, SIZE> samples{};
+    size_t next = 0;
+    size_t filled = 0;
+};
+
+struct PaintLatency {
+    LatencyWindow inputToPaint;     // input event until its command has run
+    LatencyWindow inputToScreen;    // input event until the first frame showing it
+    LatencyWindow frameInterval;    // between frames drawn back to back
+    uint64_t commands = 0;
+};
+
+// One step of a stroke, queued by the input callbacks
+struct PaintCommand {
+    enum Type : uint8_t {
+        BEGIN_STROKE,
+        CONTINUE_STROKE,
+        END_STROKE
+    };
+
+    Type type = END_STROKE;
+    PaintTool* tool = nullptr;
+    glm::vec3 position;
+    std::chrono::steady_clock::time_point inputTime;
+};
+
+// Runs the paint tools on a thread of their own, so a slow fill or a large
+// brush holds up neither input handling nor drawing.
+//
+// The input callbacks push stroke commands into a lock-free single-producer/
+// single-consumer ring, and the worker runs them in order on the project's
+// current layer. Layer data, tool settings and the undo history are shared
+// with the main thread under one mutex: the worker holds it while a command
+// runs (except for the search of a fill), and the main thread holds it while
+// it updates and draws a frame. Edits wait for the whole command, so they
+// never land between a fill's search and its commit; frames only wait for
+// the locked parts. Painted tiles reach the GPU through their tile stamps,
+// which the renderer already uploads by.
+class PaintWorker {
+public:
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+
+    // onPainted runs on the worker after each command, e.g. to wake the event loop
+    explicit PaintWorker(Project& project, std::function<void()> onPainted = nullptr);
+    ~PaintWorker();
+
+    PaintWorker(const PaintWorker&) = delete;
+    PaintWorker& operator=(const PaintWorker&) = delete;
+
+    // Producer (main thread) only; blocks only while the ring is full
+    void beginStroke(PaintTool* tool, const glm::vec3& position, std::chrono::steady_clock::time_point inputTime);
+    void continueStroke(const glm::vec3& position, std::chrono::steady_clock::time_point inputTime);
+    void endStroke(std::chrono::steady_clock::time_point inputTime);
+
+    // Wait until the worker has run every queued command, then lock the
+    // layers. Hold the lock while touching layers, tools or undo history.
+    std::unique_lock<std::mutex> lock();
+
+    // Like lock(), but lets a fill go on searching (isBusy()). The layers
+    // may then be read and drawn, not edited.
+    std::unique_lock<std::mutex> lockForDrawing();
+
+    // A command was taken and has not finished yet
+    bool isBusy();
+
+    // Frame bookkeeping for the latency metrics: beginFrame() with the lock
+    // held, before drawing; endFrame() once the frame is on screen. backToBack
+    // is false when the loop slept since the previous frame.
+    void beginFrame();
+    void endFrame(bool backToBack);
+
+    PaintLatency getLatency() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Project& project;
+    std::function<void()> onPainted;
+
+    SpscQueue<PaintCommand, QUEUE_CAPACITY> queue;
+
+    // Guards the project's layers (see lock())
+    std::mutex layerMutex;
+
+    // Sleeping while the queue is empty, and waiting for it to drain
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable drainedCondition;
+    std::atomic<bool> sleeping;
+    bool stopping;
+    bool inFlight;      // a command was taken and has not finished
+
+    // Worker state
+    PaintTool* activeTool;
+
+    // Metrics: input times of finished commands not yet drawn, of those in
+    // the frame being drawn, and when the last frame was shown
+    mutable std::mutex statsMutex;
+    PaintLatency latency;
+    std::vector<Clock::time_point> finishedInputs;
+    std::vector<Clock::time_point> frameInputs;
+    Clock::time_point lastFrameTime;
+    bool hasFrame;
+
+    std::thread thread;
+
+    void push(const PaintCommand& command);
+    void run();
+    bool waitForWork();
+    void execute(const PaintCommand& command, std::unique_lock<std::mutex>& layers);
+    void finishStroke();
+};
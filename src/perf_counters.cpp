@@ -0,0 +1,54 @@
+#include "perf_counters.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace PerfCounters {
+    namespace {
+        // Written by one thread only, so adding needs no read-modify-write
+        struct alignas(64) ThreadCounters {
+            std::array<std::atomic<uint64_t>, COUNTER_COUNT> values{};
+        };
+
+        // Counters outlive their threads, so totals never go backwards
+        struct Registry {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<ThreadCounters>> threads;
+        };
+
+        Registry& registry() {
+            static Registry instance;
+            return instance;
+        }
+
+        thread_local std::shared_ptr<ThreadCounters> localCounters;
+
+        ThreadCounters& threadCounters() {
+            if (!localCounters) {
+                localCounters = std::make_shared<ThreadCounters>();
+                Registry& all = registry();
+                std::lock_guard<std::mutex> lock(all.mutex);
+                all.threads.push_back(localCounters);
+            }
+            return *localCounters;
+        }
+    }
+
+    void add(Counter counter, uint64_t amount) {
+        std::atomic<uint64_t>& value = threadCounters().values[counter];
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    Totals read() {
+        Totals totals{};
+        Registry& all = registry();
+        std::lock_guard<std::mutex> lock(all.mutex);
+        for (const auto& thread : all.threads) {
+            for (size_t i = 0; i < COUNTER_COUNT; i++) {
+                totals[i] += thread->values[i].load(std::memory_order_relaxed);
+            }
+        }
+        return totals;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Event counters behind the Performance panel. Each thread adds to a cache
+// line of its own with relaxed atomics, so counting costs about as much as
+// a plain increment; reading sums the lines of all threads.
+namespace PerfCounters {
+    enum Counter {
+        BRUSH_DABS,         // brush and eraser stamps
+        UPLOADED_BYTES,     // texture and buffer data handed to GL
+        PICKS,
+        PICK_NANOSECONDS,
+        TASKS,              // thread pool tasks run
+        TASK_NANOSECONDS,   // time pool workers spent running tasks
+        COUNTER_COUNT
+    };
+
+    using Totals = std::array<uint64_t, COUNTER_COUNT>;
+
+    void add(Counter counter, uint64_t amount = 1);
+
+    // Totals over all threads since startup
+    Totals read();
+}
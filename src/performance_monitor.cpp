@@ -0,0 +1,59 @@
+#include "performance_monitor.h"
+#include "project.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+PerformanceMonitor::PerformanceMonitor()
+    : frameRing{}, nextFrame(0), framesSeen(0), lastTotals(PerfCounters::read()),
+      lastTime(std::chrono::steady_clock::now()) {
+}
+
+void PerformanceMonitor::endFrame(double frameMilliseconds) {
+    using namespace PerfCounters;
+
+    // Frame time history, unrolled oldest first for plotting
+    frameRing[nextFrame] = static_cast<float>(frameMilliseconds);
+    nextFrame = (nextFrame + 1) % PerformanceStats::HISTORY;
+    framesSeen = std::min(framesSeen + 1, PerformanceStats::HISTORY);
+
+    float sum = 0.0f;
+    stats.frameMax = 0.0f;
+    size_t first = (nextFrame + PerformanceStats::HISTORY - framesSeen) % PerformanceStats::HISTORY;
+    stats.frameTimes.fill(0.0f);
+    for (size_t i = 0; i < framesSeen; i++) {
+        float time = frameRing[(first + i) % PerformanceStats::HISTORY];
+        stats.frameTimes[PerformanceStats::HISTORY - framesSeen + i] = time;
+        sum += time;
+        stats.frameMax = std::max(stats.frameMax, time);
+    }
+    stats.frameAverage = sum / static_cast<float>(framesSeen);
+
+    // Counter deltas since the previous frame
+    Totals totals = read();
+    auto delta = [&](Counter counter) { return totals[counter] - lastTotals[counter]; };
+    stats.dabs = delta(BRUSH_DABS);
+    stats.uploadedBytes = delta(UPLOADED_BYTES);
+    stats.tasks = delta(TASKS);
+    if (delta(PICKS) > 0) {
+        stats.pickMilliseconds = static_cast<double>(delta(PICK_NANOSECONDS)) / delta(PICKS) / 1e6;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    double wallNanoseconds = std::chrono::duration<double, std::nano>(now - lastTime).count();
+    stats.jobThreads = ThreadPool::shared().getThreadCount();
+    if (wallNanoseconds > 0.0 && stats.jobThreads > 0) {
+        stats.jobUtilization = std::min(1.0, delta(TASK_NANOSECONDS) / (wallNanoseconds * stats.jobThreads));
+    }
+    lastTotals = totals;
+    lastTime = now;
+}
+
+void PerformanceMonitor::sampleMemory(Project& project) {
+    stats.layers.clear();
+    for (const auto& layer : project.getLayers()) {
+        stats.layers.push_back({ layer->getName(), layer->getResidentBytes() });
+    }
+    UndoHistory& undo = project.getUndoHistory();
+    stats.undoBytes = undo.getMemoryUsage();
+    stats.undoSpilledBytes = undo.getSpilledBytes();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "memory_budget.h"
+#include "perf_counters.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Project;
+
+// What the Performance panel shows, sampled once per drawn frame
+struct PerformanceStats {
+    static constexpr size_t HISTORY = 240;
+
+    // Time from the start of a frame until it was swapped, oldest first
+    std::array<float, HISTORY> frameTimes{};
+    float frameAverage = 0.0f;
+    float frameMax = 0.0f;
+
+    // Since the previous frame
+    uint64_t dabs = 0;
+    uint64_t uploadedBytes = 0;
+    uint64_t tasks = 0;
+    double jobUtilization = 0.0;    // 0..1 of the pool's worker time
+    size_t jobThreads = 0;
+
+    // Last pick that happened
+    double pickMilliseconds = 0.0;
+
+    // Gathered only while the panel is open
+    struct LayerMemory {
+        std::string name;
+        size_t bytes = 0;           // 0 while still in the project file
+    };
+    std::vector<LayerMemory> layers;
+    size_t undoBytes = 0;
+    uint64_t undoSpilledBytes = 0;
+    
+    // Per subsystem, every frame
+    MemoryReport memory;
+};
+
+class PerformanceMonitor {
+public:
+    PerformanceMonitor();
+
+    // Call once per drawn frame, after it was swapped
+    void endFrame(double frameMilliseconds);
+
+    // Layer and undo memory. This walks the project, so only do it while
+    // someone looks, with the layers locked.
+    void sampleMemory(Project& project);
+    
+    void setMemoryReport(const MemoryReport& report) { stats.memory = report; }
+
+    const PerformanceStats& getStats() const { return stats; }
+
+private:
+    PerformanceStats stats;
+    std::array<float, PerformanceStats::HISTORY> frameRing;
+    size_t nextFrame;
+    size_t framesSeen;
+    PerfCounters::Totals lastTotals;
+    std::chrono::steady_clock::time_point lastTime;
+};
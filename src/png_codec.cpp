@@ -0,0 +1,294 @@
+#include "png_codec.h"
+#include "file_writer.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+namespace PngCodec {
+    namespace {
+        // CRC-32 as used by PNG chunks
+        struct CrcTable {
+            uint32_t values[256];
+
+            CrcTable() {
+                for (uint32_t n = 0; n < 256; n++) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++) {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    values[n] = c;
+                }
+            }
+        };
+
+        uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size) {
+            static const CrcTable table;
+            crc = ~crc;
+            for (size_t i = 0; i < size; i++) {
+                crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        uint32_t adler32(const unsigned char* data, size_t size) {
+            const uint32_t MOD = 65521;
+            const size_t BLOCK = 5552;   // largest block that cannot overflow 32 bits
+            uint32_t a = 1;
+            uint32_t b = 0;
+            while (size > 0) {
+                size_t block = size < BLOCK ? size : BLOCK;
+                size -= block;
+                for (size_t i = 0; i < block; i++) {
+                    a += data[i];
+                    b += a;
+                }
+                data += block;
+                a %= MOD;
+                b %= MOD;
+            }
+            return (b << 16) | a;
+        }
+
+        void appendU32BE(std::vector<unsigned char>& out, uint32_t value) {
+            out.push_back(static_cast<unsigned char>(value >> 24));
+            out.push_back(static_cast<unsigned char>(value >> 16));
+            out.push_back(static_cast<unsigned char>(value >> 8));
+            out.push_back(static_cast<unsigned char>(value));
+        }
+
+        // Chunk data must already be at out[start + 8], with 8 bytes reserved before it
+        void finishChunk(std::vector<unsigned char>& out, size_t start, const char* type) {
+            uint32_t length = static_cast<uint32_t>(out.size() - start - 8);
+            unsigned char* header = &out[start];
+            header[0] = static_cast<unsigned char>(length >> 24);
+            header[1] = static_cast<unsigned char>(length >> 16);
+            header[2] = static_cast<unsigned char>(length >> 8);
+            header[3] = static_cast<unsigned char>(length);
+            std::memcpy(header + 4, type, 4);
+            appendU32BE(out, crc32(0, &out[start + 4], length + 4));
+        }
+
+        // Deflate bit writer (LSB first)
+        struct BitWriter {
+            std::vector<unsigned char>& out;
+            uint64_t bits;
+            int count;
+
+            explicit BitWriter(std::vector<unsigned char>& out) : out(out), bits(0), count(0) {}
+
+            void put(uint32_t value, int length) {
+                bits |= static_cast<uint64_t>(value) << count;
+                count += length;
+                while (count >= 8) {
+                    out.push_back(static_cast<unsigned char>(bits));
+                    bits >>= 8;
+                    count -= 8;
+                }
+            }
+
+            void flush() {
+                if (count > 0) {
+                    out.push_back(static_cast<unsigned char>(bits));
+                }
+                bits = 0;
+                count = 0;
+            }
+        };
+
+        uint32_t reverseBits(uint32_t code, int length) {
+            uint32_t result = 0;
+            for (int i = 0; i < length; i++) {
+                result = (result << 1) | ((code >> i) & 1);
+            }
+            return result;
+        }
+
+        // Fixed Huffman codes (RFC 1951, 3.2.6), pre-reversed for LSB-first output
+        struct FixedCodes {
+            uint16_t literal[288];
+            uint8_t literalLength[288];
+
+            // Length 3..258 -> symbol code plus extra bits, in one value
+            uint32_t match[259];
+            uint8_t matchLength[259];
+
+            FixedCodes() {
+                for (int s = 0; s < 288; s++) {
+                    uint32_t code;
+                    int length;
+                    if (s < 144) { code = 0x30 + s; length = 8; }
+                    else if (s < 256) { code = 0x190 + (s - 144); length = 9; }
+                    else if (s < 280) { code = s - 256; length = 7; }
+                    else { code = 0xC0 + (s - 280); length = 8; }
+                    literal[s] = static_cast<uint16_t>(reverseBits(code, length));
+                    literalLength[s] = static_cast<uint8_t>(length);
+                }
+
+                static const int BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                              35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+                static const int EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                               3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+                for (int length = 3; length <= 258; length++) {
+                    int index = 28;
+                    while (BASE[index] > length) {
+                        index--;
+                    }
+                    int symbol = 257 + index;
+                    match[length] = literal[symbol] | (static_cast<uint32_t>(length - BASE[index]) << literalLength[symbol]);
+                    matchLength[length] = static_cast<uint8_t>(literalLength[symbol] + EXTRA[index]);
+                }
+            }
+        };
+
+        // Single fixed-Huffman block with run-length matches only: a byte
+        // repeating the previous byte (distance 1) or the previous pixel
+        // (distance = bytes per pixel). After the Up filter, empty and flat
+        // areas of a paint layer become long runs, which is where the size
+        // goes, so this keeps most of the compression at a fraction of the cost.
+        void deflateRuns(const unsigned char* data, size_t size, int pixelBytes, std::vector<unsigned char>& out) {
+            static const FixedCodes codes;
+            const size_t MAX_MATCH = 258;
+
+            BitWriter writer(out);
+            writer.put(1, 1);   // final block
+            writer.put(1, 2);   // fixed Huffman
+
+            size_t i = 0;
+            while (i < size) {
+                size_t limit = size - i < MAX_MATCH ? size - i : MAX_MATCH;
+                size_t bestLength = 0;
+                int bestDistance = 0;
+
+                const int distances[2] = { 1, pixelBytes };
+                int candidates = pixelBytes > 1 ? 2 : 1;
+                for (int c = 0; c < candidates; c++) {
+                    int distance = distances[c];
+                    if (i < static_cast<size_t>(distance)) {
+                        break;
+                    }
+                    const unsigned char* p = data + i;
+                    const unsigned char* q = p - distance;
+                    size_t length = 0;
+                    while (length < limit && p[length] == q[length]) {
+                        length++;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = distance;
+                    }
+                }
+
+                if (bestLength >= 3) {
+                    writer.put(codes.match[bestLength], codes.matchLength[bestLength]);
+                    writer.put(reverseBits(bestDistance - 1, 5), 5);   // distances 1-4 need no extra bits
+                    i += bestLength;
+                } else {
+                    writer.put(codes.literal[data[i]], codes.literalLength[data[i]]);
+                    i++;
+                }
+            }
+
+            writer.put(codes.literal[256], codes.literalLength[256]);   // end of block
+            writer.flush();
+        }
+
+        bool encodeFast(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& png) {
+            static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+            static const unsigned char COLOR_TYPES[5] = { 0, 0, 4, 2, 6 };
+
+            size_t rowBytes = static_cast<size_t>(width) * channels;
+
+            // Up filter on every row (the row above the first counts as zero)
+            std::vector<unsigned char> filtered((rowBytes + 1) * height);
+            for (int y = 0; y < height; y++) {
+                const unsigned char* row = pixels + y * rowBytes;
+                unsigned char* dst = &filtered[y * (rowBytes + 1)];
+                dst[0] = 2;
+                if (y == 0) {
+                    std::memcpy(dst + 1, row, rowBytes);
+                } else {
+                    const unsigned char* above = row - rowBytes;
+                    for (size_t x = 0; x < rowBytes; x++) {
+                        dst[1 + x] = static_cast<unsigned char>(row[x] - above[x]);
+                    }
+                }
+            }
+
+            png.assign(SIGNATURE, SIGNATURE + 8);
+
+            size_t start = png.size();
+            png.resize(start + 8);
+            appendU32BE(png, static_cast<uint32_t>(width));
+            appendU32BE(png, static_cast<uint32_t>(height));
+            png.push_back(8);                       // bit depth
+            png.push_back(COLOR_TYPES[channels]);
+            png.push_back(0);                       // deflate
+            png.push_back(0);                       // adaptive filtering
+            png.push_back(0);                       // no interlace
+            finishChunk(png, start, "IHDR");
+
+            start = png.size();
+            png.resize(start + 8);
+            png.push_back(0x78);                    // zlib header, fastest compression
+            png.push_back(0x01);
+            deflateRuns(filtered.data(), filtered.size(), channels, png);
+            appendU32BE(png, adler32(filtered.data(), filtered.size()));
+            finishChunk(png, start, "IDAT");
+
+            start = png.size();
+            png.resize(start + 8);
+            finishChunk(png, start, "IEND");
+            return true;
+        }
+
+        void appendToVector(void* context, void* data, int size) {
+            std::vector<unsigned char>* png = static_cast<std::vector<unsigned char>*>(context);
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            png->insert(png->end(), bytes, bytes + size);
+        }
+    }
+
+    bool encode(const unsigned char* pixels, int width, int height, int channels, Mode mode,
+                std::vector<unsigned char>& png) {
+        if (width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+            return false;
+        }
+
+        if (mode == MODE_FAST) {
+            return encodeFast(pixels, width, height, channels, png);
+        }
+
+        png.clear();
+        return stbi_write_png_to_func(appendToVector, &png, width, height, channels, pixels, width * channels) != 0;
+    }
+
+    bool writeFile(const std::string& path, const unsigned char* pixels, int width, int height, int channels,
+                   Mode mode) {
+        std::vector<unsigned char> png;
+        if (!encode(pixels, width, height, channels, mode, png)) {
+            std::cerr << "Failed to encode PNG: " << path << std::endl;
+            return false;
+        }
+
+        return writeFileGather(path, { { png.data(), png.size() } });
+    }
+
+    bool readFile(const std::string& path, std::vector<unsigned char>& rgba, int& width, int& height) {
+        // Thread-local setting, so other loaders flipping their images do not
+        // affect this one and several files can be decoded at once
+        stbi_set_flip_vertically_on_load_thread(0);
+
+        int channels = 0;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (!data) {
+            std::cerr << "Failed to load image: " << path << std::endl;
+            return false;
+        }
+
+        rgba.assign(data, data + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(data);
+        return true;
+    }
+}
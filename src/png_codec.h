@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// PNG encoding and decoding for layer images.
+// All functions are thread-safe and never touch OpenGL, so layers can be
+// encoded and decoded on worker threads.
+namespace PngCodec {
+    enum Mode {
+        MODE_COMPACT,   // stb_image_write's zlib, smallest files
+        MODE_FAST       // single-pass run-length deflate, several times faster, somewhat larger
+    };
+
+    // Encode 8-bit pixels (1-4 channels, tightly packed rows) as PNG
+    bool encode(const unsigned char* pixels, int width, int height, int channels, Mode mode,
+                std::vector<unsigned char>& png);
+
+    // Encode and write to a file
+    bool writeFile(const std::string& path, const unsigned char* pixels, int width, int height, int channels,
+                   Mode mode);
+
+    // Decode a PNG (or any format stb_image reads) file to RGBA8, top row first
+    bool readFile(const std::string& path, std::vector<unsigned char>& rgba, int& width, int& height);
+}
@@ -0,0 +1,182 @@
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Profiler {
+    namespace {
+        struct Event {
+            const char* name;
+            uint64_t start;
+            uint64_t duration;
+        };
+
+        // Written by its thread only; the lock is uncontended except while
+        // a trace is being written
+        struct ThreadBuffer {
+            std::mutex mutex;
+            std::vector<Event> events;
+            size_t next = 0;
+            size_t count = 0;
+            uint32_t id = 0;
+            std::string name;
+        };
+
+        struct Registry {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+            uint32_t nextId = 1;
+        };
+
+        // Buffers outlive their threads, so a trace still shows finished threads
+        Registry& registry() {
+            static Registry instance;
+            return instance;
+        }
+
+        const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        std::atomic<bool> enabled(true);
+        thread_local std::shared_ptr<ThreadBuffer> localBuffer;
+
+        ThreadBuffer& threadBuffer() {
+            if (!localBuffer) {
+                auto buffer = std::make_shared<ThreadBuffer>();
+                buffer->events.resize(EVENTS_PER_THREAD);
+
+                Registry& all = registry();
+                std::lock_guard<std::mutex> lock(all.mutex);
+                buffer->id = all.nextId++;
+                buffer->name = "Thread " + std::to_string(buffer->id);
+                all.buffers.push_back(buffer);
+                localBuffer = buffer;
+            }
+            return *localBuffer;
+        }
+
+        void writeString(std::ostream& out, const std::string& text) {
+            out << '"';
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    out << '\\' << c;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    out << ' ';
+                } else {
+                    out << c;
+                }
+            }
+            out << '"';
+        }
+    }
+
+    uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - startTime).count());
+    }
+
+    void setEnabled(bool value) {
+        enabled.store(value, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void record(const char* name, uint64_t start, uint64_t end) {
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events[buffer.next] = { name, start, end - start };
+        buffer.next = (buffer.next + 1) % EVENTS_PER_THREAD;
+        buffer.count = std::min(buffer.count + 1, EVENTS_PER_THREAD);
+    }
+
+    void setThreadName(const std::string& name) {
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.name = name;
+    }
+
+    void clear() {
+        Registry& all = registry();
+        std::lock_guard<std::mutex> lock(all.mutex);
+        for (const auto& buffer : all.buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->next = 0;
+            buffer->count = 0;
+        }
+    }
+
+    bool writeChromeTrace(const std::string& path) {
+        // Copy the events first, so threads are held up only briefly
+        struct ThreadEvents {
+            uint32_t id;
+            std::string name;
+            std::vector<Event> events;
+        };
+        std::vector<ThreadEvents> threads;
+        {
+            Registry& all = registry();
+            std::lock_guard<std::mutex> lock(all.mutex);
+            for (const auto& buffer : all.buffers) {
+                std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+                ThreadEvents copy{ buffer->id, buffer->name, {} };
+                copy.events.reserve(buffer->count);
+                size_t first = (buffer->next + EVENTS_PER_THREAD - buffer->count) % EVENTS_PER_THREAD;
+                for (size_t i = 0; i < buffer->count; i++) {
+                    copy.events.push_back(buffer->events[(first + i) % EVENTS_PER_THREAD]);
+                }
+                threads.push_back(std::move(copy));
+            }
+        }
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "Failed to write trace: " << path << std::endl;
+            return false;
+        }
+
+        // Complete ("X") events in microseconds, plus thread names
+        size_t eventCount = 0;
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const ThreadEvents& thread : threads) {
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.id
+                << ",\"args\":{\"name\":";
+            writeString(out, thread.name);
+            out << "}}";
+            first = false;
+
+            for (const Event& event : thread.events) {
+                out << ",\n{\"name\":";
+                writeString(out, event.name);
+                out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.id << ",\"ts\":" << event.start / 1000 << '.'
+                    << (event.start % 1000) / 100 << ",\"dur\":" << event.duration / 1000 << '.'
+                    << (event.duration % 1000) / 100 << '}';
+            }
+            eventCount += thread.events.size();
+        }
+        out << "\n]}\n";
+
+        if (!out) {
+            std::cerr << "Failed to write trace: " << path << std::endl;
+            return false;
+        }
+        std::cout << "Wrote " << eventCount << " profiler events to " << path << std::endl;
+        return true;
+    }
+
+    std::string getTracePath() {
+        const char* value = std::getenv("PAINTER_TRACE");
+        return value && *value ? value : "painter_trace.json";
+    }
+
+    bool isTraceRequested() {
+        const char* value = std::getenv("PAINTER_TRACE");
+        return value && *value;
+    }
+}
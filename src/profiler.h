@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped timers for hot paths. PROFILE_SCOPE("name") records how long the
+// enclosing scope took into a ring buffer of the calling thread; the newest
+// events of every thread can be written as Chrome trace JSON, which Perfetto
+// and chrome://tracing load. Builds without PAINTER_PROFILING (CMake option
+// of the same name) compile the macros to nothing.
+//
+// If PAINTER_TRACE names a file, the trace is written there at exit.
+namespace Profiler {
+    // Events kept per thread; older ones are overwritten
+    constexpr size_t EVENTS_PER_THREAD = 32768;
+
+    // Nanoseconds since the profiler started
+    uint64_t now();
+
+    // Recording can be paused at run time; it is on by default
+    void setEnabled(bool enabled);
+    bool isEnabled();
+
+    // name must outlive the profiler, e.g. a string literal
+    void record(const char* name, uint64_t start, uint64_t end);
+
+    // Label the calling thread in the trace
+    void setThreadName(const std::string& name);
+
+    // Drop all recorded events
+    void clear();
+
+    bool writeChromeTrace(const std::string& path);
+
+    // PAINTER_TRACE, or painter_trace.json
+    std::string getTracePath();
+
+    // Written at exit when PAINTER_TRACE is set
+    bool isTraceRequested();
+
+    class Scope {
+    public:
+        explicit Scope(const char* name)
+            : name(name), active(isEnabled()), start(active ? now() : 0) {}
+        ~Scope() {
+            if (active) {
+                record(name, start, now());
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        bool active;
+        uint64_t start;
+    };
+}
+
+#if defined(PAINTER_PROFILING) && PAINTER_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) Profiler::setThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,162 @@
+#include "program_cache.h"
+#include "file_writer.h"
+#include <glad/glad.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+    // Entry file: header followed by the binary
+    struct EntryHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;
+        uint32_t size;
+    };
+
+    const char ENTRY_MAGIC[4] = {'P', 'G', 'M', 'B'};
+    const uint32_t ENTRY_VERSION = 1;
+
+    // 64-bit FNV-1a, chained through the parts of the key
+    uint64_t hashBytes(uint64_t hash, const std::string& bytes) {
+        for (unsigned char c : bytes) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        // Separator, so ("ab", "c") and ("a", "bc") differ
+        return (hash ^ 0xFFu) * 1099511628211ull;
+    }
+
+    std::string glString(GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+}
+
+ProgramCache::ProgramCache(const std::string& directory)
+    : directory(directory), enabled(false) {
+    driver = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (directory.empty() || formats <= 0) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Shader cache disabled, cannot create " << directory << ": " << error.message() << std::endl;
+        return;
+    }
+    enabled = true;
+}
+
+std::string ProgramCache::defaultDirectory() {
+    std::filesystem::path base;
+    if (const char* local = std::getenv("LOCALAPPDATA")) {
+        base = local;
+    } else if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        base = xdg;
+    } else if (const char* home = std::getenv("HOME")) {
+        base = std::filesystem::path(home) / ".cache";
+    } else {
+        std::error_code error;
+        base = std::filesystem::temp_directory_path(error);
+        if (error) {
+            return "";
+        }
+    }
+    return (base / "3DModelPainter" / "shaders").string();
+}
+
+uint64_t ProgramCache::computeKey(const std::string& vertexSource, const std::string& fragmentSource) const {
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashBytes(hash, driver);
+    hash = hashBytes(hash, vertexSource);
+    return hashBytes(hash, fragmentSource);
+}
+
+std::string ProgramCache::entryPath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool ProgramCache::load(uint64_t key, unsigned int program) const {
+    if (!enabled) {
+        return false;
+    }
+
+    std::ifstream file(entryPath(key), std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    std::streamoff fileSize = file.tellg();
+    EntryHeader header;
+    if (!file.seekg(0) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+    if (std::memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) != 0 || header.version != ENTRY_VERSION ||
+        header.key != key) {
+        return false;
+    }
+
+    // A truncated or corrupt entry is a miss, whatever size it claims
+    if (fileSize != static_cast<std::streamoff>(sizeof(header) + header.size)) {
+        return false;
+    }
+    std::vector<char> binary(header.size);
+    if (!file.read(binary.data(), static_cast<std::streamsize>(binary.size()))) {
+        return false;
+    }
+
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+bool ProgramCache::store(uint64_t key, unsigned int program) const {
+    if (!enabled) {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return false;
+    }
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) {
+        return false;
+    }
+
+    EntryHeader header;
+    std::memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+    header.version = ENTRY_VERSION;
+    header.key = key;
+    header.format = format;
+    header.size = static_cast<uint32_t>(written);
+
+    // Write next to the entry and rename, so a reader never sees half a file
+    std::string path = entryPath(key);
+    std::string temporary = path + ".tmp";
+    if (!writeFileGather(temporary, {{&header, sizeof(header)}, {binary.data(), header.size}})) {
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries (glGetProgramBinary). Entries are
+// keyed by a hash of the driver (vendor, renderer, version) and the shader
+// sources, so a driver update or an edited shader is simply a miss. Must be
+// created and used with a current GL context.
+class ProgramCache {
+public:
+    // An empty directory, or a driver without binary formats, disables the cache
+    explicit ProgramCache(const std::string& directory = defaultDirectory());
+
+    bool isEnabled() const { return enabled; }
+
+    uint64_t computeKey(const std::string& vertexSource, const std::string& fragmentSource) const;
+
+    // Load a stored binary into program. Returns false on a miss or if the
+    // driver rejects the binary; the program can then be linked normally.
+    bool load(uint64_t key, unsigned int program) const;
+
+    // Store the binary of a linked program (link it with
+    // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set)
+    bool store(uint64_t key, unsigned int program) const;
+
+    // <user cache directory>/3DModelPainter/shaders
+    static std::string defaultDirectory();
+
+private:
+    std::string directory;
+    std::string driver;
+    bool enabled;
+
+    std::string entryPath(uint64_t key) const;
+};
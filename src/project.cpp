@@ -1,11 +1,22 @@
 #include "project.h"
+#include "gltf_export.h"
+#include "project_file.h"
+#include "project_snapshot.h"
+#include "png_codec.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 
 Project::Project() 
-    : currentLayerIndex(0), textureWidth(1024), textureHeight(1024) {
+    : currentLayerIndex(0), textureWidth(1024), textureHeight(1024), pngMode(PngCodec::MODE_COMPACT),
+      structureStamp(Utils::nextChangeStamp()) {
 }
 
 Project::~Project() {
@@ -36,11 +47,91 @@ bool Project::exportModel(const std::string& path) const {
         return false;
     }
     
+    // GLB carries the flattened layers as an embedded texture
+    std::string extension = std::filesystem::path(path).extension().string();
+    if (extension == ".glb") {
+        std::vector<unsigned char> rgba;
+        flattenLayers(rgba, glm::vec4(0.8f, 0.8f, 0.8f, 1.0f)); // Base color of the basic shader
+        return GltfExport::writeGLB(model.getMeshes(), rgba.data(), textureWidth, textureHeight, path);
+    }
+    
     return model.exportModel(path);
 }
 
+void Project::flattenLayers(std::vector<unsigned char>& rgba, const glm::vec4& background) const {
+    const float color[4] = {background.r, background.g, background.b, background.a};
+    Arena::Scope scope(Arena::frame());
+    Compositor::flatten(getCompositeLayers(scope.get()), textureWidth, textureHeight, rgba, color);
+}
+
+const Compositor& Project::updateComposite() const {
+    Arena::Scope scope(Arena::frame());
+    compositor.update(getCompositeLayers(scope.get()), currentLayerIndex, textureWidth, textureHeight);
+    return compositor;
+}
+
+size_t Project::getCacheMemory() const {
+    size_t bytes = compositor.getMemoryUsage();
+    for (const auto& layer : layers) {
+        LayerTileCache& cache = *layer->getTileCache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        for (const LayerTileCache::Entry& entry : cache.tiles) {
+            bytes += entry.bytes ? entry.bytes->size() : 0;
+        }
+    }
+    return bytes;
+}
+
+void Project::releaseTileCaches() {
+    // Saves running meanwhile keep the entries they already looked up
+    for (const auto& layer : layers) {
+        LayerTileCache& cache = *layer->getTileCache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        std::vector<LayerTileCache::Entry>().swap(cache.tiles);
+    }
+}
+
+void Project::unloadHiddenLayers() {
+    for (size_t i = 0; i < layers.size(); i++) {
+        if (!layers[i]->isVisible() && i != currentLayerIndex) {
+            layers[i]->unloadPixels();
+        }
+    }
+}
+
+void Project::releaseCompositeCache() {
+    compositor.release();
+}
+
+CompositeLayers Project::getCompositeLayers(Arena& arena) const {
+    CompositeLayers inputs{ArenaAllocator<CompositeLayer>(arena)};
+    inputs.reserve(layers.size());
+    for (const auto& layer : layers) {
+        CompositeLayer input;
+        input.id = layer.get();
+        input.width = layer->getWidth();
+        input.height = layer->getHeight();
+        input.visible = layer->isVisible();
+        input.opacity = layer->getOpacity();
+        input.mode = layer->getBlendMode();
+        const std::vector<uint64_t>& stamps = layer->getTileStamps();
+        uint64_t* copy = ArenaAllocator<uint64_t>(arena).allocate(stamps.size());
+        std::copy(stamps.begin(), stamps.end(), copy);
+        input.tileStamps = copy;
+        input.tileCount = stamps.size();
+        if (input.visible) {
+            const Texture* texture = layer->getTexture();
+            input.pixels = texture->sharePixels();
+            input.channels = texture->getChannels();
+        }
+        inputs.push_back(std::move(input));
+    }
+    return inputs;
+}
+
 Layer* Project::addLayer(const std::string& name) {
-    static int layerCounter = 1;
+    // Atomic, since batch tools build projects on several threads
+    static std::atomic<int> layerCounter(1);
     std::string layerName = name;
     
     if (layerName.empty()) {
@@ -52,6 +143,7 @@ Layer* Project::addLayer(const std::string& name) {
     
     // Set current layer to the new one
     currentLayerIndex = layers.size() - 1;
+    structureStamp = Utils::nextChangeStamp();
     
     return layers.back().get();
 }
@@ -62,7 +154,9 @@ bool Project::removeLayer(size_t index) {
     }
     
     // Remove layer
+    undoHistory.forgetLayer(layers[index].get());
     layers.erase(layers.begin() + index);
+    structureStamp = Utils::nextChangeStamp();
     
     // Update current layer index
     if (currentLayerIndex >= layers.size()) {
@@ -72,6 +166,18 @@ bool Project::removeLayer(size_t index) {
     return true;
 }
 
+void Project::beginEdit(const std::string& label) {
+    std::vector<Layer*> editable;
+    for (const auto& layer : layers) {
+        editable.push_back(layer.get());
+    }
+    undoHistory.beginStep(label, editable);
+}
+
+void Project::endEdit() {
+    undoHistory.endStep();
+}
+
 Layer* Project::getLayer(size_t index) {
     if (index >= layers.size()) {
         return nullptr;
@@ -80,6 +186,16 @@ Layer* Project::getLayer(size_t index) {
     return layers[index].get();
 }
 
+bool Project::hasLayer(const Layer* layer) const {
+    for (const auto& candidate : layers) {
+        if (candidate.get() == layer) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
 Layer* Project::getCurrentLayer() {
     if (layers.empty() || currentLayerIndex >= layers.size()) {
         return nullptr;
@@ -91,15 +207,443 @@ Layer* Project::getCurrentLayer() {
 void Project::setCurrentLayerIndex(size_t index) {
     if (index < layers.size()) {
         currentLayerIndex = index;
+        structureStamp = Utils::nextChangeStamp();
     }
 }
 
 bool Project::saveProject(const std::string& path) const {
+    PROFILE_SCOPE("Project::saveProject");
+    
     if (!model.isLoaded()) {
         std::cerr << "No model loaded to save project." << std::endl;
         return false;
     }
     
+    if (std::filesystem::path(path).extension() == ".json") {
+        return saveProjectJSON(path);
+    }
+    
+    return saveProjectFile(path);
+}
+
+bool Project::loadProject(const std::string& path) {
+    if (ProjectFile::isProjectFile(path)) {
+        return loadProjectFile(path);
+    }
+    
+    return loadProjectJSON(path);
+}
+
+TileStore* Project::openHistory(const std::string& projectPath) const {
+    std::string directory = TileStore::directoryFor(projectPath);
+    if (history && history->isOpen() && history->getDirectory() == directory) {
+        return history.get();
+    }
+    
+    auto store = std::make_shared<TileStore>();
+    if (!store->open(directory)) {
+        return nullptr;
+    }
+    
+    history = store;
+    return history.get();
+}
+
+bool Project::saveVersion(const std::string& projectPath, const std::string& label) const {
+    TileStore* store = openHistory(projectPath);
+    if (!store) {
+        return false;
+    }
+    
+    SaveStats stats;
+    TileStore::VersionInfo info;
+    if (!createSnapshot().writeVersion(*store, label, stats, info)) {
+        std::cerr << "Failed to save version of " << projectPath << std::endl;
+        return false;
+    }
+    
+    std::cout << "Saved version " << info.id << " (" << info.label << ") of " << projectPath << ": "
+              << stats.tilesStored << " new objects, " << stats.bytesWritten / 1024 << " KB added in "
+              << stats.milliseconds << " ms" << std::endl;
+    
+    return true;
+}
+
+bool Project::openVersion(const std::string& projectPath, uint32_t version) {
+    auto startTime = std::chrono::steady_clock::now();
+    
+    TileStore* store = openHistory(projectPath);
+    if (!store) {
+        return false;
+    }
+    
+    try {
+        nlohmann::json manifest;
+        if (!store->readVersion(version, manifest)) {
+            return false;
+        }
+        
+        const nlohmann::json& projectData = manifest["project"];
+        if (projectData.value("tileSize", TileCodec::TILE_SIZE) != TileCodec::TILE_SIZE) {
+            std::cerr << "Unsupported tile size in version " << version << std::endl;
+            return false;
+        }
+        
+        // Geometry
+        std::vector<MeshData> meshData;
+        for (const auto& meshEntry : manifest["meshes"]) {
+            ContentHash vertexHash;
+            ContentHash indexHash;
+            std::vector<unsigned char> vertexBytes;
+            std::vector<unsigned char> indexBytes;
+            uint8_t codec;
+            if (!ContentHash::parse(meshEntry["vertices"].get<std::string>(), vertexHash) ||
+                !ContentHash::parse(meshEntry["indices"].get<std::string>(), indexHash) ||
+                !store->get(vertexHash, codec, vertexBytes) || !store->get(indexHash, codec, indexBytes) ||
+                vertexBytes.size() % sizeof(Vertex) != 0 || indexBytes.size() % sizeof(unsigned int) != 0) {
+                std::cerr << "Corrupt mesh in version " << version << std::endl;
+                return false;
+            }
+            
+            MeshData mesh;
+            mesh.vertices.resize(vertexBytes.size() / sizeof(Vertex));
+            mesh.indices.resize(indexBytes.size() / sizeof(unsigned int));
+            std::memcpy(mesh.vertices.data(), vertexBytes.data(), vertexBytes.size());
+            std::memcpy(mesh.indices.data(), indexBytes.data(), indexBytes.size());
+            meshData.push_back(std::move(mesh));
+        }
+        
+        // Layer tiles
+        const nlohmann::json& layersData = projectData["layers"];
+        const nlohmann::json& layerTiles = manifest["layers"];
+        if (layerTiles.size() != layersData.size()) {
+            std::cerr << "Layer count mismatch in version " << version << std::endl;
+            return false;
+        }
+        
+        int projectWidth = projectData["textureWidth"];
+        int projectHeight = projectData["textureHeight"];
+        
+        struct LayerImage {
+            int width;
+            int height;
+            std::vector<unsigned char> rgba;
+        };
+        struct TileRef {
+            size_t layer;
+            int x0;
+            int y0;
+            ContentHash hash;
+        };
+        std::vector<LayerImage> images(layersData.size());
+        std::vector<TileRef> tiles;
+        
+        for (size_t i = 0; i < layersData.size(); i++) {
+            LayerImage& image = images[i];
+            image.width = layersData[i].value("width", projectWidth);
+            image.height = layersData[i].value("height", projectHeight);
+            image.rgba.assign(static_cast<size_t>(image.width) * image.height * 4, 0);
+            
+            int columns = TileCodec::tileCount(image.width);
+            int tileIndex = 0;
+            for (const auto& tileEntry : layerTiles[i]["tiles"]) {
+                std::string text = tileEntry.get<std::string>();
+                TileRef tile;
+                tile.layer = i;
+                tile.x0 = (tileIndex % columns) * TileCodec::TILE_SIZE;
+                tile.y0 = (tileIndex / columns) * TileCodec::TILE_SIZE;
+                tileIndex++;
+                
+                // Empty entries are transparent tiles
+                if (text.empty() || tile.y0 >= image.height) {
+                    continue;
+                }
+                if (!ContentHash::parse(text, tile.hash)) {
+                    std::cerr << "Corrupt tile list in version " << version << std::endl;
+                    return false;
+                }
+                tiles.push_back(tile);
+            }
+        }
+        
+        // Tiles shared with versions opened before come from the store's cache
+        std::atomic<bool> tilesFailed(false);
+        ThreadPool::shared().parallelFor(tiles.size(), [&](size_t t) {
+            const TileRef& tile = tiles[t];
+            LayerImage& image = images[tile.layer];
+            int tileWidth = std::min(TileCodec::TILE_SIZE, image.width - tile.x0);
+            int tileHeight = std::min(TileCodec::TILE_SIZE, image.height - tile.y0);
+            
+            std::shared_ptr<const std::vector<unsigned char>> pixels = store->getTile(tile.hash, tileWidth, tileHeight);
+            if (!pixels) {
+                tilesFailed = true;
+                return;
+            }
+            
+            size_t rowBytes = static_cast<size_t>(tileWidth) * 4;
+            for (int y = 0; y < tileHeight; y++) {
+                std::memcpy(&image.rgba[(static_cast<size_t>(tile.y0 + y) * image.width + tile.x0) * 4],
+                            pixels->data() + y * rowBytes, rowBytes);
+            }
+        });
+        if (tilesFailed) {
+            std::cerr << "Missing tiles in version " << version << std::endl;
+            return false;
+        }
+        
+        // Everything is read; replace the current project
+        clear();
+        
+        std::string modelPath = projectData.value("model", std::string());
+        if (!model.loadFromMeshData(modelPath, meshData)) {
+            std::cerr << "Version " << version << " contains no geometry" << std::endl;
+            return false;
+        }
+        
+        textureWidth = projectWidth;
+        textureHeight = projectHeight;
+        
+        for (size_t i = 0; i < layersData.size(); i++) {
+            const auto& layerData = layersData[i];
+            LayerImage& image = images[i];
+            auto texture = std::make_unique<Texture>(image.width, image.height, std::move(image.rgba));
+            layers.push_back(std::make_unique<Layer>(std::move(texture), layerData["name"].get<std::string>()));
+            
+            Layer* layer = layers.back().get();
+            layer->setVisible(layerData["visible"]);
+            layer->setOpacity(layerData["opacity"]);
+            layer->setBlendMode(parseBlendMode(layerData.value("blendMode", std::string("normal"))));
+        }
+        
+        currentLayerIndex = projectData["currentLayerIndex"];
+        if (currentLayerIndex >= layers.size()) {
+            currentLayerIndex = layers.empty() ? 0 : layers.size() - 1;
+        }
+        
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        std::cout << "Opened version " << version << " of " << projectPath << " (" << tiles.size() << " tiles) in "
+                  << elapsed.count() << " ms" << std::endl;
+        
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error opening version: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+std::vector<TileStore::VersionInfo> Project::listVersions(const std::string& projectPath) const {
+    // Listing never creates a history directory
+    if (!std::filesystem::exists(TileStore::directoryFor(projectPath))) {
+        return {};
+    }
+    
+    TileStore* store = openHistory(projectPath);
+    return store ? store->listVersions() : std::vector<TileStore::VersionInfo>();
+}
+
+ProjectSnapshot Project::createSnapshot() const {
+    ProjectSnapshot snapshot;
+    snapshot.changeStamp = getChangeStamp();
+    
+    // Metadata
+    nlohmann::json projectData;
+    projectData["model"] = model.getPath();
+    projectData["textureWidth"] = textureWidth;
+    projectData["textureHeight"] = textureHeight;
+    projectData["currentLayerIndex"] = currentLayerIndex;
+    projectData["tileSize"] = TileCodec::TILE_SIZE;
+    
+    nlohmann::json layersData = nlohmann::json::array();
+    for (const auto& layer : layers) {
+        nlohmann::json layerData;
+        layerData["name"] = layer->getName();
+        layerData["visible"] = layer->isVisible();
+        layerData["opacity"] = layer->getOpacity();
+        layerData["blendMode"] = blendModeName(layer->getBlendMode());
+        layerData["width"] = layer->getWidth();
+        layerData["height"] = layer->getHeight();
+        layersData.push_back(layerData);
+    }
+    projectData["layers"] = layersData;
+    snapshot.metadata = projectData.dump();
+    
+    // Geometry and pixels are shared, not copied
+    for (const auto& mesh : model.getMeshes()) {
+        snapshot.meshes.push_back({ mesh.shareVertices(), mesh.shareIndices() });
+    }
+    
+    for (const auto& layer : layers) {
+        ProjectSnapshot::LayerState state;
+        state.width = layer->getWidth();
+        state.height = layer->getHeight();
+        if (layer->isLoaded()) {
+            state.pixels = layer->getTexture()->sharePixels();
+            state.channels = layer->getTexture()->getChannels();
+        } else {
+            state.source = layer->getSource();
+            state.sourceLayer = layer->getSourceLayer();
+        }
+        state.tileStamps = layer->getTileStamps();
+        state.cache = layer->getTileCache();
+        snapshot.layers.push_back(std::move(state));
+    }
+    
+    return snapshot;
+}
+
+uint64_t Project::getChangeStamp() const {
+    uint64_t stamp = structureStamp;
+    for (const auto& layer : layers) {
+        stamp = std::max(stamp, layer->getChangeStamp());
+    }
+    
+    return stamp;
+}
+
+bool Project::saveProjectFile(const std::string& path) const {
+    SaveStats stats;
+    if (!createSnapshot().write(path, stats)) {
+        // Windows cannot replace a file that is still mapped by layers;
+        // decode them to release it and try once more
+        bool decoded = false;
+        for (const auto& layer : layers) {
+            if (layer->getSource()) {
+                layer->getTexture();
+                layer->releaseSource();
+                decoded = true;
+            }
+        }
+        
+        stats = SaveStats();
+        if (!decoded || !createSnapshot().write(path, stats)) {
+            return false;
+        }
+    }
+    
+    std::cout << "Saved project " << path << " (" << model.getMeshes().size() << " meshes, " << layers.size()
+              << " layers, " << stats.tilesEncoded << " tiles encoded, " << stats.tilesReused << " reused, "
+              << stats.bytesWritten / 1024 << " KB) in " << stats.milliseconds << " ms" << std::endl;
+    
+    return true;
+}
+
+bool Project::loadProjectFile(const std::string& path) {
+    auto startTime = std::chrono::steady_clock::now();
+    
+    try {
+        // Clear existing project
+        clear();
+        
+        std::shared_ptr<ProjectFile> file = ProjectFile::open(path);
+        if (!file) {
+            return false;
+        }
+        
+        nlohmann::json projectData = nlohmann::json::parse(file->getMetadata());
+        
+        if (projectData.value("tileSize", TileCodec::TILE_SIZE) != TileCodec::TILE_SIZE) {
+            std::cerr << "Unsupported tile size in project file: " << path << std::endl;
+            return false;
+        }
+        
+        // Geometry
+        std::vector<MeshData> meshData;
+        meshData.reserve(file->getMeshChunks().size());
+        for (const ProjectFile::ChunkEntry& chunk : file->getMeshChunks()) {
+            const unsigned char* data = file->getChunkData(chunk);
+            if (chunk.size < 8) {
+                std::cerr << "Corrupt mesh chunk in project file: " << path << std::endl;
+                return false;
+            }
+            
+            uint32_t vertexCount;
+            uint32_t indexCount;
+            std::memcpy(&vertexCount, data, 4);
+            std::memcpy(&indexCount, data + 4, 4);
+            
+            size_t vertexBytes = static_cast<size_t>(vertexCount) * sizeof(Vertex);
+            size_t indexBytes = static_cast<size_t>(indexCount) * sizeof(unsigned int);
+            if (8 + vertexBytes + indexBytes != chunk.size) {
+                std::cerr << "Corrupt mesh chunk in project file: " << path << std::endl;
+                return false;
+            }
+            
+            MeshData mesh;
+            mesh.vertices.resize(vertexCount);
+            mesh.indices.resize(indexCount);
+            std::memcpy(mesh.vertices.data(), data + 8, vertexBytes);
+            std::memcpy(mesh.indices.data(), data + 8 + vertexBytes, indexBytes);
+            meshData.push_back(std::move(mesh));
+        }
+        
+        // Set texture size
+        textureWidth = projectData["textureWidth"];
+        textureHeight = projectData["textureHeight"];
+        
+        // Layers keep a reference to the file and decode on first use
+        uint32_t index = 0;
+        for (const auto& layerData : projectData["layers"]) {
+            int width = layerData.value("width", textureWidth);
+            int height = layerData.value("height", textureHeight);
+            layers.push_back(std::make_unique<Layer>(file, index++, width, height, layerData["name"].get<std::string>()));
+            
+            Layer* layer = layers.back().get();
+            layer->setVisible(layerData["visible"]);
+            layer->setOpacity(layerData["opacity"]);
+            layer->setBlendMode(parseBlendMode(layerData.value("blendMode", std::string("normal"))));
+        }
+        
+        // Visible layers are needed for the first frame anyway: decode them
+        // in the background while the geometry is built and uploaded, then
+        // upload them one after another on this thread
+        std::vector<Layer*> visibleLayers;
+        for (const auto& layer : layers) {
+            if (layer->isVisible()) {
+                visibleLayers.push_back(layer.get());
+            }
+        }
+        
+        std::vector<std::vector<unsigned char>> decoded(visibleLayers.size());
+        TaskGroup decoding;
+        for (size_t i = 0; i < visibleLayers.size(); i++) {
+            decoding.run([&visibleLayers, &decoded, i]() {
+                visibleLayers[i]->decodeSource(decoded[i]);
+            });
+        }
+        
+        std::string modelPath = projectData.value("model", std::string());
+        if (!model.loadFromMeshData(modelPath, meshData)) {
+            std::cerr << "Project file contains no geometry: " << path << std::endl;
+            decoding.wait();
+            clear();
+            return false;
+        }
+        
+        decoding.wait();
+        for (size_t i = 0; i < visibleLayers.size(); i++) {
+            visibleLayers[i]->loadPixels(std::move(decoded[i]));
+        }
+        
+        // Set current layer
+        currentLayerIndex = projectData["currentLayerIndex"];
+        if (currentLayerIndex >= layers.size()) {
+            currentLayerIndex = layers.empty() ? 0 : layers.size() - 1;
+        }
+        
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        std::cout << "Opened project " << path << " (" << layers.size() << " layers) in "
+                  << elapsed.count() << " ms" << std::endl;
+        
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading project: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool Project::saveProjectJSON(const std::string& path) const {
+    auto startTime = std::chrono::steady_clock::now();
+    
     try {
         // Create project directory
         std::filesystem::path projectPath(path);
@@ -132,12 +676,25 @@ bool Project::saveProject(const std::string& path) const {
         
         // Save layers
         nlohmann::json layersData = nlohmann::json::array();
+        std::vector<std::string> texturePaths(layers.size());
+        std::vector<std::shared_ptr<const std::vector<unsigned char>>> pixels(layers.size());
+        for (size_t i = 0; i < layers.size(); i++) {
+            texturePaths[i] = (texturesDir / (projectName + "_layer_" + std::to_string(i) + ".png")).string();
+            pixels[i] = layers[i]->getTexture()->sharePixels();
+        }
+        
+        // Encode and write layer textures concurrently
+        std::vector<char> saved(layers.size(), 0);
+        ThreadPool::shared().parallelFor(layers.size(), [&](size_t i) {
+            const Texture* texture = layers[i]->getTexture();
+            saved[i] = PngCodec::writeFile(texturePaths[i], pixels[i]->data(), texture->getWidth(),
+                                           texture->getHeight(), texture->getChannels(), pngMode);
+        });
+        
         for (size_t i = 0; i < layers.size(); i++) {
             const Layer* layer = layers[i].get();
             
-            // Save layer texture
-            std::string texturePath = (texturesDir / (projectName + "_layer_" + std::to_string(i) + ".png")).string();
-            if (!layer->saveToFile(texturePath)) {
+            if (!saved[i]) {
                 std::cerr << "Failed to save layer texture: " << i << std::endl;
                 continue;
             }
@@ -147,7 +704,8 @@ bool Project::saveProject(const std::string& path) const {
             layerData["name"] = layer->getName();
             layerData["visible"] = layer->isVisible();
             layerData["opacity"] = layer->getOpacity();
-            layerData["texture"] = texturePath;
+            layerData["blendMode"] = blendModeName(layer->getBlendMode());
+            layerData["texture"] = texturePaths[i];
             
             layersData.push_back(layerData);
         }
@@ -163,6 +721,17 @@ bool Project::saveProject(const std::string& path) const {
         file << projectData.dump(4);
         file.close();
         
+        // Report total size and time so it can be compared with GLB export
+        uintmax_t totalBytes = std::filesystem::file_size(path) + std::filesystem::file_size(modelPath);
+        for (const auto& entry : std::filesystem::directory_iterator(texturesDir)) {
+            if (entry.is_regular_file()) {
+                totalBytes += entry.file_size();
+            }
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        std::cout << "Saved project " << path << " (OBJ + " << layers.size() << " PNG, "
+                  << totalBytes / 1024 << " KB) in " << elapsed.count() << " ms" << std::endl;
+        
         return true;
     } catch (const std::exception& e) {
         std::cerr << "Error saving project: " << e.what() << std::endl;
@@ -170,7 +739,7 @@ bool Project::saveProject(const std::string& path) const {
     }
 }
 
-bool Project::loadProject(const std::string& path) {
+bool Project::loadProjectJSON(const std::string& path) {
     try {
         // Clear existing project
         clear();
@@ -187,6 +756,28 @@ bool Project::loadProject(const std::string& path) {
         file >> projectData;
         file.close();
         
+        // Decode layer images in the background while the model loads
+        struct LayerImage {
+            std::vector<unsigned char> rgba;
+            int width = 0;
+            int height = 0;
+            bool loaded = false;
+        };
+        
+        std::vector<std::string> texturePaths;
+        for (const auto& layerData : projectData["layers"]) {
+            texturePaths.push_back(layerData["texture"].get<std::string>());
+        }
+        
+        std::vector<LayerImage> images(texturePaths.size());
+        TaskGroup decoding;
+        for (size_t i = 0; i < images.size(); i++) {
+            decoding.run([&images, &texturePaths, i]() {
+                LayerImage& image = images[i];
+                image.loaded = PngCodec::readFile(texturePaths[i], image.rgba, image.width, image.height);
+            });
+        }
+        
         // Load model
         std::string modelPath = projectData["model"];
         if (!model.loadModel(modelPath)) {
@@ -197,19 +788,28 @@ bool Project::loadProject(const std::string& path) {
         // Set texture size
         textureWidth = projectData["textureWidth"];
         textureHeight = projectData["textureHeight"];
+        decoding.wait();
         
-        // Load layers
+        // Create layers and upload textures on this thread, which owns the GL context
+        size_t index = 0;
         for (const auto& layerData : projectData["layers"]) {
             std::string name = layerData["name"];
-            std::string texturePath = layerData["texture"];
+            LayerImage& image = images[index++];
+            if (!image.loaded) {
+                // Keep layer order intact with an empty layer
+                image.width = textureWidth;
+                image.height = textureHeight;
+                image.rgba.assign(static_cast<size_t>(textureWidth) * textureHeight * 4, 0);
+            }
             
-            // Create layer from texture
-            layers.push_back(std::make_unique<Layer>(texturePath, name));
+            std::unique_ptr<Texture> texture = std::make_unique<Texture>(image.width, image.height, std::move(image.rgba));
+            layers.push_back(std::make_unique<Layer>(std::move(texture), name));
             
             // Set layer properties
             Layer* layer = layers.back().get();
             layer->setVisible(layerData["visible"]);
             layer->setOpacity(layerData["opacity"]);
+            layer->setBlendMode(parseBlendMode(layerData.value("blendMode", std::string("normal"))));
         }
         
         // Set current layer
@@ -227,11 +827,13 @@ bool Project::loadProject(const std::string& path) {
 
 void Project::clear() {
     // Clear model
-    model = Model();
+    model.clear();
     
     // Clear layers
+    undoHistory.clear();
     layers.clear();
     currentLayerIndex = 0;
+    structureStamp = Utils::nextChangeStamp();
     
     // Reset texture size
     textureWidth = 1024;
@@ -2,6 +2,10 @@
 
 #include "model.h"
 #include "layer.h"
+#include "project_snapshot.h"
+#include "tile_store.h"
+#include "undo_history.h"
+#include "png_codec.h"
 #include <vector>
 #include <memory>
 #include <string>
@@ -21,17 +25,67 @@ public:
     bool removeLayer(size_t index);
     Layer* getLayer(size_t index);
     Layer* getCurrentLayer();
+    bool hasLayer(const Layer* layer) const;
     void setCurrentLayerIndex(size_t index);
     
-    // Project operations
+    // Undo: pixel edits between beginEdit() and endEdit() are undone as one step
+    void beginEdit(const std::string& label);
+    void endEdit();
+    bool undo() { return undoHistory.undo(); }
+    bool redo() { return undoHistory.redo(); }
+    UndoHistory& getUndoHistory() { return undoHistory; }
+    
+    // Composite visible layers (bottom to top) into an RGBA8 image over a background color
+    void flattenLayers(std::vector<unsigned char>& rgba, const glm::vec4& background = glm::vec4(0.0f)) const;
+    
+    // Bring the cached composite of all layers up to date; only tiles whose
+    // layers changed since the last call are recomposited
+    const Compositor& updateComposite() const;
+    
+    // Compositor inputs for the layers, bottom to top; hidden layers are not
+    // loaded. The inputs and their tile stamps are allocated from arena.
+    CompositeLayers getCompositeLayers(Arena& arena) const;
+    
+    // Memory that only makes things faster (see MemoryBudget): encoded tiles
+    // kept for incremental saves and the compositor's stacks. Releasing it
+    // costs a full re-encode on the next save or recomposite on the next frame.
+    size_t getCacheMemory() const;
+    void releaseTileCaches();
+    void releaseCompositeCache();
+    
+    // Drop the pixels of hidden layers that are unchanged since they were
+    // decoded from the project file; they are decoded again when shown
+    void unloadHiddenLayers();
+    
+    // Project operations (.json paths use the legacy JSON + OBJ + PNG layout,
+    // everything else is written as a single-file container)
     bool saveProject(const std::string& path) const;
     bool loadProject(const std::string& path);
     void clear();
     
+    // Version history in a content-addressed tile store next to a project
+    // file (TileStore::directoryFor). Versions share every unchanged tile.
+    bool saveVersion(const std::string& projectPath, const std::string& label = "") const;
+    bool openVersion(const std::string& projectPath, uint32_t version);
+    std::vector<TileStore::VersionInfo> listVersions(const std::string& projectPath) const;
+    
+    // Cheap copy-on-write view of the project that can be written from
+    // another thread while editing continues
+    ProjectSnapshot createSnapshot() const;
+    
+    // Latest change stamp of the project structure or any layer
+    uint64_t getChangeStamp() const;
+    
+    // PNG encoding used for layer textures of .json projects
+    void setPngMode(PngCodec::Mode mode) { pngMode = mode; }
+    PngCodec::Mode getPngMode() const { return pngMode; }
+    
     // Getters
     const Model& getModel() const { return model; }
     const std::vector<std::unique_ptr<Layer>>& getLayers() const { return layers; }
     size_t getCurrentLayerIndex() const { return currentLayerIndex; }
+    int getTextureWidth() const { return textureWidth; }
+    int getTextureHeight() const { return textureHeight; }
     bool hasModel() const { return model.isLoaded(); }
     
 private:
@@ -40,7 +94,27 @@ private:
     size_t currentLayerIndex;
     int textureWidth;
     int textureHeight;
+    PngCodec::Mode pngMode;
+    UndoHistory undoHistory;
+    mutable Compositor compositor;
+    
+    // Stamp of the last layer add/remove/select
+    uint64_t structureStamp;
+    
+    // Tile store of the project versions were last saved to or opened from,
+    // kept open so its decoded tiles can be reused
+    mutable std::shared_ptr<TileStore> history;
+    
+    TileStore* openHistory(const std::string& projectPath) const;
     
     // Helper to create a default texture size based on model
     void setDefaultTextureSize();
+    
+    // Single-file container format
+    bool saveProjectFile(const std::string& path) const;
+    bool loadProjectFile(const std::string& path);
+    
+    // Legacy JSON format
+    bool saveProjectJSON(const std::string& path) const;
+    bool loadProjectJSON(const std::string& path);
 };
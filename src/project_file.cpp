@@ -0,0 +1,286 @@
+#include "project_file.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const char MAGIC[4] = { '3', 'D', 'P', 'F' };
+    const uint32_t VERSION = 1;
+    const size_t HEADER_SIZE = 16;
+    const size_t FOOTER_SIZE = 16;
+    const size_t ENTRY_SIZE = 32;
+
+    // Highest layer or mesh index a file may use. Tiles are grouped by layer
+    // index, so a corrupt index must not turn into a huge allocation.
+    const uint32_t MAX_INDEX = 0xFFFF;
+
+    uint16_t readU16LE(const unsigned char* p) {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t readU32LE(const unsigned char* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    uint64_t readU64LE(const unsigned char* p) {
+        return static_cast<uint64_t>(readU32LE(p)) | (static_cast<uint64_t>(readU32LE(p + 4)) << 32);
+    }
+
+    void writeU64LE(FileWriter& writer, uint64_t value) {
+        writer.writeU32LE(static_cast<uint32_t>(value));
+        writer.writeU32LE(static_cast<uint32_t>(value >> 32));
+    }
+
+    const std::vector<ProjectFile::ChunkEntry> NO_TILES;
+}
+
+bool ProjectFile::isProjectFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char signature[4] = {};
+    if (!file.read(signature, sizeof(signature))) {
+        return false;
+    }
+
+    return std::memcmp(signature, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+std::shared_ptr<ProjectFile> ProjectFile::open(const std::string& path) {
+    std::shared_ptr<ProjectFile> project(new ProjectFile());
+    project->path = path;
+
+    MappedFile& file = project->file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open project file: " << path << std::endl;
+        return nullptr;
+    }
+
+    const unsigned char* data = file.data();
+    size_t size = file.size();
+
+    // Header and footer must both carry the signature
+    if (size < HEADER_SIZE + FOOTER_SIZE ||
+        std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0 ||
+        std::memcmp(data + size - 4, MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "Not a project file: " << path << std::endl;
+        return nullptr;
+    }
+
+    uint32_t version = readU32LE(data + 4);
+    if (version != VERSION) {
+        std::cerr << "Unsupported project file version " << version << ": " << path << std::endl;
+        return nullptr;
+    }
+
+    const unsigned char* footer = data + size - FOOTER_SIZE;
+    uint64_t tableOffset = readU64LE(footer);
+    uint32_t chunkCount = readU32LE(footer + 8);
+    if (tableOffset < HEADER_SIZE || tableOffset > size - FOOTER_SIZE ||
+        (size - FOOTER_SIZE - tableOffset) / ENTRY_SIZE < chunkCount) {
+        std::cerr << "Corrupt chunk table in project file: " << path << std::endl;
+        return nullptr;
+    }
+
+    // Read chunk table
+    const unsigned char* entry = data + tableOffset;
+    for (uint32_t i = 0; i < chunkCount; i++, entry += ENTRY_SIZE) {
+        ChunkEntry chunk;
+        chunk.type = readU32LE(entry);
+        chunk.index = readU32LE(entry + 4);
+        chunk.tileX = readU16LE(entry + 8);
+        chunk.tileY = readU16LE(entry + 10);
+        chunk.codec = entry[12];
+        chunk.offset = readU64LE(entry + 16);
+        chunk.size = readU32LE(entry + 24);
+
+        if (chunk.offset < HEADER_SIZE || chunk.offset > tableOffset || chunk.size > tableOffset - chunk.offset) {
+            std::cerr << "Chunk " << i << " is out of bounds in project file: " << path << std::endl;
+            return nullptr;
+        }
+        if ((chunk.type == CHUNK_MESH || chunk.type == CHUNK_TILE) && chunk.index > MAX_INDEX) {
+            std::cerr << "Chunk " << i << " has an invalid index in project file: " << path << std::endl;
+            return nullptr;
+        }
+
+        switch (chunk.type) {
+            case CHUNK_META:
+                project->metaChunks.push_back(chunk);
+                break;
+            case CHUNK_MESH:
+                project->meshChunks.push_back(chunk);
+                break;
+            case CHUNK_TILE:
+                if (chunk.index >= project->layerTiles.size()) {
+                    project->layerTiles.resize(chunk.index + 1);
+                }
+                project->layerTiles[chunk.index].push_back(chunk);
+                break;
+            default:
+                // Unknown chunks are skipped so newer files still open
+                break;
+        }
+    }
+
+    if (project->metaChunks.empty()) {
+        std::cerr << "Project file has no metadata: " << path << std::endl;
+        return nullptr;
+    }
+
+    return project;
+}
+
+std::string ProjectFile::getMetadata() const {
+    const ChunkEntry& meta = metaChunks.front();
+    const char* text = reinterpret_cast<const char*>(getChunkData(meta));
+    return std::string(text, meta.size);
+}
+
+const std::vector<ProjectFile::ChunkEntry>& ProjectFile::getLayerTiles(uint32_t layer) const {
+    if (layer >= layerTiles.size()) {
+        return NO_TILES;
+    }
+
+    return layerTiles[layer];
+}
+
+bool ProjectFile::decodeLayer(uint32_t layer, int width, int height, std::vector<unsigned char>& rgba) const {
+    // Tiles that were not stored are transparent
+    rgba.assign(static_cast<size_t>(width) * height * 4, 0);
+    size_t rowStride = static_cast<size_t>(width) * 4;
+
+    for (const ChunkEntry& tile : getLayerTiles(layer)) {
+        int x0 = tile.tileX * TileCodec::TILE_SIZE;
+        int y0 = tile.tileY * TileCodec::TILE_SIZE;
+        if (x0 >= width || y0 >= height) {
+            std::cerr << "Tile outside layer bounds in project file: " << path << std::endl;
+            return false;
+        }
+
+        int tileWidth = std::min(TileCodec::TILE_SIZE, width - x0);
+        int tileHeight = std::min(TileCodec::TILE_SIZE, height - y0);
+        unsigned char* target = rgba.data() + static_cast<size_t>(y0) * rowStride + static_cast<size_t>(x0) * 4;
+
+        if (!TileCodec::decode(static_cast<TileCodec::Codec>(tile.codec), getChunkData(tile), tile.size,
+                               target, tileWidth, tileHeight, rowStride)) {
+            std::cerr << "Corrupt tile (" << tile.tileX << ", " << tile.tileY << ") of layer "
+                      << layer << " in project file: " << path << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ProjectFileWriter::ProjectFileWriter()
+    : oversized(false) {
+}
+
+bool ProjectFileWriter::open(const std::string& path) {
+    chunks.clear();
+    oversized = false;
+    if (!writer.open(path)) {
+        return false;
+    }
+
+    // Header: signature, version, reserved
+    writer.write(MAGIC, sizeof(MAGIC));
+    writer.writeU32LE(VERSION);
+    writeU64LE(writer, 0);
+    return true;
+}
+
+void ProjectFileWriter::writeChunk(ProjectFile::ChunkType type, uint32_t index, const void* data, size_t size,
+                                   uint16_t tileX, uint16_t tileY, uint8_t codec) {
+    if (size > UINT32_MAX) {
+        std::cerr << "Chunk of " << size << " bytes is too large for a project file" << std::endl;
+        oversized = true;
+        return;
+    }
+    ProjectFile::ChunkEntry chunk = { type, index, tileX, tileY, codec, writer.getBytesWritten(),
+                                      static_cast<uint32_t>(size) };
+    chunks.push_back(chunk);
+    writer.write(data, size);
+}
+
+void ProjectFileWriter::beginChunk(ProjectFile::ChunkType type, uint32_t index) {
+    ProjectFile::ChunkEntry chunk = { type, index, 0, 0, TileCodec::CODEC_RAW, writer.getBytesWritten(), 0 };
+    chunks.push_back(chunk);
+}
+
+void ProjectFileWriter::endChunk() {
+    ProjectFile::ChunkEntry& chunk = chunks.back();
+    uint64_t size = writer.getBytesWritten() - chunk.offset;
+    if (size > UINT32_MAX) {
+        std::cerr << "Chunk of " << size << " bytes is too large for a project file" << std::endl;
+        oversized = true;
+        return;
+    }
+    chunk.size = static_cast<uint32_t>(size);
+}
+
+void ProjectFileWriter::writeTile(uint32_t index, uint16_t tileX, uint16_t tileY, uint8_t codec,
+                                  const void* data, size_t size) {
+    // Fully transparent tiles are implied by their absence
+    if (TileCodec::isTransparent(codec, static_cast<const unsigned char*>(data), size)) {
+        return;
+    }
+
+    writeChunk(ProjectFile::CHUNK_TILE, index, data, size, tileX, tileY, codec);
+}
+
+void ProjectFileWriter::writeLayer(uint32_t index, const unsigned char* rgba, int width, int height) {
+    size_t rowStride = static_cast<size_t>(width) * 4;
+
+    for (int ty = 0; ty < TileCodec::tileCount(height); ty++) {
+        for (int tx = 0; tx < TileCodec::tileCount(width); tx++) {
+            int x0 = tx * TileCodec::TILE_SIZE;
+            int y0 = ty * TileCodec::TILE_SIZE;
+            int tileWidth = std::min(TileCodec::TILE_SIZE, width - x0);
+            int tileHeight = std::min(TileCodec::TILE_SIZE, height - y0);
+            const unsigned char* source = rgba + static_cast<size_t>(y0) * rowStride + static_cast<size_t>(x0) * 4;
+
+            scratch.clear();
+            TileCodec::Codec codec = TileCodec::encode(source, tileWidth, tileHeight, rowStride, scratch);
+            writeTile(index, static_cast<uint16_t>(tx), static_cast<uint16_t>(ty), codec, scratch.data(), scratch.size());
+        }
+    }
+}
+
+void ProjectFileWriter::copyLayer(uint32_t index, const ProjectFile& source, uint32_t sourceLayer) {
+    for (const ProjectFile::ChunkEntry& tile : source.getLayerTiles(sourceLayer)) {
+        writeChunk(ProjectFile::CHUNK_TILE, index, source.getChunkData(tile), tile.size,
+                   tile.tileX, tile.tileY, tile.codec);
+    }
+}
+
+bool ProjectFileWriter::close() {
+    if (!writer.isOpen()) {
+        return false;
+    }
+
+    // Chunk table
+    uint64_t tableOffset = writer.getBytesWritten();
+    for (const ProjectFile::ChunkEntry& chunk : chunks) {
+        writer.writeU32LE(chunk.type);
+        writer.writeU32LE(chunk.index);
+        writer.writeU16LE(chunk.tileX);
+        writer.writeU16LE(chunk.tileY);
+        writer.writeU8(chunk.codec);
+        writer.writeU8(0);
+        writer.writeU16LE(0);
+        writeU64LE(writer, chunk.offset);
+        writer.writeU32LE(chunk.size);
+        writer.writeU32LE(0);
+    }
+
+    // Footer
+    writeU64LE(writer, tableOffset);
+    writer.writeU32LE(static_cast<uint32_t>(chunks.size()));
+    writer.write(MAGIC, sizeof(MAGIC));
+
+    chunks.clear();
+    bool written = writer.close();
+    return written && !oversized;
+}
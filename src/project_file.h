@@ -0,0 +1,106 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "file_writer.h"
+#include "tile_codec.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Single-file project container (.3dp).
+//
+// Layout: a 16-byte header, the chunk payloads, a chunk table and a 16-byte
+// footer pointing at the table. Chunks hold the JSON metadata, raw mesh
+// arrays and per-layer tiles compressed with TileCodec. Tiles that are fully
+// transparent are not stored at all.
+//
+// Opening a container only maps the file and reads the table, so layers can
+// be decoded lazily when they are first displayed or painted.
+class ProjectFile {
+public:
+    enum ChunkType : uint32_t {
+        CHUNK_META = 1,     // JSON metadata
+        CHUNK_MESH = 2,     // index = mesh index
+        CHUNK_TILE = 3      // index = layer index, tileX/tileY = tile position
+    };
+
+    struct ChunkEntry {
+        uint32_t type;
+        uint32_t index;
+        uint16_t tileX;
+        uint16_t tileY;
+        uint8_t codec;
+        uint64_t offset;
+        uint32_t size;
+    };
+
+    // Check whether a file starts with the container signature
+    static bool isProjectFile(const std::string& path);
+
+    // Map a container and read its chunk table; returns nullptr on failure
+    static std::shared_ptr<ProjectFile> open(const std::string& path);
+
+    // Metadata JSON text
+    std::string getMetadata() const;
+
+    // Mesh chunks in mesh order
+    const std::vector<ChunkEntry>& getMeshChunks() const { return meshChunks; }
+
+    // Tile chunks stored for a layer (missing tiles are transparent)
+    const std::vector<ChunkEntry>& getLayerTiles(uint32_t layer) const;
+    size_t getLayerCount() const { return layerTiles.size(); }
+
+    // Payload of a chunk
+    const unsigned char* getChunkData(const ChunkEntry& entry) const { return file.data() + entry.offset; }
+
+    // Decode all tiles of a layer into a width x height RGBA8 image
+    bool decodeLayer(uint32_t layer, int width, int height, std::vector<unsigned char>& rgba) const;
+
+    const std::string& getPath() const { return path; }
+
+private:
+    std::string path;
+    MappedFile file;
+    std::vector<ChunkEntry> metaChunks;
+    std::vector<ChunkEntry> meshChunks;
+    std::vector<std::vector<ChunkEntry>> layerTiles;
+};
+
+// Streams chunks into a new container file
+class ProjectFileWriter {
+public:
+    ProjectFileWriter();
+
+    bool open(const std::string& path);
+
+    // Append a chunk. Chunks over 4 GB cannot be stored; they make close() fail.
+    void writeChunk(ProjectFile::ChunkType type, uint32_t index, const void* data, size_t size,
+                    uint16_t tileX = 0, uint16_t tileY = 0, uint8_t codec = TileCodec::CODEC_RAW);
+
+    // Start a chunk whose payload is written piecewise through getWriter()
+    void beginChunk(ProjectFile::ChunkType type, uint32_t index);
+    void endChunk();
+    FileWriter& getWriter() { return writer; }
+
+    // Append an encoded layer tile; fully transparent tiles are dropped
+    void writeTile(uint32_t index, uint16_t tileX, uint16_t tileY, uint8_t codec, const void* data, size_t size);
+    
+    // Encode a layer (RGBA8, width x height) tile by tile
+    void writeLayer(uint32_t index, const unsigned char* rgba, int width, int height);
+
+    // Copy the compressed tiles of a layer that was never decoded
+    void copyLayer(uint32_t index, const ProjectFile& source, uint32_t sourceLayer);
+
+    // Write chunk table and footer, then close the file. Returns false if a
+    // write failed or a chunk was too large.
+    bool close();
+
+    uint64_t getBytesWritten() const { return writer.getBytesWritten(); }
+
+private:
+    FileWriter writer;
+    std::vector<ProjectFile::ChunkEntry> chunks;
+    std::vector<unsigned char> scratch;
+    bool oversized;     // a chunk did not fit its 32-bit size
+};
@@ -0,0 +1,266 @@
+#include "project_snapshot.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+    // Encode one tile of a layer, expanding textures with fewer than 4 channels
+    TileCodec::Codec encodeTile(const ProjectSnapshot::LayerState& layer, int x0, int y0, int tileWidth, int tileHeight,
+                                std::vector<unsigned char>& rgba, std::vector<unsigned char>& out) {
+        const std::vector<unsigned char>& data = *layer.pixels;
+        int channels = layer.channels;
+        size_t rowStride = static_cast<size_t>(layer.width) * channels;
+        const unsigned char* source = data.data() + static_cast<size_t>(y0) * rowStride + static_cast<size_t>(x0) * channels;
+
+        if (channels == 4) {
+            return TileCodec::encode(source, tileWidth, tileHeight, rowStride, out);
+        }
+
+        rgba.resize(static_cast<size_t>(tileWidth) * tileHeight * 4);
+        for (int y = 0; y < tileHeight; y++) {
+            for (int x = 0; x < tileWidth; x++) {
+                const unsigned char* src = source + y * rowStride + x * channels;
+                unsigned char* dst = &rgba[(static_cast<size_t>(y) * tileWidth + x) * 4];
+                dst[0] = src[0];
+                dst[1] = channels >= 2 ? src[1] : src[0];
+                dst[2] = channels >= 3 ? src[2] : src[0];
+                dst[3] = 255;
+            }
+        }
+        return TileCodec::encode(rgba.data(), tileWidth, tileHeight, static_cast<size_t>(tileWidth) * 4, out);
+    }
+}
+
+void ProjectSnapshot::encodeTiles(std::vector<std::vector<LayerTileCache::Entry>>& entries, SaveStats& stats) const {
+    // Look up every tile in the layer caches; only tiles changed since they
+    // were cached need compressing again
+    struct PendingTile {
+        size_t layer;
+        size_t tile;
+    };
+    std::vector<PendingTile> pending;
+    size_t tileCount = 0;
+    entries.assign(layers.size(), std::vector<LayerTileCache::Entry>());
+
+    for (size_t i = 0; i < layers.size(); i++) {
+        const LayerState& layer = layers[i];
+        if (!layer.pixels) {
+            continue;
+        }
+
+        entries[i].resize(layer.tileStamps.size());
+        tileCount += layer.tileStamps.size();
+        std::lock_guard<std::mutex> lock(layer.cache->mutex);
+        for (size_t tile = 0; tile < layer.tileStamps.size(); tile++) {
+            if (tile < layer.cache->tiles.size() && layer.cache->tiles[tile].bytes &&
+                layer.cache->tiles[tile].stamp == layer.tileStamps[tile]) {
+                entries[i][tile] = layer.cache->tiles[tile];
+            } else {
+                pending.push_back({ i, tile });
+            }
+        }
+    }
+
+    // Compress changed tiles concurrently
+    ThreadPool::shared().parallelFor(pending.size(), [&](size_t p) {
+        const LayerState& layer = layers[pending[p].layer];
+        size_t tile = pending[p].tile;
+        int columns = TileCodec::tileCount(layer.width);
+        int x0 = static_cast<int>(tile % columns) * TileCodec::TILE_SIZE;
+        int y0 = static_cast<int>(tile / columns) * TileCodec::TILE_SIZE;
+        int tileWidth = std::min(TileCodec::TILE_SIZE, layer.width - x0);
+        int tileHeight = std::min(TileCodec::TILE_SIZE, layer.height - y0);
+
+        std::vector<unsigned char> rgba;
+        auto bytes = std::make_shared<std::vector<unsigned char>>();
+        LayerTileCache::Entry& entry = entries[pending[p].layer][tile];
+        entry.codec = encodeTile(layer, x0, y0, tileWidth, tileHeight, rgba, *bytes);
+        entry.hash = TileStore::hashObject(entry.codec, bytes->data(), bytes->size());
+        entry.stamp = layer.tileStamps[tile];
+        entry.bytes = bytes;
+
+        // Another save may have cached a newer version meanwhile
+        std::lock_guard<std::mutex> lock(layer.cache->mutex);
+        if (layer.cache->tiles.size() < layer.tileStamps.size()) {
+            layer.cache->tiles.resize(layer.tileStamps.size());
+        }
+        if (layer.cache->tiles[tile].stamp < entry.stamp) {
+            layer.cache->tiles[tile] = entry;
+        }
+    });
+
+    stats.tilesEncoded = pending.size();
+    stats.tilesReused = tileCount - pending.size();
+}
+
+bool ProjectSnapshot::write(const std::string& path, SaveStats& stats) const {
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::error_code error;
+    std::filesystem::path projectDir = std::filesystem::path(path).parent_path();
+    if (!projectDir.empty()) {
+        std::filesystem::create_directories(projectDir, error);
+    }
+
+    // Write next to the target and swap it in, so a failed save never
+    // leaves a truncated project behind
+    std::string tempPath = path + ".tmp";
+    ProjectFileWriter writer;
+    if (!writer.open(tempPath)) {
+        std::cerr << "Failed to open project file for writing: " << tempPath << std::endl;
+        return false;
+    }
+
+    writer.writeChunk(ProjectFile::CHUNK_META, 0, metadata.data(), metadata.size());
+
+    // Geometry is stored as raw vertex/index arrays so loading skips Assimp
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const std::vector<Vertex>& vertices = *meshes[i].vertices;
+        const std::vector<unsigned int>& indices = *meshes[i].indices;
+
+        writer.beginChunk(ProjectFile::CHUNK_MESH, static_cast<uint32_t>(i));
+        FileWriter& out = writer.getWriter();
+        out.writeU32LE(static_cast<uint32_t>(vertices.size()));
+        out.writeU32LE(static_cast<uint32_t>(indices.size()));
+        out.write(vertices.data(), vertices.size() * sizeof(Vertex));
+        out.write(indices.data(), indices.size() * sizeof(unsigned int));
+        writer.endChunk();
+    }
+
+    std::vector<std::vector<LayerTileCache::Entry>> entries;
+    encodeTiles(entries, stats);
+
+    // Write layers in order; undecoded ones are copied from their project file
+    for (size_t i = 0; i < layers.size(); i++) {
+        const LayerState& layer = layers[i];
+        uint32_t index = static_cast<uint32_t>(i);
+
+        if (!layer.pixels) {
+            if (layer.source) {
+                writer.copyLayer(index, *layer.source, layer.sourceLayer);
+            }
+            continue;
+        }
+
+        int columns = TileCodec::tileCount(layer.width);
+        for (size_t tile = 0; tile < entries[i].size(); tile++) {
+            const LayerTileCache::Entry& entry = entries[i][tile];
+            writer.writeTile(index, static_cast<uint16_t>(tile % columns), static_cast<uint16_t>(tile / columns),
+                             entry.codec, entry.bytes->data(), entry.bytes->size());
+        }
+    }
+
+    uint64_t totalBytes = writer.getBytesWritten();
+    if (!writer.close()) {
+        std::cerr << "Failed to write project file: " << tempPath << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::cerr << "Failed to replace project file " << path << ": " << error.message() << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    stats.bytesWritten = totalBytes;
+    stats.milliseconds = elapsed.count();
+    return true;
+}
+
+bool ProjectSnapshot::writeVersion(TileStore& store, const std::string& label, SaveStats& stats,
+                                   TileStore::VersionInfo& info) const {
+    auto startTime = std::chrono::steady_clock::now();
+    uint64_t packSize = store.getPackSize();
+
+    // Store an object unless an earlier version already did
+    bool failed = false;
+    auto storeObject = [&](const ContentHash& hash, uint8_t codec, const void* data, size_t size) {
+        if (!store.contains(hash)) {
+            failed = failed || !store.put(hash, codec, data, size);
+            stats.tilesStored++;
+        }
+    };
+
+    nlohmann::json manifest;
+    try {
+        manifest["project"] = nlohmann::json::parse(metadata);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid project metadata: " << e.what() << std::endl;
+        return false;
+    }
+
+    nlohmann::json meshesData = nlohmann::json::array();
+    for (const MeshState& mesh : meshes) {
+        const std::vector<Vertex>& vertices = *mesh.vertices;
+        const std::vector<unsigned int>& indices = *mesh.indices;
+        size_t vertexBytes = vertices.size() * sizeof(Vertex);
+        size_t indexBytes = indices.size() * sizeof(unsigned int);
+
+        ContentHash vertexHash = TileStore::hashObject(TileCodec::CODEC_RAW, vertices.data(), vertexBytes);
+        ContentHash indexHash = TileStore::hashObject(TileCodec::CODEC_RAW, indices.data(), indexBytes);
+        storeObject(vertexHash, TileCodec::CODEC_RAW, vertices.data(), vertexBytes);
+        storeObject(indexHash, TileCodec::CODEC_RAW, indices.data(), indexBytes);
+
+        nlohmann::json meshData;
+        meshData["vertices"] = vertexHash.toString();
+        meshData["indices"] = indexHash.toString();
+        meshesData.push_back(meshData);
+    }
+    manifest["meshes"] = meshesData;
+
+    std::vector<std::vector<LayerTileCache::Entry>> entries;
+    encodeTiles(entries, stats);
+
+    // Tiles are listed row by row; transparent ones are left empty
+    nlohmann::json layersData = nlohmann::json::array();
+    for (size_t i = 0; i < layers.size(); i++) {
+        const LayerState& layer = layers[i];
+        int columns = TileCodec::tileCount(layer.width);
+        std::vector<std::string> tiles(static_cast<size_t>(columns) * TileCodec::tileCount(layer.height));
+
+        if (layer.pixels) {
+            for (size_t tile = 0; tile < entries[i].size() && tile < tiles.size(); tile++) {
+                const LayerTileCache::Entry& entry = entries[i][tile];
+                if (!TileCodec::isTransparent(entry.codec, entry.bytes->data(), entry.bytes->size())) {
+                    storeObject(entry.hash, entry.codec, entry.bytes->data(), entry.bytes->size());
+                    tiles[tile] = entry.hash.toString();
+                }
+            }
+        } else if (layer.source) {
+            // Undecoded layers are taken over as they are compressed in the project file
+            for (const ProjectFile::ChunkEntry& chunk : layer.source->getLayerTiles(layer.sourceLayer)) {
+                size_t tile = static_cast<size_t>(chunk.tileY) * columns + chunk.tileX;
+                if (tile >= tiles.size()) {
+                    continue;
+                }
+                const unsigned char* data = layer.source->getChunkData(chunk);
+                ContentHash hash = TileStore::hashObject(chunk.codec, data, chunk.size);
+                storeObject(hash, chunk.codec, data, chunk.size);
+                tiles[tile] = hash.toString();
+            }
+        }
+
+        nlohmann::json layerData;
+        layerData["tiles"] = tiles;
+        layersData.push_back(layerData);
+    }
+    manifest["layers"] = layersData;
+
+    if (failed || !store.flush()) {
+        std::cerr << "Failed to store project data in " << store.getDirectory() << std::endl;
+        return false;
+    }
+    if (!store.addVersion(label, manifest, info)) {
+        return false;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    stats.bytesWritten = store.getPackSize() - packSize;
+    stats.milliseconds = elapsed.count();
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "project_file.h"
+#include "model.h"
+#include "tile_store.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Encoded tiles of a layer from earlier saves. A tile is only compressed
+// again when the layer changed it since. Shared between the layer and any
+// save in progress, so entries are guarded by a mutex.
+struct LayerTileCache {
+    struct Entry {
+        uint64_t stamp = 0;         // change stamp of the tile when it was encoded (0 = empty)
+        uint8_t codec = 0;
+        ContentHash hash;           // TileStore::hashObject of the bytes
+        std::shared_ptr<const std::vector<unsigned char>> bytes;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> tiles;
+};
+
+// What a save did
+struct SaveStats {
+    size_t tilesEncoded = 0;
+    size_t tilesReused = 0;
+    size_t tilesStored = 0;         // new objects added to a tile store (versions only)
+    uint64_t bytesWritten = 0;
+    double milliseconds = 0.0;
+};
+
+// Frozen state of a project for saving. Taking one only copies references:
+// pixel buffers are copy-on-write and mesh arrays are immutable, so the UI
+// thread can keep painting while the snapshot is written elsewhere.
+class ProjectSnapshot {
+public:
+    struct LayerState {
+        int width = 0;
+        int height = 0;
+        int channels = 4;
+        std::shared_ptr<const std::vector<unsigned char>> pixels;   // null if never decoded
+        std::shared_ptr<const ProjectFile> source;                  // where undecoded tiles live
+        uint32_t sourceLayer = 0;
+        std::vector<uint64_t> tileStamps;
+        std::shared_ptr<LayerTileCache> cache;
+    };
+
+    struct MeshState {
+        std::shared_ptr<const std::vector<Vertex>> vertices;
+        std::shared_ptr<const std::vector<unsigned int>> indices;
+    };
+
+    std::string metadata;
+    std::vector<MeshState> meshes;
+    std::vector<LayerState> layers;
+
+    // Latest change stamp covered by this snapshot
+    uint64_t changeStamp = 0;
+
+    // Write as a project file through a temporary file and an atomic rename
+    bool write(const std::string& path, SaveStats& stats) const;
+
+    // Save as a new version in a tile store. Only tiles and meshes the store
+    // does not hold yet are appended; the version itself is a manifest.
+    bool writeVersion(TileStore& store, const std::string& label, SaveStats& stats,
+                      TileStore::VersionInfo& info) const;
+
+private:
+    // Encoded tiles of every decoded layer, compressing only the tiles whose
+    // cache entry is stale
+    void encodeTiles(std::vector<std::vector<LayerTileCache::Entry>>& entries, SaveStats& stats) const;
+};
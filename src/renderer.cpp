@@ -1,9 +1,42 @@
 #include "renderer.h"
+#include "tile_codec.h"
+#include "profiler.h"
+#include "perf_counters.h"
 #include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <glm/gtc/matrix_transform.hpp>
 
-Renderer::Renderer() {
+namespace {
+    // Uniform block binding points, as declared in the shaders
+    const unsigned int LAYER_BLOCK_BINDING = 0;
+    const unsigned int FRAME_BLOCK_BINDING = 1;
+    
+    // Uniform names, hashed at compile time
+    constexpr UniformName LAYER_TEXTURE("layerTexture");
+    constexpr UniformName LAYER_TEXTURES("layerTextures");
+    constexpr UniformName LAYER_OPACITY("layerOpacity");
+    
+    // std140 layout of FrameBlock in the vertex shaders
+    struct FrameBlock {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::mat4 model;
+    };
+    
+    // std140 layout of LayerBlock in shaders/composite.frag
+    struct LayerBlock {
+        int32_t layerCount;
+        int32_t padding[3];
+        float layerParams[Renderer::MAX_GPU_LAYERS][4];    // opacity, blend mode
+    };
+}
+
+Renderer::Renderer()
+    : compositeMode(COMPOSITE_GPU), compositeTexture(0), compositeWidth(0), compositeHeight(0),
+      layerArray(0), layerBlock(0), arrayWidth(0), arrayHeight(0), arrayDepth(0), frameBlock(0),
+      frameUniformCalls(0) {
     // Initialize OpenGL
     if (!gladLoadGL()) {
         throw std::runtime_error("Failed to initialize GLAD");
@@ -11,13 +44,54 @@ Renderer::Renderer() {
     
     initOpenGL();
     
-    // Load shaders
-    basicShader = std::make_unique<Shader>("src/shaders/basic.vert", "src/shaders/basic.frag");
-    paintShader = std::make_unique<Shader>("src/shaders/paint.vert", "src/shaders/paint.frag");
+    // Build shaders: all programs are started before any is waited for, so
+    // they compile in parallel where the driver can, and unchanged programs
+    // come from the binary cache
+    auto startTime = std::chrono::steady_clock::now();
+    programCache = std::make_unique<ProgramCache>();
+    basicShader = std::make_unique<Shader>("basic.vert", "basic.frag", programCache.get());
+    paintShader = std::make_unique<Shader>("paint.vert", "paint.frag", programCache.get());
+    compositeShader = std::make_unique<Shader>("paint.vert", "composite.frag", programCache.get());
+    
+    shaderStartup = ShaderStartup();
+    for (Shader* shader : {basicShader.get(), paintShader.get(), compositeShader.get()}) {
+        shader->finish();
+        shaderStartup.programs++;
+        shaderStartup.cached += shader->isFromCache() ? 1 : 0;
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    shaderStartup.milliseconds = elapsed.count();
+    std::cout << "Shaders ready in " << shaderStartup.milliseconds << " ms ("
+              << (shaderStartup.cached == shaderStartup.programs ? "warm" : "cold") << " start, "
+              << shaderStartup.cached << "/" << shaderStartup.programs << " from cache)" << std::endl;
+    
+    // Uniforms that never change are set once
+    paintShader->use();
+    paintShader->setInt(LAYER_TEXTURE, 0);
+    paintShader->setFloat(LAYER_OPACITY, 1.0f);
+    compositeShader->use();
+    compositeShader->setInt(LAYER_TEXTURES, 0);
+    glUseProgram(0);
+    
+    // Per-frame transforms shared by all programs
+    glGenBuffers(1, &frameBlock);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBlock);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 Renderer::~Renderer() {
-    // Cleanup handled by shader destructors
+    // Shaders are cleaned up by their destructors
+    if (compositeTexture != 0) {
+        glDeleteTextures(1, &compositeTexture);
+    }
+    if (layerArray != 0) {
+        glDeleteTextures(1, &layerArray);
+        glDeleteBuffers(1, &layerBlock);
+    }
+    if (frameBlock != 0) {
+        glDeleteBuffers(1, &frameBlock);
+    }
 }
 
 void Renderer::initOpenGL() {
@@ -31,9 +105,24 @@ void Renderer::initOpenGL() {
     // Enable blending
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    // Let the driver compile shaders on as many threads as it likes
+#ifdef GLAD_GL_KHR_parallel_shader_compile
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    }
+#endif
+#ifdef GLAD_GL_ARB_parallel_shader_compile
+    if (GLAD_GL_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+    }
+#endif
 }
 
 void Renderer::render(const Model& model, const Camera& camera, const Project& project) {
+    PROFILE_SCOPE("Renderer::render");
+    uint64_t uniformCallsBefore = Shader::getUniformCallCount();
+    
     // Set viewport dimensions
     int viewportWidth, viewportHeight;
     glfwGetFramebufferSize(glfwGetCurrentContext(), &viewportWidth, &viewportHeight);
@@ -42,90 +131,206 @@ void Renderer::render(const Model& model, const Camera& camera, const Project& p
     // Clear buffers
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
-    // Render each mesh
-    for (const auto& mesh : model.getMeshes()) {
-        renderMesh(mesh, camera);
-    }
+    // Cull meshes outside the view; both passes draw the same list
+    Frustum frustum = Frustum::fromMatrix(camera.getProjectionMatrix() * camera.getViewMatrix());
+    cullStats.meshes = model.getMeshBounds().size();
+    cullStats.meshesDrawn = model.getMeshBounds().cull(frustum, visibleMeshes);
+    
+    // Per-frame state is uploaded once for all programs
+    FrameBlock frame;
+    frame.projection = camera.getProjectionMatrix();
+    frame.view = camera.getViewMatrix();
+    frame.model = glm::mat4(1.0f);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBlock);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, frameBlock);
+    
+    // The whole model is a single indirect draw
+    basicShader->use();
+    model.getGeometry().draw(visibleMeshes);
     
     // Apply paint layers
-    applyPaintLayers(model, camera, project);
+    applyPaintLayers(model, project);
+    
+    frameUniformCalls = Shader::getUniformCallCount() - uniformCallsBefore;
 }
 
-void Renderer::renderMesh(const Mesh& mesh, const Camera& camera) {
-    // Use basic shader
-    basicShader->use();
-    
-    // Set view and projection matrices
-    glm::mat4 projection = camera.getProjectionMatrix();
-    glm::mat4 view = camera.getViewMatrix();
-    basicShader->setMat4("projection", projection);
-    basicShader->setMat4("view", view);
+void Renderer::applyPaintLayers(const Model& model, const Project& project) {
+    Arena::Scope scope(Arena::frame());
+    CompositeLayers layers{ArenaAllocator<CompositeLayer>(scope.get())};
+    if (compositeMode == COMPOSITE_GPU) {
+        layers = project.getCompositeLayers(scope.get());
+    }
     
-    // Set model matrix
-    glm::mat4 model = glm::mat4(1.0f);
-    basicShader->setMat4("model", model);
+    if (compositeMode == COMPOSITE_GPU && layers.size() <= MAX_GPU_LAYERS) {
+        // All layers are blended by the fragment shader in one pass
+        uploadLayerArray(layers, project.getTextureWidth(), project.getTextureHeight());
+        layers.clear();     // release the pixels so painting does not copy them
+        if (layerArray == 0) {
+            return;
+        }
+        
+        compositeShader->use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, layerArray);
+        glBindBufferBase(GL_UNIFORM_BUFFER, LAYER_BLOCK_BINDING, layerBlock);
+    } else {
+        // Layers are blended on the CPU; draw their composite in one pass
+        layers.clear();
+        const Compositor& compositor = project.updateComposite();
+        uploadComposite(compositor);
+        if (compositeTexture == 0) {
+            return;
+        }
+        
+        paintShader->use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, compositeTexture);
+    }
     
-    // Bind the VAO and draw
-    glBindVertexArray(mesh.getVAO());
+    model.getGeometry().draw(visibleMeshes);
+}
+
+void Renderer::uploadComposite(const Compositor& compositor) {
+    int width = compositor.getWidth();
+    int height = compositor.getHeight();
+    if (width <= 0 || height <= 0) {
+        return;
+    }
     
-    if (mesh.hasIndices()) {
-        glDrawElements(GL_TRIANGLES, mesh.getIndicesCount(), GL_UNSIGNED_INT, 0);
+    const std::vector<unsigned char>& pixels = compositor.getResult();
+    if (compositeTexture == 0) {
+        glGenTextures(1, &compositeTexture);
+        glBindTexture(GL_TEXTURE_2D, compositeTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     } else {
-        glDrawArrays(GL_TRIANGLES, 0, mesh.getVerticesCount());
+        glBindTexture(GL_TEXTURE_2D, compositeTexture);
     }
     
-    glBindVertexArray(0);
+    if (width != compositeWidth || height != compositeHeight) {
+        // New size: the whole composite was rebuilt anyway
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        PerfCounters::add(PerfCounters::UPLOADED_BYTES, static_cast<uint64_t>(width) * height * 4);
+        compositeWidth = width;
+        compositeHeight = height;
+    } else if (!compositor.getUpdatedTiles().empty()) {
+        int columns = TileCodec::tileCount(width);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+        for (size_t tile : compositor.getUpdatedTiles()) {
+            int x = static_cast<int>(tile % columns) * TileCodec::TILE_SIZE;
+            int y = static_cast<int>(tile / columns) * TileCodec::TILE_SIZE;
+            int tileWidth = std::min(TileCodec::TILE_SIZE, width - x);
+            int tileHeight = std::min(TileCodec::TILE_SIZE, height - y);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, tileWidth, tileHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                            &pixels[(static_cast<size_t>(y) * width + x) * 4]);
+            PerfCounters::add(PerfCounters::UPLOADED_BYTES, static_cast<uint64_t>(tileWidth) * tileHeight * 4);
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
 }
 
-void Renderer::applyPaintLayers(const Model& model, const Camera& camera, const Project& project) {
-    // Use paint shader
-    paintShader->use();
+void Renderer::uploadLayerArray(const CompositeLayers& layers, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    
+    if (layerArray == 0) {
+        glGenTextures(1, &layerArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, layerArray);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        
+        glGenBuffers(1, &layerBlock);
+        glBindBuffer(GL_UNIFORM_BUFFER, layerBlock);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(LayerBlock), nullptr, GL_DYNAMIC_DRAW);
+    } else {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, layerArray);
+    }
+    
+    int depth = std::max(static_cast<int>(layers.size()), 1);
+    if (width != arrayWidth || height != arrayHeight || depth > arrayDepth) {
+        // New storage; every slot is uploaded again
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, depth, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        arrayWidth = width;
+        arrayHeight = height;
+        arrayDepth = depth;
+        arraySlots.clear();
+    }
+    arraySlots.resize(layers.size());
     
-    // Set view and projection matrices
-    glm::mat4 projection = camera.getProjectionMatrix();
-    glm::mat4 view = camera.getViewMatrix();
-    paintShader->setMat4("projection", projection);
-    paintShader->setMat4("view", view);
+    LayerBlock block = {};
+    block.layerCount = static_cast<int32_t>(layers.size());
     
-    // Set model matrix
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-    paintShader->setMat4("model", modelMatrix);
+    int columns = TileCodec::tileCount(width);
+    size_t tiles = static_cast<size_t>(columns) * TileCodec::tileCount(height);
+    size_t layerBytes = static_cast<size_t>(width) * height * 4;
+    std::vector<unsigned char> sampled;
     
-    // Iterate through layers from bottom to top
-    const auto& layers = project.getLayers();
-    for (size_t i = 0; i < layers.size(); ++i) {
-        if (!layers[i]->isVisible()) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    for (size_t i = 0; i < layers.size(); i++) {
+        const CompositeLayer& layer = layers[i];
+        if (!layer.visible || layer.opacity <= 0.0f || !layer.pixels) {
             continue;
         }
+        block.layerParams[i][0] = std::min(layer.opacity, 1.0f);
+        block.layerParams[i][1] = static_cast<float>(layer.mode);
         
-        // Set layer parameters
-        paintShader->setInt("layerIndex", static_cast<int>(i));
-        paintShader->setFloat("layerOpacity", layers[i]->getOpacity());
+        ArraySlot& slot = arraySlots[i];
+        bool reload = slot.id != layer.id || slot.tileStamps.size() != layer.tileCount;
+        int slice = static_cast<int>(i);
         
-        // Bind layer texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, layers[i]->getTextureID());
-        paintShader->setInt("layerTexture", 0);
-        
-        // Draw model with painted layer
-        for (const auto& mesh : model.getMeshes()) {
-            glBindVertexArray(mesh.getVAO());
-            
-            if (mesh.hasIndices()) {
-                glDrawElements(GL_TRIANGLES, mesh.getIndicesCount(), GL_UNSIGNED_INT, 0);
-            } else {
-                glDrawArrays(GL_TRIANGLES, 0, mesh.getVerticesCount());
+        if (layer.width == width && layer.height == height && layer.channels == 4 &&
+            layer.tileCount == tiles && layer.pixels->size() >= layerBytes) {
+            // Same grid as the array: upload the tiles that changed
+            for (size_t tile = 0; tile < tiles; tile++) {
+                if (!reload && slot.tileStamps[tile] == layer.tileStamps[tile]) {
+                    continue;
+                }
+                int x = static_cast<int>(tile % columns) * TileCodec::TILE_SIZE;
+                int y = static_cast<int>(tile / columns) * TileCodec::TILE_SIZE;
+                int tileWidth = std::min(TileCodec::TILE_SIZE, width - x);
+                int tileHeight = std::min(TileCodec::TILE_SIZE, height - y);
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, slice, tileWidth, tileHeight, 1, GL_RGBA,
+                                GL_UNSIGNED_BYTE, layer.pixels->data() + (static_cast<size_t>(y) * width + x) * 4);
+                PerfCounters::add(PerfCounters::UPLOADED_BYTES, static_cast<uint64_t>(tileWidth) * tileHeight * 4);
             }
-            
-            glBindVertexArray(0);
+        } else if (reload || !std::equal(slot.tileStamps.begin(), slot.tileStamps.end(), layer.tileStamps)) {
+            // Other sizes and formats are resampled to the array as a whole
+            Compositor::sampleLayer(layer, width, height, sampled);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slice, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                            sampled.data());
+            PerfCounters::add(PerfCounters::UPLOADED_BYTES, layerBytes);
         }
+        
+        slot.id = layer.id;
+        slot.tileStamps.assign(layer.tileStamps, layer.tileStamps + layer.tileCount);
     }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    
+    glBindBuffer(GL_UNIFORM_BUFFER, layerBlock);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 bool Renderer::pickPosition(const Model& model, const Camera& camera, 
                            double mouseX, double mouseY,
                            int windowWidth, int windowHeight,
                            glm::vec3& outWorldPos) {
+    return pickModel(model, camera, mouseX, mouseY, windowWidth, windowHeight, outWorldPos,
+                     &cullStats.pickCandidates);
+}
+
+bool Renderer::pickModel(const Model& model, const Camera& camera, double mouseX, double mouseY,
+                         int windowWidth, int windowHeight, glm::vec3& outWorldPos, size_t* candidates) {
+    PROFILE_SCOPE("Renderer::pickPosition");
+    auto pickStart = std::chrono::steady_clock::now();
+    
     // Convert mouse position to normalized device coordinates
     float x = (2.0f * mouseX) / windowWidth - 1.0f;
     float y = 1.0f - (2.0f * mouseY) / windowHeight;
@@ -150,56 +355,36 @@ bool Renderer::pickPosition(const Model& model, const Camera& camera,
     float closestDist = std::numeric_limits<float>::max();
     bool hasIntersection = false;
     
-    for (const auto& mesh : model.getMeshes()) {
-        // Get mesh vertices and indices
-        const auto& vertices = mesh.getVertices();
-        const auto& indices = mesh.getIndices();
+    // Only meshes in view whose bounding sphere the ray passes are tested
+    Arena::Scope scope(Arena::frame());
+    const BoundsList& bounds = model.getMeshBounds();
+    uint8_t* inView = ArenaAllocator<uint8_t>(scope.get()).allocate(bounds.size());
+    Frustum frustum = Frustum::fromMatrix(camera.getProjectionMatrix() * camera.getViewMatrix());
+    bounds.cull(frustum, inView);
+    size_t tested = 0;
+    
+    const auto& meshes = model.getMeshes();
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const Mesh& mesh = meshes[m];
+        if (!inView[m] || !mesh.getBounds().rayHitsSphere(rayOrigin, rayWorld)) {
+            continue;
+        }
+        tested++;
         
-        // Iterate through triangles
-        for (size_t i = 0; i < indices.size(); i += 3) {
-            glm::vec3 v0 = vertices[indices[i]].Position;
-            glm::vec3 v1 = vertices[indices[i+1]].Position;
-            glm::vec3 v2 = vertices[indices[i+2]].Position;
-            
-            // Ray-triangle intersection
-            glm::vec3 e1 = v1 - v0;
-            glm::vec3 e2 = v2 - v0;
-            glm::vec3 p = glm::cross(rayWorld, e2);
-            float det = glm::dot(e1, p);
-            
-            // If ray is parallel to triangle
-            if (det < 1e-6 && det > -1e-6) {
-                continue;
-            }
-            
-            float invDet = 1.0f / det;
-            
-            // Calculate barycentric u coordinate
-            glm::vec3 t = rayOrigin - v0;
-            float u = glm::dot(t, p) * invDet;
-            
-            if (u < 0.0f || u > 1.0f) {
-                continue;
-            }
-            
-            // Calculate barycentric v coordinate
-            glm::vec3 q = glm::cross(t, e1);
-            float v = glm::dot(rayWorld, q) * invDet;
-            
-            if (v < 0.0f || u + v > 1.0f) {
-                continue;
-            }
-            
-            // Calculate distance
-            float dist = glm::dot(e2, q) * invDet;
-            
-            if (dist > 1e-6 && dist < closestDist) {
-                closestDist = dist;
-                outWorldPos = rayOrigin + rayWorld * dist;
-                hasIntersection = true;
-            }
+        float dist;
+        if (mesh.intersectRay(rayOrigin, rayWorld, dist) && dist < closestDist) {
+            closestDist = dist;
+            outWorldPos = rayOrigin + rayWorld * dist;
+            hasIntersection = true;
         }
     }
     
+    if (candidates) {
+        *candidates = tested;
+    }
+    
+    std::chrono::duration<double, std::nano> pickTime = std::chrono::steady_clock::now() - pickStart;
+    PerfCounters::add(PerfCounters::PICKS);
+    PerfCounters::add(PerfCounters::PICK_NANOSECONDS, static_cast<uint64_t>(pickTime.count()));
     return hasIntersection;
 }
@@ -4,15 +4,47 @@
 #include "camera.h"
 #include "project.h"
 #include "shader.h"
+#include "program_cache.h"
 
 #include <memory>
+#include <vector>
 #include <glm/glm.hpp>
 
 class Renderer {
 public:
+    // Where paint layers are composited: on the CPU with cached stacks (see
+    // Compositor), or on the GPU from a texture array in a single draw
+    enum CompositeMode {
+        COMPOSITE_CPU,
+        COMPOSITE_GPU
+    };
+    
+    // Deepest stack the GPU path takes; deeper ones fall back to the CPU.
+    // Keep in sync with MAX_LAYERS in shaders/composite.frag.
+    static constexpr int MAX_GPU_LAYERS = 64;
+    
+    // How long building the shaders took at startup, and how many programs
+    // came from the binary cache (all of them = warm start)
+    struct ShaderStartup {
+        double milliseconds = 0.0;
+        int programs = 0;
+        int cached = 0;
+    };
+    
     Renderer();
     ~Renderer();
     
+    const ShaderStartup& getShaderStartup() const { return shaderStartup; }
+    
+    void setCompositeMode(CompositeMode mode) { compositeMode = mode; }
+    CompositeMode getCompositeMode() const { return compositeMode; }
+    
+    // Frustum culling counters of the last frame and pick
+    const CullStats& getCullStats() const { return cullStats; }
+    
+    // Shader uniform calls made by the last frame (see Shader::getUniformCallCount)
+    uint64_t getFrameUniformCalls() const { return frameUniformCalls; }
+    
     // Render model with camera
     void render(const Model& model, const Camera& camera, const Project& project);
     
@@ -22,16 +54,57 @@ public:
                      int windowWidth, int windowHeight,
                      glm::vec3& outWorldPos);
     
+    // The same without a renderer (and GL context), e.g. for headless replay;
+    // candidates receives the number of meshes tested
+    static bool pickModel(const Model& model, const Camera& camera, double mouseX, double mouseY,
+                          int windowWidth, int windowHeight, glm::vec3& outWorldPos, size_t* candidates = nullptr);
+    
 private:
     // Shaders
+    std::unique_ptr<ProgramCache> programCache;
     std::unique_ptr<Shader> basicShader;
     std::unique_ptr<Shader> paintShader;
+    std::unique_ptr<Shader> compositeShader;
     
-    // Render meshes
-    void renderMesh(const Mesh& mesh, const Camera& camera);
+    CompositeMode compositeMode;
+    ShaderStartup shaderStartup;
+    
+    // Meshes inside the view frustum this frame
+    std::vector<uint8_t> visibleMeshes;
+    CullStats cullStats;
+    
+    // GL copy of the project's CPU composite (see Project::updateComposite)
+    unsigned int compositeTexture;
+    int compositeWidth;
+    int compositeHeight;
+    
+    // GPU path: one array slice per layer plus a uniform buffer with the
+    // layer opacities and blend modes. Slots remember the tile stamps they
+    // hold, so only changed tiles are uploaded.
+    struct ArraySlot {
+        const void* id = nullptr;
+        std::vector<uint64_t> tileStamps;
+    };
+    
+    unsigned int layerArray;
+    unsigned int layerBlock;
+    int arrayWidth;
+    int arrayHeight;
+    int arrayDepth;
+    std::vector<ArraySlot> arraySlots;
+    
+    // Uniform buffer with the per-frame transforms
+    unsigned int frameBlock;
+    uint64_t frameUniformCalls;
     
     // Apply paint layers
-    void applyPaintLayers(const Model& model, const Camera& camera, const Project& project);
+    void applyPaintLayers(const Model& model, const Project& project);
+    
+    // Upload the tiles of the composite that changed in its last update
+    void uploadComposite(const Compositor& compositor);
+    
+    // Bring the texture array and layer uniforms up to date
+    void uploadLayerArray(const CompositeLayers& layers, int width, int height);
     
     // Initialize OpenGL
     void initOpenGL();
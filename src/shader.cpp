@@ -1,73 +1,152 @@
 #include "shader.h"
+#include "program_cache.h"
+#include "shader_sources.h"
 #include <glad/glad.h>
+#include <algorithm>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <glm/gtc/type_ptr.hpp>
 
-Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath) {
-    // 1. Retrieve the vertex/fragment source code from filePath
+Shader::Shader(const std::string& vertexName, const std::string& fragmentName, const ProgramCache* cache)
+    : ID(0), vertex(0), fragment(0), cache(cache), cacheKey(0), fromCache(false), finished(false), linked(false) {
+    // 1. Look up the sources (embedded, or from the override directory)
     std::string vertexCode;
     std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
+    if (!ShaderSources::load(vertexName, vertexCode)) {
+        std::cerr << "ERROR::SHADER::SOURCE_NOT_FOUND: " << vertexName << std::endl;
+    }
+    if (!ShaderSources::load(fragmentName, fragmentCode)) {
+        std::cerr << "ERROR::SHADER::SOURCE_NOT_FOUND: " << fragmentName << std::endl;
+    }
     
-    // Ensure ifstream objects can throw exceptions
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    ID = glCreateProgram();
     
-    try {
-        // Open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        
-        // Read file's buffer contents into streams
-        std::stringstream vShaderStream, fShaderStream;
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        
-        // Close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        
-        // Convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    } catch (std::ifstream::failure& e) {
-        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+    // 2. A cached binary of the same sources and driver skips compiling
+    if (cache && cache->isEnabled()) {
+        cacheKey = cache->computeKey(vertexCode, fragmentCode);
+        fromCache = cache->load(cacheKey, ID);
+        if (fromCache) {
+            return;
+        }
     }
     
+    // 3. Compile and link. Nothing is queried here, so drivers that compile
+    // in the background keep going until finish()
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
     
-    // 2. Compile shaders
-    unsigned int vertex, fragment;
-    
-    // Vertex shader
     vertex = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex, 1, &vShaderCode, nullptr);
     glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
     
-    // Fragment shader
     fragment = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fragment, 1, &fShaderCode, nullptr);
     glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
     
-    // Shader program
-    ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
+    if (cache && cache->isEnabled()) {
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
+}
+
+bool Shader::finish() {
+    if (finished) {
+        return linked;
+    }
+    finished = true;
     
-    // Delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    if (fromCache) {
+        linked = true;
+    } else {
+        checkCompileErrors(vertex, "VERTEX");
+        checkCompileErrors(fragment, "FRAGMENT");
+        linked = checkCompileErrors(ID, "PROGRAM");
+        
+        // Delete the shaders as they're linked into our program now and no longer necessary
+        glDetachShader(ID, vertex);
+        glDetachShader(ID, fragment);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        vertex = fragment = 0;
+        
+        if (linked && cache) {
+            cache->store(cacheKey, ID);
+        }
+    }
+    
+    reflectUniforms();
+    return linked;
+}
+
+uint64_t Shader::uniformCalls = 0;
+Shader::UniformHook Shader::uniformHook = nullptr;
+void* Shader::uniformHookData = nullptr;
+
+void Shader::setUniformHook(UniformHook hook, void* userData) {
+    uniformHook = hook;
+    uniformHookData = userData;
+}
+
+void Shader::reflectUniforms() {
+    uniforms.clear();
+    
+    int count = 0;
+    int maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    
+    std::vector<char> buffer(std::max(maxLength, 1));
+    for (int i = 0; i < count; i++) {
+        int length = 0;
+        int size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, static_cast<GLuint>(i), static_cast<GLsizei>(buffer.size()), &length, &size, &type,
+                           buffer.data());
+        
+        // Members of uniform blocks have no location
+        int location = glGetUniformLocation(ID, buffer.data());
+        if (location < 0) {
+            continue;
+        }
+        
+        // Arrays are reported as "name[0]"; register them under their plain name too
+        std::string name(buffer.data(), length);
+        uniforms.push_back({UniformName::computeHash(name.c_str()), location});
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            name.resize(name.size() - 3);
+            uniforms.push_back({UniformName::computeHash(name.c_str()), location});
+        }
+    }
+    
+    std::sort(uniforms.begin(), uniforms.end(),
+              [](const UniformSlot& a, const UniformSlot& b) { return a.hash < b.hash; });
+    for (size_t i = 1; i < uniforms.size(); i++) {
+        if (uniforms[i].hash == uniforms[i - 1].hash && uniforms[i].location != uniforms[i - 1].location) {
+            std::cerr << "WARNING::SHADER::UNIFORM_HASH_COLLISION in program " << ID << std::endl;
+        }
+    }
+}
+
+int Shader::getUniformLocation(UniformName name) const {
+    auto slot = std::lower_bound(uniforms.begin(), uniforms.end(), name.hash,
+                                 [](const UniformSlot& a, uint32_t hash) { return a.hash < hash; });
+    return slot != uniforms.end() && slot->hash == name.hash ? slot->location : -1;
+}
+
+int Shader::locate(UniformName name) const {
+    uniformCalls++;
+    if (uniformHook) {
+        uniformHook(uniformHookData, name.text);
+    }
+    return getUniformLocation(name);
 }
 
 Shader::~Shader() {
+    if (vertex != 0) {
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+    }
     glDeleteProgram(ID);
 }
 
@@ -75,43 +154,79 @@ void Shader::use() const {
     glUseProgram(ID);
 }
 
-void Shader::setBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), static_cast<int>(value));
+void Shader::setBool(UniformName name, bool value) const {
+    int location = locate(name);
+    if (location < 0) {
+        return;
+    }
+    glUniform1i(location, static_cast<int>(value));
 }
 
-void Shader::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setInt(UniformName name, int value) const {
+    int location = locate(name);
+    if (location < 0) {
+        return;
+    }
+    glUniform1i(location, value);
 }
 
-void Shader::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setFloat(UniformName name, float value) const {
+    int location = locate(name);
+    if (location < 0) {
+        return;
+    }
+    glUniform1f(location, value);
 }
 
-void Shader::setVec2(const std::string& name, const glm::vec2& value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+void Shader::setVec2(UniformName name, const glm::vec2& value) const {
+    int location = locate(name);
+    if (location < 0) {
+        return;
+    }
+    glUniform2fv(location, 1, glm::value_ptr(value));
 }
 
-void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+void Shader::setVec3(UniformName name, const glm::vec3& value) const {
+    int location = locate(name);
+    if (location < 0) {
+        return;
+    }
+    glUniform3fv(location, 1, glm::value_ptr(value));
 }
 
-void Shader::setVec4(const std::string& name, const glm::vec4& value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+void Shader::setVec4(UniformName name, const glm::vec4& value) const {
+    int location = locate(name);
+    if (location < 0) {
+        return;
+    }
+    glUniform4fv(location, 1, glm::value_ptr(value));
 }
 
-void Shader::setMat2(const std::string& name, const glm::mat2& mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+void Shader::setMat2(UniformName name, const glm::mat2& mat) const {
+    int location = locate(name);
+    if (location < 0) {
+        return;
+    }
+    glUniformMatrix2fv(location, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
-void Shader::setMat3(const std::string& name, const glm::mat3& mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+void Shader::setMat3(UniformName name, const glm::mat3& mat) const {
+    int location = locate(name);
+    if (location < 0) {
+        return;
+    }
+    glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
-void Shader::setMat4(const std::string& name, const glm::mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+void Shader::setMat4(UniformName name, const glm::mat4& mat) const {
+    int location = locate(name);
+    if (location < 0) {
+        return;
+    }
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
-void Shader::checkCompileErrors(unsigned int shader, const std::string& type) const {
+bool Shader::checkCompileErrors(unsigned int shader, const std::string& type) const {
     int success;
     char infoLog[1024];
     
@@ -128,4 +243,5 @@ void Shader::checkCompileErrors(unsigned int shader, const std::string& type) co
             std::cerr << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << std::endl;
         }
     }
+    return success != 0;
 }
@@ -1,12 +1,44 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 
+// Uniform name with its FNV-1a hash. Built from a string literal the hash is
+// computed at compile time, so setting a uniform is a table lookup without
+// building a std::string or calling glGetUniformLocation.
+struct UniformName {
+    uint32_t hash;
+    const char* text;
+    
+    static constexpr uint32_t computeHash(const char* text) {
+        uint32_t hash = 2166136261u;
+        while (*text) {
+            hash = (hash ^ static_cast<unsigned char>(*text++)) * 16777619u;
+        }
+        return hash;
+    }
+    
+    constexpr UniformName(const char* text) : hash(computeHash(text)), text(text) {}
+    UniformName(const std::string& text) : hash(computeHash(text.c_str())), text(text.c_str()) {}
+};
+
+class ProgramCache;
+
 class Shader {
 public:
-    // Constructor reads and builds the shader
-    Shader(const std::string& vertexPath, const std::string& fragmentPath);
+    // Starts building a program from named sources (see ShaderSources), or
+    // loads it from the cache. Building is completed by finish(), so several
+    // programs can compile in parallel on drivers that support it.
+    Shader(const std::string& vertexName, const std::string& fragmentName, const ProgramCache* cache = nullptr);
+    
+    // Wait for the build, report errors and reflect the uniforms; must be
+    // called before use. Returns false if the program did not link.
+    bool finish();
+    
+    // Whether the program was loaded from a cached binary
+    bool isFromCache() const { return fromCache; }
     
     // Destructor
     ~Shader();
@@ -14,24 +46,60 @@ public:
     // Use the shader program
     void use() const;
     
-    // Utility uniform functions
-    void setBool(const std::string& name, bool value) const;
-    void setInt(const std::string& name, int value) const;
-    void setFloat(const std::string& name, float value) const;
-    void setVec2(const std::string& name, const glm::vec2& value) const;
-    void setVec3(const std::string& name, const glm::vec3& value) const;
-    void setVec4(const std::string& name, const glm::vec4& value) const;
-    void setMat2(const std::string& name, const glm::mat2& mat) const;
-    void setMat3(const std::string& name, const glm::mat3& mat) const;
-    void setMat4(const std::string& name, const glm::mat4& mat) const;
+    // Utility uniform functions; uniforms the program does not use are ignored
+    void setBool(UniformName name, bool value) const;
+    void setInt(UniformName name, int value) const;
+    void setFloat(UniformName name, float value) const;
+    void setVec2(UniformName name, const glm::vec2& value) const;
+    void setVec3(UniformName name, const glm::vec3& value) const;
+    void setVec4(UniformName name, const glm::vec4& value) const;
+    void setMat2(UniformName name, const glm::mat2& mat) const;
+    void setMat3(UniformName name, const glm::mat3& mat) const;
+    void setMat4(UniformName name, const glm::mat4& mat) const;
+    
+    // Location of an active uniform, -1 if there is none
+    int getUniformLocation(UniformName name) const;
     
     // Get program ID
     unsigned int getID() const { return ID; }
     
+    // Instrumentation: every uniform set through any Shader is counted, and
+    // reported to the hook if one is installed (GL thread only)
+    using UniformHook = void (*)(void* userData, const char* name);
+    static void setUniformHook(UniformHook hook, void* userData);
+    static uint64_t getUniformCallCount() { return uniformCalls; }
+    
 private:
+    struct UniformSlot {
+        uint32_t hash;
+        int location;
+    };
+    
     // Program ID
     unsigned int ID;
     
+    // Build state until finish()
+    unsigned int vertex;
+    unsigned int fragment;
+    const ProgramCache* cache;
+    uint64_t cacheKey;
+    bool fromCache;
+    bool finished;
+    bool linked;
+    
+    // Active uniforms reflected after linking, sorted by hash
+    std::vector<UniformSlot> uniforms;
+    
+    static uint64_t uniformCalls;
+    static UniformHook uniformHook;
+    static void* uniformHookData;
+    
+    // Fill the uniform table from the linked program
+    void reflectUniforms();
+    
+    // Location for a set* call, counting it
+    int locate(UniformName name) const;
+    
     // Utility function for checking shader compilation/linking errors
-    void checkCompileErrors(unsigned int shader, const std::string& type) const;
+    bool checkCompileErrors(unsigned int shader, const std::string& type) const;
 };
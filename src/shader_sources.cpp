@@ -0,0 +1,47 @@
+#include "shader_sources.h"
+#include <embedded_shaders.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace ShaderSources {
+    namespace {
+        std::string& overrideDirectory() {
+            static std::string directory = [] {
+                const char* value = std::getenv("PAINTER_SHADER_DIR");
+                return std::string(value ? value : "");
+            }();
+            return directory;
+        }
+    }
+
+    bool load(const std::string& name, std::string& source) {
+        const std::string& directory = overrideDirectory();
+        if (!directory.empty()) {
+            std::ifstream file(directory + "/" + name, std::ios::binary);
+            if (file) {
+                std::stringstream stream;
+                stream << file.rdbuf();
+                source = stream.str();
+                return true;
+            }
+        }
+
+        for (const EmbeddedShaders::Source& embedded : EmbeddedShaders::sources) {
+            if (std::strcmp(embedded.name, name.c_str()) == 0) {
+                source = embedded.text;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void setOverrideDirectory(const std::string& directory) {
+        overrideDirectory() = directory;
+    }
+
+    const std::string& getOverrideDirectory() {
+        return overrideDirectory();
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+// GLSL sources by file name ("basic.vert"). They are embedded into the
+// program at build time from src/shaders; during development a directory
+// with newer versions can be set (or given in PAINTER_SHADER_DIR), and files
+// found there take precedence.
+namespace ShaderSources {
+    // Returns false if the shader is neither in the override directory nor embedded
+    bool load(const std::string& name, std::string& source);
+
+    // Empty to use only the embedded sources
+    void setOverrideDirectory(const std::string& directory);
+    const std::string& getOverrideDirectory();
+}
@@ -8,9 +8,12 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Camera and model transforms, updated once per frame by the renderer
+layout (std140, binding = 1) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    mat4 model;
+};
 
 void main() {
     FragPos = vec3(model * vec4(aPos, 1.0));
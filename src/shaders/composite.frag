@@ -0,0 +1,66 @@
+#version 450 core
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+// Keep in sync with Renderer::MAX_GPU_LAYERS and BlendMode in compositor.h
+const int MAX_LAYERS = 64;
+const int BLEND_MULTIPLY = 1;
+const int BLEND_SCREEN = 2;
+const int BLEND_OVERLAY = 3;
+const int BLEND_ADD = 4;
+
+layout (std140, binding = 0) uniform LayerBlock {
+    int layerCount;
+    vec4 layerParams[MAX_LAYERS];   // x = opacity (0 = hidden), y = blend mode
+};
+
+uniform sampler2DArray layerTextures;
+
+// Backdrop alpha times the blend function, on premultiplied backdrop color
+// (same math as the CPU compositor)
+vec3 blendTerm(int mode, vec3 cb, vec3 cs, float ab) {
+    if (mode == BLEND_MULTIPLY) {
+        return cs * cb;
+    }
+    if (mode == BLEND_SCREEN) {
+        return cb + ab * cs - cs * cb;
+    }
+    if (mode == BLEND_OVERLAY) {
+        vec3 low = 2.0 * cs * cb;
+        vec3 high = ab - 2.0 * (ab - cb) * (1.0 - cs);
+        return mix(high, low, lessThanEqual(2.0 * cb, vec3(ab)));
+    }
+    if (mode == BLEND_ADD) {
+        return min(vec3(ab), cb + ab * cs);
+    }
+    return ab * cs;
+}
+
+void main() {
+    // Composite all layers bottom to top with premultiplied alpha
+    vec4 result = vec4(0.0);
+    for (int i = 0; i < layerCount; i++) {
+        float opacity = layerParams[i].x;
+        if (opacity <= 0.0) {
+            continue;
+        }
+
+        vec4 layerColor = texture(layerTextures, vec3(TexCoords, float(i)));
+        float alpha = layerColor.a * opacity;
+        if (alpha <= 0.0) {
+            continue;
+        }
+
+        float backdropAlpha = result.a;
+        vec3 term = blendTerm(int(layerParams[i].y), result.rgb, layerColor.rgb, backdropAlpha);
+        result.rgb = alpha * (1.0 - backdropAlpha) * layerColor.rgb + alpha * term + (1.0 - alpha) * result.rgb;
+        result.a = alpha + backdropAlpha - alpha * backdropAlpha;
+    }
+
+    // Straight alpha for the regular blend state
+    FragColor = result.a > 0.0 ? vec4(result.rgb / result.a, result.a) : vec4(0.0);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. Each side keeps a cached copy of the other side's index,
+// so the shared cache lines are only touched when the queue looks full or
+// empty.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    // Producer: false if the queue is full
+    bool push(const T& value) {
+        size_t write = writeIndex.load(std::memory_order_relaxed);
+        if (write - cachedReadIndex == Capacity) {
+            cachedReadIndex = readIndex.load(std::memory_order_acquire);
+            if (write - cachedReadIndex == Capacity) {
+                return false;
+            }
+        }
+        slots[write & (Capacity - 1)] = value;
+        writeIndex.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: false if the queue is empty
+    bool pop(T& value) {
+        size_t read = readIndex.load(std::memory_order_relaxed);
+        if (read == cachedWriteIndex) {
+            cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+            if (read == cachedWriteIndex) {
+                return false;
+            }
+        }
+        value = slots[read & (Capacity - 1)];
+        readIndex.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either thread; a snapshot that may be stale by the time it is used
+    bool empty() const {
+        return readIndex.load(std::memory_order_acquire) == writeIndex.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    // Producer side
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    size_t cachedReadIndex = 0;
+
+    // Consumer side
+    alignas(64) std::atomic<size_t> readIndex{0};
+    size_t cachedWriteIndex = 0;
+
+    alignas(64) std::array<T, Capacity> slots;
+};
@@ -1,35 +1,45 @@
 #include "texture.h"
+#include "profiler.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+#ifndef PAINTER_HEADLESS
 #include <glad/glad.h>
+#endif
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
-#include <queue>
+#include <cstring>
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+namespace {
+    // Rows per task of the parallel parts of a fill
+    const size_t FILL_GRAIN_ROWS = 32;
+
+    // Pixels a fill reaches one by one before it compares the rest of the
+    // image in parallel; small fills never scan the whole image
+    const size_t FILL_PARALLEL_PIXELS = 1 << 16;
+}
+
 Texture::Texture(int width, int height) 
-    : width(width), height(height), channels(4) {
+    : textureID(0), width(width), height(height), channels(4),
+      pixels(std::make_shared<std::vector<unsigned char>>()), dirtyMinX(0), dirtyMinY(0), dirtyMaxX(-1), dirtyMaxY(-1),
+      pixelCharge(MemoryStats::LAYER_PIXELS), gpuCharge(MemoryStats::GPU_TEXTURES) {
     
     // Create empty data array
+    std::vector<unsigned char>& data = *pixels;
     data.resize(width * height * channels, 0);
+    pixelCharge.set(data.size());
     
-    // Generate OpenGL texture
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-    // Create texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-    
-    // Unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // The GL texture is created on first use (see upload())
 }
 
-Texture::Texture(const std::string& path) : textureID(0) {
+Texture::Texture(const std::string& path)
+    : textureID(0), pixels(std::make_shared<std::vector<unsigned char>>()), dirtyMinX(0), dirtyMinY(0), dirtyMaxX(-1),
+      dirtyMaxY(-1), pixelCharge(MemoryStats::LAYER_PIXELS), gpuCharge(MemoryStats::GPU_TEXTURES) {
+    std::vector<unsigned char>& data = *pixels;
+    
     // Load image
     stbi_set_flip_vertically_on_load(true);
     unsigned char* imgData = stbi_load(path.c_str(), &width, &height, &channels, 0);
@@ -45,38 +55,43 @@ Texture::Texture(const std::string& path) : textureID(0) {
         data.assign(imgData, imgData + width * height * channels);
         stbi_image_free(imgData);
     }
+    pixelCharge.set(data.size());
     
-    // Generate OpenGL texture
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-    // Upload texture data
-    GLenum format = GL_RGB;
-    if (channels == 1) format = GL_RED;
-    else if (channels == 3) format = GL_RGB;
-    else if (channels == 4) format = GL_RGBA;
+    // The GL texture is created on first use (see upload())
+}
+
+Texture::Texture(int width, int height, std::vector<unsigned char>&& rgba)
+    : textureID(0), width(width), height(height), channels(4),
+      pixels(std::make_shared<std::vector<unsigned char>>(std::move(rgba))), dirtyMinX(0), dirtyMinY(0), dirtyMaxX(-1),
+      dirtyMaxY(-1), pixelCharge(MemoryStats::LAYER_PIXELS), gpuCharge(MemoryStats::GPU_TEXTURES) {
     
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data.data());
+    // Pixels are moved in; guard against a short buffer
+    std::vector<unsigned char>& data = *pixels;
+    data.resize(static_cast<size_t>(width) * height * channels, 0);
+    pixelCharge.set(data.size());
     
-    // Unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // The GL texture is created on first use (see upload())
 }
 
 Texture::~Texture() {
+#ifndef PAINTER_HEADLESS
     if (textureID) {
         glDeleteTextures(1, &textureID);
     }
+#endif
 }
 
 void Texture::bind(unsigned int unit) const {
+    upload();
+#ifndef PAINTER_HEADLESS
     glActiveTexture(GL_TEXTURE0 + unit);
     glBindTexture(GL_TEXTURE_2D, textureID);
+#endif
+}
+
+unsigned int Texture::getID() const {
+    upload();
+    return textureID;
 }
 
 void Texture::clear(const glm::vec4& color) {
@@ -87,6 +102,7 @@ void Texture::clear(const glm::vec4& color) {
     unsigned char a = static_cast<unsigned char>(color.a * 255.0f);
     
     // Fill data array
+    std::vector<unsigned char>& data = writableData();
     for (int i = 0; i < width * height; i++) {
         int baseIndex = i * channels;
         
@@ -115,6 +131,7 @@ void Texture::setPixel(int x, int y, const glm::vec4& color) {
     int baseIndex = (y * width + x) * channels;
     
     // Set pixel data
+    std::vector<unsigned char>& data = writableData();
     if (channels >= 1) data[baseIndex + 0] = r;
     if (channels >= 2) data[baseIndex + 1] = g;
     if (channels >= 3) data[baseIndex + 2] = b;
@@ -122,6 +139,9 @@ void Texture::setPixel(int x, int y, const glm::vec4& color) {
 }
 
 void Texture::applyBrush(int x, int y, const glm::vec4& color, float radius, float hardness) {
+    PROFILE_SCOPE("Texture::applyBrush");
+    PerfCounters::add(PerfCounters::BRUSH_DABS);
+    
     // Determine the rectangular region to update
     int minX = std::max(0, static_cast<int>(x - radius));
     int maxX = std::min(width - 1, static_cast<int>(x + radius));
@@ -168,70 +188,182 @@ void Texture::applyBrush(int x, int y, const glm::vec4& color, float radius, flo
     }
     
     // Update texture
-    updateTexture();
+    markDirty(minX, minY, maxX, maxY);
 }
 
 void Texture::fill(int x, int y, const glm::vec4& color, float tolerance) {
-    if (!isValidCoordinate(x, y)) {
+    PROFILE_SCOPE("Texture::fill");
+    FillPlan plan;
+    Arena arena;
+    planFill(*pixels, width, height, channels, x, y, color, tolerance, plan, arena);
+    applyFill(plan);
+}
+
+void Texture::planFill(const std::vector<unsigned char>& data, int width, int height, int channels, int x, int y,
+                       const glm::vec4& color, float tolerance, FillPlan& plan, Arena& arena) {
+    PROFILE_SCOPE("Texture::planFill");
+    plan = FillPlan();
+    plan.color = color;
+    if (x < 0 || x >= width || y < 0 || y >= height) {
         return;
     }
     
+    auto pixelAt = [&](int px, int py) {
+        size_t baseIndex = (static_cast<size_t>(py) * width + px) * channels;
+        glm::vec4 pixel(0.0f, 0.0f, 0.0f, 1.0f);
+        if (channels >= 1) pixel.r = data[baseIndex + 0] / 255.0f;
+        if (channels >= 2) pixel.g = data[baseIndex + 1] / 255.0f;
+        if (channels >= 3) pixel.b = data[baseIndex + 2] / 255.0f;
+        if (channels >= 4) pixel.a = data[baseIndex + 3] / 255.0f;
+        return pixel;
+    };
+    
     // Get target color to replace
-    glm::vec4 targetColor = getPixel(x, y);
+    glm::vec4 targetColor = pixelAt(x, y);
     
     // If target color is already the fill color, return
     if (glm::length(targetColor - color) < 0.01f) {
         return;
     }
     
-    // Flood fill algorithm using BFS
-    std::vector<bool> visited(width * height, false);
-    std::queue<std::pair<int, int>> queue;
+    // The search compares the pixels it reaches with the target color. Once
+    // it has reached FILL_PARALLEL_PIXELS, and there is more than one core,
+    // the pixels not compared yet are compared in parallel, and the rest of
+    // the search only follows precomputed flags.
+    const unsigned char UNKNOWN = 0;
+    const unsigned char DIFFERENT = 1;
+    const unsigned char SIMILAR = 2;
+    const unsigned char VISITED = 3;
+    auto compare = [&](int px, int py) {
+        float colorDiff = glm::length(pixelAt(px, py) - targetColor);
+        return colorDiff <= tolerance ? SIMILAR : DIFFERENT;
+    };
+    
+    ArenaAllocator<unsigned char> alloc(arena);
+    ArenaVector<unsigned char> flags(static_cast<size_t>(width) * height, UNKNOWN, alloc);
+    ThreadPool& pool = ThreadPool::shared();
+    bool compareAhead = pool.getThreadCount() > 1 && pool.getMaxThreads() > 1 &&
+                        static_cast<size_t>(width) * height > FILL_PARALLEL_PIXELS;
+    auto compareRest = [&]() {
+        pool.parallelFor(0, height, FILL_GRAIN_ROWS, [&](size_t firstRow, size_t lastRow) {
+            for (int py = static_cast<int>(firstRow); py < static_cast<int>(lastRow); py++) {
+                for (int px = 0; px < width; px++) {
+                    unsigned char& flag = flags[static_cast<size_t>(py) * width + px];
+                    if (flag == UNKNOWN) {
+                        flag = compare(px, py);
+                    }
+                }
+            }
+        });
+    };
+    
+    // Flood fill algorithm using BFS. The queue is a vector read from the
+    // front; arena memory is only given back all at once, so the consumed
+    // front is dropped in place instead of growing the vector.
+    ArenaVector<std::pair<int, int>> queue(alloc);
+    size_t head = 0;
     
     // Start with the seed pixel
-    queue.push(std::make_pair(x, y));
-    visited[y * width + x] = true;
+    queue.push_back(std::make_pair(x, y));
+    flags[static_cast<size_t>(y) * width + x] = VISITED;
+    plan.minX = plan.maxX = x;
+    plan.minY = plan.maxY = y;
     
     // Direction vectors for 4-connected flood fill
     const int dx[] = {-1, 0, 1, 0};
     const int dy[] = {0, 1, 0, -1};
     
-    while (!queue.empty()) {
+    size_t reached = 1;
+    while (head < queue.size()) {
+        if (compareAhead && reached >= FILL_PARALLEL_PIXELS) {
+            compareRest();
+            compareAhead = false;
+        }
+        
         // Get current pixel
-        std::pair<int, int> curr = queue.front();
-        queue.pop();
+        std::pair<int, int> curr = queue[head++];
+        if (head >= 4096 && head * 2 >= queue.size()) {
+            queue.erase(queue.begin(), queue.begin() + head);
+            head = 0;
+        }
         
         int cx = curr.first;
         int cy = curr.second;
-        
-        // Set pixel to fill color
-        setPixel(cx, cy, color);
+        plan.minX = std::min(plan.minX, cx);
+        plan.maxX = std::max(plan.maxX, cx);
+        plan.minY = std::min(plan.minY, cy);
+        plan.maxY = std::max(plan.maxY, cy);
         
         // Check neighboring pixels
         for (int i = 0; i < 4; i++) {
             int nx = cx + dx[i];
             int ny = cy + dy[i];
             
-            if (isValidCoordinate(nx, ny) && !visited[ny * width + nx]) {
-                glm::vec4 neighborColor = getPixel(nx, ny);
-                
-                // Check if neighbor color is similar to target color
-                float colorDiff = glm::length(neighborColor - targetColor);
-                if (colorDiff <= tolerance) {
-                    visited[ny * width + nx] = true;
-                    queue.push(std::make_pair(nx, ny));
+            if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
+                unsigned char& flag = flags[static_cast<size_t>(ny) * width + nx];
+                if (flag == UNKNOWN) {
+                    flag = compare(nx, ny);
+                }
+                if (flag == SIMILAR) {
+                    flag = VISITED;
+                    queue.push_back(std::make_pair(nx, ny));
+                    reached++;
+                }
+            }
+        }
+    }
+    
+    // Every visited pixel gets the fill color
+    int maskWidth = plan.maxX - plan.minX + 1;
+    plan.mask.assign(static_cast<size_t>(maskWidth) * (plan.maxY - plan.minY + 1), 0);
+    pool.parallelFor(plan.minY, plan.maxY + 1, FILL_GRAIN_ROWS, [&](size_t firstRow, size_t lastRow) {
+        for (int py = static_cast<int>(firstRow); py < static_cast<int>(lastRow); py++) {
+            for (int px = plan.minX; px <= plan.maxX; px++) {
+                if (flags[static_cast<size_t>(py) * width + px] == VISITED) {
+                    plan.mask[static_cast<size_t>(py - plan.minY) * maskWidth + (px - plan.minX)] = 1;
                 }
             }
         }
+    });
+}
+
+void Texture::applyFill(const FillPlan& plan) {
+    PROFILE_SCOPE("Texture::applyFill");
+    if (plan.empty() || plan.maxX >= width || plan.maxY >= height) {
+        return;
     }
     
+    // Convert color to bytes
+    unsigned char bytes[4] = {
+        static_cast<unsigned char>(plan.color.r * 255.0f),
+        static_cast<unsigned char>(plan.color.g * 255.0f),
+        static_cast<unsigned char>(plan.color.b * 255.0f),
+        static_cast<unsigned char>(plan.color.a * 255.0f)
+    };
+    int pixelBytes = std::min(channels, 4);
+    
+    // Rows are disjoint, so they are written concurrently
+    std::vector<unsigned char>& data = writableData();
+    int maskWidth = plan.maxX - plan.minX + 1;
+    ThreadPool::shared().parallelFor(plan.minY, plan.maxY + 1, FILL_GRAIN_ROWS, [&](size_t firstRow, size_t lastRow) {
+        for (int py = static_cast<int>(firstRow); py < static_cast<int>(lastRow); py++) {
+            const unsigned char* maskRow = &plan.mask[static_cast<size_t>(py - plan.minY) * maskWidth];
+            for (int px = plan.minX; px <= plan.maxX; px++) {
+                if (maskRow[px - plan.minX]) {
+                    std::memcpy(&data[(static_cast<size_t>(py) * width + px) * channels], bytes, pixelBytes);
+                }
+            }
+        }
+    });
+    
     // Update texture
-    updateTexture();
+    markDirty(plan.minX, plan.minY, plan.maxX, plan.maxY);
 }
 
 bool Texture::saveToFile(const std::string& path) const {
     // Determine format from file extension
     std::string extension = path.substr(path.find_last_of('.') + 1);
+    const std::vector<unsigned char>& data = *pixels;
     
     int result = 0;
     if (extension == "png") {
@@ -250,17 +382,113 @@ bool Texture::saveToFile(const std::string& path) const {
     return result != 0;
 }
 
-void Texture::updateTexture() {
-    glBindTexture(GL_TEXTURE_2D, textureID);
+void Texture::readRegion(int x, int y, int regionWidth, int regionHeight, unsigned char* out) const {
+    const std::vector<unsigned char>& data = *pixels;
+    size_t rowBytes = static_cast<size_t>(regionWidth) * channels;
+    for (int row = 0; row < regionHeight; row++) {
+        const unsigned char* src = &data[(static_cast<size_t>(y + row) * width + x) * channels];
+        std::memcpy(out + row * rowBytes, src, rowBytes);
+    }
+}
+
+void Texture::writeRegion(int x, int y, int regionWidth, int regionHeight, const unsigned char* region) {
+    std::vector<unsigned char>& data = writableData();
+    size_t rowBytes = static_cast<size_t>(regionWidth) * channels;
+    for (int row = 0; row < regionHeight; row++) {
+        unsigned char* dst = &data[(static_cast<size_t>(y + row) * width + x) * channels];
+        std::memcpy(dst, region + row * rowBytes, rowBytes);
+    }
     
+    markDirty(x, y, x + regionWidth - 1, y + regionHeight - 1);
+}
+
+std::vector<unsigned char>& Texture::writableData() {
+    // A snapshot (e.g. a background save) still reads the current buffer
+    if (pixels.use_count() > 1) {
+        pixels = std::make_shared<std::vector<unsigned char>>(*pixels);
+    } else {
+        // Pairs with the release when another thread dropped its reference
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    
+    return *pixels;
+}
+
+void Texture::updateTexture() {
+    markDirty(0, 0, width - 1, height - 1);
+}
+
+void Texture::markDirty(int minX, int minY, int maxX, int maxY) {
+    if (dirtyMaxX < dirtyMinX) {
+        dirtyMinX = minX;
+        dirtyMinY = minY;
+        dirtyMaxX = maxX;
+        dirtyMaxY = maxY;
+    } else {
+        dirtyMinX = std::min(dirtyMinX, minX);
+        dirtyMinY = std::min(dirtyMinY, minY);
+        dirtyMaxX = std::max(dirtyMaxX, maxX);
+        dirtyMaxY = std::max(dirtyMaxY, maxY);
+    }
+}
+
+void Texture::upload() const {
+#ifdef PAINTER_HEADLESS
+    // No GL: the pixels stay on the CPU and the ID stays 0
+    dirtyMinX = dirtyMinY = 0;
+    dirtyMaxX = dirtyMaxY = -1;
+#else
     GLenum format = GL_RGB;
     if (channels == 1) format = GL_RED;
     else if (channels == 3) format = GL_RGB;
     else if (channels == 4) format = GL_RGBA;
     
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data.data());
+    const std::vector<unsigned char>& data = *pixels;
+    if (textureID == 0) {
+        // Generate OpenGL texture
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        
+        // Set texture parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        
+        // Create texture
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        PerfCounters::add(PerfCounters::UPLOADED_BYTES, data.size());
+        gpuCharge.set(data.size());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        dirtyMinX = dirtyMinY = 0;
+        dirtyMaxX = dirtyMaxY = -1;
+        return;
+    }
     
+    int minX = std::max(dirtyMinX, 0);
+    int minY = std::max(dirtyMinY, 0);
+    int maxX = std::min(dirtyMaxX, width - 1);
+    int maxY = std::min(dirtyMaxY, height - 1);
+    dirtyMinX = dirtyMinY = 0;
+    dirtyMaxX = dirtyMaxY = -1;
+    if (maxX < minX || maxY < minY) {
+        return;
+    }
+    
+    // Upload straight from the full buffer, one row stride apart
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, minX, minY, maxX - minX + 1, maxY - minY + 1, format, GL_UNSIGNED_BYTE,
+                    &data[(static_cast<size_t>(minY) * width + minX) * channels]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     glBindTexture(GL_TEXTURE_2D, 0);
+    PerfCounters::add(PerfCounters::UPLOADED_BYTES,
+                      static_cast<uint64_t>(maxX - minX + 1) * (maxY - minY + 1) * channels);
+#endif
 }
 
 glm::vec4 Texture::getPixel(int x, int y) const {
@@ -273,6 +501,7 @@ glm::vec4 Texture::getPixel(int x, int y) const {
     glm::vec4 color(0.0f, 0.0f, 0.0f, 1.0f);
     
     // Get pixel data
+    const std::vector<unsigned char>& data = *pixels;
     if (channels >= 1) color.r = data[baseIndex + 0] / 255.0f;
     if (channels >= 2) color.g = data[baseIndex + 1] / 255.0f;
     if (channels >= 3) color.b = data[baseIndex + 2] / 255.0f;
@@ -1,9 +1,29 @@
 #pragma once
 
+#include "arena.h"
+#include "memory_budget.h"
 #include <string>
 #include <vector>
+#include <memory>
 #include <glm/glm.hpp>
 
+// Destination of a flood fill, found by Texture::planFill
+struct FillPlan {
+    std::vector<unsigned char> mask;    // 1 for pixels to set, bounding box sized
+    int minX = 0;
+    int minY = 0;
+    int maxX = -1;
+    int maxY = -1;
+    glm::vec4 color;
+    
+    bool empty() const { return maxX < minX; }
+};
+
+// RGBA (or fewer channels) pixels in memory with a GL copy. Edits only touch
+// memory and may run on any thread; the GL texture is created and updated
+// with the edited rectangle when it is next bound, on the GL thread. Edits
+// and binding must not run at the same time (see PaintWorker). Built with
+// PAINTER_HEADLESS there is no GL copy and binding does nothing.
 class Texture {
 public:
     // Create empty texture with specified dimensions
@@ -12,10 +32,13 @@ public:
     // Load texture from file
     Texture(const std::string& path);
     
+    // Create texture from RGBA8 pixel data
+    Texture(int width, int height, std::vector<unsigned char>&& rgba);
+    
     // Destructor
     ~Texture();
     
-    // Bind texture to specified texture unit
+    // Bind texture to specified texture unit, uploading pending edits first
     void bind(unsigned int unit = 0) const;
     
     // Clear texture with color
@@ -30,24 +53,61 @@ public:
     // Fill area starting from specified pixel with a color
     void fill(int x, int y, const glm::vec4& color, float tolerance = 0.1f);
     
+    // The two halves of fill(): the search only reads the pixels it is given,
+    // so it can run on a shared copy while the texture is being used. Its
+    // working memory comes from arena.
+    static void planFill(const std::vector<unsigned char>& data, int width, int height, int channels, int x, int y,
+                         const glm::vec4& color, float tolerance, FillPlan& plan, Arena& arena);
+    void applyFill(const FillPlan& plan);
+    
+    // GL texture with all edits uploaded (GL thread only)
+    unsigned int getID() const;
+    
     // Getters
-    unsigned int getID() const { return textureID; }
     int getWidth() const { return width; }
     int getHeight() const { return height; }
-    const std::vector<unsigned char>& getData() const { return data; }
+    int getChannels() const { return channels; }
+    const std::vector<unsigned char>& getData() const { return *pixels; }
+    
+    // Share the current pixels without copying. The buffer stays unchanged for
+    // as long as it is shared; the texture copies it before its next edit.
+    std::shared_ptr<const std::vector<unsigned char>> sharePixels() const { return pixels; }
+    
+    // Copy a rectangle of raw pixels (getChannels() bytes each, tightly packed rows)
+    void readRegion(int x, int y, int regionWidth, int regionHeight, unsigned char* out) const;
+    
+    // Overwrite a rectangle of raw pixels; only that rectangle is uploaded
+    void writeRegion(int x, int y, int regionWidth, int regionHeight, const unsigned char* data);
     
     // Save texture to file
     bool saveToFile(const std::string& path) const;
     
 private:
-    unsigned int textureID;
+    mutable unsigned int textureID;
     int width;
     int height;
     int channels;
-    std::vector<unsigned char> data;
+    std::shared_ptr<std::vector<unsigned char>> pixels;
+    
+    // Rectangle (inclusive) edited since the last upload
+    mutable int dirtyMinX;
+    mutable int dirtyMinY;
+    mutable int dirtyMaxX;
+    mutable int dirtyMaxY;
     
-    // Update texture data in GPU memory
+    // The pixels and the estimated size of the GL copy
+    MemoryCharge pixelCharge;
+    mutable MemoryCharge gpuCharge;
+    
+    // Pixel buffer for modification, copied first if it is shared
+    std::vector<unsigned char>& writableData();
+    
+    // Mark the whole texture, or a rectangle of it, for upload
     void updateTexture();
+    void markDirty(int minX, int minY, int maxX, int maxY);
+    
+    // Create the GL texture or upload the dirty rectangle (GL thread only)
+    void upload() const;
     
     // Get pixel color at coordinates
     glm::vec4 getPixel(int x, int y) const;
@@ -0,0 +1,319 @@
+#include "thread_pool.h"
+#include "arena.h"
+#include "profiler.h"
+#include "perf_counters.h"
+#include <chrono>
+#include <algorithm>
+
+namespace {
+    // Pool and queue index of the calling thread, when it is a worker
+    thread_local ThreadPool* currentPool = nullptr;
+    thread_local size_t currentQueue = 0;
+}
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : queued(0), maxThreads(0), stopping(false) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i <= threadCount; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+
+    workers.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+    parallelFor(0, count, 1, [&body](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            body(i);
+        }
+    });
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain,
+                             const std::function<void(size_t, size_t)>& body) {
+    if (begin >= end) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    size_t ranges = (end - begin + grain - 1) / grain;
+    size_t threads = getMaxThreads();
+    if (ranges == 1 || threads == 1) {
+        // Same ranges as in parallel, so results split per range match
+        for (size_t first = begin; first < end; first += grain) {
+            body(first, std::min(first + grain, end));
+        }
+        return;
+    }
+
+    // Workers and the caller pull ranges from a shared counter. The state
+    // lives on the caller's stack and the helper tasks in its frame arena,
+    // so a call allocates nothing once the arena has grown. Helpers still
+    // queued when the caller runs out of ranges are taken back out; the
+    // caller only waits for those that were taken (waiting for every queued
+    // helper could deadlock when called from a task).
+    struct State {
+        const std::function<void(size_t, size_t)>& body;
+        size_t begin, end, grain, ranges;
+        std::atomic<size_t> next;
+        size_t finished;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+
+        State(const std::function<void(size_t, size_t)>& body, size_t begin, size_t end, size_t grain, size_t ranges)
+            : body(body), begin(begin), end(end), grain(grain), ranges(ranges), next(0), finished(0) {}
+
+        void work() {
+            try {
+                for (size_t r = next++; r < ranges; r = next++) {
+                    size_t first = begin + r * grain;
+                    body(first, std::min(first + grain, end));
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = ranges;
+            }
+        }
+    };
+
+    struct Helper : Task {
+        State* state = nullptr;
+    };
+
+    State state(body, begin, end, grain, ranges);
+    Arena::Scope scope(Arena::frame());
+    ArenaVector<Helper> helpers(std::min(ranges, threads) - 1, Helper(),
+                                ArenaAllocator<Helper>(scope.get()));
+    for (Helper& helper : helpers) {
+        helper.state = &state;
+        helper.execute = [](Task* task) {
+            State& state = *static_cast<Helper*>(task)->state;
+            state.work();
+
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.finished++;
+            state.done.notify_all();
+        };
+        enqueue(&helper);
+    }
+
+    state.work();
+
+    size_t taken = 0;
+    for (Helper& helper : helpers) {
+        if (!cancel(&helper)) {
+            taken++;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.done.wait(lock, [&state, taken] { return state.finished == taken; });
+    if (state.error) {
+        std::rethrow_exception(state.error);
+    }
+}
+
+size_t ThreadPool::getMaxThreads() const {
+    size_t limit = maxThreads;
+    return limit ? std::min(limit, workers.size() + 1) : workers.size() + 1;
+}
+
+bool ThreadPool::runPendingTask() {
+    Task* task = takeTask();
+    if (!task) {
+        return false;
+    }
+
+    task->execute(task);
+    return true;
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+struct ThreadPool::FunctionTask : Task {
+    std::function<void()> function;
+};
+
+void ThreadPool::enqueue(std::function<void()> function) {
+    FunctionTask* task = new FunctionTask;
+    task->function = std::move(function);
+    task->execute = [](Task* task) {
+        std::unique_ptr<FunctionTask> owned(static_cast<FunctionTask*>(task));
+        owned->function();
+    };
+    enqueue(static_cast<Task*>(task));
+}
+
+void ThreadPool::enqueue(Task* task) {
+    // Workers keep their own tasks; everyone else shares the last queue
+    size_t index = currentPool == this ? currentQueue : workers.size();
+    {
+        Queue& queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        task->queue = index;
+        task->waiting = true;
+        task->next = nullptr;
+        task->previous = queue.back;
+        (queue.back ? queue.back->next : queue.front) = task;
+        queue.back = task;
+        queued++;
+    }
+
+    // Taking the lock orders this with a worker about to sleep
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::cancel(Task* task) {
+    Queue& queue = *queues[task->queue];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!task->waiting) {
+        return false;
+    }
+    unlink(queue, task);
+    return true;
+}
+
+void ThreadPool::unlink(Queue& queue, Task* task) {
+    (task->previous ? task->previous->next : queue.front) = task->next;
+    (task->next ? task->next->previous : queue.back) = task->previous;
+    task->previous = task->next = nullptr;
+    task->waiting = false;
+    queued--;
+}
+
+ThreadPool::Task* ThreadPool::takeTask() {
+    if (queued == 0) {
+        return nullptr;
+    }
+
+    // Own tasks newest first, while they are still in cache
+    size_t count = queues.size();
+    size_t self = currentPool == this ? currentQueue : workers.size();
+    if (self < workers.size()) {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (Task* task = own.back) {
+            unlink(own, task);
+            return task;
+        }
+    }
+
+    // Then the oldest task of the others, starting after this queue so
+    // thieves spread over the victims
+    for (size_t i = 1; i <= count; i++) {
+        Queue& victim = *queues[(self + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (Task* task = victim.front) {
+            unlink(victim, task);
+            return task;
+        }
+    }
+
+    return nullptr;
+}
+
+void ThreadPool::run(size_t index) {
+    currentPool = this;
+    currentQueue = index;
+    PROFILE_THREAD_NAME("Pool worker " + std::to_string(index));
+
+    while (true) {
+        if (Task* task = takeTask()) {
+            auto start = std::chrono::steady_clock::now();
+            task->execute(task);
+            std::chrono::duration<double, std::nano> busy = std::chrono::steady_clock::now() - start;
+            PerfCounters::add(PerfCounters::TASKS);
+            PerfCounters::add(PerfCounters::TASK_NANOSECONDS, static_cast<uint64_t>(busy.count()));
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+    : pool(pool), pending(0), queued(0) {
+}
+
+TaskGroup::~TaskGroup() {
+    wait(false);
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    pending++;
+    queued++;
+    pool.submit([this, task = std::move(task)]() {
+        queued--;
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        pending--;
+        done.notify_all();
+    });
+
+    // A waiting thread may now have a task of this group to help with
+    std::lock_guard<std::mutex> lock(mutex);
+    done.notify_all();
+}
+
+void TaskGroup::wait() {
+    wait(true);
+}
+
+void TaskGroup::wait(bool rethrow) {
+    while (pending > 0) {
+        if (queued > 0 && pool.runPendingTask()) {
+            continue;
+        }
+
+        // Everything left is running on other threads; sleep until it is
+        // done or one of those tasks runs another task in this group
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0 || queued > 0; });
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rethrow && error) {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
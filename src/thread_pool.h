@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool of worker threads for CPU-heavy work: image encoding and
+// decoding, texture operations, mesh processing. Every worker has a deque of
+// its own; tasks queued from a worker go to the back of its deque and run
+// last-in first-out, and idle workers steal from the front of the others.
+// Tasks queued from other threads go to a shared queue.
+//
+// Tasks must not touch OpenGL; results that need uploading are handed back to
+// the thread that owns the context.
+class ThreadPool {
+public:
+    // threadCount 0 = one worker per hardware thread
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task; the future carries its result or exception
+    template <typename F>
+    auto submit(F&& task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        enqueue([packaged]() { (*packaged)(); });
+        return result;
+    }
+
+    // Run body(i) for every i in [0, count) and wait for all of them.
+    // The calling thread works too, so this is safe to call from a task.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    // Run body(first, last) over [begin, end) in ranges of about grain
+    // indices. Ranges are fixed by grain alone, whatever the thread count, so
+    // per-range results combined in range order are deterministic.
+    void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+    // Run one queued task on the calling thread, if there is one. Lets a
+    // thread that waits for tasks help instead of blocking.
+    bool runPendingTask();
+
+    size_t getThreadCount() const { return workers.size(); }
+
+    // Let at most count threads, the caller included, run the ranges of one
+    // parallelFor (0 = all workers and the caller). Only speed depends on
+    // it, not results; for measuring how work scales.
+    void setMaxThreads(size_t count) { maxThreads = count; }
+    size_t getMaxThreads() const;
+
+    // Pool shared by the whole application
+    static ThreadPool& shared();
+
+private:
+    // Queued work. Tasks are linked into their queue in place, so queueing
+    // one allocates nothing; whoever queues a task keeps it alive until it
+    // has run or been cancelled.
+    struct Task {
+        void (*execute)(Task* task) = nullptr;
+        Task* previous = nullptr;
+        Task* next = nullptr;
+        size_t queue = 0;           // queue it was put in
+        bool waiting = false;       // still in that queue
+    };
+
+    // A submitted function; deletes itself once it has run
+    struct FunctionTask;
+
+    struct Queue {
+        std::mutex mutex;
+        Task* front = nullptr;
+        Task* back = nullptr;
+    };
+
+    std::vector<std::thread> workers;
+
+    // One deque per worker, then the queue of outside threads
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<size_t> queued;
+    std::atomic<size_t> maxThreads;
+
+    // Idle workers sleep until a task is queued
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void enqueue(std::function<void()> function);
+    void enqueue(Task* task);
+
+    // Take a task out of its queue if no thread has taken it yet
+    bool cancel(Task* task);
+
+    Task* takeTask();
+    void unlink(Queue& queue, Task* task);
+    void run(size_t index);
+};
+
+// Tasks that are waited for together. wait() runs queued tasks while it
+// waits, so groups can be nested inside tasks without running out of
+// workers. The destructor waits too.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::shared());
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+
+    // Wait for every task run so far; rethrows the first exception thrown
+    void wait();
+
+private:
+    ThreadPool& pool;
+    std::atomic<size_t> pending;    // run but not finished
+    std::atomic<size_t> queued;     // run but not started
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+
+    void wait(bool rethrow);
+};
@@ -0,0 +1,191 @@
+#include "tile_codec.h"
+#include <cstring>
+
+namespace TileCodec {
+    namespace {
+        // Run headers: 0..127 = literal run of (h + 1) pixels,
+        // 128..255 = (h - 126) copies of the following pixel (2..129)
+        const int MAX_LITERAL = 128;
+        const int MIN_REPEAT = 2;
+        const int MAX_REPEAT = 129;
+
+        inline uint32_t loadPixel(const unsigned char* p) {
+            uint32_t value;
+            std::memcpy(&value, p, 4);
+            return value;
+        }
+
+        inline void storePixel(unsigned char* p, uint32_t value) {
+            std::memcpy(p, &value, 4);
+        }
+
+        // Iterates the pixels of a strided region in row-major order
+        struct RegionCursor {
+            const unsigned char* row;
+            int x;
+            int width;
+            size_t rowStride;
+
+            uint32_t next() {
+                uint32_t value = loadPixel(row + x * 4);
+                if (++x == width) {
+                    x = 0;
+                    row += rowStride;
+                }
+                return value;
+            }
+        };
+    }
+
+    Codec encode(const unsigned char* pixels, int width, int height, size_t rowStride,
+                 std::vector<unsigned char>& out) {
+        size_t pixelCount = static_cast<size_t>(width) * height;
+        size_t rawSize = pixelCount * 4;
+        if (pixelCount == 0) {
+            return CODEC_RAW;
+        }
+
+        // Gather pixels contiguously; tiles are small so this stays in cache
+        std::vector<uint32_t> values(pixelCount);
+        RegionCursor cursor = { pixels, 0, width, rowStride };
+        bool solid = true;
+        for (size_t i = 0; i < pixelCount; i++) {
+            values[i] = cursor.next();
+            solid = solid && values[i] == values[0];
+        }
+
+        size_t start = out.size();
+
+        if (solid) {
+            out.resize(start + 4);
+            storePixel(&out[start], values[0]);
+            return CODEC_SOLID;
+        }
+
+        // Run-length encode, giving up as soon as it gets bigger than raw
+        out.reserve(start + rawSize);
+        size_t i = 0;
+        size_t literalStart = 0;
+        size_t literalCount = 0;
+
+        auto flushLiterals = [&]() {
+            while (literalCount > 0) {
+                size_t count = literalCount < MAX_LITERAL ? literalCount : MAX_LITERAL;
+                size_t pos = out.size();
+                out.resize(pos + 1 + count * 4);
+                out[pos] = static_cast<unsigned char>(count - 1);
+                std::memcpy(&out[pos + 1], &values[literalStart], count * 4);
+                literalStart += count;
+                literalCount -= count;
+            }
+        };
+
+        while (i < pixelCount && out.size() - start < rawSize) {
+            size_t run = 1;
+            while (i + run < pixelCount && run < MAX_REPEAT && values[i + run] == values[i]) {
+                run++;
+            }
+
+            if (run >= MIN_REPEAT) {
+                flushLiterals();
+                size_t pos = out.size();
+                out.resize(pos + 5);
+                out[pos] = static_cast<unsigned char>(run + 126);
+                storePixel(&out[pos + 1], values[i]);
+                i += run;
+                literalStart = i;
+            } else {
+                if (literalCount == 0) {
+                    literalStart = i;
+                }
+                literalCount++;
+                i++;
+            }
+        }
+        flushLiterals();
+
+        if (i < pixelCount || out.size() - start >= rawSize) {
+            // Raw is smaller
+            out.resize(start + rawSize);
+            std::memcpy(&out[start], values.data(), rawSize);
+            return CODEC_RAW;
+        }
+
+        return CODEC_RLE;
+    }
+
+    bool decode(Codec codec, const unsigned char* data, size_t size,
+                unsigned char* pixels, int width, int height, size_t rowStride) {
+        size_t pixelCount = static_cast<size_t>(width) * height;
+
+        switch (codec) {
+            case CODEC_RAW: {
+                if (size != pixelCount * 4) {
+                    return false;
+                }
+                for (int y = 0; y < height; y++) {
+                    std::memcpy(pixels + y * rowStride, data + static_cast<size_t>(y) * width * 4, width * 4);
+                }
+                return true;
+            }
+
+            case CODEC_SOLID: {
+                if (size != 4) {
+                    return false;
+                }
+                uint32_t value = loadPixel(data);
+                for (int y = 0; y < height; y++) {
+                    unsigned char* row = pixels + y * rowStride;
+                    for (int x = 0; x < width; x++) {
+                        storePixel(row + x * 4, value);
+                    }
+                }
+                return true;
+            }
+
+            case CODEC_RLE: {
+                const unsigned char* end = data + size;
+                size_t written = 0;
+                unsigned char* row = pixels;
+                int x = 0;
+
+                auto put = [&](uint32_t value) {
+                    storePixel(row + x * 4, value);
+                    if (++x == width) {
+                        x = 0;
+                        row += rowStride;
+                    }
+                };
+
+                while (data < end) {
+                    int header = *data++;
+                    if (header < MAX_LITERAL) {
+                        size_t count = header + 1;
+                        if (static_cast<size_t>(end - data) < count * 4 || written + count > pixelCount) {
+                            return false;
+                        }
+                        for (size_t k = 0; k < count; k++) {
+                            put(loadPixel(data));
+                            data += 4;
+                        }
+                        written += count;
+                    } else {
+                        size_t count = header - 126;
+                        if (end - data < 4 || written + count > pixelCount) {
+                            return false;
+                        }
+                        uint32_t value = loadPixel(data);
+                        data += 4;
+                        for (size_t k = 0; k < count; k++) {
+                            put(value);
+                        }
+                        written += count;
+                    }
+                }
+                return written == pixelCount;
+            }
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Fast lossless codec for RGBA8 layer tiles.
+// Paint layers are mostly empty or made of long runs of the same color, so
+// tiles are stored as a single solid color, as runs of 32-bit pixels, or raw
+// when neither helps. Encoding and decoding are a single pass over the pixels.
+namespace TileCodec {
+    // Edge length of a square layer tile in pixels
+    const int TILE_SIZE = 256;
+
+    enum Codec : uint8_t {
+        CODEC_RAW = 0,
+        CODEC_SOLID = 1,
+        CODEC_RLE = 2
+    };
+
+    // Encode a width x height RGBA8 region (rowStride bytes between rows) and
+    // append the result to out. Returns the codec that was chosen.
+    Codec encode(const unsigned char* pixels, int width, int height, size_t rowStride,
+                 std::vector<unsigned char>& out);
+
+    // Decode data produced by encode() into a region. Returns false if the data is malformed.
+    bool decode(Codec codec, const unsigned char* data, size_t size,
+                unsigned char* pixels, int width, int height, size_t rowStride);
+
+    // Whether encoded data is a fully transparent tile
+    inline bool isTransparent(uint8_t codec, const unsigned char* data, size_t size) {
+        return codec == CODEC_SOLID && size == 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 0;
+    }
+
+    // Number of tiles needed to cover a dimension
+    inline int tileCount(int pixels) {
+        return (pixels + TILE_SIZE - 1) / TILE_SIZE;
+    }
+}
@@ -0,0 +1,500 @@
+#include "tile_store.h"
+#include "file_writer.h"
+#include "mapped_file.h"
+#include "tile_codec.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+    const char PACK_MAGIC[4] = { '3', 'D', 'P', 'T' };
+    const uint32_t PACK_VERSION = 1;
+    const size_t PACK_HEADER_SIZE = 16;
+    const size_t RECORD_HEADER_SIZE = 24;
+
+    uint64_t rotl64(uint64_t value, int shift) {
+        return (value << shift) | (value >> (64 - shift));
+    }
+
+    uint64_t fmix64(uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xFF51AFD7ED558CCDull;
+        k ^= k >> 33;
+        k *= 0xC4CEB9FE1A85EC53ull;
+        k ^= k >> 33;
+        return k;
+    }
+
+    uint64_t loadU64LE(const unsigned char* p) {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; i--) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+
+    void storeU64LE(unsigned char* p, uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            p[i] = static_cast<unsigned char>(value >> (i * 8));
+        }
+    }
+
+    uint32_t loadU32LE(const unsigned char* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    void storeU32LE(unsigned char* p, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            p[i] = static_cast<unsigned char>(value >> (i * 8));
+        }
+    }
+
+    const size_t DEFAULT_CACHE_BUDGET = 256u << 20;
+}
+
+ContentHash ContentHash::compute(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    const uint64_t c1 = 0x87C37B91114253D5ull;
+    const uint64_t c2 = 0x4CF5AD432745937Full;
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    size_t blocks = size / 16;
+    for (size_t i = 0; i < blocks; i++) {
+        uint64_t k1 = loadU64LE(bytes + i * 16);
+        uint64_t k2 = loadU64LE(bytes + i * 16 + 8);
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52DCE729;
+
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495AB5;
+    }
+
+    // Remaining 0-15 bytes
+    const unsigned char* tail = bytes + blocks * 16;
+    size_t rest = size & 15;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for (size_t i = rest; i > 8; i--) {
+        k2 = (k2 << 8) | tail[i - 1];
+    }
+    for (size_t i = std::min<size_t>(rest, 8); i > 0; i--) {
+        k1 = (k1 << 8) | tail[i - 1];
+    }
+    if (rest > 8) {
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    }
+    if (rest > 0) {
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= size;
+    h2 ^= size;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    ContentHash hash;
+    hash.low = h1;
+    hash.high = h2;
+    return hash;
+}
+
+std::string ContentHash::toString() const {
+    static const char DIGITS[] = "0123456789abcdef";
+    std::string text(32, '0');
+    for (int i = 0; i < 16; i++) {
+        text[15 - i] = DIGITS[(high >> (i * 4)) & 15];
+        text[31 - i] = DIGITS[(low >> (i * 4)) & 15];
+    }
+    return text;
+}
+
+bool ContentHash::parse(const std::string& text, ContentHash& hash) {
+    if (text.size() != 32) {
+        return false;
+    }
+
+    uint64_t parts[2] = { 0, 0 };
+    for (size_t i = 0; i < 32; i++) {
+        char c = text[i];
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+        parts[i / 16] = (parts[i / 16] << 4) | static_cast<uint64_t>(digit);
+    }
+
+    hash.high = parts[0];
+    hash.low = parts[1];
+    return true;
+}
+
+TileStore::TileStore()
+    : packSize(0), cacheBytes(0), cacheBudget(DEFAULT_CACHE_BUDGET) {
+}
+
+TileStore::~TileStore() {
+    close();
+}
+
+bool TileStore::open(const std::string& directory) {
+    close();
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(directory) / "versions", error);
+    if (error) {
+        std::cerr << "Failed to create tile store " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    std::string packPath = (std::filesystem::path(directory) / "objects.pack").string();
+    if (!std::filesystem::exists(packPath)) {
+        unsigned char header[PACK_HEADER_SIZE] = {};
+        std::memcpy(header, PACK_MAGIC, sizeof(PACK_MAGIC));
+        storeU32LE(header + 4, PACK_VERSION);
+        if (!writeFileGather(packPath, { { header, sizeof(header) } })) {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!scanPack(packPath)) {
+        return false;
+    }
+
+    pack.open(packPath, std::ios::in | std::ios::out | std::ios::binary);
+    if (!pack.is_open()) {
+        std::cerr << "Failed to open tile pack: " << packPath << std::endl;
+        objects.clear();
+        return false;
+    }
+
+    this->directory = directory;
+    loadVersions();
+    return true;
+}
+
+void TileStore::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pack.is_open()) {
+            pack.close();
+        }
+        objects.clear();
+        versions.clear();
+        packSize = 0;
+        directory.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cachedTiles.clear();
+    cacheIndex.clear();
+    cacheBytes = 0;
+}
+
+bool TileStore::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pack.is_open();
+}
+
+bool TileStore::scanPack(const std::string& path) {
+    uint64_t validSize = 0;
+    uint64_t fileSize = 0;
+    {
+        MappedFile file;
+        if (!file.open(path)) {
+            std::cerr << "Failed to open tile pack: " << path << std::endl;
+            return false;
+        }
+
+        const unsigned char* data = file.data();
+        fileSize = file.size();
+        if (fileSize < PACK_HEADER_SIZE || std::memcmp(data, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0) {
+            std::cerr << "Not a tile pack: " << path << std::endl;
+            return false;
+        }
+        if (loadU32LE(data + 4) != PACK_VERSION) {
+            std::cerr << "Unsupported tile pack version " << loadU32LE(data + 4) << ": " << path << std::endl;
+            return false;
+        }
+
+        // Index every complete record
+        uint64_t offset = PACK_HEADER_SIZE;
+        while (fileSize - offset >= RECORD_HEADER_SIZE) {
+            const unsigned char* record = data + offset;
+            uint32_t size = loadU32LE(record + 16);
+            if (fileSize - offset - RECORD_HEADER_SIZE < size) {
+                break;
+            }
+
+            ContentHash hash;
+            hash.low = loadU64LE(record);
+            hash.high = loadU64LE(record + 8);
+            objects.emplace(hash, Location{ offset + RECORD_HEADER_SIZE, size, record[20] });
+            offset += RECORD_HEADER_SIZE + size;
+        }
+        validSize = offset;
+    }
+
+    // A save interrupted mid-record leaves a partial record behind
+    if (validSize < fileSize) {
+        std::cerr << "Dropping " << fileSize - validSize << " bytes of incomplete data from tile pack: "
+                  << path << std::endl;
+        std::error_code error;
+        std::filesystem::resize_file(path, validSize, error);
+        if (error) {
+            std::cerr << "Failed to truncate tile pack: " << error.message() << std::endl;
+            objects.clear();
+            return false;
+        }
+    }
+
+    packSize = validSize;
+    return true;
+}
+
+void TileStore::loadVersions() {
+    versions.clear();
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(directory) / "versions", error)) {
+        if (entry.path().extension() != ".json") {
+            continue;
+        }
+
+        std::string stem = entry.path().stem().string();
+        if (stem.empty() || !std::all_of(stem.begin(), stem.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+
+        try {
+            std::ifstream file(entry.path());
+            nlohmann::json manifest = nlohmann::json::parse(file);
+
+            VersionInfo info;
+            info.id = static_cast<uint32_t>(std::stoul(stem));
+            info.label = manifest.value("label", std::string());
+            info.time = manifest.value("time", static_cast<int64_t>(0));
+            versions.push_back(info);
+        } catch (const std::exception& e) {
+            std::cerr << "Skipping unreadable version " << entry.path().string() << ": " << e.what() << std::endl;
+        }
+    }
+
+    std::sort(versions.begin(), versions.end(),
+              [](const VersionInfo& a, const VersionInfo& b) { return a.id < b.id; });
+}
+
+std::string TileStore::versionPath(uint32_t id) const {
+    std::string name = std::to_string(id);
+    name.insert(0, name.size() < 6 ? 6 - name.size() : 0, '0');
+    return (std::filesystem::path(directory) / "versions" / (name + ".json")).string();
+}
+
+ContentHash TileStore::hashObject(uint8_t codec, const void* data, size_t size) {
+    return ContentHash::compute(data, size, codec);
+}
+
+bool TileStore::contains(const ContentHash& hash) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return objects.count(hash) != 0;
+}
+
+bool TileStore::put(const ContentHash& hash, uint8_t codec, const void* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pack.is_open()) {
+        return false;
+    }
+    if (objects.count(hash) != 0) {
+        return true;
+    }
+
+    unsigned char header[RECORD_HEADER_SIZE] = {};
+    storeU64LE(header, hash.low);
+    storeU64LE(header + 8, hash.high);
+    storeU32LE(header + 16, static_cast<uint32_t>(size));
+    header[20] = codec;
+
+    pack.seekp(static_cast<std::streamoff>(packSize));
+    pack.write(reinterpret_cast<const char*>(header), sizeof(header));
+    pack.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if (!pack) {
+        std::cerr << "Failed to write to tile pack in " << directory << std::endl;
+        pack.clear();
+        return false;
+    }
+
+    objects.emplace(hash, Location{ packSize + RECORD_HEADER_SIZE, static_cast<uint32_t>(size), codec });
+    packSize += RECORD_HEADER_SIZE + size;
+    return true;
+}
+
+bool TileStore::get(const ContentHash& hash, uint8_t& codec, std::vector<unsigned char>& data) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = objects.find(hash);
+        if (it == objects.end()) {
+            std::cerr << "Object " << hash.toString() << " missing from tile store " << directory << std::endl;
+            return false;
+        }
+
+        const Location& location = it->second;
+        codec = location.codec;
+        data.resize(location.size);
+        pack.seekg(static_cast<std::streamoff>(location.offset));
+        pack.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(location.size));
+        if (!pack) {
+            std::cerr << "Failed to read from tile pack in " << directory << std::endl;
+            pack.clear();
+            return false;
+        }
+    }
+
+    if (hashObject(codec, data.data(), data.size()) != hash) {
+        std::cerr << "Object " << hash.toString() << " is corrupt in tile store " << directory << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TileStore::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pack.flush();
+    if (!pack) {
+        pack.clear();
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const std::vector<unsigned char>> TileStore::getTile(const ContentHash& hash, int width, int height) {
+    TileKey key{ hash, width, height };
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cacheIndex.find(key);
+        if (it != cacheIndex.end()) {
+            cachedTiles.splice(cachedTiles.begin(), cachedTiles, it->second);
+            return it->second->second;
+        }
+    }
+
+    // Decode without holding the cache lock so other tiles can be decoded meanwhile
+    uint8_t codec;
+    std::vector<unsigned char> encoded;
+    if (!get(hash, codec, encoded)) {
+        return nullptr;
+    }
+
+    auto pixels = std::make_shared<std::vector<unsigned char>>(static_cast<size_t>(width) * height * 4);
+    if (!TileCodec::decode(static_cast<TileCodec::Codec>(codec), encoded.data(), encoded.size(),
+                           pixels->data(), width, height, static_cast<size_t>(width) * 4)) {
+        std::cerr << "Failed to decode tile " << hash.toString() << " from tile store " << directory << std::endl;
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cacheIndex.find(key);
+    if (it != cacheIndex.end()) {
+        return it->second->second;
+    }
+
+    cachedTiles.emplace_front(key, pixels);
+    cacheIndex.emplace(key, cachedTiles.begin());
+    cacheBytes += pixels->size();
+    trimCache();
+    return pixels;
+}
+
+void TileStore::setCacheBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheBudget = bytes;
+    trimCache();
+}
+
+void TileStore::trimCache() {
+    // Callers hold cacheMutex. Evicted tiles stay alive for whoever still uses them.
+    while (cacheBytes > cacheBudget && !cachedTiles.empty()) {
+        cacheBytes -= cachedTiles.back().second->size();
+        cacheIndex.erase(cachedTiles.back().first);
+        cachedTiles.pop_back();
+    }
+}
+
+std::vector<TileStore::VersionInfo> TileStore::listVersions() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return versions;
+}
+
+bool TileStore::addVersion(const std::string& label, nlohmann::json manifest, VersionInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pack.is_open()) {
+        return false;
+    }
+
+    info.id = versions.empty() ? 1 : versions.back().id + 1;
+    info.label = label.empty() ? "Version " + std::to_string(info.id) : label;
+    info.time = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    manifest["label"] = info.label;
+    manifest["time"] = info.time;
+    std::string text = manifest.dump();
+
+    // Manifests appear atomically, and only after the objects they name are on disk
+    std::string path = versionPath(info.id);
+    std::string tempPath = path + ".tmp";
+    if (!writeFileGather(tempPath, { { text.data(), text.size() } })) {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::cerr << "Failed to store version " << path << ": " << error.message() << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    versions.push_back(info);
+    return true;
+}
+
+bool TileStore::readVersion(uint32_t id, nlohmann::json& manifest) const {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        path = versionPath(id);
+    }
+
+    try {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Version " << id << " not found in tile store " << directory << std::endl;
+            return false;
+        }
+        manifest = nlohmann::json::parse(file);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error reading version " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+size_t TileStore::getObjectCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return objects.size();
+}
+
+uint64_t TileStore::getPackSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return packSize;
+}
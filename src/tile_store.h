@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// 128-bit content hash (MurmurHash3 x64/128) naming objects in a TileStore
+struct ContentHash {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    static ContentHash compute(const void* data, size_t size, uint64_t seed = 0);
+
+    // 32 lowercase hex digits
+    std::string toString() const;
+    static bool parse(const std::string& text, ContentHash& hash);
+
+    bool isEmpty() const { return low == 0 && high == 0; }
+    bool operator==(const ContentHash& other) const { return low == other.low && high == other.high; }
+    bool operator!=(const ContentHash& other) const { return !(*this == other); }
+};
+
+struct ContentHashHasher {
+    size_t operator()(const ContentHash& hash) const { return static_cast<size_t>(hash.low ^ hash.high); }
+};
+
+// Content-addressed project history.
+//
+// Every distinct encoded tile (and mesh array) is stored once in an
+// append-only pack, keyed by the hash of its bytes. A saved version is only a
+// manifest listing the hashes it uses, so saving a version after a small edit
+// appends just the tiles that changed.
+//
+// Layout of the store directory (next to the project, see directoryFor):
+//   objects.pack          16-byte header, then records of a 24-byte header
+//                         (hash low/high u64, size u32, codec u8, 3 reserved)
+//                         followed by the payload
+//   versions/<id>.json    one manifest per version
+//
+// Decoded tiles are kept in a memory-bounded cache, so opening another
+// version of the same project skips decoding every tile the versions share.
+// All methods are thread-safe.
+class TileStore {
+public:
+    struct VersionInfo {
+        uint32_t id = 0;
+        std::string label;
+        int64_t time = 0;       // seconds since the epoch
+    };
+
+    TileStore();
+    ~TileStore();
+
+    TileStore(const TileStore&) = delete;
+    TileStore& operator=(const TileStore&) = delete;
+
+    // History directory belonging to a project file
+    static std::string directoryFor(const std::string& projectPath) { return projectPath + ".history"; }
+
+    // Open (or create) a store; a torn record at the end of the pack is dropped
+    bool open(const std::string& directory);
+    void close();
+    bool isOpen() const;
+    const std::string& getDirectory() const { return directory; }
+
+    // Hash naming an object: its bytes seeded with the codec
+    static ContentHash hashObject(uint8_t codec, const void* data, size_t size);
+
+    // Objects
+    bool contains(const ContentHash& hash) const;
+    bool put(const ContentHash& hash, uint8_t codec, const void* data, size_t size);
+    bool get(const ContentHash& hash, uint8_t& codec, std::vector<unsigned char>& data) const;
+
+    // Flush appended objects to disk
+    bool flush();
+
+    // Tile decoded to a width x height RGBA8 image, from the cache if possible
+    std::shared_ptr<const std::vector<unsigned char>> getTile(const ContentHash& hash, int width, int height);
+
+    // Maximum memory held by decoded tiles
+    void setCacheBudget(size_t bytes);
+    size_t getCacheBudget() const { return cacheBudget; }
+
+    // Versions, oldest first
+    std::vector<VersionInfo> listVersions() const;
+
+    // Store a manifest as a new version (label and time are added to it);
+    // objects it references must be flushed first
+    bool addVersion(const std::string& label, nlohmann::json manifest, VersionInfo& info);
+    bool readVersion(uint32_t id, nlohmann::json& manifest) const;
+
+    // Statistics
+    size_t getObjectCount() const;
+    uint64_t getPackSize() const;
+
+private:
+    struct Location {
+        uint64_t offset;
+        uint32_t size;
+        uint8_t codec;
+    };
+
+    struct TileKey {
+        ContentHash hash;
+        int width;
+        int height;
+
+        bool operator==(const TileKey& other) const {
+            return hash == other.hash && width == other.width && height == other.height;
+        }
+    };
+
+    struct TileKeyHasher {
+        size_t operator()(const TileKey& key) const {
+            return ContentHashHasher()(key.hash) ^ (static_cast<size_t>(key.width) << 16) ^ key.height;
+        }
+    };
+
+    using TileList = std::list<std::pair<TileKey, std::shared_ptr<const std::vector<unsigned char>>>>;
+
+    std::string directory;
+
+    // Pack file and index
+    mutable std::mutex mutex;
+    mutable std::fstream pack;
+    std::unordered_map<ContentHash, Location, ContentHashHasher> objects;
+    uint64_t packSize;
+    std::vector<VersionInfo> versions;
+
+    // Decoded tiles, most recently used first
+    std::mutex cacheMutex;
+    TileList cachedTiles;
+    std::unordered_map<TileKey, TileList::iterator, TileKeyHasher> cacheIndex;
+    size_t cacheBytes;
+    size_t cacheBudget;
+
+    bool scanPack(const std::string& path);
+    void loadVersions();
+    std::string versionPath(uint32_t id) const;
+    void trimCache();
+};
@@ -1,12 +1,19 @@
 #include "ui.h"
 #include <iostream>
 #include <algorithm>
+#include <cstdio>
 
 UI::UI(GLFWwindow* window) 
     : selectedTool(nullptr),
       loadModelFlag(false),
       saveProjectFlag(false),
-      exportModelFlag(false) {
+      exportModelFlag(false),
+      saveVersionFlag(false),
+      versionToOpen(0),
+      saveTraceFlag(false),
+      gpuCompositing(true),
+      uniformCalls(0),
+      performancePanel(false) {
     
     // Setup ImGui context
     IMGUI_CHECKVERSION();
@@ -47,6 +54,9 @@ void UI::update(float deltaTime, Project& project,
     showToolbar(tools);
     showLayersPanel(project);
     showPropertiesPanel(currentTool);
+    if (performancePanel) {
+        showPerformancePanel();
+    }
     
     // File dialogs
     if (loadModelFlag) {
@@ -71,6 +81,20 @@ void UI::render() {
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+std::vector<InputEvent> UI::takeCommands() {
+    std::vector<InputEvent> taken;
+    taken.swap(commands);
+    return taken;
+}
+
+void UI::queueCommand(ProjectCommand command, int layer) {
+    InputEvent event;
+    event.type = InputEvent::COMMAND;
+    event.a = static_cast<int32_t>(command);
+    event.b = layer;
+    commands.push_back(event);
+}
+
 bool UI::wantCaptureMouse() const {
     return ImGui::GetIO().WantCaptureMouse;
 }
@@ -83,8 +107,7 @@ void UI::showMainMenuBar(Project& project) {
     if (ImGui::BeginMainMenuBar()) {
         if (ImGui::BeginMenu("File")) {
             if (ImGui::MenuItem("New Project")) {
-                project.clear();
-                project.addLayer(); // Add a default layer
+                queueCommand(ProjectCommand::NEW_PROJECT);
             }
             
             if (ImGui::MenuItem("Open Model", "Ctrl+O")) {
@@ -95,6 +118,24 @@ void UI::showMainMenuBar(Project& project) {
                 saveProjectFlag = true;
             }
             
+            // Versions live next to the saved project
+            if (ImGui::MenuItem("Save Version", nullptr, false, !projectPath.empty())) {
+                saveVersionFlag = true;
+            }
+            
+            if (ImGui::BeginMenu("Open Version", !projectPath.empty())) {
+                std::vector<TileStore::VersionInfo> versions = project.listVersions(projectPath);
+                if (versions.empty()) {
+                    ImGui::TextDisabled("No saved versions");
+                }
+                for (auto it = versions.rbegin(); it != versions.rend(); ++it) {
+                    if (ImGui::MenuItem(it->label.c_str())) {
+                        versionToOpen = it->id;
+                    }
+                }
+                ImGui::EndMenu();
+            }
+            
             if (ImGui::MenuItem("Export Model", "Ctrl+E")) {
                 exportModelFlag = true;
             }
@@ -109,20 +150,30 @@ void UI::showMainMenuBar(Project& project) {
         }
         
         if (ImGui::BeginMenu("Edit")) {
-            if (ImGui::MenuItem("Undo", "Ctrl+Z", false, false)) {
-                // TODO: Implement undo
+            UndoHistory& history = project.getUndoHistory();
+            std::string undoLabel = "Undo " + history.getUndoLabel();
+            std::string redoLabel = "Redo " + history.getRedoLabel();
+            
+            if (ImGui::MenuItem(undoLabel.c_str(), "Ctrl+Z", false, history.canUndo())) {
+                queueCommand(ProjectCommand::UNDO);
+            }
+            
+            if (ImGui::MenuItem(redoLabel.c_str(), "Ctrl+Y", false, history.canRedo())) {
+                queueCommand(ProjectCommand::REDO);
             }
             
-            if (ImGui::MenuItem("Redo", "Ctrl+Y", false, false)) {
-                // TODO: Implement redo
+            // Undo memory beyond the budget is kept on disk
+            int budgetMB = static_cast<int>(history.getMemoryBudget() >> 20);
+            if (ImGui::SliderInt("Undo Memory (MB)", &budgetMB, 16, 4096)) {
+                history.setMemoryBudget(static_cast<size_t>(budgetMB) << 20);
             }
+            ImGui::TextDisabled("%zu MB in memory, %llu MB on disk", history.getMemoryUsage() >> 20,
+                                static_cast<unsigned long long>(history.getSpilledBytes() >> 20));
             
             ImGui::Separator();
             
             if (ImGui::MenuItem("Clear All Layers")) {
-                for (size_t i = 0; i < project.getLayers().size(); i++) {
-                    project.getLayer(i)->clear();
-                }
+                queueCommand(ProjectCommand::CLEAR_ALL_LAYERS);
             }
             
             ImGui::EndMenu();
@@ -130,15 +181,15 @@ void UI::showMainMenuBar(Project& project) {
         
         if (ImGui::BeginMenu("Layer")) {
             if (ImGui::MenuItem("Add Layer", "Ctrl+N")) {
-                project.addLayer();
+                queueCommand(ProjectCommand::ADD_LAYER);
             }
             
             if (ImGui::MenuItem("Remove Current Layer", nullptr, false, project.getCurrentLayerIndex() >= 0)) {
-                project.removeLayer(project.getCurrentLayerIndex());
+                queueCommand(ProjectCommand::REMOVE_LAYER, static_cast<int>(project.getCurrentLayerIndex()));
             }
             
             if (ImGui::MenuItem("Clear Current Layer", nullptr, false, project.getCurrentLayerIndex() >= 0)) {
-                project.getCurrentLayer()->clear();
+                queueCommand(ProjectCommand::CLEAR_LAYER);
             }
             
             ImGui::EndMenu();
@@ -149,6 +200,24 @@ void UI::showMainMenuBar(Project& project) {
                 // TODO: Reset camera
             }
             
+            ImGui::MenuItem("GPU Compositing", nullptr, &gpuCompositing);
+            ImGui::MenuItem("Performance", nullptr, &performancePanel);
+            if (ImGui::MenuItem("Save Profiler Trace", "F12")) {
+                saveTraceFlag = true;
+            }
+            
+            ImGui::Separator();
+            ImGui::TextDisabled("Meshes drawn: %zu / %zu", cullStats.meshesDrawn, cullStats.meshes);
+            ImGui::TextDisabled("Meshes tested by last pick: %zu", cullStats.pickCandidates);
+            ImGui::TextDisabled("Uniform calls per frame: %llu", static_cast<unsigned long long>(uniformCalls));
+            ImGui::TextDisabled("Paint commands: %llu", static_cast<unsigned long long>(paintLatency.commands));
+            ImGui::TextDisabled("Input to paint: %.2f ms avg, %.2f ms max", paintLatency.inputToPaint.average(),
+                                paintLatency.inputToPaint.maximum());
+            ImGui::TextDisabled("Input to screen: %.2f ms avg, %.2f ms max", paintLatency.inputToScreen.average(),
+                                paintLatency.inputToScreen.maximum());
+            ImGui::TextDisabled("Frame time: %.2f ms avg, %.2f ms max", paintLatency.frameInterval.average(),
+                                paintLatency.frameInterval.maximum());
+            
             ImGui::EndMenu();
         }
         
@@ -198,14 +267,14 @@ void UI::showLayersPanel(Project& project) {
     
     // Add layer button
     if (ImGui::Button("Add Layer")) {
-        project.addLayer();
+        queueCommand(ProjectCommand::ADD_LAYER);
     }
     
     ImGui::SameLine();
     
     // Remove layer button
     if (ImGui::Button("Remove Layer") && project.getCurrentLayerIndex() >= 0) {
-        project.removeLayer(project.getCurrentLayerIndex());
+        queueCommand(ProjectCommand::REMOVE_LAYER, static_cast<int>(project.getCurrentLayerIndex()));
     }
     
     ImGui::Separator();
@@ -226,7 +295,7 @@ void UI::showLayersPanel(Project& project) {
         // Layer selection
         bool selected = (project.getCurrentLayerIndex() == i);
         if (ImGui::Selectable(layers[i]->getName().c_str(), selected)) {
-            project.setCurrentLayerIndex(i);
+            queueCommand(ProjectCommand::SELECT_LAYER, i);
         }
         
         // Edit layer name on double-click
@@ -253,6 +322,13 @@ void UI::showLayersPanel(Project& project) {
             layers[i]->setOpacity(opacity);
         }
         
+        // Blend mode
+        static const char* const blendModes[] = {"Normal", "Multiply", "Screen", "Overlay", "Add"};
+        int blendMode = layers[i]->getBlendMode();
+        if (ImGui::Combo("##blend", &blendMode, blendModes, BLEND_MODE_COUNT)) {
+            layers[i]->setBlendMode(static_cast<BlendMode>(blendMode));
+        }
+        
         ImGui::PopID();
     }
     
@@ -300,6 +376,88 @@ void UI::showPropertiesPanel(PaintTool* currentTool) {
     ImGui::End();
 }
 
+void UI::showPerformancePanel() {
+    ImGui::SetNextWindowPos(ImVec2(60, 20));
+    ImGui::SetNextWindowSize(ImVec2(320, 640));
+    ImGui::Begin("Performance", &performancePanel);
+    
+    const PerformanceStats& stats = performanceStats;
+    auto megabytes = [](uint64_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+    
+    // Frame times, oldest on the left
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "avg %.2f ms, max %.2f ms", stats.frameAverage, stats.frameMax);
+    ImGui::PlotHistogram("##frames", stats.frameTimes.data(), static_cast<int>(stats.frameTimes.size()), 0, overlay,
+                         0.0f, std::max(stats.frameMax, 16.7f), ImVec2(-1, 80));
+    
+    ImGui::Text("Pick: %.3f ms", stats.pickMilliseconds);
+    ImGui::Text("Dabs per frame: %llu", static_cast<unsigned long long>(stats.dabs));
+    ImGui::Text("Uploaded per frame: %.2f MB", megabytes(stats.uploadedBytes));
+    
+    ImGui::Separator();
+    ImGui::Text("Jobs: %zu workers, %llu tasks per frame", stats.jobThreads,
+                static_cast<unsigned long long>(stats.tasks));
+    char utilization[32];
+    snprintf(utilization, sizeof(utilization), "%.0f%% busy", stats.jobUtilization * 100.0);
+    ImGui::ProgressBar(static_cast<float>(stats.jobUtilization), ImVec2(-1, 0), utilization);
+    
+    ImGui::Separator();
+    const MemoryReport& memory = stats.memory;
+    if (memory.overHard) {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Memory: %.1f MB, over the hard budget", megabytes(memory.total));
+    } else if (memory.overSoft) {
+        ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.3f, 1.0f), "Memory: %.1f MB, over the soft budget", megabytes(memory.total));
+    } else {
+        ImGui::Text("Memory: %.1f MB", megabytes(memory.total));
+    }
+    if (memory.softBudget || memory.hardBudget) {
+        ImGui::Text("Budgets: %.0f MB soft, %.0f MB hard", megabytes(memory.softBudget), megabytes(memory.hardBudget));
+        ImGui::Text("Evictions: %llu (last freed %.1f MB)", static_cast<unsigned long long>(memory.evictions),
+                    megabytes(memory.lastEvicted));
+    }
+    if (ImGui::BeginTable("##subsystemMemory", 2)) {
+        ImGui::TableSetupColumn("Subsystem");
+        ImGui::TableSetupColumn("MB");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < MemoryStats::CATEGORY_COUNT; i++) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(MemoryStats::getName(static_cast<MemoryStats::Category>(i)));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", megabytes(memory.bytes[i]));
+        }
+        ImGui::EndTable();
+    }
+    
+    ImGui::Separator();
+    size_t residentBytes = 0;
+    for (const PerformanceStats::LayerMemory& layer : stats.layers) {
+        residentBytes += layer.bytes;
+    }
+    ImGui::Text("Layers: %.1f MB resident", megabytes(residentBytes));
+    if (ImGui::BeginTable("##layerMemory", 2)) {
+        ImGui::TableSetupColumn("Layer");
+        ImGui::TableSetupColumn("MB");
+        ImGui::TableHeadersRow();
+        for (const PerformanceStats::LayerMemory& layer : stats.layers) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(layer.name.c_str());
+            ImGui::TableNextColumn();
+            if (layer.bytes > 0) {
+                ImGui::Text("%.1f", megabytes(layer.bytes));
+            } else {
+                ImGui::TextDisabled("on disk");
+            }
+        }
+        ImGui::EndTable();
+    }
+    ImGui::Text("Undo: %.1f MB in memory, %.1f MB spilled", megabytes(stats.undoBytes),
+                megabytes(stats.undoSpilledBytes));
+    
+    ImGui::End();
+}
+
 void UI::showOpenModelDialog() {
     ImGui::OpenPopup("Open Model");
     
@@ -363,7 +521,7 @@ void UI::showExportModelDialog() {
         static char path[256] = "";
         ImGui::InputText("Path", path, 256);
         
-        ImGui::TextUnformatted("Supported formats: .obj, .fbx");
+        ImGui::TextUnformatted("Supported formats: .obj, .ply, .glb, .fbx");
         
         ImGui::Separator();
         
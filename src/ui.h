@@ -5,6 +5,9 @@
 #include "imgui_impl_opengl3.h"
 #include "paint_tool.h"
 #include "project.h"
+#include "paint_worker.h"
+#include "performance_monitor.h"
+#include "input_log.h"
 
 #include <GLFW/glfw3.h>
 #include <string>
@@ -35,22 +38,42 @@ public:
     bool shouldLoadModel() const { return loadModelFlag; }
     bool shouldSaveProject() const { return saveProjectFlag; }
     bool shouldExportModel() const { return exportModelFlag; }
+    bool shouldSaveVersion() const { return saveVersionFlag; }
+    uint32_t getVersionToOpen() const { return versionToOpen; }    // 0 = none
+    bool shouldSaveTrace() const { return saveTraceFlag; }
     
     // Clear flags
     void clearModelLoadFlag() { loadModelFlag = false; }
     void clearSaveProjectFlag() { saveProjectFlag = false; }
     void clearExportModelFlag() { exportModelFlag = false; }
+    void clearSaveVersionFlag() { saveVersionFlag = false; }
+    void clearVersionToOpen() { versionToOpen = 0; }
+    void clearSaveTraceFlag() { saveTraceFlag = false; }
     
     // Set flags
     void setModelLoadFlag() { loadModelFlag = true; }
     void setSaveProjectFlag() { saveProjectFlag = true; }
     void setExportModelFlag() { exportModelFlag = true; }
+    void setSaveTraceFlag() { saveTraceFlag = true; }
+    
+    // Project edits picked since the last call, oldest first (COMMAND events)
+    std::vector<InputEvent> takeCommands();
     
     // Get file paths
     const std::string& getModelPath() const { return modelPath; }
     const std::string& getProjectPath() const { return projectPath; }
     const std::string& getExportPath() const { return exportPath; }
     
+    // View options
+    bool useGpuCompositing() const { return gpuCompositing; }
+    bool isPerformancePanelOpen() const { return performancePanel; }
+    
+    // Renderer counters shown in the View menu
+    void setCullStats(const CullStats& stats) { cullStats = stats; }
+    void setUniformCalls(uint64_t calls) { uniformCalls = calls; }
+    void setPaintLatency(const PaintLatency& latency) { paintLatency = latency; }
+    void setPerformanceStats(const PerformanceStats& stats) { performanceStats = stats; }
+    
 private:
     // ImGui context
     ImGuiContext* context;
@@ -62,6 +85,21 @@ private:
     bool loadModelFlag;
     bool saveProjectFlag;
     bool exportModelFlag;
+    bool saveVersionFlag;
+    uint32_t versionToOpen;
+    bool saveTraceFlag;
+    
+    // Edits waiting for Application
+    std::vector<InputEvent> commands;
+    void queueCommand(ProjectCommand command, int layer = 0);
+    
+    // View options
+    bool gpuCompositing;
+    CullStats cullStats;
+    uint64_t uniformCalls;
+    PaintLatency paintLatency;
+    bool performancePanel;
+    PerformanceStats performanceStats;
     
     // File paths
     std::string modelPath;
@@ -73,6 +111,7 @@ private:
     void showToolbar(const std::vector<std::unique_ptr<PaintTool>>& tools);
     void showLayersPanel(Project& project);
     void showPropertiesPanel(PaintTool* currentTool);
+    void showPerformancePanel();
     
     // File dialogs
     void showOpenModelDialog();
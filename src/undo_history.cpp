@@ -0,0 +1,458 @@
+#include "undo_history.h"
+#include "tile_codec.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+    // Size of a tile from the layer size it was captured at
+    void tileSize(int layerWidth, int layerHeight, uint32_t tile, int& width, int& height) {
+        int columns = TileCodec::tileCount(layerWidth);
+        int x = static_cast<int>(tile % columns) * TileCodec::TILE_SIZE;
+        int y = static_cast<int>(tile / columns) * TileCodec::TILE_SIZE;
+        width = std::min(TileCodec::TILE_SIZE, layerWidth - x);
+        height = std::min(TileCodec::TILE_SIZE, layerHeight - y);
+    }
+}
+
+UndoHistory::UndoHistory(size_t memoryBudget)
+    : memoryBudget(memoryBudget), spillFailed(false), stopping(false), spillEnd(0), spillGeneration(0) {
+    std::string name = "3d_model_painter_undo_" +
+                       std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "_" +
+                       std::to_string(reinterpret_cast<uintptr_t>(this)) + ".spill";
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+    spillPath = (error ? std::filesystem::path(name) : directory / name).string();
+
+    worker = std::thread(&UndoHistory::run, this);
+}
+
+UndoHistory::~UndoHistory() {
+    for (auto& entry : trackedLayers) {
+        entry.second.layer->setTileRecorder(nullptr);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    resetSpillFile();
+}
+
+void UndoHistory::beginStep(const std::string& label, const std::vector<Layer*>& layers) {
+    endStep();
+
+    recording = std::make_unique<Step>();
+    recording->label = label;
+    for (Layer* layer : layers) {
+        trackedLayers[layer] = { layer, std::vector<bool>(layer->getTileCount(), false) };
+        layer->setTileRecorder(this);
+    }
+}
+
+void UndoHistory::recordTile(const Layer& layer, size_t tile) {
+    auto it = trackedLayers.find(&layer);
+    if (!recording || it == trackedLayers.end() || tile >= it->second.captured.size() || it->second.captured[tile]) {
+        return;
+    }
+    it->second.captured[tile] = true;
+
+    TileImage image;
+    image.layer = it->second.layer;
+    image.tile = static_cast<uint32_t>(tile);
+    image.layerWidth = layer.getWidth();
+    image.layerHeight = layer.getHeight();
+    image.channels = layer.getTexture()->getChannels();
+
+    auto pixels = std::make_shared<std::vector<unsigned char>>();
+    layer.readTile(tile, *pixels);
+    image.bytes = pixels;
+    recording->tiles.push_back(std::move(image));
+}
+
+void UndoHistory::endStep() {
+    if (!recording) {
+        return;
+    }
+
+    for (auto& entry : trackedLayers) {
+        entry.second.layer->setTileRecorder(nullptr);
+    }
+    trackedLayers.clear();
+
+    // Brush rectangles and fills report more tiles than they change; keep
+    // only tiles whose pixels really differ now
+    std::unique_ptr<Step> step = std::move(recording);
+    std::vector<unsigned char> current;
+    auto unchanged = [&current](const TileImage& image) {
+        if (image.layer->getWidth() != image.layerWidth || image.layer->getHeight() != image.layerHeight) {
+            return true;
+        }
+        image.layer->readTile(image.tile, current);
+        return current == *image.bytes;
+    };
+    step->tiles.erase(std::remove_if(step->tiles.begin(), step->tiles.end(), unchanged), step->tiles.end());
+    if (step->tiles.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        undoSteps.push_back(std::move(step));
+        redoSteps.clear();
+        if (spilledBytes() == 0) {
+            resetSpillFile();
+        }
+    }
+    wake.notify_one();
+}
+
+bool UndoHistory::canUndo() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !undoSteps.empty();
+}
+
+bool UndoHistory::canRedo() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !redoSteps.empty();
+}
+
+std::string UndoHistory::getUndoLabel() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return undoSteps.empty() ? std::string() : undoSteps.back()->label;
+}
+
+std::string UndoHistory::getRedoLabel() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return redoSteps.empty() ? std::string() : redoSteps.back()->label;
+}
+
+bool UndoHistory::undo() {
+    endStep();
+    return swapStep(undoSteps, redoSteps);
+}
+
+bool UndoHistory::redo() {
+    endStep();
+    return swapStep(redoSteps, undoSteps);
+}
+
+bool UndoHistory::swapStep(StepList& from, StepList& to) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (from.empty()) {
+            return false;
+        }
+
+        std::shared_ptr<Step> step = from.back();
+        from.pop_back();
+
+        std::vector<unsigned char> pixels;
+        for (TileImage& image : step->tiles) {
+            Layer* layer = image.layer;
+            if (layer->getWidth() != image.layerWidth || layer->getHeight() != image.layerHeight ||
+                layer->getTexture()->getChannels() != image.channels) {
+                continue;
+            }
+            if (!loadImage(image, pixels)) {
+                std::cerr << "Failed to restore tile " << image.tile << " of layer " << layer->getName() << std::endl;
+                continue;
+            }
+
+            // The current pixels become what the opposite direction restores
+            auto current = std::make_shared<std::vector<unsigned char>>();
+            layer->readTile(image.tile, *current);
+            layer->writeTile(image.tile, pixels.data());
+
+            image.bytes = current;
+            image.encoded = false;
+            image.spillSize = 0;
+        }
+
+        step->compressed = false;
+        to.push_back(step);
+    }
+    wake.notify_one();
+
+    return true;
+}
+
+bool UndoHistory::loadImage(const TileImage& image, std::vector<unsigned char>& pixels) {
+    std::vector<unsigned char> spilled;
+    const std::vector<unsigned char>* bytes = image.bytes.get();
+    if (!bytes) {
+        std::lock_guard<std::mutex> lock(spillMutex);
+        spilled.resize(image.spillSize);
+        spillFile.seekg(static_cast<std::streamoff>(image.spillOffset));
+        spillFile.read(reinterpret_cast<char*>(spilled.data()), image.spillSize);
+        if (!spillFile) {
+            spillFile.clear();
+            return false;
+        }
+        bytes = &spilled;
+    }
+
+    if (!image.encoded) {
+        pixels = *bytes;
+        return true;
+    }
+
+    int width, height;
+    tileSize(image.layerWidth, image.layerHeight, image.tile, width, height);
+    pixels.resize(static_cast<size_t>(width) * height * 4);
+    return TileCodec::decode(static_cast<TileCodec::Codec>(image.codec), bytes->data(), bytes->size(),
+                             pixels.data(), width, height, static_cast<size_t>(width) * 4);
+}
+
+void UndoHistory::forgetLayer(const Layer* layer) {
+    if (trackedLayers.erase(layer) && recording) {
+        auto& tiles = recording->tiles;
+        tiles.erase(std::remove_if(tiles.begin(), tiles.end(),
+                                   [layer](const TileImage& image) { return image.layer == layer; }),
+                    tiles.end());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (StepList* steps : { &undoSteps, &redoSteps }) {
+        for (auto it = steps->begin(); it != steps->end();) {
+            auto& tiles = (*it)->tiles;
+            tiles.erase(std::remove_if(tiles.begin(), tiles.end(),
+                                       [layer](const TileImage& image) { return image.layer == layer; }),
+                        tiles.end());
+            it = tiles.empty() ? steps->erase(it) : it + 1;
+        }
+    }
+}
+
+void UndoHistory::clear() {
+    if (recording) {
+        for (auto& entry : trackedLayers) {
+            entry.second.layer->setTileRecorder(nullptr);
+        }
+        trackedLayers.clear();
+        recording.reset();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    undoSteps.clear();
+    redoSteps.clear();
+    resetSpillFile();
+}
+
+void UndoHistory::setMemoryBudget(size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        memoryBudget = bytes;
+    }
+    wake.notify_one();
+}
+
+size_t UndoHistory::getMemoryBudget() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memoryBudget;
+}
+
+size_t UndoHistory::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memoryUsage();
+}
+
+uint64_t UndoHistory::getSpilledBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return spilledBytes();
+}
+
+size_t UndoHistory::memoryUsage() const {
+    size_t bytes = 0;
+    for (const StepList* steps : { &undoSteps, &redoSteps }) {
+        for (const auto& step : *steps) {
+            for (const TileImage& image : step->tiles) {
+                bytes += image.bytes ? image.bytes->size() : 0;
+            }
+        }
+    }
+    return bytes;
+}
+
+uint64_t UndoHistory::spilledBytes() const {
+    uint64_t bytes = 0;
+    for (const StepList* steps : { &undoSteps, &redoSteps }) {
+        for (const auto& step : *steps) {
+            for (const TileImage& image : step->tiles) {
+                bytes += image.bytes ? 0 : image.spillSize;
+            }
+        }
+    }
+    return bytes;
+}
+
+std::shared_ptr<UndoHistory::Step> UndoHistory::nextUncompressed() const {
+    // Most recent first: those are the likeliest to be undone
+    for (const StepList* steps : { &undoSteps, &redoSteps }) {
+        for (auto it = steps->rbegin(); it != steps->rend(); ++it) {
+            if (!(*it)->compressed) {
+                return *it;
+            }
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<UndoHistory::Step> UndoHistory::nextToSpill() const {
+    if (spillFailed || memoryUsage() <= memoryBudget) {
+        return nullptr;
+    }
+
+    // Oldest undo steps first, then the redo steps furthest away
+    for (const StepList* steps : { &undoSteps, &redoSteps }) {
+        for (const auto& step : *steps) {
+            for (const TileImage& image : step->tiles) {
+                if (image.bytes) {
+                    return step;
+                }
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool UndoHistory::hasWork() const {
+    return nextUncompressed() != nullptr || nextToSpill() != nullptr;
+}
+
+void UndoHistory::resetSpillFile() {
+    std::lock_guard<std::mutex> lock(spillMutex);
+    if (spillFile.is_open()) {
+        spillFile.close();
+    }
+    if (spillEnd > 0) {
+        std::error_code error;
+        std::filesystem::remove(spillPath, error);
+    }
+    spillEnd = 0;
+    spillGeneration++;
+    spillFailed = false;
+}
+
+void UndoHistory::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || hasWork(); });
+        if (stopping) {
+            return;
+        }
+
+        if (std::shared_ptr<Step> step = nextUncompressed()) {
+            compress(step, lock);
+        } else if (std::shared_ptr<Step> step = nextToSpill()) {
+            spill(step, lock);
+        }
+    }
+}
+
+void UndoHistory::compress(const std::shared_ptr<Step>& step, std::unique_lock<std::mutex>& lock) {
+    struct Job {
+        size_t index = 0;
+        std::shared_ptr<const std::vector<unsigned char>> raw;
+        int width = 0;
+        int height = 0;
+        uint8_t codec = TileCodec::CODEC_RAW;
+        std::shared_ptr<std::vector<unsigned char>> encoded;
+    };
+
+    std::vector<Job> jobs;
+    for (size_t i = 0; i < step->tiles.size(); i++) {
+        const TileImage& image = step->tiles[i];
+        if (image.bytes && !image.encoded && image.channels == 4) {
+            Job job;
+            job.index = i;
+            job.raw = image.bytes;
+            tileSize(image.layerWidth, image.layerHeight, image.tile, job.width, job.height);
+            jobs.push_back(job);
+        }
+    }
+    step->compressed = true;
+
+    lock.unlock();
+    for (Job& job : jobs) {
+        job.encoded = std::make_shared<std::vector<unsigned char>>();
+        job.codec = TileCodec::encode(job.raw->data(), job.width, job.height, static_cast<size_t>(job.width) * 4,
+                                      *job.encoded);
+        job.encoded->shrink_to_fit();
+    }
+    lock.lock();
+
+    // Tiles swapped by an undo or redo meanwhile keep their new pixels
+    for (const Job& job : jobs) {
+        if (job.index < step->tiles.size() && step->tiles[job.index].bytes == job.raw) {
+            TileImage& image = step->tiles[job.index];
+            image.bytes = job.encoded;
+            image.encoded = true;
+            image.codec = job.codec;
+        }
+    }
+}
+
+void UndoHistory::spill(const std::shared_ptr<Step>& step, std::unique_lock<std::mutex>& lock) {
+    struct Job {
+        size_t index;
+        std::shared_ptr<const std::vector<unsigned char>> bytes;
+        uint64_t offset;
+    };
+
+    std::vector<Job> jobs;
+    for (size_t i = 0; i < step->tiles.size(); i++) {
+        if (step->tiles[i].bytes) {
+            jobs.push_back({ i, step->tiles[i].bytes, 0 });
+        }
+    }
+
+    lock.unlock();
+    bool written = true;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> spillLock(spillMutex);
+        generation = spillGeneration;
+        if (!spillFile.is_open()) {
+            spillFile.open(spillPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        }
+
+        spillFile.seekp(static_cast<std::streamoff>(spillEnd));
+        for (Job& job : jobs) {
+            job.offset = spillEnd;
+            spillFile.write(reinterpret_cast<const char*>(job.bytes->data()),
+                            static_cast<std::streamsize>(job.bytes->size()));
+            spillEnd += job.bytes->size();
+        }
+        spillFile.flush();
+        if (!spillFile) {
+            spillFile.clear();
+            written = false;
+        }
+    }
+    lock.lock();
+
+    if (!written) {
+        std::cerr << "Failed to write undo spill file " << spillPath << "; keeping undo steps in memory" << std::endl;
+        spillFailed = true;
+        return;
+    }
+
+    std::lock_guard<std::mutex> spillLock(spillMutex);
+    if (generation != spillGeneration) {
+        return;
+    }
+    for (const Job& job : jobs) {
+        if (job.index < step->tiles.size() && step->tiles[job.index].bytes == job.bytes) {
+            TileImage& image = step->tiles[job.index];
+            image.spillOffset = job.offset;
+            image.spillSize = static_cast<uint32_t>(job.bytes->size());
+            image.bytes = nullptr;
+        }
+    }
+}
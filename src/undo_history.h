@@ -0,0 +1,131 @@
+#pragma once
+
+#include "layer.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Tile-based undo and redo for layer edits.
+//
+// A step keeps the previous pixels of only the tiles its edits touched,
+// captured right before the first modification (see TileRecorder). Undoing a
+// step swaps those tiles with the current ones, which turns it into its own
+// redo step, so both directions cost O(touched tiles).
+//
+// Finished steps are compressed with TileCodec on a worker thread. When the
+// history grows past its memory budget, the oldest steps are moved to a
+// spill file on disk and only read back when they are undone.
+class UndoHistory : private TileRecorder {
+public:
+    explicit UndoHistory(size_t memoryBudget = 256u << 20);
+    ~UndoHistory();
+
+    UndoHistory(const UndoHistory&) = delete;
+    UndoHistory& operator=(const UndoHistory&) = delete;
+
+    // Edits to any of the layers between beginStep() and endStep() form one step.
+    // Steps that end up changing no pixels are dropped.
+    void beginStep(const std::string& label, const std::vector<Layer*>& layers);
+    void endStep();
+    bool isRecording() const { return recording != nullptr; }
+
+    // Undo/redo on the layers the step was recorded on
+    bool canUndo() const;
+    bool canRedo() const;
+    std::string getUndoLabel() const;
+    std::string getRedoLabel() const;
+    bool undo();
+    bool redo();
+
+    // Remove everything recorded for a layer that is about to be destroyed
+    void forgetLayer(const Layer* layer);
+
+    // Drop all steps
+    void clear();
+
+    // Memory held by steps in RAM; beyond the budget, steps are spilled to disk
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const;
+    size_t getMemoryUsage() const;
+    uint64_t getSpilledBytes() const;
+
+private:
+    // Pixels of one tile, raw or TileCodec-encoded, in memory or spilled
+    struct TileImage {
+        Layer* layer = nullptr;
+        uint32_t tile = 0;
+        int layerWidth = 0;         // layer size at capture, to skip tiles of resized layers
+        int layerHeight = 0;
+        int channels = 4;
+        bool encoded = false;
+        uint8_t codec = 0;
+        std::shared_ptr<const std::vector<unsigned char>> bytes;   // null while spilled
+        uint64_t spillOffset = 0;
+        uint32_t spillSize = 0;
+    };
+
+    struct Step {
+        std::string label;
+        std::vector<TileImage> tiles;
+        bool compressed = false;    // no raw tiles left for the worker
+    };
+
+    using StepList = std::deque<std::shared_ptr<Step>>;
+
+    struct TrackedLayer {
+        Layer* layer;
+        std::vector<bool> captured;
+    };
+
+    // Step being recorded, by whichever thread holds the layers (the paint
+    // worker for strokes); the spill worker never touches it
+    std::unique_ptr<Step> recording;
+    std::unordered_map<const Layer*, TrackedLayer> trackedLayers;
+
+    // Shared with the worker
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    StepList undoSteps;
+    StepList redoSteps;
+    size_t memoryBudget;
+    bool spillFailed;
+    bool stopping;
+
+    // Spill file, guarded by spillMutex. Lock order is mutex, then spillMutex.
+    // The generation changes whenever the file is emptied.
+    std::mutex spillMutex;
+    std::fstream spillFile;
+    std::string spillPath;
+    uint64_t spillEnd;
+    uint64_t spillGeneration;
+
+    std::thread worker;
+
+    void recordTile(const Layer& layer, size_t tile) override;
+
+    // Move a step from one stack to the other, swapping its tiles with the layers
+    bool swapStep(StepList& from, StepList& to);
+
+    // Pixels of a tile image, decoded and read back from the spill file as needed
+    bool loadImage(const TileImage& image, std::vector<unsigned char>& pixels);
+
+    // Callers hold mutex
+    size_t memoryUsage() const;
+    uint64_t spilledBytes() const;
+    std::shared_ptr<Step> nextUncompressed() const;
+    std::shared_ptr<Step> nextToSpill() const;
+    bool hasWork() const;
+    void resetSpillFile();
+
+    // Worker thread loop
+    void run();
+    void compress(const std::shared_ptr<Step>& step, std::unique_lock<std::mutex>& lock);
+    void spill(const std::shared_ptr<Step>& step, std::unique_lock<std::mutex>& lock);
+};
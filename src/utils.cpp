@@ -1,5 +1,6 @@
 #include "utils.h"
 #include <filesystem>
+#include <atomic>
 
 namespace Utils {
     glm::vec2 worldToTextureCoord(const glm::vec3& worldPos, int textureWidth, int textureHeight) {
@@ -33,4 +34,9 @@ namespace Utils {
         std::filesystem::path p(path);
         return p.extension().string();
     }
+    
+    uint64_t nextChangeStamp() {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
 }
@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 #include <string>
+#include <cstdint>
 
 namespace Utils {
     // Convert a world-space position to texture coordinates
@@ -15,4 +16,8 @@ namespace Utils {
     
     // Get file extension
     std::string getFileExtension(const std::string& path);
+    
+    // Monotonic, thread-safe counter for marking when something changed;
+    // a larger stamp always means a later change
+    uint64_t nextChangeStamp();
 }